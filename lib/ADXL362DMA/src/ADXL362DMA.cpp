@@ -221,7 +221,8 @@ void ADXL362DMA::cleanBuffer(ADXL362DataBase *data) {
 	partialSampleBytesCount = 0;
 
 	for(data->startOffset = 0; data->startOffset < data->bytesRead; data->startOffset += 2) {
-		uint8_t dataType = (data->buf[data->startOffset] >> 6) & 0x3;
+		// Entries are LSB first, the axis tag is in the top 2 bits of the MSB
+		uint8_t dataType = (data->buf[data->startOffset + 1] >> 6) & 0x3;
 		if (dataType == 0x0) { // x-axis
 			break;
 		}
@@ -236,6 +237,263 @@ void ADXL362DMA::cleanBuffer(ADXL362DataBase *data) {
 
 }
 
+bool ADXL362DMA::startStream(pin_t intPin, size_t samplesPerBurst, bool storeTemp) {
+	stopStream();
+
+	size_t entriesPerSample = storeTemp ? 4 : 3;
+	if (samplesPerBurst == 0 || samplesPerBurst * entriesPerSample > FIFO_MAX_ENTRIES) {
+		return false;
+	}
+	streamBurstEntries = samplesPerBurst * entriesPerSample;
+
+	// The transfer is the read FIFO command byte followed by the entries
+	size_t transferSize = streamBurstEntries * 2 + 1;
+	streamTx = new uint8_t[transferSize];
+	for(size_t ii = 0; ii < STREAM_NUM_BUFFERS; ii++) {
+		streamBuf[ii] = new uint8_t[transferSize];
+	}
+	if (!streamTx || !streamBuf[0] || !streamBuf[1]) {
+		streamFree();
+		return false;
+	}
+	memset(streamTx, 0, transferSize);
+	streamTx[0] = CMD_READ_FIFO;
+
+	// Disabling the FIFO in standby clears it, so the first entry will be an x value
+	setMeasureMode(false);
+	writeFifoControlAndSamples(0, storeTemp, FIFO_DISABLED);
+	writeFifoControlAndSamples(streamBurstEntries, storeTemp, FIFO_STREAM);
+	writeIntmap1(INTMAP_FIFO_WATERMARK);
+
+	streamNumFilled = streamNumConsumed = 0;
+	streamOverflowCount = streamResyncCount = 0;
+	streamBusy = streamPending = false;
+	streamIntPin = intPin;
+	readFifoObject = this;
+
+	setMeasureMode(true);
+
+	// Hold the bus for the duration of streaming so the ISR only needs to set CS and start the DMA
+	if (!initialized) {
+		initialized = true;
+		spi.begin(cs);
+	}
+	spi.beginTransaction(settings);
+	streaming = true;
+
+	pinMode(intPin, INPUT);
+	attachInterrupt(intPin, &ADXL362DMA::streamInterrupt, this, RISING);
+
+	// The watermark may already have been reached, in which case there won't be a rising edge
+	ATOMIC_BLOCK() {
+		if (pinReadFast(streamIntPin)) {
+			streamStartBurst();
+		}
+	}
+	return true;
+}
+
+void ADXL362DMA::stopStream() {
+	if (!streaming) {
+		return;
+	}
+	detachInterrupt(streamIntPin);
+	streamPending = false;
+
+	while(streamBusy) {
+		delay(1);
+	}
+	streaming = false;
+	spi.endTransaction();
+
+	writeIntmap1(0);
+	writeFifoControlAndSamples(0, storeTemp, FIFO_DISABLED);
+
+	streamFree();
+}
+
+size_t ADXL362DMA::readStream(int16_t *x, int16_t *y, int16_t *z, int16_t *t, uint32_t *sequence) {
+	uint32_t consumed = streamNumConsumed;
+	if (consumed == streamNumFilled) {
+		return 0;
+	}
+
+	size_t skipped;
+	size_t numSamples = decodeFifo(&streamBuf[consumed % STREAM_NUM_BUFFERS][1], streamBurstEntries, storeTemp, x, y, z, t, &skipped);
+	if (skipped) {
+		streamResyncCount++;
+	}
+	if (sequence) {
+		*sequence = consumed;
+	}
+
+	ATOMIC_BLOCK() {
+		streamNumConsumed = consumed + 1;
+
+		// Samples that arrived while both buffers were full are still in the FIFO
+		if (streamPending || pinReadFast(streamIntPin)) {
+			streamStartBurst();
+		}
+	}
+	return numSamples;
+}
+
+void ADXL362DMA::streamInterrupt() {
+	streamStartBurst();
+}
+
+void ADXL362DMA::streamStartBurst() {
+	if (!streaming || streamBusy) {
+		// The completion callback checks INT1 again
+		return;
+	}
+	if ((streamNumFilled - streamNumConsumed) >= STREAM_NUM_BUFFERS) {
+		if (!streamPending) {
+			streamPending = true;
+			streamOverflowCount++;
+		}
+		return;
+	}
+	streamPending = false;
+	streamBusy = true;
+
+	pinResetFast(cs);
+	spi.transfer(streamTx, streamBuf[streamNumFilled % STREAM_NUM_BUFFERS], streamBurstEntries * 2 + 1, streamCallbackInternal);
+}
+
+// [static]
+void ADXL362DMA::streamCallbackInternal(void) {
+	ADXL362DMA *obj = readFifoObject;
+
+	pinSetFast(obj->cs);
+	obj->streamNumFilled++;
+	obj->streamBusy = false;
+
+	// INT1 stays high while the FIFO is at or above the watermark, so there won't be another edge
+	if (pinReadFast(obj->streamIntPin)) {
+		obj->streamStartBurst();
+	}
+}
+
+void ADXL362DMA::streamFree() {
+	if (streamTx) {
+		delete[] streamTx;
+		streamTx = 0;
+	}
+	for(size_t ii = 0; ii < STREAM_NUM_BUFFERS; ii++) {
+		if (streamBuf[ii]) {
+			delete[] streamBuf[ii];
+			streamBuf[ii] = 0;
+		}
+	}
+}
+
+// Sign extend two 14-bit entries packed in a 32-bit word (first entry in the low half), removing the axis tags
+static inline uint32_t signExtend14x2(uint32_t word) {
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+	// Flipping the sign bit and subtracting it sign extends; SSUB16 does both halves without a borrow between them
+	return __SSUB16((word & 0x3fff3fff) ^ 0x20002000, 0x20002000);
+#else
+	uint32_t lo = (uint16_t)(((word & 0x3fff) ^ 0x2000) - 0x2000);
+	uint32_t hi = (uint16_t)((((word >> 16) & 0x3fff) ^ 0x2000) - 0x2000);
+	return lo | (hi << 16);
+#endif
+}
+
+static inline uint32_t loadWord(const uint8_t *src) {
+	uint32_t word;
+	memcpy(&word, src, sizeof(word));
+	return word;
+}
+
+// [static]
+size_t ADXL362DMA::decodeFifo(const uint8_t *src, size_t numEntries, bool storeTemp, int16_t *x, int16_t *y, int16_t *z, int16_t *t, size_t *skipped) {
+	// Axis tags: x = 0, y = 1, z = 2, t = 3 in the top 2 bits of each entry
+	const uint32_t TAG_MASK = 0xc000c000;
+	const size_t entriesPerSample = storeTemp ? 4 : 3;
+
+	size_t numSamples = 0;
+	size_t numSkipped = 0;
+	size_t entry = 0;
+
+	while(numEntries - entry >= entriesPerSample) {
+		const uint8_t *p = &src[entry * 2];
+
+		if (storeTemp) {
+			// One sample is two words: [x y] [z t]
+			uint32_t w0 = loadWord(p);
+			uint32_t w1 = loadWord(p + 4);
+			if ((w0 & TAG_MASK) == 0x40000000 && (w1 & TAG_MASK) == 0xc0008000) {
+				w0 = signExtend14x2(w0);
+				w1 = signExtend14x2(w1);
+				x[numSamples] = (int16_t) w0;
+				y[numSamples] = (int16_t)(w0 >> 16);
+				z[numSamples] = (int16_t) w1;
+				if (t) {
+					t[numSamples] = (int16_t)(w1 >> 16);
+				}
+				numSamples++;
+				entry += 4;
+				continue;
+			}
+		}
+		else
+		if (numEntries - entry >= 6) {
+			// Two samples are three words: [x0 y0] [z0 x1] [y1 z1]
+			uint32_t w0 = loadWord(p);
+			uint32_t w1 = loadWord(p + 4);
+			uint32_t w2 = loadWord(p + 8);
+			if ((w0 & TAG_MASK) == 0x40000000 && (w1 & TAG_MASK) == 0x00008000 && (w2 & TAG_MASK) == 0x80004000) {
+				w0 = signExtend14x2(w0);
+				w1 = signExtend14x2(w1);
+				w2 = signExtend14x2(w2);
+				x[numSamples] = (int16_t) w0;
+				y[numSamples] = (int16_t)(w0 >> 16);
+				z[numSamples] = (int16_t) w1;
+				x[numSamples + 1] = (int16_t)(w1 >> 16);
+				y[numSamples + 1] = (int16_t) w2;
+				z[numSamples + 1] = (int16_t)(w2 >> 16);
+				numSamples += 2;
+				entry += 6;
+				continue;
+			}
+		}
+
+		// Single sample: the last odd XYZ sample, or realigning after a tag mismatch
+		uint16_t e[4];
+		memcpy(e, p, entriesPerSample * 2);
+		bool valid = true;
+		for(size_t ii = 0; ii < entriesPerSample; ii++) {
+			if ((e[ii] >> 14) != ii) {
+				valid = false;
+				break;
+			}
+		}
+		if (!valid) {
+			// Skip one entry and look for the next x value
+			entry++;
+			numSkipped++;
+			continue;
+		}
+
+		uint32_t xy = signExtend14x2(e[0] | ((uint32_t)e[1] << 16));
+		uint32_t zt = signExtend14x2(e[2] | ((storeTemp ? (uint32_t)e[3] : 0) << 16));
+		x[numSamples] = (int16_t) xy;
+		y[numSamples] = (int16_t)(xy >> 16);
+		z[numSamples] = (int16_t) zt;
+		if (storeTemp && t) {
+			t[numSamples] = (int16_t)(zt >> 16);
+		}
+		numSamples++;
+		entry += entriesPerSample;
+	}
+
+	if (skipped) {
+		*skipped = numSkipped;
+	}
+	return numSamples;
+}
+
 
 void ADXL362DMA::writeActivityThreshold(uint16_t value) { // value is an 11-bit integer
 	writeRegister16(REG_THRESH_ACT_L, value);
@@ -497,13 +755,14 @@ It is recommended that an even number of bytes be read (using a multibyte transa
 
 
 int16_t ADXL362DataBase::readSigned14(const uint8_t *pValue) const {
-	uint8_t msb = pValue[0] & 0x3f;
+	// LSB first, then the MSB with the axis tag in the top 2 bits
+	uint8_t msb = pValue[1] & 0x3f;
 	if (msb & 0x20) {
 		// Add in sign extension
 		msb |= 0xc0;
 	}
 
-	return ((int16_t) pValue[1] | (msb << 8));
+	return (int16_t)(pValue[0] | (msb << 8));
 }
 
 int16_t ADXL362DataBase::readX(size_t index) const {
@@ -189,10 +189,111 @@ public:
 	/**
 	 * @brief Reads entries from the FIFO asynchronously using SPI DMA
 	 * 
-	 * Warning: This API appears to be returning incorrect data. Use the readXYZ() instead.
+	 * This reads the number of FIFO entries synchronously first, then starts the DMA. For continuous
+	 * sampling, startStream() is more efficient.
 	 */
 	void readFifoAsync(ADXL362DataBase *data);
 
+	/**
+	 * @brief Start continuous streaming from the FIFO using the watermark interrupt and SPI DMA
+	 * 
+	 * @param intPin The pin connected to INT1 on the ADXL362
+	 * 
+	 * @param samplesPerBurst Number of XYZ or XYZT samples to read per SPI DMA transfer. The FIFO watermark
+	 * is set to this many samples, so the maximum is 170 for XYZ or 127 for XYZT (511 FIFO entries).
+	 * 
+	 * @param storeTemp true to store XYZT samples (with temperature), false for XYZ only
+	 * 
+	 * @return true if streaming started, false if samplesPerBurst is out of range or memory could not
+	 * be allocated.
+	 * 
+	 * The FIFO is set to stream mode with a watermark interrupt mapped to INT1, active high. When the FIFO
+	 * reaches the watermark, the interrupt handler starts a SPI DMA transfer of exactly samplesPerBurst samples
+	 * into one of two buffers, so there's no synchronous read of the number of FIFO entries and no work other
+	 * than starting the DMA in the interrupt. If INT1 is still asserted when the transfer completes, the next
+	 * transfer is started immediately into the other buffer.
+	 * 
+	 * Set the sample rate and range before calling this; streaming turns on measure mode. The SPI bus is held
+	 * (spi.beginTransaction) until stopStream() is called, so don't use other devices on the same SPI bus or
+	 * call the register read and write methods while streaming.
+	 */
+	bool startStream(pin_t intPin, size_t samplesPerBurst, bool storeTemp = false);
+
+	/**
+	 * @brief Stop streaming. Waits for a transfer in progress to complete and disables the FIFO.
+	 * 
+	 * Samples that have been read but not retrieved with readStream() are discarded.
+	 */
+	void stopStream();
+
+	/**
+	 * @brief Returns true if startStream() has been called and stopStream() has not
+	 */
+	bool isStreaming() const { return streaming; };
+
+	/**
+	 * @brief Returns true if a burst of samples is available to read using readStream()
+	 */
+	bool streamAvailable() const { return streamNumConsumed != streamNumFilled; };
+
+	/**
+	 * @brief Decode the oldest burst of samples into separate x, y, z, and optionally t arrays
+	 * 
+	 * @param x Array of at least samplesPerBurst samples for the x values
+	 * @param y Array of at least samplesPerBurst samples for the y values
+	 * @param z Array of at least samplesPerBurst samples for the z values
+	 * @param t Array of at least samplesPerBurst samples for temperature values, or NULL to ignore them. 
+	 * Only filled in if storeTemp was true.
+	 * @param sequence If not NULL, filled in with the sequence number of the burst. It starts at 0 and
+	 * increments by 1 for each burst read from the FIFO.
+	 * 
+	 * @return Number of samples decoded, 0 if there is no burst available. This is normally samplesPerBurst, 
+	 * but can be less if the FIFO overflowed and samples had to be skipped to realign on an x value.
+	 * 
+	 * The buffer is returned to the DMA after decoding, so call this often enough that the FIFO doesn't fill.
+	 */
+	size_t readStream(int16_t *x, int16_t *y, int16_t *z, int16_t *t = NULL, uint32_t *sequence = NULL);
+
+	/**
+	 * @brief Number of bursts read from the FIFO since startStream()
+	 */
+	uint32_t getStreamSequence() const { return streamNumFilled; };
+
+	/**
+	 * @brief Number of times the watermark was reached while both buffers were waiting for readStream()
+	 * 
+	 * The samples stay in the FIFO and are read when a buffer is freed, but if this keeps happening the FIFO
+	 * will fill and the oldest samples are lost.
+	 */
+	uint32_t getStreamOverflowCount() const { return streamOverflowCount; };
+
+	/**
+	 * @brief Number of bursts where FIFO entries had to be skipped to realign on an x value
+	 * 
+	 * This happens after the FIFO fills and the ADXL362 discards old entries.
+	 */
+	uint32_t getStreamResyncCount() const { return streamResyncCount; };
+
+	/**
+	 * @brief Decode raw FIFO entries into separate x, y, z, and t arrays
+	 * 
+	 * @param src Raw FIFO data, 2 bytes per entry
+	 * @param numEntries Number of 2-byte entries in src
+	 * @param storeTemp true if the entries are XYZT, false if XYZ
+	 * @param x Filled in with the x values. Must have room for numEntries / 3 (XYZ) or numEntries / 4 (XYZT) values.
+	 * @param y Filled in with the y values
+	 * @param z Filled in with the z values
+	 * @param t Filled in with the temperature values, can be NULL
+	 * @param skipped If not NULL, filled in with the number of entries skipped to realign on an x value
+	 * 
+	 * @return Number of samples decoded
+	 * 
+	 * Each entry has a 2-bit axis tag and a 14-bit sign extended value. The tags of each sample are checked
+	 * and the values are sign extended two at a time using 16-bit SIMD instructions on Cortex-M4 and M33.
+	 * Entries before the first x value and any partial sample are skipped.
+	 */
+	static size_t decodeFifo(const uint8_t *src, size_t numEntries, bool storeTemp, int16_t *x, int16_t *y, int16_t *z, int16_t *t, size_t *skipped = NULL);
+
 	/**
 	 * @brief Write the activity threshold register
 	 * 
@@ -514,6 +615,11 @@ public:
 	 */
 	void writeRegister16(uint8_t addr, uint16_t value);
 
+	/**
+	 * @brief Returns the range in g (2, 4, or 8) set by writeFilterControl(range, halfBW, extSample, odr)
+	 */
+	uint8_t getRangeG() const { return rangeG; };
+
 	/**
 	 * @brief Returns the number of bytes for a full XYZ or XYZT FIFO entry depending on the storeTemp flag
 	 */
@@ -632,6 +738,9 @@ public:
 	static const uint8_t MEASURE_STANDBY = 0x0;			//!< Standby mode
 	static const uint8_t MEASURE_MEASUREMENT = 0x2;		//!< Measurement mode
 
+	static const size_t FIFO_MAX_ENTRIES = 511;			//!< Maximum number of 2-byte entries in the FIFO
+	static const size_t STREAM_NUM_BUFFERS = 2;			//!< Number of DMA buffers used by startStream()
+
 	static const int STATE_FREE = 0;			//!< ADXL362DataEx Not currently in use
 	static const int STATE_READING_FIFO = 1;	//!< ADXL362DataEx Reading FIFO by SPI DMA
 	static const int STATE_READ_COMPLETE = 2;	//!< ADXL362DataEx Reading complete
@@ -649,6 +758,26 @@ private:
 
 	static void readFifoCallbackInternal(void);
 
+	/**
+	 * @brief INT1 interrupt handler when streaming
+	 */
+	void streamInterrupt();
+
+	/**
+	 * @brief Start a DMA transfer of one burst if a buffer is free. Called from an ISR or with interrupts disabled.
+	 */
+	void streamStartBurst();
+
+	/**
+	 * @brief SPI DMA completion callback when streaming, called from an ISR
+	 */
+	static void streamCallbackInternal(void);
+
+	/**
+	 * @brief Free the streaming buffers
+	 */
+	void streamFree();
+
 	void cleanBuffer(ADXL362DataBase *data);
 
 	SPIClass &spi; //!< SPI interface, typically SPI or SPI1
@@ -660,6 +789,18 @@ private:
 	size_t  partialSampleBytesCount = 0;
 	bool initialized = false; //!< Set to true after SPI initialization has occurred
 
+	bool streaming = false; //!< startStream() has been called
+	pin_t streamIntPin = PIN_INVALID; //!< Pin connected to INT1 when streaming
+	size_t streamBurstEntries = 0; //!< FIFO entries (2 bytes each) per burst
+	uint8_t *streamTx = 0; //!< Read FIFO command followed by zeros, streamBurstEntries * 2 + 1 bytes
+	uint8_t *streamBuf[STREAM_NUM_BUFFERS] = {0}; //!< DMA buffers. The first byte is received during the command byte.
+	volatile bool streamBusy = false; //!< A DMA transfer is in progress
+	volatile bool streamPending = false; //!< Watermark reached while no buffer was free
+	volatile uint32_t streamNumFilled = 0; //!< Bursts read from the FIFO. Buffer index is this modulo STREAM_NUM_BUFFERS.
+	volatile uint32_t streamNumConsumed = 0; //!< Bursts decoded by readStream()
+	volatile uint32_t streamOverflowCount = 0; //!< Watermark reached with no free buffer
+	uint32_t streamResyncCount = 0; //!< Bursts that needed realignment
+
 };
 
 
@@ -0,0 +1,259 @@
+#ifndef __ADXL362SIGNAL_H
+#define __ADXL362SIGNAL_H
+
+// Adapter from ADXL362DMA FIFO data to an Edge Impulse signal_t
+// Github: https://github.com/rickkas7/ADXL362DMA
+// License: MIT
+//
+// This header is only used with an Edge Impulse C++ library export in the project, it's not included by
+// ADXL362DMA.h. Include it after the Edge Impulse inferencing header.
+
+#include "ADXL362DMA.h"
+#include "edge-impulse-sdk/dsp/numpy_types.h"
+#include "edge-impulse-sdk/dsp/returntypes.hpp"
+
+#if !EIDSP_SIGNAL_C_FN_POINTER
+
+/**
+ * @brief Ring buffer of accelerometer samples that can be passed directly to run_classifier() as a signal_t
+ *
+ * @param NUM_SAMPLES Number of XYZ samples to keep. This must be at least the model window size
+ * (EI_CLASSIFIER_RAW_SAMPLE_COUNT). Making it larger allows new samples to be added while the classifier is
+ * reading an older window.
+ *
+ * Samples are stored as int16_t in separate x, y, and z planes, 6 bytes per sample instead of the 12 bytes
+ * per sample of an interleaved float buffer. FIFO data is decoded directly into the ring, and the conversion
+ * to float happens in get_data as the DSP block reads the signal, producing the interleaved XYZ layout
+ * that the Edge Impulse spectral analysis block expects. There's no intermediate float buffer and no
+ * SignalWithAxes copy.
+ *
+ * Values are left as raw ADXL362 counts. Use scaleAxesForRange() to fold the conversion to m/s^2 into
+ * the scale_axes of the DSP block configuration so the scaling is done in the block's existing scale
+ * pass instead of a separate one.
+ */
+template <size_t NUM_SAMPLES>
+class ADXL362Signal {
+public:
+	/**
+	 * @brief Number of samples decoded at a time. This is the maximum burst size for startStream (170 XYZ samples).
+	 */
+	static const size_t MAX_BLOCK_SAMPLES = ADXL362DMA::FIFO_MAX_ENTRIES / 3;
+
+	/**
+	 * @brief Number of axes in the signal (x, y, z)
+	 */
+	static const size_t NUM_AXES = 3;
+
+	/**
+	 * @brief Constructor. The buffer is static, so this is usually a global variable.
+	 */
+	ADXL362Signal() {
+		static_assert(NUM_SAMPLES >= MAX_BLOCK_SAMPLES, "NUM_SAMPLES must be at least MAX_BLOCK_SAMPLES");
+
+		signal.total_length = 0;
+		signal.get_data = [this](size_t offset, size_t length, float *out_ptr) {
+			return this->get_data(offset, length, out_ptr);
+		};
+	}
+
+	/**
+	 * @brief Decode the oldest burst from ADXL362DMA::startStream() directly into the ring
+	 *
+	 * @param accel The accelerometer object that is streaming. The samples per burst must be no more than MAX_BLOCK_SAMPLES.
+	 *
+	 * @return Number of samples added, 0 if there was no burst available
+	 */
+	size_t readStream(ADXL362DMA &accel) {
+		size_t numSamples = accel.readStream(&planes[0][writeIndex], &planes[1][writeIndex], &planes[2][writeIndex]);
+		commit(numSamples);
+		return numSamples;
+	}
+
+	/**
+	 * @brief Decode a completed ADXL362DMA::readFifoAsync() buffer into the ring
+	 *
+	 * @param data The buffer, in STATE_READ_COMPLETE. Temperature values, if stored, are ignored.
+	 *
+	 * @return Number of samples added
+	 */
+	size_t addFifo(const ADXL362DataBase *data) {
+		const size_t entriesPerSample = data->storeTemp ? 4 : 3;
+		const uint8_t *src = &data->buf[data->startOffset];
+		size_t numEntries = data->numSamplesRead * entriesPerSample;
+		size_t numAdded = 0;
+
+		while(numEntries > 0) {
+			size_t blockEntries = numEntries;
+			if (blockEntries > MAX_BLOCK_SAMPLES * entriesPerSample) {
+				blockEntries = MAX_BLOCK_SAMPLES * entriesPerSample;
+			}
+			size_t numSamples = ADXL362DMA::decodeFifo(src, blockEntries, data->storeTemp, &planes[0][writeIndex], &planes[1][writeIndex], &planes[2][writeIndex], NULL);
+			commit(numSamples);
+			numAdded += numSamples;
+
+			src += blockEntries * 2;
+			numEntries -= blockEntries;
+		}
+		return numAdded;
+	}
+
+	/**
+	 * @brief Add samples that are already in separate x, y, and z arrays
+	 *
+	 * @return Number of samples added (always numSamples)
+	 */
+	size_t addSamples(const int16_t *x, const int16_t *y, const int16_t *z, size_t numSamples) {
+		for(size_t ii = 0; ii < numSamples; ) {
+			size_t count = numSamples - ii;
+			if (count > MAX_BLOCK_SAMPLES) {
+				count = MAX_BLOCK_SAMPLES;
+			}
+			memcpy(&planes[0][writeIndex], &x[ii], count * sizeof(int16_t));
+			memcpy(&planes[1][writeIndex], &y[ii], count * sizeof(int16_t));
+			memcpy(&planes[2][writeIndex], &z[ii], count * sizeof(int16_t));
+			commit(count);
+			ii += count;
+		}
+		return numSamples;
+	}
+
+	/**
+	 * @brief Get a signal for the most recent window of samples
+	 *
+	 * @param windowSamples Number of XYZ samples in the window, typically EI_CLASSIFIER_RAW_SAMPLE_COUNT
+	 *
+	 * @return signal_t* Pass this to run_classifier() or run_classifier_continuous(), or NULL if there aren't
+	 * windowSamples samples yet.
+	 *
+	 * The window is fixed when this is called. Samples added afterwards don't affect it until they overwrite
+	 * it, which happens after NUM_SAMPLES - windowSamples more samples have been added.
+	 */
+	ei::signal_t *getSignal(size_t windowSamples = NUM_SAMPLES) {
+		if (windowSamples > NUM_SAMPLES || windowSamples > getNumSamples()) {
+			return NULL;
+		}
+		windowStart = (writeIndex + NUM_SAMPLES - windowSamples) % NUM_SAMPLES;
+		signal.total_length = windowSamples * NUM_AXES;
+		return &signal;
+	}
+
+	/**
+	 * @brief Read part of the window set by getSignal() as interleaved XYZ floats
+	 *
+	 * @param offset Offset in floats (3 per sample)
+	 * @param length Number of floats to read
+	 * @param out_ptr Buffer to write to
+	 *
+	 * @return 0 on success, or EIDSP_OUT_OF_BOUNDS
+	 */
+	int get_data(size_t offset, size_t length, float *out_ptr) {
+		if (offset + length > signal.total_length) {
+			return ei::EIDSP_OUT_OF_BOUNDS;
+		}
+
+		size_t index = (windowStart + offset / NUM_AXES) % NUM_SAMPLES;
+		size_t axis = offset % NUM_AXES;
+
+		// Partial sample at the start
+		while(length > 0 && axis != 0) {
+			*out_ptr++ = (float)planes[axis][index];
+			length--;
+			if (++axis == NUM_AXES) {
+				axis = 0;
+				index = (index + 1) % NUM_SAMPLES;
+			}
+		}
+
+		// Whole samples, in runs that end at the end of the ring
+		size_t numSamples = length / NUM_AXES;
+		while(numSamples > 0) {
+			size_t count = NUM_SAMPLES - index;
+			if (count > numSamples) {
+				count = numSamples;
+			}
+			const int16_t *x = &planes[0][index];
+			const int16_t *y = &planes[1][index];
+			const int16_t *z = &planes[2][index];
+			for(size_t ii = 0; ii < count; ii++) {
+				out_ptr[0] = (float)x[ii];
+				out_ptr[1] = (float)y[ii];
+				out_ptr[2] = (float)z[ii];
+				out_ptr += NUM_AXES;
+			}
+			numSamples -= count;
+			index = (index + count) % NUM_SAMPLES;
+		}
+
+		// Partial sample at the end
+		for(size_t ii = 0; ii < length % NUM_AXES; ii++) {
+			*out_ptr++ = (float)planes[ii][index];
+		}
+		return 0;
+	}
+
+	/**
+	 * @brief Number of samples in the ring, up to NUM_SAMPLES
+	 */
+	size_t getNumSamples() const { return (totalSamples < NUM_SAMPLES) ? (size_t)totalSamples : NUM_SAMPLES; };
+
+	/**
+	 * @brief Total number of samples added since construction or clear()
+	 */
+	uint32_t getTotalSamples() const { return totalSamples; };
+
+	/**
+	 * @brief Remove all samples, for example after stopping and restarting the accelerometer
+	 */
+	void clear() {
+		writeIndex = windowStart = 0;
+		totalSamples = 0;
+		signal.total_length = 0;
+	}
+
+	/**
+	 * @brief Fold the conversion from raw counts to m/s^2 into a DSP block scale_axes value
+	 *
+	 * @param scaleAxes The scale_axes from the DSP block configuration in model_variables.h
+	 *
+	 * @param rangeG The accelerometer range, 2, 4, or 8, from ADXL362DMA::getRangeG()
+	 *
+	 * @return The value to use for scale_axes when the signal is raw ADXL362 counts
+	 *
+	 * The ADXL362 sensitivity is 1 mg per count at 2g, 2 mg at 4g, and 4 mg at 8g. Models trained with data
+	 * in m/s^2, which is what the Edge Impulse data forwarder and mobile client use, need this conversion.
+	 * For example:
+	 *
+	 * ei_dsp_config_3.scale_axes = ADXL362Signal<256>::scaleAxesForRange(ei_dsp_config_3.scale_axes, accel.getRangeG());
+	 */
+	static float scaleAxesForRange(float scaleAxes, uint8_t rangeG) {
+		return scaleAxes * ((float)rangeG / 2.0f) * 0.001f * 9.80665f;
+	}
+
+protected:
+	/**
+	 * @brief Advance the write position after numSamples were written at writeIndex
+	 *
+	 * Decoding always writes contiguously at writeIndex, so samples past the end of the ring land in the
+	 * spare space after it and are moved to the beginning.
+	 */
+	void commit(size_t numSamples) {
+		size_t end = writeIndex + numSamples;
+		if (end > NUM_SAMPLES) {
+			for(size_t axis = 0; axis < NUM_AXES; axis++) {
+				memcpy(&planes[axis][0], &planes[axis][NUM_SAMPLES], (end - NUM_SAMPLES) * sizeof(int16_t));
+			}
+		}
+		writeIndex = end % NUM_SAMPLES;
+		totalSamples += numSamples;
+	}
+
+	int16_t planes[NUM_AXES][NUM_SAMPLES + MAX_BLOCK_SAMPLES]; //!< x, y, z samples, with room to decode a block past the end
+	size_t writeIndex = 0; //!< Index in planes to write the next sample
+	size_t windowStart = 0; //!< Index in planes of the first sample of the window set by getSignal()
+	uint32_t totalSamples = 0; //!< Number of samples added
+	ei::signal_t signal; //!< Signal returned by getSignal()
+};
+
+#endif // !EIDSP_SIGNAL_C_FN_POINTER
+
+#endif /* __ADXL362SIGNAL_H */
@@ -0,0 +1,83 @@
+#include "Microphone_PDM.h"
+#include "MicWavRecorder.h"
+
+// This example records a wav file to the flash file system. Press the MODE button to start
+// recording and again to stop. Each recording replaces /usr/audio.wav.
+
+SYSTEM_THREAD(ENABLED);
+SYSTEM_MODE(SEMI_AUTOMATIC);
+
+SerialLogHandler logHandler;
+
+// Maximum recording length in milliseconds, if the MODE button isn't pressed to stop
+const unsigned long MAX_RECORDING_LENGTH_MS = 60000;
+
+// Forward declarations
+void buttonHandler(system_event_t event, int data);
+
+bool buttonClicked = false;
+Microphone_PDM_WavRecorder *recorder = 0;
+
+void setup() {
+	Particle.connect();
+
+	// Register handler to handle clicking on the SETUP button
+	System.on(button_click, buttonHandler);
+
+	// Blue D7 LED indicates recording is on
+	pinMode(D7, OUTPUT);
+	digitalWrite(D7, LOW);
+
+	int err = Microphone_PDM::instance()
+		.withOutputSize(Microphone_PDM::OutputSize::SIGNED_16)
+		.withRange(Microphone_PDM::Range::RANGE_2048)
+		.withSampleRate(16000)
+		.init();
+
+	if (err) {
+		Log.error("PDM decoder init err=%d", err);
+	}
+
+	err = Microphone_PDM::instance().start();
+	if (err) {
+		Log.error("PDM decoder start err=%d", err);
+	}
+}
+
+void loop() {
+	Microphone_PDM::instance().loop();
+
+	if (buttonClicked) {
+		buttonClicked = false;
+
+		if (recorder && !recorder->done()) {
+			// Stop early. The close callback is called when the file is closed.
+			recorder->stop();
+		}
+		else {
+			digitalWrite(D7, HIGH);
+
+			recorder = new Microphone_PDM_WavRecorder();
+			recorder->withFile("/usr/audio.wav")
+				.withDurationMs(MAX_RECORDING_LENGTH_MS)
+				.withCloseCallback([](int result, uint32_t dataSize) {
+					digitalWrite(D7, LOW);
+					Log.info("recording closed result=%d dataSize=%lu dropped=%lu",
+						result, dataSize, recorder->getDroppedChunkCount());
+				});
+
+			if (!Microphone_PDM::instance().bufferSamplingStart(recorder)) {
+				Log.error("failed to start recording result=%d", recorder->getResult());
+				digitalWrite(D7, LOW);
+				Microphone_PDM::instance().releaseBufferSampling();
+				recorder = 0;
+			}
+		}
+	}
+}
+
+
+// button handler for the SETUP button, used to toggle recording on and off
+void buttonHandler(system_event_t event, int data) {
+	buttonClicked = true;
+}
@@ -0,0 +1,65 @@
+#ifndef __MICROPHONE_PDM_HOST_PARTICLE_H
+#define __MICROPHONE_PDM_HOST_PARTICLE_H
+
+// Minimal stand-in for the Device OS Particle.h, so the Microphone_PDM library can be built on a
+// computer with the Microphone_PDM_Host simulator backend. Only what the library itself uses is here.
+//
+// Add this directory to the include path before the library src directory and define MICROPHONE_PDM_HOST=1.
+// It is never used in device builds.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+
+typedef uint16_t pin_t;
+
+const pin_t A0 = 19;
+const pin_t A1 = 18;
+
+// Same values as system_error.h in Device OS
+enum {
+	SYSTEM_ERROR_NONE = 0,
+	SYSTEM_ERROR_NOT_SUPPORTED = -120,
+	SYSTEM_ERROR_NOT_ALLOWED = -130,
+	SYSTEM_ERROR_NOT_FOUND = -170,
+	SYSTEM_ERROR_ALREADY_EXISTS = -180,
+	SYSTEM_ERROR_LIMIT_EXCEEDED = -200,
+	SYSTEM_ERROR_INVALID_STATE = -210,
+	SYSTEM_ERROR_IO = -220,
+	SYSTEM_ERROR_NO_MEMORY = -260,
+	SYSTEM_ERROR_INVALID_ARGUMENT = -270
+};
+
+inline uint32_t micros() {
+	return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t millis() {
+	return (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Writes log messages to stderr, in place of the Device OS Logger
+ */
+class HostLogger {
+public:
+	void trace(const char *fmt, ...) const { va_list ap; va_start(ap, fmt); write("TRACE", fmt, ap); va_end(ap); }
+	void info(const char *fmt, ...) const { va_list ap; va_start(ap, fmt); write("INFO", fmt, ap); va_end(ap); }
+	void warn(const char *fmt, ...) const { va_list ap; va_start(ap, fmt); write("WARN", fmt, ap); va_end(ap); }
+	void error(const char *fmt, ...) const { va_list ap; va_start(ap, fmt); write("ERROR", fmt, ap); va_end(ap); }
+
+protected:
+	void write(const char *level, const char *fmt, va_list ap) const {
+		fprintf(stderr, "%010lu [app] %s: ", (unsigned long) millis(), level);
+		vfprintf(stderr, fmt, ap);
+		fputc('\n', stderr);
+	}
+};
+
+static const HostLogger Log;
+
+#endif /* __MICROPHONE_PDM_HOST_PARTICLE_H */
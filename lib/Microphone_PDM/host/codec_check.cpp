@@ -0,0 +1,336 @@
+// Round trip checks for MicAudioEncoder and the wav files written by Microphone_PDM_WavRecorder, run on
+// a computer with the host simulator. From the root of the repository:
+//
+// g++ -std=c++14 -O2 -DMICROPHONE_PDM_HOST=1 -Ilib/Microphone_PDM/host -Ilib/Microphone_PDM/src lib/Microphone_PDM/host/codec_check.cpp lib/Microphone_PDM/src/*.cpp -pthread -o codec_check
+// ./codec_check
+//
+// - mu-law: every 16-bit sample is encoded and decoded, the error must be within half a step of its segment,
+//   and every code must decode to a value that encodes back to the same code
+// - IMA ADPCM: the output must not depend on how the samples are split over encode() calls, every block
+//   must start with the exact sample, the decoded signal must be close to the original, and a full scale
+//   square wave must not wrap around
+// - wav: a recording in each format is read back, the RIFF, fmt, fact and data chunks are checked against
+//   the encoder settings, and the data must decode to the same samples as encoding the source directly
+//
+// Exits with 1 if any check fails.
+
+#include "Microphone_PDM.h"
+#include "MicWavRecorder.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static void check(bool ok, const char *fmt, ...) {
+	numChecks++;
+	if (!ok) {
+		numFailures++;
+		va_list ap;
+		va_start(ap, fmt);
+		printf("FAIL ");
+		vprintf(fmt, ap);
+		printf("\n");
+		va_end(ap);
+	}
+}
+
+static double snr(const int16_t *ref, const int16_t *test, size_t n) {
+	double signal = 0, noise = 0;
+	for(size_t ii = 0; ii < n; ii++) {
+		signal += (double)ref[ii] * ref[ii];
+		noise += ((double)ref[ii] - test[ii]) * ((double)ref[ii] - test[ii]);
+	}
+	return (noise == 0) ? 999.0 : 10 * log10(signal / noise);
+}
+
+static uint16_t getUint16LE(const uint8_t *p) {
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getUint32LE(const uint8_t *p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Speech-like test signal: two tones, a slow envelope, and noise
+static std::vector<int16_t> makeSignal(size_t numSamples) {
+	std::vector<int16_t> samples(numSamples);
+	srand(1234);
+	for(size_t ii = 0; ii < numSamples; ii++) {
+		double env = 0.5 + 0.5 * sin(ii * 0.0007);
+		samples[ii] = (int16_t)(env * (9000 * sin(ii * 0.05) + 4000 * sin(ii * 0.31)) + (rand() % 401 - 200));
+	}
+	return samples;
+}
+
+static void checkMulaw() {
+	int maxExcess = 0;
+	int prev = -32768;
+	for(int32_t sample = -32768; sample <= 32767; sample++) {
+		uint8_t code = MicAudioEncoder::mulawEncode((int16_t)sample);
+		int decoded = MicAudioEncoder::mulawDecode(code);
+
+		// With the bias of 132 added, G.711 segment seg (above 0) holds magnitudes from 128 << seg in steps of
+		// 8 << seg, decoded to the middle of the step. Magnitudes above 32635 are clipped first.
+		int mag = abs(sample);
+		int seg = 0;
+		while(seg < 7 && ((mag > 32635) ? 32635 : mag) + 132 >= (256 << seg)) {
+			seg++;
+		}
+		int halfStep = 4 << seg;
+		int expected = (mag > 32635) ? 32635 : mag;
+		int err = abs(abs(decoded) - expected);
+		if (err > halfStep && err - halfStep > maxExcess) {
+			maxExcess = err - halfStep;
+		}
+		check(decoded >= prev, "mulaw not monotonic at %d", (int)sample);
+		prev = decoded;
+	}
+	check(maxExcess == 0, "mulaw error exceeds half a step by %d", maxExcess);
+
+	for(int code = 0; code < 256; code++) {
+		int16_t decoded = MicAudioEncoder::mulawDecode((uint8_t)code);
+		uint8_t again = MicAudioEncoder::mulawEncode(decoded);
+		// 0x7f and 0xff are both 0, negative zero encodes as positive zero
+		check(again == code || (code == 0x7f && again == 0xff), "mulaw code 0x%02x decodes to %d, encodes to 0x%02x", code, decoded, again);
+	}
+	printf("mu-law: all 65536 samples and 256 codes checked\n");
+}
+
+// Encodes the samples with encode() calls of the given sizes, repeating the list, then flushes
+static std::vector<uint8_t> encodeAdpcm(const std::vector<int16_t> &samples, uint16_t blockAlign, const std::vector<size_t> &callSizes) {
+	MicAudioEncoder encoder;
+	encoder.init(MicAudioEncoder::Format::IMA_ADPCM, 1, blockAlign);
+
+	std::vector<uint8_t> out(encoder.getMaxEncodedSize(samples.size()) + blockAlign);
+	size_t len = 0;
+	size_t offset = 0;
+	for(size_t call = 0; offset < samples.size(); call++) {
+		size_t count = callSizes[call % callSizes.size()];
+		if (count > samples.size() - offset) {
+			count = samples.size() - offset;
+		}
+		len += encoder.encode(&samples[offset], count, &out[len]);
+		offset += count;
+	}
+	len += encoder.flush(&out[len]);
+	out.resize(len);
+	return out;
+}
+
+// A short last block with an odd number of nibbles decodes one padding sample, numSamples (the fact chunk
+// in a wav file) removes it
+static std::vector<int16_t> decodeAdpcm(const uint8_t *data, size_t len, uint16_t blockAlign, size_t numSamples) {
+	std::vector<int16_t> samples;
+	std::vector<int16_t> block(1 + (blockAlign - 4) * 2);
+	for(size_t offset = 0; offset < len; offset += blockAlign) {
+		size_t blockSize = (len - offset < blockAlign) ? len - offset : blockAlign;
+		size_t count = MicAudioEncoder::decodeImaAdpcmBlock(&data[offset], blockSize, block.data());
+		samples.insert(samples.end(), block.begin(), block.begin() + count);
+	}
+	if (samples.size() == numSamples + 1) {
+		samples.resize(numSamples);
+	}
+	return samples;
+}
+
+static void checkImaAdpcm() {
+	const uint16_t blockAligns[] = { 8, 36, 256, 512, 1024 };
+	std::vector<int16_t> samples = makeSignal(16000 * 3 + 123);
+
+	for(uint16_t blockAlign : blockAligns) {
+		const size_t samplesPerBlock = 1 + (blockAlign - 4) * 2;
+
+		std::vector<uint8_t> whole = encodeAdpcm(samples, blockAlign, { samples.size() });
+		std::vector<uint8_t> pieces = encodeAdpcm(samples, blockAlign, { 1, 7, 512, samplesPerBlock, 1000, 3 });
+		check(whole == pieces, "adpcm block %u: output depends on encode() call sizes", blockAlign);
+
+		std::vector<int16_t> decoded = decodeAdpcm(whole.data(), whole.size(), blockAlign, samples.size());
+		check(decoded.size() == samples.size(), "adpcm block %u: decoded %u samples, expected %u", blockAlign, (unsigned)decoded.size(), (unsigned)samples.size());
+		if (decoded.size() != samples.size()) {
+			continue;
+		}
+		for(size_t ii = 0; ii < samples.size(); ii += samplesPerBlock) {
+			check(decoded[ii] == samples[ii], "adpcm block %u: block at sample %u starts with %d, expected %d", blockAlign, (unsigned)ii, decoded[ii], samples[ii]);
+		}
+		double db = snr(samples.data(), decoded.data(), samples.size());
+		check(db > 20.0, "adpcm block %u: SNR %.1f dB", blockAlign, db);
+		printf("IMA ADPCM block %4u: %u bytes, SNR %.1f dB\n", blockAlign, (unsigned)whole.size(), db);
+	}
+
+	// Full scale square wave: the predictor has to clamp, not wrap around, and catch up within a few samples
+	const size_t halfPeriod = 40;
+	std::vector<int16_t> square(16000);
+	for(size_t ii = 0; ii < square.size(); ii++) {
+		square[ii] = ((ii / halfPeriod) % 2) ? 32767 : -32768;
+	}
+	std::vector<uint8_t> encoded = encodeAdpcm(square, MicAudioEncoder::DEFAULT_BLOCK_ALIGN, { square.size() });
+	std::vector<int16_t> decoded = decodeAdpcm(encoded.data(), encoded.size(), MicAudioEncoder::DEFAULT_BLOCK_ALIGN, square.size());
+	int wrong = 0;
+	for(size_t ii = 0; ii < decoded.size(); ii++) {
+		if (ii % halfPeriod >= halfPeriod / 2 && (decoded[ii] < 0) != (square[ii] < 0)) {
+			wrong++;
+		}
+	}
+	check(decoded.size() == square.size() && wrong == 0, "adpcm square wave: %d samples with the wrong sign", wrong);
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &data) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		return false;
+	}
+	uint8_t buf[4096];
+	size_t count;
+	while((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		data.insert(data.end(), buf, buf + count);
+	}
+	fclose(fp);
+	return true;
+}
+
+static void checkWav(const std::vector<int16_t> &source, MicAudioEncoder::Format format, const char *name) {
+	char path[64];
+	snprintf(path, sizeof(path), "codec_check_%s.wav", name);
+
+	const uint32_t durationMs = 1000;
+	const uint32_t numSamples = 16000 * durationMs / 1000;
+
+	Microphone_PDM::instance().withSourceSamples(source.data(), source.size(), 16000).withSpeed(0);
+	Microphone_PDM::instance().withOutputSize(Microphone_PDM::OutputSize::RAW_SIGNED_16).withSampleRate(16000).init();
+	Microphone_PDM::instance().start();
+
+	Microphone_PDM_WavRecorder *recorder = new Microphone_PDM_WavRecorder();
+	recorder->withFile(path).withEncoding(format).withDurationMs(durationMs);
+	bool started = Microphone_PDM::instance().bufferSamplingStart(recorder);
+	check(started, "%s: recording did not start (%d)", name, recorder->getResult());
+	while(started && !recorder->done()) {
+		Microphone_PDM::instance().loop();
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	Microphone_PDM::instance().stop();
+	if (started) {
+		check(recorder->getResult() == 0, "%s: recording result %d", name, recorder->getResult());
+	}
+	// Deletes the recorder
+	Microphone_PDM::instance().releaseBufferSampling();
+	if (!started) {
+		return;
+	}
+
+	// The same samples encoded directly
+	MicAudioEncoder encoder;
+	encoder.init(format);
+	std::vector<int16_t> first(source.begin(), source.begin() + numSamples);
+	std::vector<uint8_t> expectedData(encoder.getMaxEncodedSize(numSamples) + encoder.getBlockAlign());
+	size_t expectedSize = encoder.encode(first.data(), numSamples, expectedData.data());
+	expectedSize += encoder.flush(&expectedData[expectedSize]);
+	expectedData.resize(expectedSize);
+
+	std::vector<uint8_t> file;
+	check(readFile(path, file), "%s: can't read %s", name, path);
+	remove(path);
+	if (file.size() < 44) {
+		check(false, "%s: file is only %u bytes", name, (unsigned)file.size());
+		return;
+	}
+	check(memcmp(&file[0], "RIFF", 4) == 0 && memcmp(&file[8], "WAVE", 4) == 0, "%s: not RIFF WAVE", name);
+	check(getUint32LE(&file[4]) == file.size() - 8, "%s: RIFF size %u, file size %u", name, getUint32LE(&file[4]), (unsigned)file.size());
+
+	// Walk the chunks
+	const uint8_t *fmt = 0, *fact = 0, *data = 0;
+	uint32_t fmtSize = 0, factSize = 0, dataSize = 0;
+	for(size_t offset = 12; offset + 8 <= file.size(); ) {
+		uint32_t size = getUint32LE(&file[offset + 4]);
+		const uint8_t *body = &file[offset + 8];
+		if (memcmp(&file[offset], "fmt ", 4) == 0) {
+			fmt = body;
+			fmtSize = size;
+		}
+		else
+		if (memcmp(&file[offset], "fact", 4) == 0) {
+			fact = body;
+			factSize = size;
+		}
+		else
+		if (memcmp(&file[offset], "data", 4) == 0) {
+			data = body;
+			dataSize = size;
+			check(offset + 8 + size == file.size(), "%s: data chunk ends at %u, file size %u", name, (unsigned)(offset + 8 + size), (unsigned)file.size());
+			break;
+		}
+		offset += 8 + size + (size & 1);
+	}
+	if (!fmt || !data) {
+		check(false, "%s: missing fmt or data chunk", name);
+		return;
+	}
+
+	const bool isPcm = (format == MicAudioEncoder::Format::PCM);
+	const bool isAdpcm = (format == MicAudioEncoder::Format::IMA_ADPCM);
+	check(fmtSize == (isPcm ? 16u : isAdpcm ? 20u : 18u), "%s: fmt size %u", name, fmtSize);
+	check(getUint16LE(&fmt[0]) == (uint16_t)format, "%s: format tag %u", name, getUint16LE(&fmt[0]));
+	check(getUint16LE(&fmt[2]) == 1, "%s: %u channels", name, getUint16LE(&fmt[2]));
+	check(getUint32LE(&fmt[4]) == 16000, "%s: sample rate %u", name, getUint32LE(&fmt[4]));
+	check(getUint32LE(&fmt[8]) == 16000 * encoder.getBlockAlign() / encoder.getSamplesPerBlock(), "%s: byte rate %u", name, getUint32LE(&fmt[8]));
+	check(getUint16LE(&fmt[12]) == encoder.getBlockAlign(), "%s: block align %u", name, getUint16LE(&fmt[12]));
+	check(getUint16LE(&fmt[14]) == encoder.getBitsPerSample(), "%s: bits per sample %u", name, getUint16LE(&fmt[14]));
+	if (fmtSize >= 18) {
+		check(getUint16LE(&fmt[16]) == fmtSize - 18, "%s: cbSize %u", name, getUint16LE(&fmt[16]));
+	}
+	if (isAdpcm && fmtSize >= 20) {
+		check(getUint16LE(&fmt[18]) == encoder.getSamplesPerBlock(), "%s: samples per block %u", name, getUint16LE(&fmt[18]));
+	}
+
+	if (isPcm) {
+		check(!fact, "%s: PCM file has a fact chunk", name);
+	}
+	else {
+		check(fact && factSize == 4, "%s: missing fact chunk", name);
+		if (fact) {
+			check(getUint32LE(fact) == numSamples, "%s: fact sample count %u, expected %u", name, getUint32LE(fact), numSamples);
+		}
+	}
+
+	check(dataSize == expectedSize, "%s: data size %u, expected %u", name, dataSize, (unsigned)expectedSize);
+	check(dataSize == expectedSize && memcmp(data, expectedData.data(), dataSize) == 0, "%s: data differs from encoding the source directly", name);
+
+	// Decode what was written and compare with the source
+	std::vector<int16_t> decoded;
+	if (isAdpcm) {
+		decoded = decodeAdpcm(data, dataSize, encoder.getBlockAlign(), fact ? getUint32LE(fact) : 0);
+	}
+	else
+	if (isPcm) {
+		for(uint32_t ii = 0; ii + 1 < dataSize; ii += 2) {
+			decoded.push_back((int16_t)getUint16LE(&data[ii]));
+		}
+	}
+	else {
+		for(uint32_t ii = 0; ii < dataSize; ii++) {
+			decoded.push_back(MicAudioEncoder::mulawDecode(data[ii]));
+		}
+	}
+	check(decoded.size() == numSamples, "%s: decoded %u samples, expected %u", name, (unsigned)decoded.size(), numSamples);
+	if (decoded.size() == numSamples) {
+		double db = snr(first.data(), decoded.data(), numSamples);
+		check(db > (isPcm ? 900.0 : 20.0), "%s: SNR %.1f dB", name, db);
+		printf("wav %-9s %6u data bytes, SNR %.1f dB\n", name, dataSize, db);
+	}
+}
+
+int main() {
+	checkMulaw();
+	checkImaAdpcm();
+
+	std::vector<int16_t> source = makeSignal(16000 * 2);
+	checkWav(source, MicAudioEncoder::Format::PCM, "pcm");
+	checkWav(source, MicAudioEncoder::Format::MULAW, "mulaw");
+	checkWav(source, MicAudioEncoder::Format::IMA_ADPCM, "ima_adpcm");
+
+	printf("%d checks, %d failed\n", numChecks, numFailures);
+	return (numFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+// Checks Microphone_PDM_Base::convertSamples() and deinterleaveSamples() against the scalar conversion, and
+// times both, run on a computer with the host simulator. From the root of the repository:
+//
+// g++ -std=c++14 -O2 -DMICROPHONE_PDM_HOST=1 -Ilib/Microphone_PDM/host -Ilib/Microphone_PDM/src lib/Microphone_PDM/host/convert_check.cpp lib/Microphone_PDM/src/*.cpp -pthread -o convert_check
+// ./convert_check
+//
+// This exercises the SSE2 path on x86 and the NEON path on 64-bit ARM. Every OutputSize and Range pair is
+// checked for:
+// - every 16-bit input value, against the clipping rules documented for convertSamples()
+// - all lengths up to a few vectors, so every SIMD tail is hit, with unaligned destinations, in place,
+//   and without writing past the end of the destination
+// - the stereo deinterleave, for the same lengths, against converting each channel separately
+//
+// Then it prints the time per sample for the SIMD and scalar versions, in CPU cycles on x86 (TSC) and
+// nanoseconds elsewhere. Exits with 1 if any check fails.
+
+#include "Microphone_PDM.h"
+
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef Microphone_PDM_Base::OutputSize OutputSize;
+typedef Microphone_PDM_Base::Range Range;
+
+// The scalar conversion the SIMD versions fall back to for the last few samples is protected
+class ScalarReference : public Microphone_PDM_Base {
+public:
+	using Microphone_PDM_Base::convertSamplesScalar;
+};
+
+static const size_t MAX_LENGTH = 67;
+static const size_t GUARD_SIZE = 16;
+static const uint8_t GUARD = 0xa5;
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static void check(bool ok, const char *fmt, ...) {
+	numChecks++;
+	if (!ok && numFailures++ < 20) {
+		va_list ap;
+		va_start(ap, fmt);
+		printf("FAIL ");
+		vprintf(fmt, ap);
+		printf("\n");
+		va_end(ap);
+	}
+}
+
+static const char *outputSizeName(OutputSize outputSize) {
+	switch(outputSize) {
+	case OutputSize::UNSIGNED_8:
+		return "UNSIGNED_8";
+	case OutputSize::SIGNED_16:
+		return "SIGNED_16";
+	default:
+		return "RAW_SIGNED_16";
+	}
+}
+
+static size_t sampleSize(OutputSize outputSize) {
+	return (outputSize == OutputSize::UNSIGNED_8) ? 1 : 2;
+}
+
+// Expected output for one sample, from the description of convertSamples() and Range
+static int expectedValue(int16_t sample, OutputSize outputSize, Range range) {
+	int32_t val;
+	switch(outputSize) {
+	case OutputSize::UNSIGNED_8:
+		val = (int32_t)sample >> (int)range;
+		val = (val < -128) ? -128 : (val > 127) ? 127 : val;
+		return val + 128;
+
+	case OutputSize::SIGNED_16:
+		val = (int32_t)sample * (1 << (8 - (int)range));
+		return (val < -32768) ? -32768 : (val > 32767) ? 32767 : val;
+
+	default:
+		return sample;
+	}
+}
+
+static int readValue(const uint8_t *dst, size_t index, OutputSize outputSize) {
+	if (outputSize == OutputSize::UNSIGNED_8) {
+		return dst[index];
+	}
+	int16_t val;
+	memcpy(&val, &dst[index * 2], 2);
+	return val;
+}
+
+static bool guardIntact(const uint8_t *p) {
+	for(size_t ii = 0; ii < GUARD_SIZE; ii++) {
+		if (p[ii] != GUARD) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void checkAllValues(OutputSize outputSize, Range range) {
+	std::vector<int16_t> src(65536);
+	for(size_t ii = 0; ii < src.size(); ii++) {
+		src[ii] = (int16_t)(ii - 32768);
+	}
+	std::vector<uint8_t> simd(src.size() * 2), scalar(src.size() * 2);
+	Microphone_PDM_Base::convertSamples(src.data(), simd.data(), src.size(), outputSize, range);
+	ScalarReference::convertSamplesScalar(src.data(), 1, scalar.data(), src.size(), outputSize, range);
+
+	int wrong = 0, first = 0;
+	for(size_t ii = 0; ii < src.size(); ii++) {
+		int expected = expectedValue(src[ii], outputSize, range);
+		if (readValue(simd.data(), ii, outputSize) != expected || readValue(scalar.data(), ii, outputSize) != expected) {
+			if (wrong++ == 0) {
+				first = src[ii];
+			}
+		}
+	}
+	check(wrong == 0, "%s range %d: %d of 65536 values wrong, first input %d", outputSizeName(outputSize), (int)range, wrong, first);
+}
+
+static void checkLengths(OutputSize outputSize, Range range, const std::vector<int16_t> &pattern) {
+	const size_t size = sampleSize(outputSize);
+
+	for(size_t len = 0; len <= MAX_LENGTH; len++) {
+		std::vector<uint8_t> expected(len * size);
+		ScalarReference::convertSamplesScalar(pattern.data(), 1, expected.data(), len, outputSize, range);
+
+		// Destination at every byte offset, followed by a guard
+		for(size_t offset = 0; offset < 4; offset++) {
+			std::vector<uint8_t> dst(offset + len * size + GUARD_SIZE, GUARD);
+			Microphone_PDM_Base::convertSamples(pattern.data(), &dst[offset], len, outputSize, range);
+			check(len == 0 || memcmp(&dst[offset], expected.data(), len * size) == 0, "%s range %d: length %u offset %u differs from scalar", outputSizeName(outputSize), (int)range, (unsigned)len, (unsigned)offset);
+			check(guardIntact(&dst[offset + len * size]), "%s range %d: length %u offset %u wrote past the end", outputSizeName(outputSize), (int)range, (unsigned)len, (unsigned)offset);
+		}
+
+		// In place
+		std::vector<int16_t> buf(pattern.begin(), pattern.begin() + len);
+		Microphone_PDM_Base::convertSamples(buf.data(), buf.data(), len, outputSize, range);
+		check(len == 0 || memcmp(buf.data(), expected.data(), len * size) == 0, "%s range %d: length %u in place differs from scalar", outputSizeName(outputSize), (int)range, (unsigned)len);
+	}
+}
+
+static void checkDeinterleave(OutputSize outputSize, Range range, const std::vector<int16_t> &pattern) {
+	const size_t size = sampleSize(outputSize);
+
+	for(size_t frames = 0; frames <= MAX_LENGTH; frames++) {
+		std::vector<uint8_t> expectedLeft(frames * size), expectedRight(frames * size);
+		ScalarReference::convertSamplesScalar(&pattern[0], 2, expectedLeft.data(), frames, outputSize, range);
+		ScalarReference::convertSamplesScalar(&pattern[1], 2, expectedRight.data(), frames, outputSize, range);
+
+		for(size_t offset = 0; offset < 2; offset++) {
+			std::vector<uint8_t> left(offset + frames * size + GUARD_SIZE, GUARD), right(offset + frames * size + GUARD_SIZE, GUARD);
+			Microphone_PDM_Base::deinterleaveSamples(pattern.data(), &left[offset], &right[offset], frames, outputSize, range);
+			bool same = frames == 0 ||
+				(memcmp(&left[offset], expectedLeft.data(), frames * size) == 0 && memcmp(&right[offset], expectedRight.data(), frames * size) == 0);
+			check(same, "%s range %d: deinterleave %u frames offset %u differs from scalar", outputSizeName(outputSize), (int)range, (unsigned)frames, (unsigned)offset);
+			check(guardIntact(&left[offset + frames * size]) && guardIntact(&right[offset + frames * size]), "%s range %d: deinterleave %u frames offset %u wrote past the end", outputSizeName(outputSize), (int)range, (unsigned)frames, (unsigned)offset);
+		}
+	}
+}
+
+static uint64_t timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Best of several runs over one DMA buffer worth of samples (512), per sample
+template<class Fn>
+static double timePerSample(size_t numSamples, Fn fn) {
+	double best = 1e9;
+	for(int run = 0; run < 200; run++) {
+		uint64_t start = timestamp();
+		for(int rep = 0; rep < 16; rep++) {
+			fn();
+		}
+		double t = (double)(timestamp() - start) / (16.0 * numSamples);
+		if (t < best) {
+			best = t;
+		}
+	}
+	return best;
+}
+
+static void benchmark(const std::vector<int16_t> &pattern) {
+	const size_t numSamples = 512;
+	std::vector<uint8_t> dst(numSamples * 2), left(numSamples), right(numSamples);
+#if defined(__x86_64__) || defined(__i386__)
+	const char *unit = "cycles (TSC)";
+#else
+	const char *unit = "ns";
+#endif
+
+	printf("\n%-14s %-28s %10s %10s   per sample, %s\n", "output", "", "simd", "scalar", unit);
+	const OutputSize sizes[] = { OutputSize::UNSIGNED_8, OutputSize::SIGNED_16 };
+	for(OutputSize outputSize : sizes) {
+		const Range range = Range::RANGE_2048;
+		double simd = timePerSample(numSamples, [&]() {
+			Microphone_PDM_Base::convertSamples(pattern.data(), dst.data(), numSamples, outputSize, range);
+		});
+		double scalar = timePerSample(numSamples, [&]() {
+			ScalarReference::convertSamplesScalar(pattern.data(), 1, dst.data(), numSamples, outputSize, range);
+		});
+		printf("%-14s %-28s %10.3f %10.3f\n", outputSizeName(outputSize), "convertSamples", simd, scalar);
+
+		simd = timePerSample(numSamples, [&]() {
+			Microphone_PDM_Base::deinterleaveSamples(pattern.data(), left.data(), right.data(), numSamples / 2, outputSize, range);
+		});
+		scalar = timePerSample(numSamples, [&]() {
+			ScalarReference::convertSamplesScalar(&pattern[0], 2, left.data(), numSamples / 2, outputSize, range);
+			ScalarReference::convertSamplesScalar(&pattern[1], 2, right.data(), numSamples / 2, outputSize, range);
+		});
+		printf("%-14s %-28s %10.3f %10.3f\n", outputSizeName(outputSize), "deinterleaveSamples", simd, scalar);
+	}
+}
+
+int main() {
+	// Random samples with a good share of values that clip in every range
+	std::vector<int16_t> pattern(4096);
+	srand(1234);
+	for(size_t ii = 0; ii < pattern.size(); ii++) {
+		int val = (rand() % 4 == 0) ? (rand() % 65536 - 32768) : (rand() % 8192 - 4096);
+		pattern[ii] = (int16_t)val;
+	}
+
+	const OutputSize sizes[] = { OutputSize::UNSIGNED_8, OutputSize::SIGNED_16, OutputSize::RAW_SIGNED_16 };
+	for(OutputSize outputSize : sizes) {
+		for(int range = (int)Range::RANGE_128; range <= (int)Range::RANGE_32768; range++) {
+			checkAllValues(outputSize, (Range)range);
+			checkLengths(outputSize, (Range)range, pattern);
+			checkDeinterleave(outputSize, (Range)range, pattern);
+		}
+	}
+	printf("%d checks, %d failed\n", numChecks, numFailures);
+
+	benchmark(pattern);
+
+	return (numFailures == 0) ? 0 : 1;
+}
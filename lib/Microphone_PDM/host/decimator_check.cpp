@@ -0,0 +1,242 @@
+// Checks MicDecimator against a direct-form reference filter, run on a computer with the host simulator.
+// From the root of the repository:
+//
+// g++ -std=c++14 -O2 -DMICROPHONE_PDM_HOST=1 -Ilib/Microphone_PDM/host -Ilib/Microphone_PDM/src lib/Microphone_PDM/host/decimator_check.cpp lib/Microphone_PDM/src/*.cpp -pthread -o decimator_check
+// ./decimator_check
+//
+// - the built-in factor 2 and 4 filters, and caller-supplied coefficients whose length isn't a multiple of 8,
+//   must be bit-exact with a 64-bit direct-form FIR that keeps every factor-th output, for any split of the
+//   stream over process() calls, including blocks larger than maxBlockSize, and in place
+// - full scale input must saturate, not wrap around
+// - reset() must give the same output as a newly initialized decimator
+// - the built-in filters must pass DC and low frequencies with unity gain and attenuate everything that
+//   would alias by at least the amount documented in MicDecimator.cpp
+//
+// Exits with 1 if any check fails.
+
+#include "MicDecimator.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static void check(bool ok, const char *fmt, ...) {
+	numChecks++;
+	if (!ok && numFailures++ < 20) {
+		va_list ap;
+		va_start(ap, fmt);
+		printf("FAIL ");
+		vprintf(fmt, ap);
+		printf("\n");
+		va_end(ap);
+	}
+}
+
+// The built-in filters are private to MicDecimator.cpp. These are the same tables, so a change to one
+// without the other shows up as a mismatch.
+static const int16_t coeffsFactor2[48] = {
+	-3, -13, -2, 33, 29, -48, -90, 29, 176, 63, -249, -257,
+	230, 538, -22, -828, -475, 973, 1348, -710, -2792, -633, 6312, 12775,
+	12775, 6312, -633, -2792, -710, 1348, 973, -475, -828, -22, 538, 230,
+	-257, -249, 63, 176, 29, -90, -48, 29, 33, -2, -13, -3,
+};
+
+static const int16_t coeffsFactor4[96] = {
+	0, -3, -6, -8, -5, 3, 13, 21, 20, 8, -14, -36,
+	-48, -39, -7, 39, 80, 93, 63, -6, -91, -153, -157, -86,
+	44, 184, 269, 244, 97, -130, -346, -447, -359, -78, 306, 636,
+	744, 521, -15, -703, -1263, -1389, -856, 389, 2172, 4129, 5797, 6757,
+	6757, 5797, 4129, 2172, 389, -856, -1389, -1263, -703, -15, 521, 744,
+	636, 306, -78, -359, -447, -346, -130, 97, 244, 269, 184, 44,
+	-86, -157, -153, -91, -6, 63, 93, 80, 39, -7, -39, -48,
+	-36, -14, 8, 20, 21, 13, 3, -5, -8, -6, -3, 0,
+};
+
+// An odd-length filter for factor 3, passed in by the caller
+static const int16_t coeffsFactor3[13] = {
+	-120, -310, -250, 640, 2900, 5600, 6850, 5600, 2900, 640, -250, -310, -120,
+};
+
+struct Filter {
+	unsigned int factor;
+	const int16_t *coeffs;
+	size_t numTaps;
+	bool builtIn;
+};
+
+static const Filter filters[] = {
+	{ 2, coeffsFactor2, sizeof(coeffsFactor2) / sizeof(coeffsFactor2[0]), true },
+	{ 4, coeffsFactor4, sizeof(coeffsFactor4) / sizeof(coeffsFactor4[0]), true },
+	{ 3, coeffsFactor3, sizeof(coeffsFactor3) / sizeof(coeffsFactor3[0]), false },
+};
+
+// y[n] = sum h[k] x[n - k] with x before the start of the stream taken as 0, evaluated at n = 0, factor,
+// 2 * factor, ..., rounded from Q30 to Q15 and saturated
+static std::vector<int16_t> referenceDecimate(const Filter &filter, const std::vector<int16_t> &src) {
+	std::vector<int16_t> out;
+	for(size_t n = 0; n < src.size(); n += filter.factor) {
+		int64_t acc = 0;
+		for(size_t k = 0; k < filter.numTaps && k <= n; k++) {
+			acc += (int64_t)filter.coeffs[k] * src[n - k];
+		}
+		int64_t val = (acc + (1 << 14)) >> 15;
+		val = (val < -32768) ? -32768 : (val > 32767) ? 32767 : val;
+		out.push_back((int16_t)val);
+	}
+	return out;
+}
+
+static bool initDecimator(MicDecimator &decimator, const Filter &filter, size_t maxBlockSize) {
+	if (filter.builtIn) {
+		return decimator.init(filter.factor, maxBlockSize);
+	}
+	return decimator.init(filter.factor, maxBlockSize, filter.coeffs, filter.numTaps);
+}
+
+// Feed src in random sized blocks, some larger than maxBlockSize, and collect the output
+static std::vector<int16_t> streamDecimate(MicDecimator &decimator, const std::vector<int16_t> &src, size_t maxBlockSize, bool inPlace) {
+	std::vector<int16_t> out;
+	size_t pos = 0;
+	while(pos < src.size()) {
+		size_t count = 1 + (size_t)rand() % (maxBlockSize * 3);
+		if (count > src.size() - pos) {
+			count = src.size() - pos;
+		}
+		std::vector<int16_t> block(&src[pos], &src[pos] + count);
+		std::vector<int16_t> dst(count);
+		size_t outCount = inPlace ? decimator.process(block.data(), count, block.data()) : decimator.process(block.data(), count, dst.data());
+		const std::vector<int16_t> &result = inPlace ? block : dst;
+		out.insert(out.end(), result.begin(), result.begin() + outCount);
+		pos += count;
+	}
+	return out;
+}
+
+static size_t firstDifference(const std::vector<int16_t> &a, const std::vector<int16_t> &b) {
+	size_t ii = 0;
+	while(ii < a.size() && ii < b.size() && a[ii] == b[ii]) {
+		ii++;
+	}
+	return ii;
+}
+
+static void checkBitExact(const Filter &filter, const std::vector<int16_t> &src, const char *signal) {
+	std::vector<int16_t> expected = referenceDecimate(filter, src);
+
+	const size_t blockSizes[] = { 1, 7, 64, 256 };
+	for(size_t maxBlockSize : blockSizes) {
+		for(int inPlace = 0; inPlace < 2; inPlace++) {
+			MicDecimator decimator;
+			check(initDecimator(decimator, filter, maxBlockSize), "factor %u: init failed", filter.factor);
+			std::vector<int16_t> out = streamDecimate(decimator, src, maxBlockSize, inPlace != 0);
+			size_t diff = firstDifference(out, expected);
+			check(out.size() == expected.size() && diff == out.size(), "factor %u %s maxBlockSize %u%s: %u outputs, expected %u, first difference at %u",
+				filter.factor, signal, (unsigned)maxBlockSize, inPlace ? " in place" : "", (unsigned)out.size(), (unsigned)expected.size(), (unsigned)diff);
+		}
+	}
+}
+
+static void checkReset(const Filter &filter, const std::vector<int16_t> &src) {
+	MicDecimator decimator;
+	initDecimator(decimator, filter, 256);
+
+	// Leave history and a partial phase behind
+	std::vector<int16_t> dst(src.size());
+	decimator.process(src.data(), 333, dst.data());
+	decimator.reset();
+
+	std::vector<int16_t> expected = referenceDecimate(filter, src);
+	std::vector<int16_t> out = streamDecimate(decimator, src, 256, false);
+	check(out == expected, "factor %u: output after reset() differs from a new decimator", filter.factor);
+}
+
+// Output RMS over input RMS, in dB, of a sine at freq (fraction of the input sample rate), ignoring the
+// filter's startup
+static double gainDb(const Filter &filter, double freq) {
+	const size_t numSamples = 16384;
+	const double amplitude = 16000.0;
+	std::vector<int16_t> src(numSamples);
+	for(size_t ii = 0; ii < numSamples; ii++) {
+		src[ii] = (int16_t)lrint(amplitude * sin(2.0 * M_PI * freq * ii + 0.3));
+	}
+	MicDecimator decimator;
+	initDecimator(decimator, filter, 512);
+	std::vector<int16_t> out = streamDecimate(decimator, src, 512, false);
+
+	double sum = 0;
+	size_t count = 0;
+	for(size_t ii = filter.numTaps; ii < out.size(); ii++, count++) {
+		sum += (double)out[ii] * out[ii];
+	}
+	double rms = sqrt(sum / count);
+	return 20.0 * log10((rms + 1e-9) / (amplitude / sqrt(2.0)));
+}
+
+static void checkResponse(const Filter &filter, double passband, double stopbandDb) {
+	// Passband: within 0.1 dB of unity
+	double worstPass = 0;
+	for(double freq = 0.005; freq <= passband; freq += 0.005) {
+		double db = gainDb(filter, freq);
+		if (fabs(db) > fabs(worstPass)) {
+			worstPass = db;
+		}
+	}
+	check(fabs(worstPass) < 0.1, "factor %u: passband gain %.3f dB", filter.factor, worstPass);
+
+	// Stopband: from the output Nyquist frequency to the input Nyquist frequency
+	double nyquist = 0.5 / filter.factor;
+	double worstStop = -200;
+	for(double freq = nyquist; freq < 0.5; freq += 0.0025) {
+		double db = gainDb(filter, freq);
+		if (db > worstStop) {
+			worstStop = db;
+		}
+	}
+	check(worstStop < stopbandDb, "factor %u: stopband gain %.1f dB, expected below %.1f dB", filter.factor, worstStop, stopbandDb);
+
+	// DC is exact apart from rounding
+	std::vector<int16_t> dc(4096, 10000);
+	MicDecimator decimator;
+	initDecimator(decimator, filter, 512);
+	std::vector<int16_t> out = streamDecimate(decimator, dc, 512, false);
+	check(abs(out.back() - 10000) <= 2, "factor %u: DC 10000 gives %d", filter.factor, out.back());
+
+	printf("factor %u: passband to %.3f fs within %.3f dB, stopband %.1f dB\n", filter.factor, passband, worstPass, worstStop);
+}
+
+int main() {
+	srand(1234);
+
+	std::vector<int16_t> noise(5000), fullScale(5000);
+	for(size_t ii = 0; ii < noise.size(); ii++) {
+		noise[ii] = (int16_t)(rand() % 65536 - 32768);
+		// Alternating runs of full scale values drive the accumulator to its limits
+		fullScale[ii] = ((ii / 17) % 2) ? 32767 : -32768;
+	}
+
+	for(const Filter &filter : filters) {
+		checkBitExact(filter, noise, "noise");
+		checkBitExact(filter, fullScale, "full scale");
+		checkReset(filter, noise);
+	}
+
+	// Factor 1 passes samples through, factors without a built-in filter need coefficients
+	{
+		MicDecimator decimator;
+		check(decimator.init(1, 64), "factor 1: init failed");
+		std::vector<int16_t> out = streamDecimate(decimator, noise, 64, true);
+		check(out == noise, "factor 1: output differs from input");
+		check(!decimator.init(3, 64), "factor 3 without coefficients: init succeeded");
+		check(decimator.getFactor() == 1, "factor 3 without coefficients: factor is %u", decimator.getFactor());
+	}
+
+	checkResponse(filters[0], 0.17, -55.0);
+	checkResponse(filters[1], 0.085, -55.0);
+
+	printf("%d checks, %d failed\n", numChecks, numFailures);
+
+	return (numFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// Checks how Microphone_PDM_WavRecorder and MicWavFileSink handle errors, run on a computer with the host
+// simulator. From the root of the repository:
+//
+// g++ -std=c++14 -O2 -DMICROPHONE_PDM_HOST=1 -Ilib/Microphone_PDM/host -Ilib/Microphone_PDM/src lib/Microphone_PDM/host/recorder_check.cpp lib/Microphone_PDM/src/*.cpp -pthread -o recorder_check
+// ./recorder_check
+//
+// - a sink that fails to open, or fails to write the header, makes start() return false with the sink's
+//   error in getResult(), closes the sink, frees everything start() allocated, and start() can be called
+//   again and then records normally
+// - an encoding that doesn't match the output size fails without allocating
+// - MicWavFileSink translates errno: a missing directory is NOT_FOUND, a directory is NOT_ALLOWED, and on
+//   Linux writing to /dev/full is LIMIT_EXCEEDED
+//
+// Exits with 1 if any check fails.
+
+#include "Microphone_PDM.h"
+#include "MicWavRecorder.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <new>
+#include <thread>
+#include <vector>
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static void check(bool ok, const char *fmt, ...) {
+	numChecks++;
+	if (!ok) {
+		numFailures++;
+		va_list ap;
+		va_start(ap, fmt);
+		printf("FAIL ");
+		vprintf(fmt, ap);
+		printf("\n");
+		va_end(ap);
+	}
+}
+
+// The recorder allocates its chunks with new[], so counting the arrays that are still allocated shows leaks
+static int liveArrays = 0;
+
+void *operator new[](size_t size) {
+	void *p = malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	liveArrays++;
+	return p;
+}
+
+void operator delete[](void *p) noexcept {
+	if (p) {
+		liveArrays--;
+		free(p);
+	}
+}
+
+void operator delete[](void *p, size_t) noexcept {
+	operator delete[](p);
+}
+
+// A sink that can be told to fail, and remembers what was written
+class TestSink : public MicWavSink {
+public:
+	virtual int open() {
+		numOpens++;
+		isOpen = (openResult == 0);
+		data.clear();
+		return openResult;
+	}
+
+	virtual int write(const uint8_t *buf, size_t len) {
+		if (writeResult != 0) {
+			return writeResult;
+		}
+		data.insert(data.end(), buf, buf + len);
+		return 0;
+	}
+
+	virtual int writeAt(size_t offset, const uint8_t *buf, size_t len) {
+		if (offset + len > data.size()) {
+			return SYSTEM_ERROR_IO;
+		}
+		memcpy(&data[offset], buf, len);
+		return 0;
+	}
+
+	virtual int close() {
+		numCloses++;
+		isOpen = false;
+		return 0;
+	}
+
+	int openResult = 0;
+	int writeResult = 0;
+	int numOpens = 0;
+	int numCloses = 0;
+	bool isOpen = false;
+	std::vector<uint8_t> data;
+};
+
+static void startMic(Microphone_PDM::OutputSize outputSize, const std::vector<int16_t> &source) {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+	mic.uninit();
+	mic.withSourceSamples(source.data(), source.size(), 16000).withSpeed(0);
+	mic.withOutputSize(outputSize).withSampleRate(16000).init();
+	mic.start();
+}
+
+static void stopMic() {
+	Microphone_PDM::instance().stop();
+	Microphone_PDM::instance().releaseBufferSampling();
+}
+
+// Fails start() with the sink set up by fail, then fixes the sink and starts again
+static void checkSinkFailure(const char *name, void (*fail)(TestSink &sink), int expected, MicAudioEncoder::Format format) {
+	std::vector<int16_t> source(16000, 1000);
+	startMic(Microphone_PDM::OutputSize::SIGNED_16, source);
+
+	TestSink sink;
+	fail(sink);
+
+	Microphone_PDM_WavRecorder *recorder = new Microphone_PDM_WavRecorder();
+	recorder->withSink(&sink).withEncoding(format).withDurationMs(100);
+
+	int before = liveArrays;
+	bool started = Microphone_PDM::instance().bufferSamplingStart(recorder);
+	check(!started, "%s: start() succeeded", name);
+	check(recorder->getResult() == expected, "%s: getResult() is %d, expected %d", name, recorder->getResult(), expected);
+	check(!sink.isOpen, "%s: sink left open", name);
+	check(liveArrays == before, "%s: %d arrays still allocated after start() failed", name, liveArrays - before);
+
+	// Retry on the same recorder
+	sink.openResult = sink.writeResult = 0;
+	started = recorder->start();
+	check(started, "%s: start() failed after the sink was fixed (%d)", name, recorder->getResult());
+	while(started && !recorder->done()) {
+		Microphone_PDM::instance().loop();
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	check(recorder->getResult() == 0, "%s: result %d after retry", name, recorder->getResult());
+	check(recorder->getDataSize() > 0 && sink.data.size() == 44 + recorder->getDataSize() + (format == MicAudioEncoder::Format::PCM ? 0 : 14),
+		"%s: %u bytes in the sink, data size %u", name, (unsigned)sink.data.size(), (unsigned)recorder->getDataSize());
+	check(sink.numOpens == 2 && sink.numCloses >= 2, "%s: %d opens, %d closes", name, sink.numOpens, sink.numCloses);
+
+	stopMic();
+}
+
+static void checkEncodingMismatch() {
+	std::vector<int16_t> source(16000, 1000);
+	startMic(Microphone_PDM::OutputSize::UNSIGNED_8, source);
+
+	TestSink sink;
+	Microphone_PDM_WavRecorder *recorder = new Microphone_PDM_WavRecorder();
+	recorder->withSink(&sink).withEncoding(MicAudioEncoder::Format::MULAW).withDurationMs(100);
+
+	int before = liveArrays;
+	check(!Microphone_PDM::instance().bufferSamplingStart(recorder), "mu-law with 8-bit samples: start() succeeded");
+	check(recorder->getResult() == SYSTEM_ERROR_INVALID_ARGUMENT, "mu-law with 8-bit samples: getResult() is %d", recorder->getResult());
+	check(sink.numOpens == 0, "mu-law with 8-bit samples: sink was opened");
+	check(liveArrays == before, "mu-law with 8-bit samples: %d arrays still allocated", liveArrays - before);
+
+	stopMic();
+}
+
+static void checkFileSink() {
+	{
+		MicWavFileSink sink("recorder_check_missing_dir/file.wav");
+		int res = sink.open();
+		check(res == SYSTEM_ERROR_NOT_FOUND, "file in a missing directory: open() returned %d", res);
+	}
+	{
+		MicWavFileSink sink(".");
+		int res = sink.open();
+		check(res == SYSTEM_ERROR_NOT_ALLOWED, "directory: open() returned %d", res);
+	}
+	if (access("/dev/full", W_OK) == 0) {
+		MicWavFileSink sink("/dev/full");
+		check(sink.open() == 0, "/dev/full: open() failed");
+		uint8_t buf[64] = { 0 };
+		int res = sink.write(buf, sizeof(buf));
+		check(res == SYSTEM_ERROR_LIMIT_EXCEEDED, "/dev/full: write() returned %d", res);
+		sink.close();
+	}
+
+	// The recorder passes the sink's error through
+	std::vector<int16_t> source(16000, 1000);
+	startMic(Microphone_PDM::OutputSize::SIGNED_16, source);
+	Microphone_PDM_WavRecorder *recorder = new Microphone_PDM_WavRecorder();
+	recorder->withFile("recorder_check_missing_dir/file.wav").withDurationMs(100);
+	check(!Microphone_PDM::instance().bufferSamplingStart(recorder), "file in a missing directory: start() succeeded");
+	check(recorder->getResult() == SYSTEM_ERROR_NOT_FOUND, "file in a missing directory: getResult() is %d", recorder->getResult());
+	stopMic();
+}
+
+int main() {
+	checkSinkFailure("open fails", [](TestSink &sink) { sink.openResult = SYSTEM_ERROR_NOT_FOUND; }, SYSTEM_ERROR_NOT_FOUND, MicAudioEncoder::Format::PCM);
+	checkSinkFailure("header write fails", [](TestSink &sink) { sink.writeResult = SYSTEM_ERROR_IO; }, SYSTEM_ERROR_IO, MicAudioEncoder::Format::PCM);
+	checkSinkFailure("mu-law open fails", [](TestSink &sink) { sink.openResult = SYSTEM_ERROR_LIMIT_EXCEEDED; }, SYSTEM_ERROR_LIMIT_EXCEEDED, MicAudioEncoder::Format::MULAW);
+	checkEncodingMismatch();
+	checkFileSink();
+
+	Microphone_PDM::instance().uninit();
+
+	printf("%d checks, %d failed\n", numChecks, numFailures);
+
+	return (numFailures == 0) ? 0 : 1;
+}
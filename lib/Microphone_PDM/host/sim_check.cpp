@@ -0,0 +1,300 @@
+// Checks the behavior of the host simulator backend (Microphone_PDM_Host) that applications test against.
+// From the root of the repository:
+//
+// g++ -std=c++14 -O2 -DMICROPHONE_PDM_HOST=1 -Ilib/Microphone_PDM/host -Ilib/Microphone_PDM/src lib/Microphone_PDM/host/sim_check.cpp lib/Microphone_PDM/src/*.cpp -pthread -o sim_check
+// ./sim_check
+//
+// - init() rejects a missing source and source sample rates that can't be decimated to the sample rate
+// - at speed 0, every sample of the source comes out once, in order, through both copySamples() and
+//   noCopySamples(), with consecutive sequence numbers, the last buffer padded with zeros, no overruns,
+//   and isSourceDone() set at the end
+// - getLastSequence() is already updated inside the noCopySamples() callback
+// - in real time with a consumer that falls behind, the buffers the DMA couldn't fill show up as overruns
+//   and as the same number of missing sequence numbers, each delivered buffer still holds the source
+//   samples for its sequence number, and reading with more than one buffer waiting counts as late
+// - waitForSamples() wakes for a completed buffer and times out when stopped
+// - a 32000 Hz source at a sample rate of 16000 comes out the same as passing it through MicDecimator
+// - withCodecGain() scales the source samples and saturates
+//
+// Exits with 1 if any check fails.
+
+#include "Microphone_PDM.h"
+
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static int numChecks = 0;
+static int numFailures = 0;
+
+static void check(bool ok, const char *fmt, ...) {
+	numChecks++;
+	if (!ok && numFailures++ < 20) {
+		va_list ap;
+		va_start(ap, fmt);
+		printf("FAIL ");
+		vprintf(fmt, ap);
+		printf("\n");
+		va_end(ap);
+	}
+}
+
+static const size_t BUFFER_SAMPLES = Microphone_PDM_Host::BUFFER_SIZE_SAMPLES;
+
+// Sample i of the source is a function of i so any buffer can be checked on its own
+static int16_t sourceSample(size_t index) {
+	return (int16_t)((index * 37 + (index >> 8) * 1001) & 0x7fff) - 16384;
+}
+
+static std::vector<int16_t> makeSource(size_t numSamples) {
+	std::vector<int16_t> source(numSamples);
+	for(size_t ii = 0; ii < numSamples; ii++) {
+		source[ii] = sourceSample(ii);
+	}
+	return source;
+}
+
+static int initMic(const std::vector<int16_t> &source, int sourceSampleRate, int sampleRate, float speed) {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+	mic.uninit();
+	mic.withSourceSamples(source.data(), source.size(), sourceSampleRate).withSpeed(speed).withJitterUs(0).withStall(0, 0).withLoop(false);
+	return mic
+		.withOutputSize(Microphone_PDM::OutputSize::RAW_SIGNED_16)
+		.withRange(Microphone_PDM::Range::RANGE_2048)
+		.withSampleRate(sampleRate)
+		.init();
+}
+
+// Read until the source is done and no buffers are left, with a deadline so a hang fails instead of blocking
+static std::vector<int16_t> readAll(bool useCallback, bool &sequenceOk, bool &callbackSequenceOk) {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+	std::vector<int16_t> out;
+	// Sequence numbers keep counting across stop() and start(), so the first buffer sets the base
+	uint32_t expectedSequence = 0;
+	bool first = true;
+	sequenceOk = callbackSequenceOk = true;
+
+	uint32_t start = millis();
+	while(millis() - start < 10000) {
+		bool gotBuffer;
+		if (useCallback) {
+			gotBuffer = mic.noCopySamples([&](void *pSamples, size_t numSamples) {
+				if (first) {
+					expectedSequence = mic.getLastSequence();
+				}
+				if (mic.getLastSequence() != expectedSequence) {
+					callbackSequenceOk = false;
+				}
+				const int16_t *samples = (const int16_t *)pSamples;
+				out.insert(out.end(), samples, samples + numSamples);
+			});
+		}
+		else {
+			std::vector<int16_t> buf(mic.getNumberOfSamples());
+			gotBuffer = mic.copySamples(buf.data());
+			if (gotBuffer) {
+				out.insert(out.end(), buf.begin(), buf.end());
+			}
+		}
+		if (gotBuffer) {
+			if (first) {
+				expectedSequence = mic.getLastSequence();
+				first = false;
+			}
+			if (mic.getLastSequence() != expectedSequence) {
+				sequenceOk = false;
+			}
+			expectedSequence++;
+		}
+		else if (mic.isSourceDone()) {
+			if (!mic.samplesAvailable()) {
+				break;
+			}
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+	return out;
+}
+
+static void checkInit() {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+	std::vector<int16_t> source = makeSource(1000);
+
+	mic.withSourceSamples(NULL, 0, 16000);
+	check(!mic.isSourceLoaded(), "empty source is loaded");
+	check(mic.withSampleRate(16000).init() == SYSTEM_ERROR_INVALID_STATE, "init without a source did not fail with INVALID_STATE");
+
+	check(initMic(source, 44100, 16000, 0) == SYSTEM_ERROR_INVALID_ARGUMENT, "44100 Hz source at 16000 Hz did not fail");
+	check(initMic(source, 48000, 16000, 0) == SYSTEM_ERROR_INVALID_ARGUMENT, "48000 Hz source at 16000 Hz (factor 3) did not fail");
+	check(initMic(source, 16000, 16000, 0) == 0, "16000 Hz source at 16000 Hz failed");
+	check(initMic(source, 32000, 16000, 0) == 0, "32000 Hz source at 16000 Hz failed");
+	check(initMic(source, 32000, 8000, 0) == 0, "32000 Hz source at 8000 Hz failed");
+	mic.uninit();
+}
+
+static void checkSpeedZero(bool useCallback) {
+	const char *api = useCallback ? "noCopySamples" : "copySamples";
+	Microphone_PDM &mic = Microphone_PDM::instance();
+
+	// Not a multiple of the buffer size, so the last buffer is padded
+	std::vector<int16_t> source = makeSource(BUFFER_SAMPLES * 40 + 100);
+	check(initMic(source, 16000, 16000, 0) == 0, "%s: init failed", api);
+	check(mic.getNumberOfSamples() == BUFFER_SAMPLES, "%s: %u samples per buffer", api, (unsigned)mic.getNumberOfSamples());
+	mic.start();
+
+	bool sequenceOk, callbackSequenceOk;
+	std::vector<int16_t> out = readAll(useCallback, sequenceOk, callbackSequenceOk);
+	mic.stop();
+
+	size_t expectedSize = ((source.size() + BUFFER_SAMPLES - 1) / BUFFER_SAMPLES) * BUFFER_SAMPLES;
+	check(out.size() == expectedSize, "%s: %u samples, expected %u", api, (unsigned)out.size(), (unsigned)expectedSize);
+	check(out.size() >= source.size() && std::equal(source.begin(), source.end(), out.begin()), "%s: samples differ from the source", api);
+	bool padded = true;
+	for(size_t ii = source.size(); ii < out.size(); ii++) {
+		padded = padded && out[ii] == 0;
+	}
+	check(padded, "%s: last buffer is not padded with zeros", api);
+	check(sequenceOk, "%s: sequence numbers are not consecutive", api);
+	check(callbackSequenceOk, "%s: getLastSequence() inside the callback is not the buffer passed to it", api);
+	check(mic.getOverrunCount() == 0, "%s: %u overruns at speed 0", api, (unsigned)mic.getOverrunCount());
+	check(mic.isSourceDone(), "%s: source is not done", api);
+}
+
+static void checkOverruns() {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+
+	// 16000 Hz at speed 4 is one buffer every 4 ms
+	std::vector<int16_t> source = makeSource(BUFFER_SAMPLES * 200);
+	check(initMic(source, 16000, 16000, 4.0) == 0, "overruns: init failed");
+	uint32_t lateBefore = mic.getLateCount();
+	mic.start();
+
+	// Let every buffer fill, and then some more that must be discarded
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	uint32_t firstSequence = 0;
+	uint32_t previousSequence = 0;
+	uint32_t missing = 0;
+	size_t numBuffers = 0;
+	bool contentOk = true;
+	bool first = true;
+	uint32_t start = millis();
+	while(millis() - start < 10000 && !(mic.isSourceDone() && !mic.samplesAvailable())) {
+		bool gotBuffer = mic.noCopySamples([&](void *pSamples, size_t numSamples) {
+			const int16_t *samples = (const int16_t *)pSamples;
+			uint32_t sequence = mic.getLastSequence();
+			if (first) {
+				// Nothing has been read yet, so the first buffer can't have been discarded
+				firstSequence = sequence;
+			}
+			for(size_t ii = 0; ii < numSamples; ii++) {
+				size_t index = (sequence - firstSequence) * BUFFER_SAMPLES + ii;
+				int16_t expected = (index < source.size()) ? source[index] : 0;
+				if (samples[ii] != expected) {
+					contentOk = false;
+				}
+			}
+			if (!first) {
+				missing += sequence - previousSequence - 1;
+			}
+			first = false;
+			previousSequence = sequence;
+			numBuffers++;
+		});
+		if (!gotBuffer) {
+			mic.waitForSamples(20);
+		}
+	}
+	mic.stop();
+
+	uint32_t overruns = mic.getOverrunCount();
+	check(overruns > 0, "overruns: no overruns with a consumer 100 ms behind");
+	check(missing == overruns, "overruns: %u sequence numbers missing, %u overruns", (unsigned)missing, (unsigned)overruns);
+	check(numBuffers + overruns == 200, "overruns: %u delivered + %u discarded, expected 200 buffers", (unsigned)numBuffers, (unsigned)overruns);
+	check(contentOk, "overruns: a buffer doesn't hold the source samples for its sequence number");
+	check(mic.getLateCount() > lateBefore, "overruns: reading a backlog of buffers was not counted as late");
+}
+
+static void checkWait() {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+
+	std::vector<int16_t> source = makeSource(BUFFER_SAMPLES * 50);
+	check(initMic(source, 16000, 16000, 1.0) == 0, "wait: init failed");
+	mic.start();
+
+	// One buffer every 16 ms
+	check(mic.waitForSamples(200), "wait: no buffer within 200 ms");
+	check(mic.samplesAvailable(), "wait: woke without samples");
+	mic.stop();
+
+	while(mic.samplesAvailable()) {
+		mic.noCopySamples([](void *, size_t) {});
+	}
+	uint32_t start = millis();
+	check(!mic.waitForSamples(50), "wait: woke while stopped");
+	check(millis() - start >= 45, "wait: returned after %u ms, expected the 50 ms timeout", (unsigned)(millis() - start));
+}
+
+static void checkDecimation() {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+
+	std::vector<int16_t> source = makeSource(BUFFER_SAMPLES * 20);
+	check(initMic(source, 32000, 16000, 0) == 0, "decimation: init failed");
+	check(mic.getNumberOfSamples() == BUFFER_SAMPLES / 2, "decimation: %u samples per buffer", (unsigned)mic.getNumberOfSamples());
+	mic.start();
+
+	bool sequenceOk, callbackSequenceOk;
+	std::vector<int16_t> out = readAll(true, sequenceOk, callbackSequenceOk);
+	mic.stop();
+
+	MicDecimator decimator;
+	decimator.init(2, BUFFER_SAMPLES);
+	std::vector<int16_t> expected(source.size());
+	expected.resize(decimator.process(source.data(), source.size(), expected.data()));
+	check(out == expected, "decimation: %u samples differ from MicDecimator (%u samples)", (unsigned)out.size(), (unsigned)expected.size());
+	check(sequenceOk, "decimation: sequence numbers are not consecutive");
+}
+
+static void checkGain() {
+	Microphone_PDM &mic = Microphone_PDM::instance();
+
+	std::vector<int16_t> source = { 0, 100, -100, 1000, -1000, 20000, -20000, 32767, -32768 };
+	source.resize(BUFFER_SAMPLES);
+	mic.withCodecGain(6.0);
+	check(initMic(source, 16000, 16000, 0) == 0, "gain: init failed");
+	mic.start();
+
+	bool sequenceOk, callbackSequenceOk;
+	std::vector<int16_t> out = readAll(true, sequenceOk, callbackSequenceOk);
+	mic.stop();
+	mic.withCodecGain(0.0);
+
+	// 6 dB is a factor of 1.995
+	const int16_t expected[] = { 0, 199, -200, 1995, -1996, 32767, -32768, 32767, -32768 };
+	bool ok = out.size() == BUFFER_SAMPLES;
+	for(size_t ii = 0; ok && ii < sizeof(expected) / sizeof(expected[0]); ii++) {
+		if (out[ii] != expected[ii]) {
+			check(false, "gain: sample %d gives %d, expected %d", source[ii], out[ii], expected[ii]);
+			ok = false;
+		}
+	}
+	check(ok, "gain: output differs");
+}
+
+int main() {
+	checkInit();
+	checkSpeedZero(false);
+	checkSpeedZero(true);
+	checkOverruns();
+	checkWait();
+	checkDecimation();
+	checkGain();
+
+	Microphone_PDM::instance().uninit();
+
+	printf("%d checks, %d failed\n", numChecks, numFailures);
+
+	return (numFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+#include "MicAudioCodec.h"
+
+// IMA ADPCM quantizer step sizes
+static const int16_t imaStepTable[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+// Change to the step index for the magnitude bits of a nibble
+static const int8_t imaIndexTable[8] = {
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// G.711 mu-law
+static const int MULAW_BIAS = 0x84;
+static const int MULAW_CLIP = 32635;
+
+// Size of the IMA ADPCM block header: int16 first sample, step index, reserved
+static const size_t IMA_BLOCK_HEADER_SIZE = 4;
+
+// Add the difference for one nibble to predictor and update stepIndex. Shared by the encoder and decoder
+// so they track exactly the same state.
+static void imaUpdate(uint8_t nibble, int32_t &predictor, int &stepIndex) {
+	int step = imaStepTable[stepIndex];
+	int diff = step >> 3;
+	if (nibble & 4) {
+		diff += step;
+	}
+	if (nibble & 2) {
+		diff += step >> 1;
+	}
+	if (nibble & 1) {
+		diff += step >> 2;
+	}
+	predictor += (nibble & 8) ? -diff : diff;
+	if (predictor > 32767) {
+		predictor = 32767;
+	}
+	else
+	if (predictor < -32768) {
+		predictor = -32768;
+	}
+
+	stepIndex += imaIndexTable[nibble & 7];
+	if (stepIndex < 0) {
+		stepIndex = 0;
+	}
+	else
+	if (stepIndex > 88) {
+		stepIndex = 88;
+	}
+}
+
+MicAudioEncoder::MicAudioEncoder() {
+}
+
+MicAudioEncoder::~MicAudioEncoder() {
+	delete[] block;
+}
+
+bool MicAudioEncoder::init(Format format, uint8_t numChannels, uint16_t blockAlign) {
+	delete[] block;
+	block = 0;
+
+	this->format = format;
+	this->numChannels = numChannels;
+	this->blockAlign = blockAlign;
+	samplesPerBlock = 1;
+	numBlockSamples = 0;
+	predictor = 0;
+	stepIndex = 0;
+	numSamplesEncoded = 0;
+
+	switch(format) {
+	case Format::PCM:
+	case Format::MULAW:
+		return numChannels >= 1;
+
+	case Format::IMA_ADPCM:
+		if (numChannels != 1 || blockAlign < 8) {
+			return false;
+		}
+		samplesPerBlock = 1 + (blockAlign - IMA_BLOCK_HEADER_SIZE) * 2;
+		block = new uint8_t[blockAlign];
+		return block != 0;
+	}
+	return false;
+}
+
+size_t MicAudioEncoder::encode(const int16_t *src, size_t numSamples, uint8_t *dst) {
+	numSamplesEncoded += numSamples;
+
+	switch(format) {
+	case Format::PCM:
+		memcpy(dst, src, numSamples * sizeof(int16_t));
+		return numSamples * sizeof(int16_t);
+
+	case Format::MULAW:
+		for(size_t ii = 0; ii < numSamples; ii++) {
+			dst[ii] = mulawEncode(src[ii]);
+		}
+		return numSamples;
+
+	case Format::IMA_ADPCM:
+		break;
+	}
+
+	if (!block) {
+		return 0;
+	}
+
+	size_t dstSize = 0;
+	for(size_t ii = 0; ii < numSamples; ii++) {
+		if (numBlockSamples == 0) {
+			// The block header holds the first sample exactly, which resets any accumulated error
+			predictor = src[ii];
+			memcpy(&block[0], &src[ii], 2);
+			block[2] = (uint8_t) stepIndex;
+			block[3] = 0;
+		}
+		else {
+			uint8_t nibble = encodeNibble(src[ii]);
+			size_t pos = numBlockSamples - 1;
+			uint8_t *p = &block[IMA_BLOCK_HEADER_SIZE + pos / 2];
+			if ((pos & 1) == 0) {
+				*p = nibble;
+			}
+			else {
+				*p |= nibble << 4;
+			}
+		}
+
+		if (++numBlockSamples >= samplesPerBlock) {
+			memcpy(&dst[dstSize], block, blockAlign);
+			dstSize += blockAlign;
+			numBlockSamples = 0;
+		}
+	}
+	return dstSize;
+}
+
+size_t MicAudioEncoder::flush(uint8_t *dst) {
+	if (format != Format::IMA_ADPCM || !block || numBlockSamples == 0) {
+		return 0;
+	}
+
+	// An odd number of nibbles leaves the high nibble of the last byte as 0
+	size_t size = IMA_BLOCK_HEADER_SIZE + numBlockSamples / 2;
+	memcpy(dst, block, size);
+	numBlockSamples = 0;
+	return size;
+}
+
+size_t MicAudioEncoder::getMaxEncodedSize(size_t numSamples) const {
+	switch(format) {
+	case Format::PCM:
+		return numSamples * sizeof(int16_t);
+
+	case Format::MULAW:
+		return numSamples;
+
+	case Format::IMA_ADPCM:
+		break;
+	}
+	// Whole blocks only, including the samples already waiting
+	return ((numBlockSamples + numSamples) / samplesPerBlock) * blockAlign;
+}
+
+uint8_t MicAudioEncoder::getBitsPerSample() const {
+	switch(format) {
+	case Format::MULAW:
+		return 8;
+
+	case Format::IMA_ADPCM:
+		return 4;
+
+	default:
+		return 16;
+	}
+}
+
+uint16_t MicAudioEncoder::getBlockAlign() const {
+	if (format == Format::IMA_ADPCM) {
+		return blockAlign;
+	}
+	return numChannels * getBitsPerSample() / 8;
+}
+
+uint8_t MicAudioEncoder::encodeNibble(int16_t sample) {
+	int step = imaStepTable[stepIndex];
+	int32_t diff = (int32_t)sample - predictor;
+
+	uint8_t nibble = 0;
+	if (diff < 0) {
+		nibble = 8;
+		diff = -diff;
+	}
+	if (diff >= step) {
+		nibble |= 4;
+		diff -= step;
+	}
+	step >>= 1;
+	if (diff >= step) {
+		nibble |= 2;
+		diff -= step;
+	}
+	step >>= 1;
+	if (diff >= step) {
+		nibble |= 1;
+	}
+
+	imaUpdate(nibble, predictor, stepIndex);
+	return nibble;
+}
+
+// [static]
+uint8_t MicAudioEncoder::mulawEncode(int16_t sample) {
+	int value = sample;
+	uint8_t sign = 0;
+	if (value < 0) {
+		sign = 0x80;
+		value = -value;
+	}
+	if (value > MULAW_CLIP) {
+		value = MULAW_CLIP;
+	}
+	value += MULAW_BIAS;
+
+	// Segment is the position of the highest set bit above bit 7
+	int exponent = 7;
+	for(int mask = 0x4000; (value & mask) == 0 && exponent > 0; mask >>= 1) {
+		exponent--;
+	}
+	int mantissa = (value >> (exponent + 3)) & 0x0f;
+
+	return (uint8_t) ~(sign | (exponent << 4) | mantissa);
+}
+
+// [static]
+int16_t MicAudioEncoder::mulawDecode(uint8_t value) {
+	value = ~value;
+	int exponent = (value >> 4) & 0x07;
+	int mantissa = value & 0x0f;
+	int sample = (((mantissa << 3) + MULAW_BIAS) << exponent) - MULAW_BIAS;
+
+	return (int16_t) ((value & 0x80) ? -sample : sample);
+}
+
+// [static]
+size_t MicAudioEncoder::decodeImaAdpcmBlock(const uint8_t *block, size_t blockSize, int16_t *dst) {
+	if (blockSize < IMA_BLOCK_HEADER_SIZE) {
+		return 0;
+	}
+
+	int16_t first;
+	memcpy(&first, &block[0], 2);
+	int32_t predictor = first;
+	int stepIndex = block[2];
+	if (stepIndex > 88) {
+		stepIndex = 88;
+	}
+
+	size_t numSamples = 0;
+	dst[numSamples++] = first;
+
+	for(size_t ii = IMA_BLOCK_HEADER_SIZE; ii < blockSize; ii++) {
+		imaUpdate(block[ii] & 0x0f, predictor, stepIndex);
+		dst[numSamples++] = (int16_t) predictor;
+
+		imaUpdate(block[ii] >> 4, predictor, stepIndex);
+		dst[numSamples++] = (int16_t) predictor;
+	}
+	return numSamples;
+}
@@ -0,0 +1,142 @@
+#ifndef _MICAUDIOCODEC_H
+#define _MICAUDIOCODEC_H
+
+#include "Particle.h"
+
+/**
+ * @brief Streaming encoder from signed 16-bit samples to G.711 mu-law or IMA ADPCM
+ *
+ * Mu-law stores each sample in 8 bits (2:1) and IMA ADPCM in 4 bits (4:1), in the formats used by
+ * wav files (format tags 7 and 0x11), so the output can be written directly after a header from
+ * MicWavHeaderBase::writeHeader(). PCM passes the samples through unchanged.
+ *
+ * IMA ADPCM is encoded in blocks of getBlockAlign() bytes, each starting with the exact value of its
+ * first sample and the step index. encode() only outputs whole blocks and keeps the rest of the
+ * samples until the next call; flush() outputs the last, shorter block. IMA ADPCM is mono only.
+ */
+class MicAudioEncoder {
+public:
+	/**
+	 * @brief Output format. The values are the wav format tags.
+	 */
+	enum class Format {
+		PCM = 1, 		//!< Signed 16-bit little endian, unchanged
+		MULAW = 7, 		//!< G.711 mu-law, 8 bits per sample
+		IMA_ADPCM = 0x11 //!< IMA (DVI) ADPCM, 4 bits per sample in blocks
+	};
+
+	/**
+	 * @brief Default IMA ADPCM block size in bytes, 505 samples per block
+	 */
+	static const uint16_t DEFAULT_BLOCK_ALIGN = 256;
+
+	MicAudioEncoder();
+	virtual ~MicAudioEncoder();
+
+	/**
+	 * @brief Set the output format and reset the encoder
+	 *
+	 * @param format Output format
+	 *
+	 * @param numChannels Number of channels. Must be 1 for IMA_ADPCM.
+	 *
+	 * @param blockAlign IMA ADPCM block size in bytes, at least 8. Ignored for other formats.
+	 *
+	 * @return true if the combination is supported
+	 */
+	bool init(Format format, uint8_t numChannels = 1, uint16_t blockAlign = DEFAULT_BLOCK_ALIGN);
+
+	/**
+	 * @brief Encode samples
+	 *
+	 * @param src Signed 16-bit samples, interleaved if there are 2 channels
+	 *
+	 * @param numSamples Number of samples
+	 *
+	 * @param dst Buffer for the encoded data, at least getMaxEncodedSize(numSamples) bytes
+	 *
+	 * @return Number of bytes written to dst
+	 */
+	size_t encode(const int16_t *src, size_t numSamples, uint8_t *dst);
+
+	/**
+	 * @brief Output any samples kept for a partial IMA ADPCM block. Call once at the end of the recording.
+	 *
+	 * @param dst Buffer, at least getBlockAlign() bytes
+	 *
+	 * @return Number of bytes written to dst
+	 */
+	size_t flush(uint8_t *dst);
+
+	/**
+	 * @brief Maximum number of bytes encode() can write for numSamples
+	 */
+	size_t getMaxEncodedSize(size_t numSamples) const;
+
+	/**
+	 * @brief Number of samples encoded since init(), including ones waiting for a whole block
+	 */
+	uint32_t getNumSamples() const { return numSamplesEncoded; };
+
+	Format getFormat() const { return format; };
+
+	uint8_t getNumChannels() const { return numChannels; };
+
+	/**
+	 * @brief wav BitsPerSample: 16, 8, or 4
+	 */
+	uint8_t getBitsPerSample() const;
+
+	/**
+	 * @brief wav BlockAlign: bytes per frame for PCM and mu-law, bytes per block for IMA ADPCM
+	 */
+	uint16_t getBlockAlign() const;
+
+	/**
+	 * @brief Samples per IMA ADPCM block, or 1 for other formats
+	 */
+	uint16_t getSamplesPerBlock() const { return samplesPerBlock; };
+
+	/**
+	 * @brief Convert a sample to G.711 mu-law
+	 */
+	static uint8_t mulawEncode(int16_t sample);
+
+	/**
+	 * @brief Convert a G.711 mu-law value back to a sample
+	 */
+	static int16_t mulawDecode(uint8_t value);
+
+	/**
+	 * @brief Decode one mono IMA ADPCM block
+	 *
+	 * @param block The block, including the 4 byte header
+	 *
+	 * @param blockSize Size of the block in bytes. The last block of a file can be shorter than the block align.
+	 *
+	 * @param dst Buffer for the samples, at least 1 + (blockSize - 4) * 2 samples
+	 *
+	 * @return Number of samples written to dst
+	 *
+	 * This is mainly for reading the files back on a computer to check them.
+	 */
+	static size_t decodeImaAdpcmBlock(const uint8_t *block, size_t blockSize, int16_t *dst);
+
+protected:
+	/**
+	 * @brief Encode one sample to a nibble, updating predictor and stepIndex
+	 */
+	uint8_t encodeNibble(int16_t sample);
+
+	Format format = Format::PCM; //!< Output format
+	uint8_t numChannels = 1; //!< Number of channels
+	uint16_t blockAlign = DEFAULT_BLOCK_ALIGN; //!< IMA ADPCM bytes per block
+	uint16_t samplesPerBlock = 1; //!< IMA ADPCM samples per block
+	uint8_t *block = 0; //!< IMA ADPCM block being encoded
+	size_t numBlockSamples = 0; //!< Number of samples in block
+	int32_t predictor = 0; //!< IMA ADPCM predicted sample
+	int stepIndex = 0; //!< IMA ADPCM index into the step table
+	uint32_t numSamplesEncoded = 0; //!< See getNumSamples()
+};
+
+#endif /* _MICAUDIOCODEC_H */
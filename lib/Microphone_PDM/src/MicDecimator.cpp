@@ -0,0 +1,212 @@
+#include "MicDecimator.h"
+
+// Kaiser-windowed (beta 6) low-pass filters in Q15 with unity gain at DC.
+//
+// Factor 2: 48 taps, passband to 0.17 fs, -57 dB at 0.25 fs (the output Nyquist frequency).
+// At 32000 Hz in, that's flat to 5.4 kHz and the stopband starts at 8 kHz.
+static const int16_t coeffsFactor2[48] = {
+	-3, -13, -2, 33, 29, -48, -90, 29, 176, 63, -249, -257,
+	230, 538, -22, -828, -475, 973, 1348, -710, -2792, -633, 6312, 12775,
+	12775, 6312, -633, -2792, -710, 1348, 973, -475, -828, -22, 538, 230,
+	-257, -249, 63, 176, 29, -90, -48, 29, 33, -2, -13, -3,
+};
+
+// Factor 4: 96 taps, passband to 0.085 fs, -60 dB at 0.125 fs (the output Nyquist frequency).
+// At 32000 Hz in, that's flat to 2.7 kHz and the stopband starts at 4 kHz.
+static const int16_t coeffsFactor4[96] = {
+	0, -3, -6, -8, -5, 3, 13, 21, 20, 8, -14, -36,
+	-48, -39, -7, 39, 80, 93, 63, -6, -91, -153, -157, -86,
+	44, 184, 269, 244, 97, -130, -346, -447, -359, -78, 306, 636,
+	744, 521, -15, -703, -1263, -1389, -856, 389, 2172, 4129, 5797, 6757,
+	6757, 5797, 4129, 2172, 389, -856, -1389, -1263, -703, -15, 521, 744,
+	636, 306, -78, -359, -447, -346, -130, 97, 244, 269, 184, 44,
+	-86, -157, -153, -91, -6, 63, 93, 80, 39, -7, -39, -48,
+	-36, -14, 8, 20, 21, 13, 3, -5, -8, -6, -3, 0,
+};
+
+// Dot product of numTaps samples and coefficients. numTaps is always a multiple of 8.
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+// Cortex-M4 and M33: two multiply-accumulates per cycle using SMLAD, the same as arm_fir_decimate_q15()
+
+static inline int32_t dotProduct(const int16_t *x, const int16_t *h, size_t numTaps) {
+	int32_t acc = 0;
+	for(size_t ii = 0; ii < numTaps; ii += 4) {
+		uint32_t x0, x1, h0, h1;
+		memcpy(&x0, &x[ii], 4);
+		memcpy(&x1, &x[ii + 2], 4);
+		memcpy(&h0, &h[ii], 4);
+		memcpy(&h1, &h[ii + 2], 4);
+		acc = (int32_t) __SMLAD(x0, h0, (uint32_t)acc);
+		acc = (int32_t) __SMLAD(x1, h1, (uint32_t)acc);
+	}
+	return acc;
+}
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+static inline int32_t dotProduct(const int16_t *x, const int16_t *h, size_t numTaps) {
+	__m128i acc = _mm_setzero_si128();
+	for(size_t ii = 0; ii < numTaps; ii += 8) {
+		__m128i xv = _mm_loadu_si128((const __m128i *)&x[ii]);
+		__m128i hv = _mm_loadu_si128((const __m128i *)&h[ii]);
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(xv, hv));
+	}
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+}
+
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+static inline int32_t dotProduct(const int16_t *x, const int16_t *h, size_t numTaps) {
+	int32x4_t acc = vdupq_n_s32(0);
+	for(size_t ii = 0; ii < numTaps; ii += 8) {
+		int16x8_t xv = vld1q_s16(&x[ii]);
+		int16x8_t hv = vld1q_s16(&h[ii]);
+		acc = vmlal_s16(acc, vget_low_s16(xv), vget_low_s16(hv));
+		acc = vmlal_s16(acc, vget_high_s16(xv), vget_high_s16(hv));
+	}
+	return vaddvq_s32(acc);
+}
+
+#else
+
+static inline int32_t dotProduct(const int16_t *x, const int16_t *h, size_t numTaps) {
+	int32_t acc = 0;
+	for(size_t ii = 0; ii < numTaps; ii++) {
+		acc += (int32_t)x[ii] * (int32_t)h[ii];
+	}
+	return acc;
+}
+#endif
+
+// Round a Q30 accumulator to Q15 with saturation
+static inline int16_t roundQ15(int32_t acc) {
+	int32_t val = (acc + (1 << 14)) >> 15;
+
+	if (val < -32768) {
+		val = -32768;
+	}
+	if (val > 32767) {
+		val = 32767;
+	}
+	return (int16_t) val;
+}
+
+
+MicDecimator::MicDecimator() {
+}
+
+MicDecimator::~MicDecimator() {
+	release();
+}
+
+bool MicDecimator::init(unsigned int factor, size_t maxBlockSize, const int16_t *coeffs, size_t numTaps) {
+	release();
+
+	if (factor <= 1) {
+		return true;
+	}
+
+	if (!coeffs) {
+		switch(factor) {
+			case 2:
+				coeffs = coeffsFactor2;
+				numTaps = sizeof(coeffsFactor2) / sizeof(coeffsFactor2[0]);
+				break;
+
+			case 4:
+				coeffs = coeffsFactor4;
+				numTaps = sizeof(coeffsFactor4) / sizeof(coeffsFactor4[0]);
+				break;
+
+			default:
+				return false;
+		}
+	}
+	if (numTaps == 0 || maxBlockSize == 0) {
+		return false;
+	}
+
+	// Pad to a multiple of 8 with leading zeros so the dot product has no tail. The zeros multiply
+	// the oldest history samples.
+	size_t paddedTaps = (numTaps + 7) & ~(size_t)7;
+
+	this->coeffs = new int16_t[paddedTaps];
+	this->state = new int16_t[paddedTaps - 1 + maxBlockSize];
+	if (!this->coeffs || !this->state) {
+		release();
+		return false;
+	}
+
+	// The newest sample is at the end of the window, so reverse the coefficients
+	size_t pad = paddedTaps - numTaps;
+	for(size_t ii = 0; ii < paddedTaps; ii++) {
+		this->coeffs[ii] = (ii < pad) ? 0 : coeffs[numTaps - 1 - (ii - pad)];
+	}
+
+	this->factor = factor;
+	this->numTaps = paddedTaps;
+	this->maxBlockSize = maxBlockSize;
+	reset();
+
+	return true;
+}
+
+void MicDecimator::reset() {
+	phase = 0;
+	if (state) {
+		memset(state, 0, (numTaps - 1) * sizeof(int16_t));
+	}
+}
+
+size_t MicDecimator::process(const int16_t *src, size_t numSamples, int16_t *dst) {
+	if (factor <= 1) {
+		if (src != dst) {
+			memmove(dst, src, numSamples * sizeof(int16_t));
+		}
+		return numSamples;
+	}
+
+	const size_t history = numTaps - 1;
+	size_t outCount = 0;
+
+	while(numSamples > 0) {
+		size_t count = (numSamples < maxBlockSize) ? numSamples : maxBlockSize;
+
+		// The whole block is copied before any output is written, which is what makes in-place safe:
+		// the outputs for this block only ever overwrite input that has been consumed.
+		memcpy(&state[history], src, count * sizeof(int16_t));
+
+		size_t pos = phase;
+		for(; pos < count; pos += factor) {
+			// Window ends at the input sample at pos
+			dst[outCount++] = roundQ15(dotProduct(&state[pos], coeffs, numTaps));
+		}
+		phase = pos - count;
+
+		memmove(state, &state[count], history * sizeof(int16_t));
+
+		src += count;
+		numSamples -= count;
+	}
+
+	return outCount;
+}
+
+void MicDecimator::release() {
+	if (coeffs) {
+		delete[] coeffs;
+		coeffs = 0;
+	}
+	if (state) {
+		delete[] state;
+		state = 0;
+	}
+	factor = 1;
+	numTaps = 0;
+	maxBlockSize = 0;
+	phase = 0;
+}
@@ -0,0 +1,93 @@
+#ifndef __MICDECIMATOR_H
+#define __MICDECIMATOR_H
+
+#include "Particle.h"
+
+/**
+ * @brief Streaming FIR decimator for 16-bit samples
+ *
+ * Low-pass filters the samples and keeps every factor-th output, computing only the outputs that are kept.
+ * The filter history is kept between calls to process(), so a continuous stream can be passed in one
+ * DMA buffer at a time without discontinuities at the buffer boundaries.
+ *
+ * This is used by Microphone_PDM to capture at a higher sample rate than the output sample rate, for
+ * example capture at 32000 Hz and output 16000 Hz, or to produce 8000 Hz on the nRF52, which only samples
+ * at 16000 Hz. You normally won't use this class directly.
+ */
+class MicDecimator {
+public:
+	/**
+	 * @brief Construct a decimator. It does nothing (factor 1) until init() is called.
+	 */
+	MicDecimator();
+
+	/**
+	 * @brief Destructor. Releases the filter state and coefficients.
+	 */
+	virtual ~MicDecimator();
+
+	/**
+	 * @brief Set the decimation factor and allocate the filter state
+	 *
+	 * @param factor Decimation factor. 1 passes samples through unmodified. 2 and 4 have built-in
+	 * anti-aliasing filters; other factors require coeffs.
+	 *
+	 * @param maxBlockSize The largest number of samples that will be passed to process() at once. Larger
+	 * blocks are still processed correctly, just in pieces.
+	 *
+	 * @param coeffs Optional Q15 filter coefficients. If NULL, the built-in filter for factor is used. The
+	 * sum of the absolute values of the coefficients must be less than 2.0 (65536) so the accumulator can't
+	 * overflow.
+	 *
+	 * @param numTaps Number of coefficients in coeffs
+	 *
+	 * @return true on success, false if there is no filter for factor or memory could not be allocated
+	 *
+	 * Calling init() again releases the previous state and resets the filter.
+	 */
+	bool init(unsigned int factor, size_t maxBlockSize, const int16_t *coeffs = NULL, size_t numTaps = 0);
+
+	/**
+	 * @brief Clear the filter history, for example after the stream is stopped and restarted
+	 */
+	void reset();
+
+	/**
+	 * @brief Filter and decimate a block of samples
+	 *
+	 * @param src Input samples
+	 *
+	 * @param numSamples Number of input samples
+	 *
+	 * @param dst Output samples. There will be numSamples / factor samples when numSamples is a multiple
+	 * of factor; otherwise the remainder carries over to the next call. dst can be the same as src.
+	 *
+	 * @return size_t Number of samples written to dst
+	 */
+	size_t process(const int16_t *src, size_t numSamples, int16_t *dst);
+
+	/**
+	 * @brief Get the decimation factor set by init()
+	 */
+	unsigned int getFactor() const { return factor; };
+
+	/**
+	 * @brief Get the number of filter taps, rounded up to a multiple of 8
+	 */
+	size_t getNumTaps() const { return numTaps; };
+
+protected:
+	/**
+	 * @brief Release the filter state and coefficients
+	 */
+	void release();
+
+	unsigned int factor = 1;	//!< Decimation factor
+	size_t numTaps = 0;			//!< Number of coefficients, padded with leading zeros to a multiple of 8
+	size_t maxBlockSize = 0;	//!< Number of input samples state has room for after the history
+	size_t phase = 0;			//!< Input samples to skip before the next output
+	int16_t *coeffs = 0;		//!< Coefficients in reverse order so they line up with the history
+	int16_t *state = 0;			//!< numTaps - 1 samples of history followed by the current block
+};
+
+#endif /* __MICDECIMATOR_H */
@@ -0,0 +1,79 @@
+#include "MicLatency.h"
+
+static int highestBit(uint32_t value) {
+	return 31 - __builtin_clz(value);
+}
+
+// [static]
+size_t MicLatencyHistogram::bucketIndex(uint32_t value) {
+	if (value < SUB_BUCKETS) {
+		return value;
+	}
+	int bit = highestBit(value);
+	uint32_t sub = (value >> (bit - 2)) & (SUB_BUCKETS - 1);
+	return (size_t)(bit - 1) * SUB_BUCKETS + sub;
+}
+
+// [static]
+uint32_t MicLatencyHistogram::bucketUpperBound(size_t index) {
+	if (index < SUB_BUCKETS) {
+		return (uint32_t)index;
+	}
+	int bit = (int)(index / SUB_BUCKETS) + 1;
+	uint64_t sub = index % SUB_BUCKETS;
+	return (uint32_t)((((uint64_t)SUB_BUCKETS + sub + 1) << (bit - 2)) - 1);
+}
+
+void MicLatencyHistogram::add(uint32_t us) {
+	if (count == 0 || us < min) {
+		min = us;
+	}
+	if (us > max) {
+		max = us;
+	}
+	count++;
+	total += us;
+
+	uint16_t *bucket = &buckets[bucketIndex(us)];
+	if (*bucket == UINT16_MAX) {
+		for (size_t ix = 0; ix < NUM_BUCKETS; ix++) {
+			buckets[ix] = (buckets[ix] + 1) / 2;
+		}
+	}
+	(*bucket)++;
+}
+
+void MicLatencyHistogram::reset() {
+	count = 0;
+	min = 0;
+	max = 0;
+	total = 0;
+	memset(buckets, 0, sizeof(buckets));
+}
+
+uint32_t MicLatencyHistogram::getPercentile(uint32_t percent) const {
+	uint64_t inBuckets = 0;
+	for (size_t ix = 0; ix < NUM_BUCKETS; ix++) {
+		inBuckets += buckets[ix];
+	}
+	if (inBuckets == 0) {
+		return 0;
+	}
+
+	// First bucket where at least percent of the measurements are at or below
+	uint64_t seen = 0;
+	for (size_t ix = 0; ix < NUM_BUCKETS; ix++) {
+		seen += buckets[ix];
+		if (seen * 100 >= inBuckets * percent) {
+			uint32_t bound = bucketUpperBound(ix);
+			return (bound < max) ? bound : max;
+		}
+	}
+	return max;
+}
+
+void MicLatencyHistogram::log() const {
+	Log.info("%s: n=%lu min=%lu p50=%lu mean=%lu p90=%lu p99=%lu max=%lu us", name,
+		(unsigned long)count, (unsigned long)min, (unsigned long)getPercentile(50), (unsigned long)getMean(),
+		(unsigned long)getPercentile(90), (unsigned long)getPercentile(99), (unsigned long)max);
+}
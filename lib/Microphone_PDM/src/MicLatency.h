@@ -0,0 +1,104 @@
+#ifndef __MICLATENCY_H
+#define __MICLATENCY_H
+
+#include "Particle.h"
+
+/**
+ * @brief Histogram of latencies in microseconds
+ *
+ * Values below 4 us have their own bucket, and above that every power of two is split into 4 buckets,
+ * so percentiles are at most 25% above the real value. The buckets cover up to about 2^32 us (71 minutes)
+ * in 512 bytes. When a bucket is full every bucket is halved, which keeps the shape of the distribution.
+ *
+ * Use it with the buffer timestamps (Microphone_PDM::getLastTimestamp()) to measure how long audio takes
+ * to get from the microphone to your code, and through each stage of your own processing. It only uses
+ * micros() values, so it works the same with the host simulator.
+ */
+class MicLatencyHistogram {
+public:
+	static const size_t SUB_BUCKETS = 4;	//!< Buckets per power of two
+	static const size_t NUM_BUCKETS = 124;	//!< Enough for 32 bit values
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param name Name used by log(). The string is not copied.
+	 */
+	explicit MicLatencyHistogram(const char *name = "") : name(name) { reset(); };
+
+	/**
+	 * @brief Add a measurement
+	 *
+	 * @param us Latency in microseconds
+	 */
+	void add(uint32_t us);
+
+	/**
+	 * @brief Add the time from start to end, two micros() values. Wraparound is handled.
+	 */
+	void addInterval(uint32_t start, uint32_t end) { add(end - start); };
+
+	/**
+	 * @brief Clear all measurements
+	 */
+	void reset();
+
+	/**
+	 * @brief Number of measurements since reset()
+	 */
+	uint32_t getCount() const { return count; };
+
+	/**
+	 * @brief Smallest measurement, 0 if there are none
+	 */
+	uint32_t getMin() const { return min; };
+
+	/**
+	 * @brief Largest measurement
+	 */
+	uint32_t getMax() const { return max; };
+
+	/**
+	 * @brief Average of the measurements
+	 */
+	uint32_t getMean() const { return count ? (uint32_t)(total / count) : 0; };
+
+	/**
+	 * @brief Value that percent of the measurements are at or below
+	 *
+	 * @param percent 0 to 100, for example 50 for the median or 99
+	 *
+	 * @return uint32_t Upper bound of the bucket the percentile is in, but never more than getMax()
+	 */
+	uint32_t getPercentile(uint32_t percent) const;
+
+	/**
+	 * @brief Get the name passed to the constructor
+	 */
+	const char *getName() const { return name; };
+
+	/**
+	 * @brief Log a one line summary with Log.info
+	 */
+	void log() const;
+
+protected:
+	/**
+	 * @brief Bucket a value goes in
+	 */
+	static size_t bucketIndex(uint32_t value);
+
+	/**
+	 * @brief Largest value in a bucket
+	 */
+	static uint32_t bucketUpperBound(size_t index);
+
+	const char *name;				//!< Name used by log()
+	uint32_t count;					//!< Number of measurements
+	uint32_t min;					//!< Smallest measurement
+	uint32_t max;					//!< Largest measurement
+	uint64_t total;					//!< Sum of the measurements, for the mean
+	uint16_t buckets[NUM_BUCKETS];	//!< Number of measurements in each bucket
+};
+
+#endif /* __MICLATENCY_H */
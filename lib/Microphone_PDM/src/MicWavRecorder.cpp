@@ -0,0 +1,394 @@
+#include "MicWavRecorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+#include <chrono>
+#endif
+
+// Sleep in the writer thread while waiting for a chunk
+static void writerSleep() {
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#else
+	delay(1);
+#endif
+}
+
+// Translate errno from the POSIX file API into a SYSTEM_ERROR_* value
+static int errnoToSystemError(int err) {
+	switch(err) {
+		case ENOENT:
+		case ENOTDIR:
+			return SYSTEM_ERROR_NOT_FOUND;
+
+		case EACCES:
+		case EPERM:
+		case EROFS:
+		case EISDIR:
+			return SYSTEM_ERROR_NOT_ALLOWED;
+
+		case EEXIST:
+			return SYSTEM_ERROR_ALREADY_EXISTS;
+
+		case ENOSPC:
+		case EFBIG:
+		case EMFILE:
+		case ENFILE:
+			return SYSTEM_ERROR_LIMIT_EXCEEDED;
+
+		case ENOMEM:
+			return SYSTEM_ERROR_NO_MEMORY;
+
+		case EINVAL:
+		case ENAMETOOLONG:
+			return SYSTEM_ERROR_INVALID_ARGUMENT;
+
+		default:
+			return SYSTEM_ERROR_IO;
+	}
+}
+
+MicWavFileSink::MicWavFileSink(const char *path) {
+	this->path = strdup(path);
+}
+
+MicWavFileSink::~MicWavFileSink() {
+	close();
+	free(path);
+}
+
+int MicWavFileSink::open() {
+	close();
+
+	if (!path) {
+		return SYSTEM_ERROR_NO_MEMORY;
+	}
+	fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		return errnoToSystemError(errno);
+	}
+	return 0;
+}
+
+int MicWavFileSink::write(const uint8_t *buf, size_t len) {
+	while(len > 0) {
+		ssize_t count = ::write(fd, buf, len);
+		if (count < 0) {
+			return errnoToSystemError(errno);
+		}
+		if (count == 0) {
+			return SYSTEM_ERROR_IO;
+		}
+		buf += count;
+		len -= count;
+	}
+	return 0;
+}
+
+int MicWavFileSink::writeAt(size_t offset, const uint8_t *buf, size_t len) {
+	off_t end = lseek(fd, 0, SEEK_CUR);
+	if (end < 0 || lseek(fd, (off_t)offset, SEEK_SET) < 0) {
+		return SYSTEM_ERROR_IO;
+	}
+	int res = write(buf, len);
+	lseek(fd, end, SEEK_SET);
+	return res;
+}
+
+int MicWavFileSink::close() {
+	int res = 0;
+	if (fd >= 0) {
+		if (::close(fd) != 0) {
+			res = SYSTEM_ERROR_IO;
+		}
+		fd = -1;
+	}
+	return res;
+}
+
+
+Microphone_PDM_WavRecorder::Microphone_PDM_WavRecorder() : finishing(false), writerDone(false), writerRunning(false), dataSize(0), result(0) {
+}
+
+Microphone_PDM_WavRecorder::~Microphone_PDM_WavRecorder() {
+	// Writes whatever was queued and closes the sink
+	stop();
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+	if (writerThread.joinable()) {
+		writerThread.join();
+	}
+#else
+	while(writerRunning) {
+		delay(1);
+	}
+#endif
+	delete[] chunkState;
+	delete[] chunkLength;
+	delete[] encodeBuffer;
+	delete ownedSink;
+}
+
+Microphone_PDM_WavRecorder &Microphone_PDM_WavRecorder::withFile(const char *path) {
+	delete ownedSink;
+	ownedSink = new MicWavFileSink(path);
+	sink = ownedSink;
+	return *this;
+}
+
+Microphone_PDM_WavRecorder &Microphone_PDM_WavRecorder::withSink(MicWavSink *sink) {
+	this->sink = sink;
+	return *this;
+}
+
+bool Microphone_PDM_WavRecorder::start() {
+	if (!sink || buffer || chunkSize == 0) {
+		return false;
+	}
+	result = 0;
+
+	Microphone_PDM &mic = Microphone_PDM::instance();
+	sampleSizeInBytes = mic.getSampleSizeInBytes();
+
+	if (encoding != MicAudioEncoder::Format::PCM && sampleSizeInBytes != 2) {
+		// The encoders take signed 16-bit samples
+		result = SYSTEM_ERROR_INVALID_ARGUMENT;
+		return false;
+	}
+	if (!encoder.init(encoding, mic.getNumChannels(), encodingBlockAlign)) {
+		result = SYSTEM_ERROR_NOT_SUPPORTED;
+		return false;
+	}
+
+	// Keep chunks a whole number of frames, or of blocks for IMA ADPCM
+	size_t frameSize = sampleSizeInBytes * mic.getNumChannels();
+	if (encoding == MicAudioEncoder::Format::IMA_ADPCM) {
+		frameSize = encoder.getBlockAlign();
+		if (chunkSize < frameSize) {
+			chunkSize = frameSize;
+		}
+	}
+	chunkSize -= chunkSize % frameSize;
+	targetSize = (size_t)(mic.getSampleRate() / 1000 * durationMs) * sampleSizeInBytes * mic.getNumChannels();
+
+	if (encoding != MicAudioEncoder::Format::PCM) {
+		// Enough for a DMA buffer of samples and a partial block flushed at stop()
+		encodeBuffer = new uint8_t[mic.getBufferSizeInBytes() + encoder.getBlockAlign()];
+		if (!encodeBuffer) {
+			result = SYSTEM_ERROR_NO_MEMORY;
+			releaseChunks();
+			return false;
+		}
+	}
+
+	bufferSize = numChunks * chunkSize;
+	buffer = new uint8_t[bufferSize];
+	chunkState = new std::atomic<uint8_t>[numChunks];
+	chunkLength = new size_t[numChunks];
+	if (!buffer || !chunkState || !chunkLength) {
+		result = SYSTEM_ERROR_NO_MEMORY;
+		releaseChunks();
+		return false;
+	}
+	for(size_t ii = 0; ii < numChunks; ii++) {
+		chunkState[ii] = CHUNK_FREE;
+		chunkLength[ii] = 0;
+	}
+
+	header.writeHeader((uint16_t) encoder.getFormat(), mic.getNumChannels(), (uint32_t) mic.getSampleRate(),
+		encoder.getBitsPerSample(), encoder.getBlockAlign(), encoder.getSamplesPerBlock(), 0);
+
+	int res = sink->open();
+	if (res == 0) {
+		res = sink->write(header.getBuffer(), header.getBufferOffset());
+	}
+	if (res != 0) {
+		result = res;
+		sink->close();
+		releaseChunks();
+		return false;
+	}
+
+	writerRunning = true;
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+	writerThread = std::thread(&Microphone_PDM_WavRecorder::writerThreadFunction, this);
+#else
+	os_result_t osRes = os_thread_create(&writerThread, "wavrec", OS_THREAD_PRIORITY_DEFAULT, [](void *param) {
+		((Microphone_PDM_WavRecorder *)param)->writerThreadFunction();
+		os_thread_exit(nullptr);
+	}, this, 3072);
+	if (osRes != 0) {
+		writerRunning = false;
+		result = SYSTEM_ERROR_NO_MEMORY;
+		sink->close();
+		releaseChunks();
+		return false;
+	}
+#endif
+	return true;
+}
+
+void Microphone_PDM_WavRecorder::loop() {
+	if (writerDone) {
+		if (!closeCallbackCalled) {
+			closeCallbackCalled = true;
+			if (closeCallback) {
+				closeCallback(result, dataSize);
+			}
+		}
+		return;
+	}
+
+	if (!buffer || finishing || !Microphone_PDM::instance().samplesAvailable()) {
+		return;
+	}
+
+	Microphone_PDM::instance().noCopySamples([this](void *pSamples, size_t numSamples) {
+		const uint8_t *src = (const uint8_t *)pSamples;
+		size_t bytesToCopy = sampleSizeInBytes * numSamples;
+
+		if (targetSize && (receivedSize + bytesToCopy) > targetSize) {
+			bytesToCopy = targetSize - receivedSize;
+		}
+		receivedSize += bytesToCopy;
+
+		if (encodeBuffer) {
+			size_t encodedSize = encoder.encode((const int16_t *)src, bytesToCopy / 2, encodeBuffer);
+			appendToChunks(encodeBuffer, encodedSize);
+		}
+		else {
+			appendToChunks(src, bytesToCopy);
+		}
+
+		if (targetSize && receivedSize >= targetSize) {
+			stop();
+		}
+	});
+}
+
+bool Microphone_PDM_WavRecorder::done() const {
+	return writerDone;
+}
+
+void Microphone_PDM_WavRecorder::stop() {
+	if (!writerRunning || finishing) {
+		return;
+	}
+	if (encodeBuffer) {
+		appendToChunks(encodeBuffer, encoder.flush(encodeBuffer));
+	}
+	if (fillOffset > 0) {
+		handOffChunk();
+	}
+
+	// The writer checks this before looking for a ready chunk, so it can't miss the one above
+	finishing = true;
+}
+
+void Microphone_PDM_WavRecorder::releaseChunks() {
+	// buffer is also what makes start() refuse to run twice, so it has to be cleared for a retry
+	delete[] buffer;
+	buffer = 0;
+	bufferSize = 0;
+	delete[] chunkState;
+	chunkState = 0;
+	delete[] chunkLength;
+	chunkLength = 0;
+	delete[] encodeBuffer;
+	encodeBuffer = 0;
+}
+
+void Microphone_PDM_WavRecorder::appendToChunks(const uint8_t *src, size_t len) {
+	while(len > 0) {
+		size_t count = chunkSize - fillOffset;
+		if (count > len) {
+			count = len;
+		}
+		memcpy(&buffer[fillIndex * chunkSize + fillOffset], src, count);
+		fillOffset += count;
+		src += count;
+		len -= count;
+
+		if (fillOffset >= chunkSize) {
+			handOffChunk();
+		}
+	}
+}
+
+void Microphone_PDM_WavRecorder::handOffChunk() {
+	size_t nextIndex = (fillIndex + 1) % numChunks;
+
+	if (chunkState[nextIndex] != CHUNK_FREE) {
+		// Nowhere to put the next samples, so discard this chunk and fill it again
+		droppedChunkCount++;
+		fillOffset = 0;
+		return;
+	}
+
+	chunkLength[fillIndex] = fillOffset;
+	chunkState[fillIndex] = CHUNK_READY;
+
+	size_t numReady = 0;
+	for(size_t ii = 0; ii < numChunks; ii++) {
+		if (chunkState[ii] == CHUNK_READY) {
+			numReady++;
+		}
+	}
+	if (numReady > 1) {
+		backPressureCount++;
+	}
+
+	fillIndex = nextIndex;
+	fillOffset = 0;
+}
+
+void Microphone_PDM_WavRecorder::writerThreadFunction() {
+	size_t writeIndex = 0;
+
+	while(true) {
+		bool isFinishing = finishing;
+
+		if (chunkState[writeIndex] == CHUNK_READY) {
+			if (result == 0) {
+				int res = sink->write(&buffer[writeIndex * chunkSize], chunkLength[writeIndex]);
+				if (res == 0) {
+					dataSize += chunkLength[writeIndex];
+				}
+				else {
+					// Keep consuming chunks so loop() doesn't count them as dropped, but don't write any more
+					result = res;
+				}
+			}
+			chunkState[writeIndex] = CHUNK_FREE;
+			writeIndex = (writeIndex + 1) % numChunks;
+			continue;
+		}
+
+		if (isFinishing) {
+			break;
+		}
+		writerSleep();
+	}
+
+	// Patch the RIFF and data chunk sizes now that the length is known
+	header.setDataSize(dataSize);
+	if (encoding != MicAudioEncoder::Format::PCM) {
+		uint32_t numSamples = encoder.getNumSamples() / encoder.getNumChannels();
+		if (droppedChunkCount || result != 0) {
+			// Some of the encoded samples aren't in the file. Chunks hold whole blocks, so count from the size.
+			numSamples = (uint32_t)((uint64_t)dataSize * encoder.getSamplesPerBlock() / encoder.getBlockAlign());
+		}
+		header.setFactSampleCount(numSamples);
+	}
+	int res = sink->writeAt(0, header.getBuffer(), header.getBufferOffset());
+	int closeRes = sink->close();
+	if (result == 0) {
+		result = (res != 0) ? res : closeRes;
+	}
+
+	writerDone = true;
+	writerRunning = false;
+}
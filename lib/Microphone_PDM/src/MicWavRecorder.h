@@ -0,0 +1,283 @@
+#ifndef _MICWAVRECORDER_H
+#define _MICWAVRECORDER_H
+
+#include "Particle.h"
+#include "Microphone_PDM.h"
+#include "MicWavWriter.h"
+#include "MicAudioCodec.h"
+
+#include <atomic>
+
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+#include <thread>
+#endif
+
+/**
+ * @brief Destination for the data written by Microphone_PDM_WavRecorder
+ *
+ * The methods are called from the recorder's writer thread, not from loop(), so they can block
+ * while flash is erased or a file system is busy.
+ */
+class MicWavSink {
+public:
+	virtual ~MicWavSink() {};
+
+	/**
+	 * @brief Open the sink, truncating anything that was there
+	 *
+	 * @return 0 on success or a SYSTEM_ERROR_* value
+	 */
+	virtual int open() = 0;
+
+	/**
+	 * @brief Append data at the end of the sink
+	 *
+	 * @return 0 on success or a SYSTEM_ERROR_* value
+	 */
+	virtual int write(const uint8_t *buf, size_t len) = 0;
+
+	/**
+	 * @brief Overwrite data at an offset from the start of the sink. Used to patch the wav header.
+	 *
+	 * @return 0 on success or a SYSTEM_ERROR_* value
+	 */
+	virtual int writeAt(size_t offset, const uint8_t *buf, size_t len) = 0;
+
+	/**
+	 * @brief Close the sink
+	 *
+	 * @return 0 on success or a SYSTEM_ERROR_* value
+	 */
+	virtual int close() = 0;
+};
+
+/**
+ * @brief Sink that writes to a file using the POSIX file API
+ *
+ * On the device this is the LittleFS flash file system (Device OS 2.0 and later). On a computer with
+ * the host simulator it's a normal file.
+ */
+class MicWavFileSink : public MicWavSink {
+public:
+	/**
+	 * @brief Constructor
+	 *
+	 * @param path Path to the file. The string is copied.
+	 */
+	explicit MicWavFileSink(const char *path);
+	virtual ~MicWavFileSink();
+
+	virtual int open();
+	virtual int write(const uint8_t *buf, size_t len);
+	virtual int writeAt(size_t offset, const uint8_t *buf, size_t len);
+	virtual int close();
+
+protected:
+	char *path = 0; //!< Copy of the path
+	int fd = -1; //!< File descriptor while open
+};
+
+/**
+ * @brief Records a wav file of any length in fixed-size chunks instead of a buffer for the whole clip
+ *
+ * Microphone_PDM_BufferSampling_wav allocates the whole recording in RAM, which is 32 KB per second at
+ * 16000 Hz, 16-bit. This class only needs numChunks * chunkSize bytes (8 KB by default) for any
+ * duration.
+ *
+ * loop() copies samples from the DMA buffers into the current chunk. When a chunk is full it's passed to
+ * a writer thread and the next chunk is filled while it's written, so slow flash writes don't hold up
+ * reading the DMA buffers. When recording ends, the RIFF and data sizes in the header are patched using
+ * MicWavHeaderBase::setDataSize().
+ *
+ * Like the other buffer sampling classes, allocate it with new and pass it to
+ * Microphone_PDM::instance().bufferSamplingStart(), and call Microphone_PDM::instance().loop() from loop().
+ *
+ * If the writer falls behind and all of the chunks are waiting to be written, the chunk being filled is
+ * discarded and getDroppedChunkCount() increments. The recording is shorter by that amount.
+ *
+ * withEncoding() compresses the samples with MicAudioEncoder in loop() before they're put in the chunks,
+ * so the writer has 2 or 4 times less to write.
+ */
+class Microphone_PDM_WavRecorder : public Microphone_PDM_BufferSampling {
+public:
+	/**
+	 * @brief Default size of each chunk in bytes. A multiple of the 4096 byte flash sector size works best.
+	 */
+	static const size_t DEFAULT_CHUNK_SIZE = 4096;
+
+	/**
+	 * @brief Default number of chunks (double buffering)
+	 */
+	static const size_t DEFAULT_NUM_CHUNKS = 2;
+
+	/**
+	 * @brief Constructor - do not allocate on the stack!
+	 */
+	Microphone_PDM_WavRecorder();
+
+	/**
+	 * @brief Destructor. Stops the writer thread and closes the sink if still recording.
+	 */
+	virtual ~Microphone_PDM_WavRecorder();
+
+	/**
+	 * @brief Record to a file at path, using MicWavFileSink
+	 *
+	 * @param path Path to the file. The string is copied.
+	 */
+	Microphone_PDM_WavRecorder &withFile(const char *path);
+
+	/**
+	 * @brief Record to your own sink
+	 *
+	 * @param sink The sink. It's not deleted by this object and must remain valid until done() is true.
+	 */
+	Microphone_PDM_WavRecorder &withSink(MicWavSink *sink);
+
+	/**
+	 * @brief Set the size of each chunk in bytes (default: 4096). Must be set before start().
+	 */
+	Microphone_PDM_WavRecorder &withChunkSize(size_t chunkSize) { this->chunkSize = chunkSize; return *this; };
+
+	/**
+	 * @brief Set the number of chunks, at least 2 (default: 2). Must be set before start().
+	 *
+	 * More chunks let the writer fall further behind, for example during a flash erase, before
+	 * data is lost.
+	 */
+	Microphone_PDM_WavRecorder &withNumChunks(size_t numChunks) { this->numChunks = (numChunks < 2) ? 2 : numChunks; return *this; };
+
+	/**
+	 * @brief Compress the samples written to the file (default: PCM, uncompressed). Must be set before start().
+	 *
+	 * @param format MicAudioEncoder::Format::MULAW (8 bits per sample) or MicAudioEncoder::Format::IMA_ADPCM
+	 * (4 bits per sample, mono only)
+	 *
+	 * @param blockAlign IMA ADPCM block size in bytes. The chunk size is rounded down to a multiple of it so a
+	 * dropped chunk doesn't split a block.
+	 *
+	 * The microphone must be configured for OutputSize::SIGNED_16 when using a format other than PCM.
+	 */
+	Microphone_PDM_WavRecorder &withEncoding(MicAudioEncoder::Format format, uint16_t blockAlign = MicAudioEncoder::DEFAULT_BLOCK_ALIGN) { this->encoding = format; this->encodingBlockAlign = blockAlign; return *this; };
+
+	/**
+	 * @brief Sets a function to call from loop() when the file is closed
+	 *
+	 * @param closeCallback Function or lambda. result is 0 on success or a SYSTEM_ERROR_* value, and
+	 * dataSize is the number of bytes of samples in the file.
+	 *
+	 * The completion callback of the base class is not used because there is no buffer containing the
+	 * whole recording.
+	 */
+	Microphone_PDM_WavRecorder &withCloseCallback(std::function<void(int result, uint32_t dataSize)> closeCallback) { this->closeCallback = closeCallback; return *this; };
+
+	/**
+	 * @brief Allocate the chunks, write the header, and start the writer thread
+	 *
+	 * @return true on success. On failure getResult() is the reason, except for a missing sink or a
+	 * recording that is already running, and start() can be called again after fixing it.
+	 *
+	 * If withDurationMs() was not used, or was set to 0, recording continues until stop() is called.
+	 */
+	virtual bool start();
+
+	/**
+	 * @brief Copy samples into the chunks. Called from Microphone_PDM::loop().
+	 */
+	virtual void loop();
+
+	/**
+	 * @brief Returns true after the file has been closed
+	 */
+	virtual bool done() const;
+
+	/**
+	 * @brief Stop recording. The samples already received are written and the file is closed.
+	 */
+	void stop();
+
+	/**
+	 * @brief Number of bytes of samples written to the sink so far. This is the encoded size when using withEncoding().
+	 */
+	uint32_t getDataSize() const { return dataSize; };
+
+	/**
+	 * @brief Number of chunks that were handed to the writer while it still had another one waiting
+	 *
+	 * This increments when the writer is falling behind but has not lost data yet. It's always 0 with 2
+	 * chunks because there is nowhere to queue a second one.
+	 */
+	uint32_t getBackPressureCount() const { return backPressureCount; };
+
+	/**
+	 * @brief Number of chunks discarded because all of the others were waiting to be written
+	 */
+	uint32_t getDroppedChunkCount() const { return droppedChunkCount; };
+
+	/**
+	 * @brief Result of the recording, 0 on success or a SYSTEM_ERROR_* value if start() or writing to the sink failed
+	 */
+	int getResult() const { return result; };
+
+protected:
+	/**
+	 * @brief State of a chunk. FREE chunks belong to loop(), READY chunks belong to the writer thread.
+	 */
+	enum {
+		CHUNK_FREE = 0,
+		CHUNK_READY
+	};
+
+	/**
+	 * @brief Pass the chunk being filled to the writer, or discard it if the next chunk isn't free
+	 */
+	void handOffChunk();
+
+	/**
+	 * @brief Free the chunks and the encode buffer when start() fails, so it can be called again
+	 */
+	void releaseChunks();
+
+	/**
+	 * @brief Copy bytes for the file into the chunks, handing off each chunk as it fills
+	 */
+	void appendToChunks(const uint8_t *src, size_t len);
+
+	/**
+	 * @brief Writer thread. Writes ready chunks in order, then patches the header and closes the sink.
+	 */
+	void writerThreadFunction();
+
+	MicWavSink *sink = 0; //!< Where the data is written
+	MicWavSink *ownedSink = 0; //!< Sink created by withFile(), deleted by this object
+	MicWavHeader<MicWavHeaderBase::MAX_SIZE> header; //!< wav header, written at start and patched at close
+	MicAudioEncoder::Format encoding = MicAudioEncoder::Format::PCM; //!< Format set by withEncoding()
+	uint16_t encodingBlockAlign = MicAudioEncoder::DEFAULT_BLOCK_ALIGN; //!< IMA ADPCM block size set by withEncoding()
+	MicAudioEncoder encoder; //!< Encodes samples in loop() when the format isn't PCM
+	uint8_t *encodeBuffer = 0; //!< Encoded samples from one DMA buffer, before they're copied into the chunks
+	size_t chunkSize = DEFAULT_CHUNK_SIZE; //!< Bytes per chunk
+	size_t numChunks = DEFAULT_NUM_CHUNKS; //!< Number of chunks in buffer
+	std::atomic<uint8_t> *chunkState = 0; //!< CHUNK_FREE or CHUNK_READY for each chunk
+	size_t *chunkLength = 0; //!< Number of bytes in each chunk, set before it's made ready
+	size_t fillIndex = 0; //!< Chunk loop() is filling
+	size_t fillOffset = 0; //!< Offset in the chunk loop() is filling
+	size_t targetSize = 0; //!< Number of bytes to record, or 0 to record until stop()
+	size_t receivedSize = 0; //!< Number of bytes copied into chunks, including dropped ones
+	std::atomic<bool> finishing; //!< Set by loop() after the last chunk has been handed off
+	std::atomic<bool> writerDone; //!< Set by the writer thread when the sink is closed
+	std::atomic<bool> writerRunning; //!< True while the writer thread exists
+	std::atomic<uint32_t> dataSize; //!< Bytes written to the sink
+	std::atomic<int> result; //!< 0 or the first error from the sink
+	uint32_t backPressureCount = 0; //!< See getBackPressureCount()
+	uint32_t droppedChunkCount = 0; //!< See getDroppedChunkCount()
+	bool closeCallbackCalled = false; //!< Close callback is only called once
+	std::function<void(int result, uint32_t dataSize)> closeCallback = 0; //!< Called from loop() after close
+
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+	std::thread writerThread; //!< Writer thread
+#else
+	os_thread_t writerThread = 0; //!< Writer thread
+#endif
+};
+
+#endif /* _MICWAVRECORDER_H */
@@ -29,16 +29,36 @@ MicWavHeaderBase::~MicWavHeaderBase() {
 }
 
 bool MicWavHeaderBase::writeHeader(uint8_t numChannels, uint32_t sampleRate, uint8_t bitsPerSample, uint32_t dataSizeInBytes) {
-	if (bufferSize < 44) {
-		DEBUG_NORMAL(("buffer too small, was %d need 44", bufferSize));
+	return writeHeader(FORMAT_PCM, numChannels, sampleRate, bitsPerSample, numChannels * bitsPerSample / 8, 1, dataSizeInBytes);
+}
+
+bool MicWavHeaderBase::writeHeader(uint16_t audioFormat, uint8_t numChannels, uint32_t sampleRate, uint8_t bitsPerSample, uint16_t blockAlign, uint16_t samplesPerBlock, uint32_t dataSizeInBytes) {
+	// PCM has a 16 byte fmt chunk. Other formats add cbSize (and samplesPerBlock for IMA ADPCM) and a fact chunk.
+	size_t fmtSize = 16;
+	if (audioFormat == FORMAT_IMA_ADPCM) {
+		fmtSize = 20;
+	}
+	else
+	if (audioFormat != FORMAT_PCM) {
+		fmtSize = 18;
+	}
+	size_t factSize = (audioFormat != FORMAT_PCM) ? 12 : 0;
+	size_t headerSize = 20 + fmtSize + factSize + 8;
+
+	if (bufferSize < headerSize) {
+		DEBUG_NORMAL(("buffer too small, was %d need %d", bufferSize, headerSize));
 		return false;
 	}
+	if (samplesPerBlock == 0) {
+		samplesPerBlock = 1;
+	}
+
 	// Chunk ID (4 bytes)
 	// Technically using 'riff' would work, but it generates a compiler warning
 	setUint32BE(0, fourCharStringToValue("RIFF"));
 
-	// ChunkSize. 36 is the header (44 bytes), except for the first 8 bytes (Chunk ID and Chunk Size) (4 bytes)
-	setUint32LE(4, dataSizeInBytes + 36);
+	// ChunkSize. The header, except for the first 8 bytes (Chunk ID and Chunk Size), plus the data (4 bytes)
+	setUint32LE(4, dataSizeInBytes + headerSize - 8);
 
 	// Format (4 bytes)
 	setUint32BE(8, fourCharStringToValue("WAVE"));
@@ -47,10 +67,10 @@ bool MicWavHeaderBase::writeHeader(uint8_t numChannels, uint32_t sampleRate, uin
 	setUint32BE(12, fourCharStringToValue("fmt "));
 
 	// Subchunk 1 size (16 bytes for PCM, offsets 20 - 36) (4 bytes)
-	setUint32LE(16, 16);
+	setUint32LE(16, fmtSize);
 
 	// Audio format PCM = 1 (2 bytes)
-	setUint16LE(20, 1);
+	setUint16LE(20, audioFormat);
 
 	// Num channels (2 bytes)
 	setUint16LE(22, numChannels);
@@ -58,23 +78,43 @@ bool MicWavHeaderBase::writeHeader(uint8_t numChannels, uint32_t sampleRate, uin
 	// Sample rate (4 bytes)
 	setUint32LE(24, sampleRate);
 
-	// Byte rate (4 bytes)
-	setUint32LE(28, sampleRate * numChannels * bitsPerSample / 8);
+	// Byte rate (4 bytes). For block formats, bytes per block times blocks per second.
+	setUint32LE(28, (uint32_t)((uint64_t)sampleRate * blockAlign / samplesPerBlock));
 
 	// Block align (2 bytes)
-	setUint16LE(32, numChannels * bitsPerSample / 8);
+	setUint16LE(32, blockAlign);
 
 	// Bits per sample, per channel (2 bytes)
 	setUint16LE(34, bitsPerSample);
 
+	size_t offset = 36;
+	if (fmtSize > 16) {
+		// Size of the extra format bytes (2 bytes)
+		setUint16LE(offset, fmtSize - 18);
+		offset += 2;
+	}
+	if (audioFormat == FORMAT_IMA_ADPCM) {
+		// Samples per block, per channel (2 bytes)
+		setUint16LE(offset, samplesPerBlock);
+		offset += 2;
+	}
+
+	if (factSize) {
+		// fact chunk with the number of samples per channel, required for non-PCM formats (12 bytes)
+		setUint32BE(offset, fourCharStringToValue("fact"));
+		setUint32LE(offset + 4, 4);
+		setUint32LE(offset + 8, (uint32_t)((uint64_t)dataSizeInBytes * samplesPerBlock / blockAlign));
+		offset += 12;
+	}
+
 	// Subchunk 2 ID (4 bytes)
-	setUint32BE(36, fourCharStringToValue("data"));
+	setUint32BE(offset, fourCharStringToValue("data"));
 
 	// data size (numSamples * numChannels * bitsPerSample / 8) (4 bytes)
-	setUint32LE(40, dataSizeInBytes);
+	setUint32LE(offset + 4, dataSizeInBytes);
 
-	// End of header is offset 44
-	bufferOffset = 44;
+	// End of header is offset 44 for PCM
+	bufferOffset = offset + 8;
 
 	return true;
 }
@@ -83,8 +123,22 @@ bool MicWavHeaderBase::writeHeader(uint8_t numChannels, uint32_t sampleRate, uin
 void MicWavHeaderBase::setDataSize(uint32_t dataSizeInBytes) {
 	// DEBUG_HIGH(("setDataSize %lu", dataSizeInBytes));
 
-	setUint32LE(4, dataSizeInBytes + 36);
-	setUint32LE(40, dataSizeInBytes);
+	size_t dataOffset = getDataOffset();
+	if (dataOffset == 0) {
+		dataOffset = STANDARD_SIZE;
+	}
+
+	setUint32LE(4, dataSizeInBytes + dataOffset - 8);
+	setUint32LE(dataOffset - 4, dataSizeInBytes);
+}
+
+void MicWavHeaderBase::setFactSampleCount(uint32_t numSamples) {
+	size_t chunkDataOffset;
+	uint32_t chunkDataSize;
+
+	if (findChunk(fourCharStringToValue("fact"), chunkDataOffset, chunkDataSize) && chunkDataSize >= 4) {
+		setUint32LE(chunkDataOffset, numSamples);
+	}
 }
 
 uint32_t MicWavHeaderBase::getDataOffset() const {
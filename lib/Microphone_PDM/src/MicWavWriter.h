@@ -27,16 +27,47 @@ public:
 	 */
 	bool writeHeader(uint8_t numChannels, uint32_t sampleRate, uint8_t bitsPerSample, uint32_t dataSizeInBytes = 0);
 
+	/**
+	 * @brief Writes a wav file header for PCM or a compressed format
+	 *
+	 * @param audioFormat wav format tag: FORMAT_PCM, FORMAT_MULAW, or FORMAT_IMA_ADPCM
+	 *
+	 * @param numChannels number of channels
+	 *
+	 * @param sampleRate sampling rate per channel in samples per second
+	 *
+	 * @param bitsPerSample bits per sample per channel: 16 or 8 for PCM, 8 for mu-law, 4 for IMA ADPCM
+	 *
+	 * @param blockAlign bytes per frame, or bytes per block for IMA ADPCM
+	 *
+	 * @param samplesPerBlock samples per channel in each block, 1 except for IMA ADPCM
+	 *
+	 * @param dataSizeInBytes the size of the data (optional), see the other overload
+	 *
+	 * Formats other than PCM have a longer fmt chunk and a fact chunk containing the number of samples, so the
+	 * header is up to MAX_SIZE bytes. MicAudioEncoder has the values to pass for the format it encodes. Use
+	 * setFactSampleCount() to update the number of samples when it's known.
+	 */
+	bool writeHeader(uint16_t audioFormat, uint8_t numChannels, uint32_t sampleRate, uint8_t bitsPerSample, uint16_t blockAlign, uint16_t samplesPerBlock, uint32_t dataSizeInBytes = 0);
+
 	/**
 	 * @brief Update the size of the data chunk (in bytes).
 	 *
 	 * @param dataSizeInBytes This is the size of the data (part of the file after getDataOffset()), which is
-	 * typically 44 bytes less than the file size for files we create.
+	 * typically 44 bytes less than the file size for PCM files we create.
 	 *
 	 * This modifies the file chunk header and the data subchunk size.
 	 */
 	void setDataSize(uint32_t dataSizeInBytes);
 
+	/**
+	 * @brief Update the number of samples per channel in the fact chunk, if there is one
+	 *
+	 * For IMA ADPCM the last block is usually partial, so the sample count can't be calculated from the
+	 * data size. Call this after setDataSize() with the number of samples that were encoded.
+	 */
+	void setFactSampleCount(uint32_t numSamples);
+
 	/**
 	 * @brief Gets the offset of the data chunk
 	 *
@@ -72,6 +103,16 @@ public:
 
 	size_t getBufferOffset() const { return bufferOffset; };
 
+	/**
+	 * @brief Set the number of valid bytes in buffer when reading an existing header
+	 *
+	 * @param bufferOffset Number of bytes of the file that have been read into buffer
+	 *
+	 * writeHeader() sets this automatically. When reading a file, read the start of it into buffer and
+	 * call this so findChunk() and getDataOffset() know how much of the header is available.
+	 */
+	void setBufferOffset(size_t bufferOffset) { this->bufferOffset = (bufferOffset < bufferSize) ? bufferOffset : bufferSize; };
+
 	uint8_t *getBuffer() { return buffer; };
 
 	const uint8_t *getBuffer() const { return buffer; };
@@ -88,6 +129,15 @@ public:
 	 */
 	static const size_t STANDARD_SIZE = 44;
 
+	/**
+	 * @brief Largest header writeHeader() writes, for IMA ADPCM
+	 */
+	static const size_t MAX_SIZE = 60;
+
+	static const uint16_t FORMAT_PCM = 1; //!< wav format tag for PCM
+	static const uint16_t FORMAT_MULAW = 7; //!< wav format tag for G.711 mu-law
+	static const uint16_t FORMAT_IMA_ADPCM = 0x11; //!< wav format tag for IMA ADPCM
+
 protected:
 	uint8_t *buffer;
 	size_t bufferSize;
@@ -81,62 +81,401 @@ size_t Microphone_PDM::getSampleSizeInBytes() const {
 }
 
 
-void Microphone_PDM_Base::copySamplesInternal(const int16_t *src, uint8_t *dst) const {
-	const int16_t *srcEnd = &src[numSamples];
+bool Microphone_PDM_Base::waitForSamples(uint32_t timeoutMs) {
+	uint32_t start = micros();
+	if (waitedBefore) {
+		waitStats.activeUs += start - lastWaitEnd;
+	}
+	waitStats.waits++;
 
-	size_t increment = copySrcIncrement();
+	bool ready = waitReady();
+	if (ready) {
+		waitStats.alreadyReady++;
+	}
+	else {
+		uint32_t startMs = millis();
+		while(true) {
+			uint32_t elapsedMs = millis() - startMs;
+			if (elapsedMs >= timeoutMs) {
+				waitStats.timeouts++;
+				break;
+			}
 
-	if (outputSize == OutputSize::UNSIGNED_8) {
+			bool woken = waitSleep(timeoutMs - elapsedMs);
+			if (waitReady()) {
+				ready = true;
+				waitStats.dmaWakeups++;
+				break;
+			}
+			if (woken) {
+				// The semaphore was left over from a buffer that was already read, or the
+				// interrupt completed a buffer that was discarded
+				waitStats.spuriousWakeups++;
+			}
+		}
+	}
 
-		// Scale the 16-bit signed values to an appropriate range for unsigned 8-bit values
-		int16_t div = (int16_t)(1 << (size_t) range);
+	lastWaitEnd = micros();
+	waitStats.idleUs += lastWaitEnd - start;
+	waitedBefore = true;
+	return ready;
+}
 
-		while(src < srcEnd) {
-			int16_t val = *src / div;
-			src += increment;
+void Microphone_PDM_Base::resetWaitStats() {
+	waitStats = {};
+	waitedBefore = false;
+}
 
-			// Clip to signed 8-bit
-			if (val < -128) {
-				val = -128;
-			}
-			if (val > 127) {
-				val = 127;
+float Microphone_PDM_Base::getActiveRatio() const {
+	uint64_t total = waitStats.activeUs + waitStats.idleUs;
+	return total ? (float)waitStats.activeUs / (float)total : 0.0;
+}
+
+void Microphone_PDM_Base::logWaitStats() const {
+	Log.info("PDM wait: active %u%%, %lu waits, %lu DMA wakeups, %lu already ready, %lu spurious, %lu timeouts",
+		(unsigned int)(getActiveRatio() * 100 + 0.5), (unsigned long)waitStats.waits, (unsigned long)waitStats.dmaWakeups,
+		(unsigned long)waitStats.alreadyReady, (unsigned long)waitStats.spuriousWakeups, (unsigned long)waitStats.timeouts);
+}
+
+void Microphone_PDM_Base::copySamplesInternal(int16_t *src, uint8_t *dst) {
+	size_t count = numSamples;
+
+	if (decimator.getFactor() > 1) {
+		// Filter in place in the DMA buffer, then convert into dst
+		count = decimator.process(src, numSamples, src);
+	}
+
+	if (codecGain) {
+		// The hardware already scaled the samples to 16 bits, so there is no range adjustment
+		convertSamples(src, dst, count, (outputSize == OutputSize::SIGNED_16) ? OutputSize::RAW_SIGNED_16 : outputSize, Range::RANGE_32768);
+	}
+	else {
+		convertSamples(src, dst, count, outputSize, range);
+	}
+}
+
+// [static]
+float Microphone_PDM_Base::getRangeGainDb(Range range) {
+	return 6.0206 * (float)(8 - (int)range);
+}
+
+// For SIGNED_16, samples are shifted left so the microphone range fills 16 bits. For UNSIGNED_8, samples
+// are shifted right so it fills 8 bits. Both use an arithmetic shift and saturate, so every kernel
+// below produces identical results.
+static inline unsigned int signed16Shift(Microphone_PDM_Base::Range range) {
+	return 8 - (unsigned int) range;
+}
+
+static inline unsigned int unsigned8Shift(Microphone_PDM_Base::Range range) {
+	return (unsigned int) range;
+}
+
+static inline int16_t convertSigned16(int16_t sample, unsigned int shift) {
+	int32_t val = (int32_t)sample * (1 << shift);
+
+	// Clip to signed 16-bit
+	if (val < -32768) {
+		val = -32768;
+	}
+	if (val > 32767) {
+		val = 32767;
+	}
+	return (int16_t) val;
+}
+
+static inline uint8_t convertUnsigned8(int16_t sample, unsigned int shift) {
+	int32_t val = (int32_t)sample >> shift;
+
+	// Clip to signed 8-bit
+	if (val < -128) {
+		val = -128;
+	}
+	if (val > 127) {
+		val = 127;
+	}
+
+	// Add 128 to make unsigned 8-bit (offset)
+	return (uint8_t) (val + 128);
+}
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+// Cortex-M4 (nRF52840) and Cortex-M33 (RTL872x). Two 16-bit samples are processed per 32-bit word.
+
+static inline uint32_t loadWord(const void *p) {
+	uint32_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+static inline void storeWord(void *p, uint32_t w) {
+	memcpy(p, &w, sizeof(w));
+}
+
+// Saturating left shift of both halfwords of w
+static inline uint32_t signed16Pair(uint32_t w, unsigned int shift) {
+	int32_t lo = __SSAT((int32_t)(int16_t)w * (1 << shift), 16);
+	int32_t hi = __SSAT(((int32_t)w >> 16) * (1 << shift), 16);
+	return __PKHBT((uint32_t)lo, (uint32_t)hi, 16);
+}
+
+// Arithmetic right shift of both halfwords of w, saturated to 8 bits and offset to unsigned.
+// Result is in the low byte of each halfword.
+static inline uint32_t unsigned8Pair(uint32_t w, unsigned int shift) {
+	int32_t lo = (int32_t)(int16_t)w >> shift;
+	int32_t hi = ((int32_t)w >> 16) >> shift;
+	uint32_t pair = __SSAT16(__PKHBT((uint32_t)lo, (uint32_t)hi, 16), 8);
+	return pair ^ 0x00800080;
+}
+
+static size_t convertSigned16Simd(const int16_t *src, int16_t *dst, size_t numSamples, unsigned int shift) {
+	size_t ii = 0;
+	for(; ii + 2 <= numSamples; ii += 2) {
+		storeWord(&dst[ii], signed16Pair(loadWord(&src[ii]), shift));
+	}
+	return ii;
+}
+
+static size_t convertUnsigned8Simd(const int16_t *src, uint8_t *dst, size_t numSamples, unsigned int shift) {
+	size_t ii = 0;
+	for(; ii + 4 <= numSamples; ii += 4) {
+		// Both words are read before the store so this is safe in place
+		uint32_t a = unsigned8Pair(loadWord(&src[ii]), shift);
+		uint32_t b = unsigned8Pair(loadWord(&src[ii + 2]), shift);
+		storeWord(&dst[ii], (a & 0xff) | ((a >> 8) & 0xff00) | ((b & 0xff) << 16) | ((b & 0xff0000) << 8));
+	}
+	return ii;
+}
+
+static size_t deinterleaveSimd(const int16_t *src, void *left, void *right, size_t numFrames, Microphone_PDM_Base::OutputSize outputSize, Microphone_PDM_Base::Range range) {
+	size_t ii = 0;
+
+	if (outputSize == Microphone_PDM_Base::OutputSize::UNSIGNED_8) {
+		unsigned int shift = unsigned8Shift(range);
+		uint8_t *l = (uint8_t *)left;
+		uint8_t *r = (uint8_t *)right;
+
+		for(; ii + 2 <= numFrames; ii += 2) {
+			uint32_t w0 = loadWord(&src[2 * ii]);
+			uint32_t w1 = loadWord(&src[2 * ii + 2]);
+			uint32_t lpair = unsigned8Pair(__PKHBT(w0, w1, 16), shift);
+			uint32_t rpair = unsigned8Pair(__PKHTB(w1, w0, 16), shift);
+			l[ii] = (uint8_t) lpair;
+			l[ii + 1] = (uint8_t) (lpair >> 16);
+			r[ii] = (uint8_t) rpair;
+			r[ii + 1] = (uint8_t) (rpair >> 16);
+		}
+	}
+	else {
+		unsigned int shift = (outputSize == Microphone_PDM_Base::OutputSize::SIGNED_16) ? signed16Shift(range) : 0;
+		int16_t *l = (int16_t *)left;
+		int16_t *r = (int16_t *)right;
+
+		for(; ii + 2 <= numFrames; ii += 2) {
+			uint32_t w0 = loadWord(&src[2 * ii]);
+			uint32_t w1 = loadWord(&src[2 * ii + 2]);
+			uint32_t lpair = __PKHBT(w0, w1, 16);
+			uint32_t rpair = __PKHTB(w1, w0, 16);
+			if (shift) {
+				lpair = signed16Pair(lpair, shift);
+				rpair = signed16Pair(rpair, shift);
 			}
+			storeWord(&l[ii], lpair);
+			storeWord(&r[ii], rpair);
+		}
+	}
+	return ii;
+}
 
-			// Add 128 to make unsigned 8-bit (offset)
-			*((uint8_t *)dst) = (uint8_t) (val + 128);
-			dst += sizeof(uint8_t);
+#elif defined(__SSE2__)
+// Host builds on x86. Eight 16-bit samples per 128-bit vector.
+#include <emmintrin.h>
+
+static inline __m128i signed16Vector(__m128i v, __m128i shift) {
+	// Widen to 32 bits so the shift can't overflow, then pack back with signed saturation
+	__m128i lo = _mm_sll_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), shift);
+	__m128i hi = _mm_sll_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), shift);
+	return _mm_packs_epi32(lo, hi);
+}
+
+static size_t convertSigned16Simd(const int16_t *src, int16_t *dst, size_t numSamples, unsigned int shift) {
+	__m128i count = _mm_cvtsi32_si128((int)shift);
+	size_t ii = 0;
+	for(; ii + 8 <= numSamples; ii += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[ii]);
+		_mm_storeu_si128((__m128i *)&dst[ii], signed16Vector(v, count));
+	}
+	return ii;
+}
+
+static size_t convertUnsigned8Simd(const int16_t *src, uint8_t *dst, size_t numSamples, unsigned int shift) {
+	__m128i count = _mm_cvtsi32_si128((int)shift);
+	__m128i offset = _mm_set1_epi8((char)0x80);
+	size_t ii = 0;
+	for(; ii + 16 <= numSamples; ii += 16) {
+		__m128i a = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)&src[ii]), count);
+		__m128i b = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)&src[ii + 8]), count);
+		_mm_storeu_si128((__m128i *)&dst[ii], _mm_xor_si128(_mm_packs_epi16(a, b), offset));
+	}
+	return ii;
+}
+
+static size_t deinterleaveSimd(const int16_t *src, void *left, void *right, size_t numFrames, Microphone_PDM_Base::OutputSize outputSize, Microphone_PDM_Base::Range range) {
+	size_t ii = 0;
+
+	for(; ii + 8 <= numFrames; ii += 8) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *)&src[2 * ii]);
+		__m128i v1 = _mm_loadu_si128((const __m128i *)&src[2 * ii + 8]);
+
+		// Sign-extended 32-bit left and right samples
+		__m128i l0 = _mm_srai_epi32(_mm_slli_epi32(v0, 16), 16);
+		__m128i l1 = _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16);
+		__m128i r0 = _mm_srai_epi32(v0, 16);
+		__m128i r1 = _mm_srai_epi32(v1, 16);
+
+		if (outputSize == Microphone_PDM_Base::OutputSize::UNSIGNED_8) {
+			__m128i count = _mm_cvtsi32_si128((int)unsigned8Shift(range));
+			__m128i offset = _mm_set1_epi8((char)0x80);
+			__m128i l = _mm_sra_epi16(_mm_packs_epi32(l0, l1), count);
+			__m128i r = _mm_sra_epi16(_mm_packs_epi32(r0, r1), count);
+			_mm_storel_epi64((__m128i *)&((uint8_t *)left)[ii], _mm_xor_si128(_mm_packs_epi16(l, l), offset));
+			_mm_storel_epi64((__m128i *)&((uint8_t *)right)[ii], _mm_xor_si128(_mm_packs_epi16(r, r), offset));
+		}
+		else {
+			unsigned int shift = (outputSize == Microphone_PDM_Base::OutputSize::SIGNED_16) ? signed16Shift(range) : 0;
+			__m128i count = _mm_cvtsi32_si128((int)shift);
+			_mm_storeu_si128((__m128i *)&((int16_t *)left)[ii], _mm_packs_epi32(_mm_sll_epi32(l0, count), _mm_sll_epi32(l1, count)));
+			_mm_storeu_si128((__m128i *)&((int16_t *)right)[ii], _mm_packs_epi32(_mm_sll_epi32(r0, count), _mm_sll_epi32(r1, count)));
 		}
+	}
+	return ii;
+}
 
+#elif defined(__ARM_NEON)
+// Host builds on 64-bit ARM. Eight 16-bit samples per 128-bit vector.
+#include <arm_neon.h>
+
+static size_t convertSigned16Simd(const int16_t *src, int16_t *dst, size_t numSamples, unsigned int shift) {
+	int16x8_t count = vdupq_n_s16((int16_t)shift);
+	size_t ii = 0;
+	for(; ii + 8 <= numSamples; ii += 8) {
+		vst1q_s16(&dst[ii], vqshlq_s16(vld1q_s16(&src[ii]), count));
 	}
-	else if (outputSize == OutputSize::SIGNED_16) {		
-		int32_t mult = (int32_t)(1 << (8 - (size_t) range));
+	return ii;
+}
 
-		while(src < srcEnd) {
-			// Scale to signed 16 bit range
-			int32_t val = (int32_t)*src * mult;
-			src += increment;
+static inline uint8x8_t unsigned8Vector(int16x8_t v, int16x8_t count) {
+	// Negative shift count is an arithmetic right shift
+	int8x8_t n = vqmovn_s16(vshlq_s16(v, count));
+	return veor_u8(vreinterpret_u8_s8(n), vdup_n_u8(0x80));
+}
 
-			// Clip to signed 16-bit
-			if (val < -32767) {
-				val = -32767;
-			}
-			if (val > 32768) {
-				val = 32868;
-			}
+static size_t convertUnsigned8Simd(const int16_t *src, uint8_t *dst, size_t numSamples, unsigned int shift) {
+	int16x8_t count = vdupq_n_s16(-(int16_t)shift);
+	size_t ii = 0;
+	for(; ii + 8 <= numSamples; ii += 8) {
+		uint8x8_t out = unsigned8Vector(vld1q_s16(&src[ii]), count);
+		vst1_u8(&dst[ii], out);
+	}
+	return ii;
+}
+
+static size_t deinterleaveSimd(const int16_t *src, void *left, void *right, size_t numFrames, Microphone_PDM_Base::OutputSize outputSize, Microphone_PDM_Base::Range range) {
+	size_t ii = 0;
+
+	if (outputSize == Microphone_PDM_Base::OutputSize::UNSIGNED_8) {
+		int16x8_t count = vdupq_n_s16(-(int16_t)unsigned8Shift(range));
+		for(; ii + 8 <= numFrames; ii += 8) {
+			int16x8x2_t v = vld2q_s16(&src[2 * ii]);
+			vst1_u8(&((uint8_t *)left)[ii], unsigned8Vector(v.val[0], count));
+			vst1_u8(&((uint8_t *)right)[ii], unsigned8Vector(v.val[1], count));
+		}
+	}
+	else {
+		unsigned int shift = (outputSize == Microphone_PDM_Base::OutputSize::SIGNED_16) ? signed16Shift(range) : 0;
+		int16x8_t count = vdupq_n_s16((int16_t)shift);
+		for(; ii + 8 <= numFrames; ii += 8) {
+			int16x8x2_t v = vld2q_s16(&src[2 * ii]);
+			vst1q_s16(&((int16_t *)left)[ii], vqshlq_s16(v.val[0], count));
+			vst1q_s16(&((int16_t *)right)[ii], vqshlq_s16(v.val[1], count));
+		}
+	}
+	return ii;
+}
+
+#else
+// No SIMD available, everything is done by convertSamplesScalar()
 
-			*((int16_t *)dst) = (int16_t) val;
-			dst += sizeof(uint16_t);
+static size_t convertSigned16Simd(const int16_t *src, int16_t *dst, size_t numSamples, unsigned int shift) {
+	return 0;
+}
+
+static size_t convertUnsigned8Simd(const int16_t *src, uint8_t *dst, size_t numSamples, unsigned int shift) {
+	return 0;
+}
+
+static size_t deinterleaveSimd(const int16_t *src, void *left, void *right, size_t numFrames, Microphone_PDM_Base::OutputSize outputSize, Microphone_PDM_Base::Range range) {
+	return 0;
+}
+#endif
+
+// [static]
+void Microphone_PDM_Base::convertSamples(const int16_t *src, void *dst, size_t numSamples, OutputSize outputSize, Range range) {
+	size_t done;
+
+	if (outputSize == OutputSize::UNSIGNED_8) {
+		done = convertUnsigned8Simd(src, (uint8_t *)dst, numSamples, unsigned8Shift(range));
+		convertSamplesScalar(&src[done], 1, &((uint8_t *)dst)[done], numSamples - done, outputSize, range);
+	}
+	else if (outputSize == OutputSize::SIGNED_16) {
+		done = convertSigned16Simd(src, (int16_t *)dst, numSamples, signed16Shift(range));
+		convertSamplesScalar(&src[done], 1, (uint8_t *)&((int16_t *)dst)[done], numSamples - done, outputSize, range);
+	}
+	else {
+		// OutputSize::RAW_SIGNED_16
+		if (src != (const int16_t *)dst) {
+			memmove(dst, src, numSamples * sizeof(int16_t));
+		}
+	}
+}
+
+// [static]
+void Microphone_PDM_Base::deinterleaveSamples(const int16_t *src, void *left, void *right, size_t numFrames, OutputSize outputSize, Range range) {
+	size_t done = deinterleaveSimd(src, left, right, numFrames, outputSize, range);
+	size_t sampleSize = (outputSize == OutputSize::UNSIGNED_8) ? sizeof(uint8_t) : sizeof(int16_t);
+
+	convertSamplesScalar(&src[2 * done], 2, &((uint8_t *)left)[done * sampleSize], numFrames - done, outputSize, range);
+	convertSamplesScalar(&src[2 * done + 1], 2, &((uint8_t *)right)[done * sampleSize], numFrames - done, outputSize, range);
+}
+
+// [static]
+void Microphone_PDM_Base::convertSamplesScalar(const int16_t *src, size_t srcIncrement, uint8_t *dst, size_t numSamples, OutputSize outputSize, Range range) {
+	const int16_t *srcEnd = &src[numSamples * srcIncrement];
+
+	if (outputSize == OutputSize::UNSIGNED_8) {
+		unsigned int shift = unsigned8Shift(range);
+
+		while(src < srcEnd) {
+			*dst = convertUnsigned8(*src, shift);
+			dst += sizeof(uint8_t);
+			src += srcIncrement;
+		}
+	}
+	else if (outputSize == OutputSize::SIGNED_16) {
+		unsigned int shift = signed16Shift(range);
+
+		while(src < srcEnd) {
+			int16_t val = convertSigned16(*src, shift);
+			memcpy(dst, &val, sizeof(int16_t));
+			dst += sizeof(int16_t);
+			src += srcIncrement;
 		}
 	}
 	else {
 		// OutputSize::RAW_SIGNED_16
-		if (src != (int16_t *)dst || increment != 1) {
-			while(src < srcEnd) {
-				*((int16_t *)dst) = *src;
-				dst += sizeof(int16_t);
-				src += increment;
-			}
+		while(src < srcEnd) {
+			memcpy(dst, src, sizeof(int16_t));
+			dst += sizeof(int16_t);
+			src += srcIncrement;
 		}
 	}
 }
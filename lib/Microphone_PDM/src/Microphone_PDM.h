@@ -2,6 +2,7 @@
 #define __Microphone_PDM_H
 
 #include "Particle.h"
+#include "MicDecimator.h"
 
 /**
  * @brief Class to configure buffer sampling mode
@@ -147,6 +148,15 @@ public:
 		RANGE_32768, 	//!< From -32768 to 32767 (16 bits) (same as raw mode)
 	};
 
+	/**
+	 * @brief High-pass filtering done by the codec before the samples reach the DMA buffer. RTL872x only.
+	 */
+	enum class CodecHighPass {
+		OFF,			//!< No filtering, the DC offset of the microphone is kept
+		DC_BLOCK,		//!< DC blocking filter only
+		HIGH_PASS		//!< DC blocking filter and 2nd order high-pass filter (default, as set up by the codec driver)
+	};
+
 	/**
 	 * @brief Return the sample rate (16000 or 32000) in samples per second
 	 * 
@@ -154,6 +164,170 @@ public:
 	 */
 	int getSampleRate() const { return sampleRate; };
 
+	/**
+	 * @brief Gain the range adjustment applies for a range, in dB
+	 * 
+	 * @param range Range of the microphone
+	 * 
+	 * @return float About 6 dB per bit, for example 24.08 dB for RANGE_2048 and 0 for RANGE_32768
+	 * 
+	 * Pass this to withCodecGain() to move the range adjustment into the hardware.
+	 */
+	static float getRangeGainDb(Range range);
+
+	/**
+	 * @brief Returns true if the gain is applied by the hardware (withCodecGain()) instead of the range adjustment
+	 * 
+	 * The range setting is ignored in this case. SIGNED_16 samples are copied unmodified, as for RAW_SIGNED_16,
+	 * and UNSIGNED_8 samples are the upper 8 bits.
+	 */
+	bool hasCodecGain() const { return codecGain; };
+
+	/**
+	 * @brief Get the hardware gain in dB
+	 * 
+	 * @return float After init(), the gain the hardware is actually set to, which is rounded to its step size and
+	 * clipped to what it supports.
+	 */
+	float getCodecGainDb() const { return codecGainDb; };
+
+	/**
+	 * @brief Returns true if the codec removes the DC offset, so software DC removal can be skipped. RTL872x only.
+	 */
+	bool hasCodecHighPass() const { return codecHighPassActive; };
+
+	/**
+	 * @brief Convert raw 16-bit samples to an output size and range
+	 * 
+	 * @param src Raw signed 16-bit samples as written by the DMA
+	 * 
+	 * @param dst Destination buffer, 8 or 16-bit samples depending on outputSize. Does not need to be aligned.
+	 * 
+	 * @param numSamples Number of samples to convert
+	 * 
+	 * @param outputSize Output size. RAW_SIGNED_16 copies the samples unmodified.
+	 * 
+	 * @param range Range of the microphone, used to determine how much to shift the samples
+	 * 
+	 * This is the kernel used by copySamples() and noCopySamples(). It's public so you can do the conversion
+	 * as part of your own read, for example converting straight from the DMA buffer into an inference
+	 * buffer, so each sample is only touched once. It uses the DSP saturating instructions on Cortex-M4 and
+	 * M33 and SSE2 or NEON when built for a computer. Values are clipped to the output size, from -32768 to
+	 * 32767 for SIGNED_16 and from 0 to 255 for UNSIGNED_8.
+	 * 
+	 * src and dst can be the same buffer to transform the data in place.
+	 */
+	static void convertSamples(const int16_t *src, void *dst, size_t numSamples, OutputSize outputSize, Range range);
+
+	/**
+	 * @brief Split interleaved stereo samples into separate left and right buffers, converting them
+	 * 
+	 * @param src Raw interleaved signed 16-bit samples (left, right, left, right, ...)
+	 * 
+	 * @param left Destination for the left channel, 8 or 16-bit samples depending on outputSize
+	 * 
+	 * @param right Destination for the right channel, 8 or 16-bit samples depending on outputSize
+	 * 
+	 * @param numFrames Number of frames, which is half the number of samples in src
+	 * 
+	 * @param outputSize Output size, as for convertSamples()
+	 * 
+	 * @param range Range of the microphone, as for convertSamples()
+	 * 
+	 * The conversion is done in the same pass as the deinterleave. src must not overlap left or right.
+	 */
+	static void deinterleaveSamples(const int16_t *src, void *left, void *right, size_t numFrames, OutputSize outputSize, Range range);
+
+	/**
+	 * @brief Get the sequence number of the buffer most recently returned by copySamples() or noCopySamples()
+	 * 
+	 * @return uint32_t Sequence number
+	 * 
+	 * Every DMA buffer the hardware fills gets the next sequence number, including buffers that had to be
+	 * discarded because the consumer had not released enough buffers (see getOverrunCount()). If the
+	 * sequence number is not one more than the previous one, samples were lost between the two buffers.
+	 * On every platform it's updated before the samples are copied or passed to the noCopySamples() callback,
+	 * so the callback can use it and getLastTimestamp() for the buffer it was passed.
+	 */
+	uint32_t getLastSequence() const { return lastSequence; };
+
+	/**
+	 * @brief Get the time the buffer most recently returned by copySamples() or noCopySamples() was filled
+	 * 
+	 * @return uint32_t micros() value taken in the DMA completion interrupt, which is when the last sample
+	 * of the buffer was captured
+	 * 
+	 * Together with the sequence number this gives the capture time of every sample: sample i of the buffer
+	 * (0 to getNumberOfSamples() - 1) was captured (getNumberOfSamples() - 1 - i) sample periods before the
+	 * timestamp, and the buffer starts at sample number getLastSequence() * getNumberOfSamples() since start().
+	 * The time between the timestamp and when you read the buffer is how long it waited for you.
+	 */
+	uint32_t getLastTimestamp() const { return lastTimestamp; };
+
+	/**
+	 * @brief Number of times a buffer was read while a newer one was already waiting
+	 * 
+	 * @return uint32_t Count since init
+	 * 
+	 * This increments when the consumer is falling behind but has not lost samples yet. If it keeps
+	 * falling behind, the buffers fill up and getOverrunCount() starts to increment.
+	 */
+	uint32_t getLateCount() const { return lateCount; };
+
+	/**
+	 * @brief Counters kept by waitForSamples()
+	 */
+	struct WaitStats {
+		uint32_t waits;				//!< Calls to waitForSamples()
+		uint32_t alreadyReady;		//!< Samples were already waiting, so it returned without sleeping
+		uint32_t dmaWakeups;		//!< Woken by the DMA completion interrupt with samples ready
+		uint32_t spuriousWakeups;	//!< Woken without samples ready, such as by a buffer that was discarded or already read
+		uint32_t timeouts;			//!< Returned because the timeout expired
+		uint64_t idleUs;			//!< Time spent blocked in waitForSamples()
+		uint64_t activeUs;			//!< Time between calls to waitForSamples(), spent processing samples
+	};
+
+	/**
+	 * @brief Sleep until samples are ready, instead of polling samplesAvailable()
+	 * 
+	 * @param timeoutMs Longest time to wait in milliseconds. 0 only checks.
+	 * 
+	 * @return true Samples are ready: copySamples() or noCopySamples() will return a buffer, or on the RTL872x with
+	 * destinations enabled, destinationComplete() will.
+	 * @return false The timeout expired
+	 * 
+	 * The calling thread blocks on a semaphore that the DMA completion interrupt gives, so other threads can run
+	 * and when there are none, the Device OS idle thread puts the CPU to sleep (WFI) until the next interrupt. It
+	 * returns within microseconds of the buffer completing, so reading samples this way has the same latency as
+	 * polling without keeping the CPU busy. The host simulator does the same with a condition variable.
+	 * 
+	 * Only one thread should wait at a time.
+	 */
+	bool waitForSamples(uint32_t timeoutMs);
+
+	/**
+	 * @brief Get the counters kept by waitForSamples() since init or resetWaitStats()
+	 */
+	const WaitStats &getWaitStats() const { return waitStats; };
+
+	/**
+	 * @brief Clear the counters kept by waitForSamples()
+	 */
+	void resetWaitStats();
+
+	/**
+	 * @brief Share of the time the thread calling waitForSamples() was busy rather than waiting, 0.0 to 1.0
+	 * 
+	 * This is the measured CPU load of your audio processing: active time / (active time + idle time) since init
+	 * or resetWaitStats(). Idle time only counts for the waiting thread; other threads may run while it waits.
+	 */
+	float getActiveRatio() const;
+
+	/**
+	 * @brief Log a one line summary of the wait counters with Log.info
+	 */
+	void logWaitStats() const;
+
 protected:
 	/**
 	 * @brief You cannot instantiate one of these, it's only done by the subclass, which is a Microphone_PDM_* MCU-specific class
@@ -177,30 +351,85 @@ protected:
 	 * is RAW_SIGNED_16, which does not do any transformation.
 	 * 
 	 * src and dst can be the same buffer to transform the data range in place.
+	 * 
+	 * If the capture sample rate is higher than the output sample rate, the samples are first filtered
+	 * and decimated in place in src by decimator, so there are fewer samples than numSamples.
+	 * The conversion is done by convertSamples().
 	 */
-	void copySamplesInternal(const int16_t *src, uint8_t *dst) const;
+	void copySamplesInternal(int16_t *src, uint8_t *dst);
 
 	/**
-	 * @brief How much to increment src in copySamplesInternal. Used internally.
+	 * @brief Record that the consumer took a buffer. Used internally.
 	 * 
-	 * @return size_t number of bytes
+	 * @param sequence Sequence number of the buffer
 	 * 
-	 * This is almost always 1. The exception is if you are using 8000 Hz sampling on the nRF52. In this case,
-	 * every other sample is skipped and the subclass overrides this to return 2.
+	 * @param timestamp micros() when the buffer was filled
+	 * 
+	 * @param numReady Number of buffers ready, including this one
 	 */
-	virtual size_t copySrcIncrement() const { return 1; };
+	void bufferAcquired(uint32_t sequence, uint32_t timestamp, size_t numReady) {
+		lastSequence = sequence;
+		lastTimestamp = timestamp;
+		if (numReady > 1) {
+			lateCount++;
+		}
+	}
+
+	/**
+	 * @brief Whether waitForSamples() can return. Implemented by the MCU-specific class.
+	 */
+	virtual bool waitReady() const { return false; };
+
+	/**
+	 * @brief Block until the DMA completion interrupt or the timeout. Implemented by the MCU-specific class.
+	 * 
+	 * @param timeoutMs Longest time to block
+	 * 
+	 * @return true if woken by the interrupt, which does not mean samples are ready
+	 */
+	virtual bool waitSleep(uint32_t timeoutMs) { (void)timeoutMs; return false; };
+
+	/**
+	 * @brief Portable conversion used for strided input and where there is no SIMD kernel. Used internally.
+	 * 
+	 * @param src Raw signed 16-bit samples
+	 * 
+	 * @param srcIncrement Number of samples to advance src for each output sample
+	 * 
+	 * @param dst Destination buffer, 8 or 16-bit samples depending on outputSize
+	 * 
+	 * @param numSamples Number of output samples
+	 */
+	static void convertSamplesScalar(const int16_t *src, size_t srcIncrement, uint8_t *dst, size_t numSamples, OutputSize outputSize, Range range);
 
 	pin_t clkPin = A0;		//!< The pin used for the PDM clock (output)
 	pin_t datPin = A1;		//!< The pin used for the PDM data (input)
 	bool stereoMode = false;	//!< Use stereo mode (default: false, mono mode)
-	int sampleRate; //!< Either 8000 or 16000 only. Not supported on nRF52.
+	int sampleRate = 16000; //!< Output sample rate, 8000, 16000, or 32000
+	int captureSampleRate = 0; //!< Hardware sample rate if higher than sampleRate, or 0 to capture at sampleRate
+	MicDecimator decimator; //!< Filters from the capture sample rate down to sampleRate
 	OutputSize outputSize = OutputSize::SIGNED_16;	//!< Output size (8 or 16 bits)
 	Range range = Range::RANGE_2048;				//!< Range adjustment factor
+	bool codecGain = false;		//!< Gain is set in the hardware and the range adjustment is skipped
+	float codecGainDb = 0.0;	//!< Hardware gain in dB, updated by init() to the gain actually set
+	bool codecLimiter = false;	//!< Enable the codec ALC limiter (RTL872x)
+	float codecLimiterDb = 0.0;	//!< Limiter threshold, 0 to -23.625 dB
+	CodecHighPass codecHighPass = CodecHighPass::HIGH_PASS; //!< Codec high-pass filter (RTL872x)
+	bool codecHighPassActive = false; //!< Set by init() when the hardware removes the DC offset
+	bool codecSettings = false;	//!< A withCodec*() setting was used, otherwise init() leaves the RTL872x codec as its driver set it up
 	size_t numSamples; //!< Number of samples in the DMA buffer
+	uint32_t lastSequence = 0; //!< Sequence number of the last buffer the consumer took
+	uint32_t lastTimestamp = 0; //!< micros() when the last buffer the consumer took was filled
+	uint32_t lateCount = 0; //!< Number of times the consumer took a buffer when more than one was ready
+	WaitStats waitStats = {}; //!< Counters kept by waitForSamples()
+	uint32_t lastWaitEnd = 0; //!< micros() when waitForSamples() last returned
+	bool waitedBefore = false; //!< lastWaitEnd is valid
 };
 
 // This is here because the platform-specific classes derive from Microphone_PDM_Base
-#if defined(HAL_PLATFORM_RTL872X) && HAL_PLATFORM_RTL872X
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+	#include "Microphone_PDM_Host.h"
+#elif defined(HAL_PLATFORM_RTL872X) && HAL_PLATFORM_RTL872X
 	#include "Microphone_PDM_RTL872x.h"
 #elif HAL_PLATFORM_NRF52840 
 	#include "Microphone_PDM_nRF52.h"
@@ -256,6 +485,23 @@ public:
 	 */
 	Microphone_PDM &withPinDAT(pin_t datPin) { this->datPin = datPin; return *this; };
 
+#if HAL_PLATFORM_NRF52840
+	/**
+	 * @brief Sets the number of DMA buffers. nRF52 only!
+	 * 
+	 * @param numBuffers Number of buffers, at least MIN_BUFFERS (3). Default is NUM_BUFFERS (4).
+	 * 
+	 * Each buffer is 1024 bytes. The PDM peripheral always owns two of them (the one being filled
+	 * and the next one), and the rest hold samples until you read them. More buffers let your code fall
+	 * further behind without losing samples. There is one additional buffer that the PDM writes into when
+	 * you haven't released any, whose samples are discarded.
+	 * 
+	 * This setting must be set before the first init(). The buffers are allocated by the first init() and
+	 * never resized, so once they exist the call is ignored. On the RTL872x there are always 4 buffers.
+	 */
+	Microphone_PDM &withNumBuffers(size_t numBuffers) { setNumBuffers(numBuffers); return *this; };
+#endif
+
 	/**
 	 * @brief Sets the size of the output samples
 	 *
@@ -303,6 +549,67 @@ public:
 	 */
 	Microphone_PDM &withSampleRate(int sampleRate) { this->sampleRate = sampleRate; return *this; };
 
+	/**
+	 * @brief Sets a higher hardware sampling rate that is filtered down to the sample rate. RTL872x only.
+	 * 
+	 * @param captureSampleRate 16000 or 32000. Must be 2 or 4 times the sample rate set with withSampleRate().
+	 * The default is 0, which captures at the sample rate.
+	 * 
+	 * For example, withSampleRate(16000).withCaptureSampleRate(32000) samples the microphone at 32 kHz then
+	 * low-pass filters and decimates to 16 kHz. This gives better quality than sampling at the lower rate
+	 * directly, at the cost of a small amount of CPU for the filter (about 2 multiply-accumulate instructions
+	 * per input sample). The filter state carries over from one DMA buffer to the next.
+	 * 
+	 * An invalid combination captures at the sample rate. Only supported in mono.
+	 * 
+	 * On the nRF52 the hardware always samples at 16000 Hz, so this is ignored; setting a sample rate of
+	 * 8000 automatically uses the decimation filter.
+	 */
+	Microphone_PDM &withCaptureSampleRate(int captureSampleRate) { this->captureSampleRate = captureSampleRate; return *this; };
+
+	/**
+	 * @brief Amplify the samples in the hardware instead of shifting them with the range adjustment
+	 * 
+	 * @param gainDb Gain in dB. Use getRangeGainDb() to get the same level as a range setting.
+	 * 
+	 * On the RTL872x the codec applies the DMIC boost (0, 12, 24, or 36 dB) and then its digital volume
+	 * (-17.625 to +30 dB in 0.375 dB steps), so from -17.625 to +66 dB. On the nRF52 the PDM peripheral
+	 * gain is -20 to +20 dB in 0.5 dB steps. The host simulator multiplies the source samples.
+	 * 
+	 * The gain is applied before the samples are rounded to 16 bits, so quiet microphones keep the
+	 * resolution that the left shift of the range adjustment throws away, and the range conversion in
+	 * copySamples() and noCopySamples() is skipped (see hasCodecGain()). Samples written directly to
+	 * destinations on the RTL872x are also amplified.
+	 * 
+	 * This setting must be set before init().
+	 */
+	Microphone_PDM &withCodecGain(float gainDb) { this->codecGain = true; this->codecGainDb = gainDb; this->codecSettings = true; return *this; };
+
+	/**
+	 * @brief Enable the codec ALC limiter. RTL872x only.
+	 * 
+	 * @param enable true to enable the limiter. It's disabled by default.
+	 * 
+	 * @param thresholdDb Limiter threshold, from 0 to -23.625 dB below full scale in 0.375 dB steps
+	 * 
+	 * The limiter reduces the gain of loud sounds in the codec, so a high withCodecGain() setting does
+	 * not clip. This setting must be set before init(). It's ignored on nRF52 and by the host simulator.
+	 */
+	Microphone_PDM &withCodecLimiter(bool enable, float thresholdDb = 0.0) { this->codecLimiter = enable; this->codecLimiterDb = thresholdDb; this->codecSettings = true; return *this; };
+
+	/**
+	 * @brief Select the codec high-pass filter. RTL872x only.
+	 * 
+	 * @param highPass OFF, DC_BLOCK, or HIGH_PASS (default)
+	 * 
+	 * The codec filters out the DC offset of the microphone before the DMA, so software that subtracts
+	 * the mean or runs its own DC blocking filter can be skipped when hasCodecHighPass() is true.
+	 * The nRF52 PDM peripheral has no high-pass filter, and it's ignored by the host simulator.
+	 * 
+	 * This setting must be set before init().
+	 */
+	Microphone_PDM &withCodecHighPass(CodecHighPass highPass) { this->codecHighPass = highPass; this->codecSettings = true; return *this; };
+
 	/**
 	 * @brief Initialize the PDM module.
 	 *
@@ -396,11 +703,12 @@ public:
 	 * that is determined by the MCU type at compile time and does not change. 
 	 * 
 	 * On the nRF52, it's 512 samples (1024 bytes), except in one case: If you set a sample rate of
-	 * 8000 Hz, it will be 256 samples because the hardware only samples at 16000 Hz but the code
-	 * will automatically discard every other sample so there will only be 256 samples.
+	 * 8000 Hz, it will be 256 samples because the hardware only samples at 16000 Hz and the samples
+	 * are filtered and decimated by 2.
 	 * 
 	 * On the RTL872x, it's 256 samples (512 bytes). It's smaller because the are 4 buffers instead of the
-	 * 2 buffers used on the nRF52, and the optimal DMA size on the RTL872x is 512 bytes.
+	 * 2 buffers used on the nRF52, and the optimal DMA size on the RTL872x is 512 bytes. If the capture
+	 * sample rate is higher than the sample rate, it's divided by the decimation factor (2 or 4).
 	 */
 	size_t getNumberOfSamples() const {
 		return Microphone_PDM_MCU::getNumberOfSamples();
@@ -0,0 +1,313 @@
+#include "Particle.h"
+
+#if defined(MICROPHONE_PDM_HOST) && MICROPHONE_PDM_HOST
+
+#include "Microphone_PDM.h"
+#include "MicWavWriter.h"
+
+#include <cmath>
+#include <random>
+
+Microphone_PDM_Host::Microphone_PDM_Host() : Microphone_PDM_Base(BUFFER_SIZE_SAMPLES),
+	exitThread(false), sourceDone(false), numTargeted(0), numReleased(0), numConsumed(0), nextSequence(0), overrunCount(0) {
+
+}
+
+Microphone_PDM_Host::~Microphone_PDM_Host() {
+	stop();
+}
+
+Microphone_PDM_Host &Microphone_PDM_Host::withSourceFile(const char *path, int sampleRate, uint8_t numChannels) {
+	source.clear();
+
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		Log.error("could not open %s", path);
+		return *this;
+	}
+
+	// Anything that has a RIFF WAVE header is treated as a wav file, otherwise it's raw PCM
+	MicWavHeader<4096> wav;
+	wav.setBufferOffset(fread(wav.getBuffer(), 1, wav.getBufferSize(), fp));
+
+	size_t dataOffset = 0;
+	uint32_t dataSize = 0;
+
+	if (wav.getBufferOffset() >= MicWavHeaderBase::STANDARD_SIZE &&
+		wav.getUint32BE(0) == MicWavHeaderBase::fourCharStringToValue("RIFF") &&
+		wav.getUint32BE(8) == MicWavHeaderBase::fourCharStringToValue("WAVE")) {
+
+		size_t fmtOffset;
+		uint32_t fmtSize;
+		if (!wav.findChunk(MicWavHeaderBase::fourCharStringToValue("fmt "), fmtOffset, fmtSize) ||
+			!wav.findChunk(MicWavHeaderBase::fourCharStringToValue("data"), dataOffset, dataSize) ||
+			wav.getUint16LE(fmtOffset) != 1 || wav.getUint16LE(fmtOffset + 14) != 16) {
+			Log.error("%s is not a 16-bit PCM wav file", path);
+			fclose(fp);
+			return *this;
+		}
+		numChannels = (uint8_t) wav.getUint16LE(fmtOffset + 2);
+		sampleRate = (int) wav.getUint32LE(fmtOffset + 4);
+	}
+	else {
+		fseek(fp, 0, SEEK_END);
+		dataSize = (uint32_t) ftell(fp);
+	}
+
+	std::vector<int16_t> samples(dataSize / sizeof(int16_t));
+	fseek(fp, (long) dataOffset, SEEK_SET);
+	samples.resize(fread(samples.data(), sizeof(int16_t), samples.size(), fp));
+	fclose(fp);
+
+	return withSourceSamples(samples.data(), samples.size(), sampleRate, numChannels);
+}
+
+Microphone_PDM_Host &Microphone_PDM_Host::withSourceSamples(const int16_t *samples, size_t numSamples, int sampleRate, uint8_t numChannels) {
+	source.assign(samples, samples + numSamples);
+	sourceSampleRate = sampleRate;
+	sourceChannels = numChannels;
+	return *this;
+}
+
+int Microphone_PDM_Host::init() {
+	if (source.empty() || sourceSampleRate <= 0) {
+		return SYSTEM_ERROR_INVALID_STATE;
+	}
+	if (sourceChannels != (stereoMode ? 2 : 1)) {
+		return SYSTEM_ERROR_INVALID_ARGUMENT;
+	}
+
+	// The source sample rate is the capture sample rate
+	unsigned int factor = 1;
+	if (sourceSampleRate != sampleRate) {
+		if (stereoMode || sampleRate <= 0 || (sourceSampleRate % sampleRate) != 0) {
+			return SYSTEM_ERROR_INVALID_ARGUMENT;
+		}
+		factor = (unsigned int)(sourceSampleRate / sampleRate);
+	}
+	if (!decimator.init(factor, BUFFER_SIZE_SAMPLES)) {
+		return SYSTEM_ERROR_INVALID_ARGUMENT;
+	}
+
+	// Simulate the codec gain on the source samples, the limiter and high-pass filter are not simulated
+	sourceGain = codecGain ? (int32_t)lround(65536.0 * pow(10.0, codecGainDb / 20.0)) : 0;
+	return 0;
+}
+
+int Microphone_PDM_Host::uninit() {
+	return stop();
+}
+
+int Microphone_PDM_Host::start() {
+	stop();
+
+	numTargeted = numReleased = numConsumed = 0;
+	overrunCount = 0;
+	wakePending = false;
+	sourceOffset = 0;
+	sourceDone = false;
+	exitThread = false;
+	decimator.reset();
+
+	thread = std::thread(&Microphone_PDM_Host::threadFunction, this);
+	return 0;
+}
+
+int Microphone_PDM_Host::stop() {
+	if (thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			exitThread = true;
+		}
+		cond.notify_all();
+		thread.join();
+	}
+
+	// Anything not yet read is discarded
+	numConsumed = (uint32_t) numReleased;
+	return 0;
+}
+
+bool Microphone_PDM_Host::samplesAvailable() const {
+	return (readyBuffer() != NULL);
+}
+
+bool Microphone_PDM_Host::copySamples(void*pSamples) {
+	int16_t *src = readyBuffer();
+	if (src) {
+		acquireBuffer();
+		copySamplesInternal(src, (uint8_t *)pSamples);
+		releaseBuffer();
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+bool Microphone_PDM_Host::noCopySamples(std::function<void(void *pSamples, size_t numSamples)>callback) {
+	int16_t *src = readyBuffer();
+	if (src) {
+		acquireBuffer();
+		copySamplesInternal(src, (uint8_t *)src);
+		callback(src, getNumberOfSamples());
+		releaseBuffer();
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+bool Microphone_PDM_Host::waitReady() const {
+	return (readyBuffer() != NULL);
+}
+
+bool Microphone_PDM_Host::waitSleep(uint32_t timeoutMs) {
+	std::unique_lock<std::mutex> lock(mutex);
+	wakeCond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return wakePending; });
+
+	bool woken = wakePending;
+	wakePending = false;
+	return woken;
+}
+
+int16_t *Microphone_PDM_Host::readyBuffer() const {
+	uint32_t consumed = numConsumed;
+	if (consumed == numReleased) {
+		return NULL;
+	}
+	return const_cast<int16_t *>(&samples[(consumed % NUM_BUFFERS) * BUFFER_SIZE_SAMPLES]);
+}
+
+void Microphone_PDM_Host::acquireBuffer() {
+	uint32_t consumed = numConsumed;
+
+	bufferAcquired(sequence[consumed % NUM_BUFFERS], timestamp[consumed % NUM_BUFFERS], numReleased - consumed);
+}
+
+void Microphone_PDM_Host::releaseBuffer() {
+	uint32_t consumed = numConsumed;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		numConsumed = consumed + 1;
+	}
+	cond.notify_all();
+}
+
+int16_t *Microphone_PDM_Host::nextTarget() {
+	uint32_t targeted = numTargeted;
+	if ((targeted - numConsumed) < NUM_BUFFERS) {
+		numTargeted = targeted + 1;
+		return &samples[(targeted % NUM_BUFFERS) * BUFFER_SIZE_SAMPLES];
+	}
+	else {
+		// Consumer owns every buffer that the DMA isn't filling
+		return &samples[NUM_BUFFERS * BUFFER_SIZE_SAMPLES];
+	}
+}
+
+bool Microphone_PDM_Host::readSource(int16_t *dst) {
+	if (sourceOffset >= source.size()) {
+		if (!loop) {
+			return false;
+		}
+		sourceOffset = 0;
+	}
+
+	size_t count = source.size() - sourceOffset;
+	if (count > BUFFER_SIZE_SAMPLES) {
+		count = BUFFER_SIZE_SAMPLES;
+	}
+	memcpy(dst, &source[sourceOffset], count * sizeof(int16_t));
+	if (sourceGain) {
+		for (size_t ix = 0; ix < count; ix++) {
+			int64_t val = ((int64_t)dst[ix] * sourceGain) >> 16;
+			dst[ix] = (int16_t)((val < -32768) ? -32768 : ((val > 32767) ? 32767 : val));
+		}
+	}
+	memset(&dst[count], 0, (BUFFER_SIZE_SAMPLES - count) * sizeof(int16_t));
+	sourceOffset += count;
+
+	return true;
+}
+
+void Microphone_PDM_Host::threadFunction() {
+	const int16_t *discard = &samples[NUM_BUFFERS * BUFFER_SIZE_SAMPLES];
+
+	// Time to fill one buffer at the source sample rate, adjusted for speed
+	std::chrono::duration<double, std::micro> period(0);
+	if (speed > 0) {
+		period = std::chrono::duration<double, std::micro>(1e6 * BUFFER_SIZE_SAMPLES / (sourceSampleRate * sourceChannels) / speed);
+	}
+
+	std::mt19937 rng(nextSequence);
+	std::uniform_int_distribution<int32_t> jitter(-(int32_t)jitterUs, (int32_t)jitterUs);
+
+	auto startTime = std::chrono::steady_clock::now();
+	int16_t *target = nextTarget();
+
+	for(uint32_t bufferNum = 1; ; bufferNum++) {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if (speed > 0) {
+			// Completion times are relative to the start so jitter and stalls don't accumulate
+			auto completion = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * bufferNum);
+			if (jitterUs) {
+				completion += std::chrono::microseconds(jitter(rng));
+			}
+			if (stallEvery && (bufferNum % stallEvery) == 0) {
+				auto stalled = std::chrono::steady_clock::now() + std::chrono::milliseconds(stallMs);
+				if (stalled > completion) {
+					completion = stalled;
+				}
+			}
+			cond.wait_until(lock, completion, [this]() { return (bool)exitThread; });
+		}
+		else {
+			// As fast as possible, but wait for a free buffer instead of discarding
+			cond.wait(lock, [this, &target, discard]() {
+				if (target == discard) {
+					target = nextTarget();
+				}
+				return exitThread || target != discard;
+			});
+		}
+		if (exitThread) {
+			break;
+		}
+		lock.unlock();
+
+		if (!readSource(target)) {
+			sourceDone = true;
+			break;
+		}
+
+		if (target == discard) {
+			overrunCount++;
+		}
+		else {
+			sequence[numReleased % NUM_BUFFERS] = nextSequence;
+			timestamp[numReleased % NUM_BUFFERS] = micros();
+			numReleased++;
+		}
+		nextSequence++;
+
+		// Same as the completion interrupt giving the semaphore
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			wakePending = true;
+		}
+		wakeCond.notify_all();
+
+		if (sourceOffset >= source.size() && !loop) {
+			sourceDone = true;
+			break;
+		}
+
+		target = nextTarget();
+	}
+}
+
+#endif // MICROPHONE_PDM_HOST
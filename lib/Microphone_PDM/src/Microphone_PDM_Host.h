@@ -0,0 +1,263 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Simulated implementation of PDM for building and testing on a computer
+ *
+ * This class is used when the library is built with MICROPHONE_PDM_HOST=1, using the Particle.h
+ * stand-in in the host directory. Instead of a microphone, samples come from a wav file, a raw PCM file,
+ * or a buffer, and are delivered through the same samplesAvailable(), copySamples(), and noCopySamples()
+ * API as the MCU-specific classes.
+ *
+ * A thread plays the role of the DMA. It fills one 512 byte buffer at a time at the rate the samples
+ * would arrive from the hardware (or faster), with the same buffer ownership rules as the RTL872x: 4
+ * buffers, one of which the DMA is filling, and a discard buffer used when the consumer owns the rest.
+ * Jitter and stalls can be added to the buffer completion times to exercise overrun handling.
+ *
+ * You do not instantiate this class directly; it's automatically created when you use the
+ * Microphone_PDM singleton. Because init() is not accessible from this class, configure the simulator
+ * in a separate statement before the usual Microphone_PDM::instance().with...().init() call.
+ */
+class Microphone_PDM_Host : public Microphone_PDM_Base
+{
+public:
+    static const size_t BUFFER_SIZE_SAMPLES = 256; //!< 512 bytes per buffer, the same as RTL872x
+    static const size_t NUM_BUFFERS = 4;  //!< 4 buffers, the same as RTL872x
+
+	/**
+	 * @brief Use a wav file or raw PCM file as the source of samples
+	 *
+	 * @param path Path to the file
+	 *
+	 * @param sampleRate Sample rate of a raw file. Ignored for wav files, which have it in the header.
+	 *
+	 * @param numChannels Number of channels in a raw file. Ignored for wav files.
+	 *
+	 * Files must be signed 16-bit little endian PCM. The file is read into memory immediately; check
+	 * isSourceLoaded() to see if it succeeded. The sample rate of the file is the capture sample rate. If
+	 * it's 2 or 4 times the sample rate set with withSampleRate(), the samples are decimated, the same as
+	 * withCaptureSampleRate() on the RTL872x.
+	 */
+	Microphone_PDM_Host &withSourceFile(const char *path, int sampleRate = 16000, uint8_t numChannels = 1);
+
+	/**
+	 * @brief Use samples in memory as the source of samples
+	 *
+	 * @param samples Signed 16-bit samples, interleaved if numChannels is 2. They are copied.
+	 *
+	 * @param numSamples Number of samples (not frames)
+	 *
+	 * @param sampleRate Sample rate of the samples
+	 *
+	 * @param numChannels 1 or 2
+	 */
+	Microphone_PDM_Host &withSourceSamples(const int16_t *samples, size_t numSamples, int sampleRate, uint8_t numChannels = 1);
+
+	/**
+	 * @brief How fast to deliver samples
+	 *
+	 * @param speed 1.0 is real time (the default), 2.0 is twice as fast, etc.
+	 *
+	 * 0 delivers a buffer as soon as one is free, so samples are never discarded. This is useful for measuring
+	 * how fast the consumer can process samples.
+	 */
+	Microphone_PDM_Host &withSpeed(float speed) { this->speed = speed; return *this; };
+
+	/**
+	 * @brief Add random timing jitter to each buffer completion
+	 *
+	 * @param jitterUs Each buffer completes up to this many microseconds early or late. The average rate is unchanged.
+	 */
+	Microphone_PDM_Host &withJitterUs(uint32_t jitterUs) { this->jitterUs = jitterUs; return *this; };
+
+	/**
+	 * @brief Periodically delay a buffer completion, like an interrupt that is blocked
+	 *
+	 * @param everyBuffers Stall before every this many buffers. 0 disables stalls (the default).
+	 *
+	 * @param stallMs How long to stall in milliseconds
+	 *
+	 * The buffers that should have completed during the stall complete immediately afterwards, so the
+	 * average rate is unchanged but the consumer sees a burst.
+	 */
+	Microphone_PDM_Host &withStall(uint32_t everyBuffers, uint32_t stallMs) { this->stallEvery = everyBuffers; this->stallMs = stallMs; return *this; };
+
+	/**
+	 * @brief Restart from the beginning of the source when it's used up. The default is to stop.
+	 */
+	Microphone_PDM_Host &withLoop(bool loop) { this->loop = loop; return *this; };
+
+	/**
+	 * @brief Returns true if withSourceFile() or withSourceSamples() loaded samples
+	 */
+	bool isSourceLoaded() const { return !source.empty(); };
+
+	/**
+	 * @brief Returns true after the last buffer of the source has been delivered (never when looping)
+	 *
+	 * The last buffer is padded with zeros. It may still be waiting to be read.
+	 */
+	bool isSourceDone() const { return sourceDone; };
+
+	/**
+	 * @brief Number of buffers discarded because the consumer had not released a buffer
+	 *
+	 * @return uint32_t Count since start()
+	 *
+	 * This works the same way as on the RTL872x and nRF52.
+	 */
+	uint32_t getOverrunCount() const { return overrunCount; };
+
+protected:
+	/**
+	 * @brief This object is constructed when the Microphone_PDM class singleton is instantiated
+	 */
+    Microphone_PDM_Host();
+
+	/**
+	 * @brief This class is never deleted
+	 */
+    virtual ~Microphone_PDM_Host();
+
+	/**
+	 * @brief Check the source and settings
+	 *
+	 * Fails if there is no source, the number of channels does not match the stereo setting, or the source
+	 * sample rate can't be decimated to the sample rate.
+	 */
+	virtual int init();
+
+	/**
+	 * @brief Uninitialize. Stops the simulated DMA if running.
+	 */
+	virtual int uninit();
+
+	/**
+	 * @brief Start the simulated DMA thread from the beginning of the source
+	 */
+	virtual int start();
+
+	/**
+	 * @brief Stop the simulated DMA thread. Buffers not yet read are discarded.
+	 */
+	virtual int stop();
+
+	/**
+	 * @brief Return true if there is data available to be copied using copySamples
+	 */
+	virtual bool samplesAvailable() const;
+
+	/**
+	 * @brief Copy samples from the simulated DMA buffer to your buffer
+	 *
+	 * @param pSamples Pointer to buffer to copy samples to. It must be at least getNumberOfSamples() samples in length.
+	 */
+	virtual bool copySamples(void* pSamples);
+
+	/**
+	 * @brief Alternative API to get samples, see Microphone_PDM::noCopySamples()
+	 */
+    virtual bool noCopySamples(std::function<void(void *pSamples, size_t numSamples)>callback);
+
+	/**
+	 * @brief Samples are ready, for waitForSamples()
+	 */
+	virtual bool waitReady() const;
+
+	/**
+	 * @brief Block until the simulated DMA completes a buffer, for waitForSamples()
+	 *
+	 * Works like the binary semaphore the interrupt gives on the devices: every completion, including a
+	 * discarded buffer, sets a pending wakeup that the next wait takes, even if nobody was waiting.
+	 */
+	virtual bool waitSleep(uint32_t timeoutMs);
+
+	/**
+	 * @brief Return the number of int16_t samples that copySamples will copy
+	 *
+	 * 256 samples, divided by the decimation factor if the source sample rate is higher than the sample rate.
+	 */
+	size_t getNumberOfSamples() const {
+		return BUFFER_SIZE_SAMPLES / decimator.getFactor();
+	}
+
+	/**
+	 * @brief Get the oldest filled buffer, or NULL if there isn't one. Used internally.
+	 */
+	int16_t *readyBuffer() const;
+
+	/**
+	 * @brief Record the sequence, timestamp, and lateness of the oldest filled buffer before it's passed
+	 * to the consumer, the same as the RTL872x does. Used internally.
+	 */
+	void acquireBuffer();
+
+	/**
+	 * @brief Return the oldest filled buffer to the free pool. Used internally.
+	 */
+	void releaseBuffer();
+
+	/**
+	 * @brief The simulated DMA
+	 */
+	void threadFunction();
+
+	/**
+	 * @brief Pick the buffer the simulated DMA will fill next: the next free buffer, or discard
+	 */
+	int16_t *nextTarget();
+
+	/**
+	 * @brief Copy the next buffer of samples from the source into dst
+	 *
+	 * @return false if the source has been used up (and loop is false)
+	 */
+	bool readSource(int16_t *dst);
+
+	std::vector<int16_t> source;			//!< Source samples
+	int sourceSampleRate = 0;				//!< Source sample rate, the simulated capture sample rate
+	uint8_t sourceChannels = 1;				//!< Source number of channels
+	size_t sourceOffset = 0;				//!< Next sample to read from source
+
+	float speed = 1.0;						//!< 1.0 = real time, 0 = as fast as buffers are released
+	uint32_t jitterUs = 0;					//!< Maximum jitter in microseconds
+	uint32_t stallEvery = 0;				//!< Stall before every this many buffers, 0 = never
+	uint32_t stallMs = 0;					//!< Stall duration
+	bool loop = false;						//!< Restart the source when it's used up
+	int32_t sourceGain = 0;					//!< Simulated codec gain as 16.16 fixed point, 0 = no gain
+
+	std::thread thread;						//!< Simulated DMA thread
+	std::mutex mutex;						//!< Used with cond for waiting in the thread
+	std::condition_variable cond;			//!< Signaled when a buffer is released or the thread should exit
+	std::condition_variable wakeCond;		//!< Signaled when the simulated DMA completes a buffer
+	bool wakePending = false;				//!< A completion since the last waitSleep(), protected by mutex
+	std::atomic<bool> exitThread;			//!< Set by stop() to make the thread exit
+	std::atomic<bool> sourceDone;			//!< Set when the source has been used up
+
+	// Buffers are targeted, filled, and read in ring order, the buffer index is the counter modulo NUM_BUFFERS.
+	// The counters only ever increase. numTargeted and numReleased are written by the thread, numConsumed
+	// by the consumer.
+	std::atomic<uint32_t> numTargeted;		//!< Buffers chosen by the simulated DMA to fill
+	std::atomic<uint32_t> numReleased;		//!< Buffers filled
+	std::atomic<uint32_t> numConsumed;		//!< Buffers read by the consumer and free again
+	std::atomic<uint32_t> nextSequence;		//!< Sequence number for the next filled buffer
+	std::atomic<uint32_t> overrunCount;		//!< Buffers discarded since start()
+
+	int16_t samples[BUFFER_SIZE_SAMPLES * (NUM_BUFFERS + 1)]; //!< Buffers, followed by the discard buffer
+	uint32_t sequence[NUM_BUFFERS];			//!< Sequence number of each filled buffer
+	uint32_t timestamp[NUM_BUFFERS];		//!< micros() when each buffer was filled
+};
+
+/**
+ * @brief Microphone_PDM_MCU is an alias for the MCU-specific class, in this case the simulator
+ *
+ * This class exists so the subclass Microphone_PDM can just reference Microphone_PDM_MCU
+ * as its superclass regardless of which class is actually used.
+ */
+class Microphone_PDM_MCU : public Microphone_PDM_Host {
+};
@@ -26,13 +26,103 @@ int Microphone_PDM_RTL872x::init() {
             break;
     }
 
-    dmic_setup(sampleRate, stereoMode);
+    // Capture at a higher rate and decimate, if requested and possible
+    int captureRate = captureSampleRate;
+    switch(captureRate) {
+        case 16000:
+        case 32000:
+            if (!stereoMode && captureRate > sampleRate && (captureRate % sampleRate) == 0) {
+                break;
+            }
+            captureRate = sampleRate;
+            break;
+
+        default:
+            captureRate = sampleRate;
+            break;
+    }
+
+    if (!decimator.init(captureRate / sampleRate, BUFFER_SIZE_SAMPLES)) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+
+    if (!wakeSemaphore && os_semaphore_create(&wakeSemaphore, 1, 0) != 0) {
+        wakeSemaphore = NULL;
+    }
+
+    dmic_setup(captureRate, stereoMode);
+    setupCodec();
+    dmic_set_wake_callback(wakeFromInterrupt);
     return 0;
 }
 
 
+void Microphone_PDM_RTL872x::setupCodec() {
+    if (!codecSettings) {
+        // Leave the registers as CODEC_Init() set them, which includes the DC blocking and
+        // high-pass filters
+        codecHighPassActive = true;
+        return;
+    }
+
+    DMIC_CODEC_OBJ codec = {};
+
+    if (codecGain) {
+        // DMIC boost in 12 dB steps first, then the digital volume for the rest
+        float gain = codecGainDb;
+        if (gain < -17.625) {
+            gain = -17.625;
+        }
+        if (gain > 66.0) {
+            gain = 66.0;
+        }
+        int boost = (gain >= 12.0) ? (int)(gain / 12.0) : 0;
+        if (boost > 3) {
+            boost = 3;
+        }
+        int volume = 0x2f + (int)lroundf((gain - 12.0 * boost) / 0.375);
+        if (volume < 0) {
+            volume = 0;
+        }
+        if (volume > 0x7f) {
+            volume = 0x7f;
+        }
+
+        codec.gain_enable = 1;
+        codec.dmic_boost = (unsigned int)boost;
+        codec.adc_gain = (unsigned int)volume;
+        codecGainDb = 12.0 * boost + 0.375 * (volume - 0x2f);
+    }
+
+    if (codecLimiter) {
+        int threshold = (int)lroundf(-codecLimiterDb / 0.375);
+        codec.limiter_enable = 1;
+        codec.limiter_threshold = (unsigned int)((threshold < 0) ? 0 : ((threshold > 0x3f) ? 0x3f : threshold));
+    }
+
+    switch(codecHighPass) {
+        case CodecHighPass::OFF:
+            codec.high_pass = DMIC_HPF_OFF;
+            break;
+
+        case CodecHighPass::DC_BLOCK:
+            codec.high_pass = DMIC_HPF_DC_BLOCK;
+            break;
+
+        case CodecHighPass::HIGH_PASS:
+        default:
+            codec.high_pass = DMIC_HPF_HIGH_PASS;
+            break;
+    }
+    codecHighPassActive = (codec.high_pass != DMIC_HPF_OFF);
+
+    dmic_codec_config(&codec);
+}
+
 int Microphone_PDM_RTL872x::start() {
     dmic_flush();
+    decimator.reset();
+    overrunsAtStart = dmic_overruns();
 
     running = true;
     return 0;
@@ -60,6 +150,7 @@ bool Microphone_PDM_RTL872x::copySamples(void*pSamples) {
 
     int16_t *src = (int16_t *)dmic_ready();
 	if (src) {
+		bufferAcquired(dmic_ready_sequence(), dmic_ready_timestamp(), dmic_ready_count());
 		copySamplesInternal(src, (uint8_t *)pSamples);
         dmic_read(NULL, 0);
 		return true;
@@ -76,8 +167,9 @@ bool Microphone_PDM_RTL872x::noCopySamples(std::function<void(void *pSamples, si
 
     int16_t *src = (int16_t *)dmic_ready();
 	if (src) {
+		bufferAcquired(dmic_ready_sequence(), dmic_ready_timestamp(), dmic_ready_count());
 		copySamplesInternal(src, (uint8_t *)src);
-		callback(src, BUFFER_SIZE_SAMPLES);
+		callback(src, getNumberOfSamples());
         dmic_read(NULL, 0);
 		return true;
 	}
@@ -86,5 +178,57 @@ bool Microphone_PDM_RTL872x::noCopySamples(std::function<void(void *pSamples, si
 	}
 }
 
+bool Microphone_PDM_RTL872x::waitReady() const {
+    if (!running) {
+        return false;
+    }
+    return dmic_ready() != NULL || dmic_dest_ready_count() > 0;
+}
+
+bool Microphone_PDM_RTL872x::waitSleep(uint32_t timeoutMs) {
+    if (!wakeSemaphore) {
+        // No semaphore, fall back to polling
+        delay(1);
+        return false;
+    }
+    return os_semaphore_take(wakeSemaphore, timeoutMs, false) == 0;
+}
+
+// [static]
+void Microphone_PDM_RTL872x::wakeFromInterrupt() {
+    os_semaphore_t sem = Microphone_PDM::instance().wakeSemaphore;
+    if (sem) {
+        // Binary semaphore, so completions while nobody is waiting leave at most one wakeup
+        os_semaphore_give(sem, false);
+    }
+}
+
+void Microphone_PDM_RTL872x::enableDestinations(bool enable) {
+    dmic_dest_enable(enable);
+}
+
+bool Microphone_PDM_RTL872x::queueDestination(int16_t *pSamples, size_t numSamples) {
+    return dmic_dest_queue((unsigned char *)pSamples, numSamples * sizeof(int16_t)) == 0;
+}
+
+bool Microphone_PDM_RTL872x::destinationComplete(std::function<void(int16_t *pSamples, size_t numSamples)>callback) {
+    if (!running) {
+        return false;
+    }
+
+    size_t len;
+    unsigned int seq;
+    unsigned int timestamp;
+    int16_t *dst = (int16_t *)dmic_dest_ready(&len, &seq, &timestamp);
+    if (dst) {
+        bufferAcquired(seq, timestamp, dmic_dest_ready_count());
+        callback(dst, len / sizeof(int16_t));
+        dmic_dest_release();
+        return true;
+    }
+    else {
+        return false;
+    }
+}
 
 #endif // HAL_PLATFORM_RTL872X
@@ -15,6 +15,87 @@ class Microphone_PDM_RTL872x : public Microphone_PDM_Base
 public:
     static const size_t BUFFER_SIZE_SAMPLES = SP_DMA_PAGE_SIZE / 2; //!< 512 bytes per buffer
     static const size_t NUM_BUFFERS = SP_DMA_PAGE_NUM;  //!< 4 buffers, so 2048 bytes total
+    static const size_t NUM_DESTINATIONS = SP_DEST_QUEUE_NUM; //!< Maximum number of queued destinations
+    static const size_t DESTINATION_ALIGNMENT = SP_DEST_ALIGN; //!< Destination address and size alignment in bytes
+
+	/**
+	 * @brief Switch between the internal DMA buffers and caller-supplied destinations
+	 * 
+	 * @param enable true to have the DMA write directly into buffers queued with queueDestination()
+	 * 
+	 * When enabled, the GDMA writes samples straight into your buffers instead of the 4 internal
+	 * buffers, so there is no copy between the DMA buffer and your buffer. samplesAvailable(),
+	 * copySamples(), and noCopySamples() return false in this mode; use destinationComplete().
+	 * 
+	 * If no destination is queued when the DMA needs one, that block of samples is discarded and
+	 * getDestinationOverruns() is incremented.
+	 * 
+	 * Disabling abandons any queued destinations that the DMA has not started on.
+	 */
+	void enableDestinations(bool enable);
+
+	/**
+	 * @brief Queue a buffer for the DMA to write samples into
+	 * 
+	 * @param pSamples Pointer to the buffer. Must be aligned to DESTINATION_ALIGNMENT (32) bytes.
+	 * 
+	 * @param numSamples Number of 16-bit samples. The size in bytes must be a multiple of 
+	 * DESTINATION_ALIGNMENT and no larger than 4096 bytes.
+	 * 
+	 * @return true The buffer was queued
+	 * @return false The queue is full (NUM_DESTINATIONS) or the buffer is not aligned
+	 * 
+	 * Buffers are filled in the order they are queued. Typically you split a larger buffer, such as
+	 * an inference slice, into getNumberOfSamples() sized pieces and queue them all. The buffer must
+	 * not be touched until it is returned by destinationComplete(). The cache maintenance required
+	 * for DMA is handled here and in the DMA interrupt.
+	 * 
+	 * The samples are always unadjusted 16-bit samples as returned by the MCU (RAW_SIGNED_16) at the
+	 * capture sample rate, regardless of the outputSize, range, and capture sample rate settings.
+	 */
+	bool queueDestination(int16_t *pSamples, size_t numSamples);
+
+	/**
+	 * @brief Get the oldest queued destination that has been filled
+	 * 
+	 * @param callback Callback function or lambda
+	 * 
+	 * @return true A destination was complete and the callback was called
+	 * @return false No destinations are complete yet
+	 * 
+	 * The callback function or lamba has this prototype:
+	 * 
+	 *   void callback(int16_t *pSamples, size_t numSamples)
+	 * 
+	 * pSamples is the pointer that was passed to queueDestination(). After the callback returns
+	 * the destination is removed from the queue and can be queued again.
+	 */
+	bool destinationComplete(std::function<void(int16_t *pSamples, size_t numSamples)>callback);
+
+	/**
+	 * @brief Number of blocks of samples discarded because no destination was queued
+	 * 
+	 * @return uint32_t Count since start(). Compare to a previous value to detect an overrun.
+	 * 
+	 * This is the same as getOverrunCount().
+	 */
+	uint32_t getDestinationOverruns() const {
+		return getOverrunCount();
+	}
+
+	/**
+	 * @brief Number of DMA buffers discarded because the consumer had not released a buffer for the DMA to use
+	 * 
+	 * @return uint32_t Count since start()
+	 * 
+	 * The DMA owns a buffer until it's filled, then the consumer owns it until copySamples() or noCopySamples()
+	 * returns (or destinationComplete() in destination mode). If the consumer owns all NUM_BUFFERS buffers 
+	 * when the DMA needs one, the samples are discarded and this is incremented. The sequence numbers
+	 * (getLastSequence()) still advance so the gap shows where samples were lost.
+	 */
+	uint32_t getOverrunCount() const {
+		return dmic_overruns() - overrunsAtStart;
+	}
 
 protected:
 	/**
@@ -102,6 +183,28 @@ protected:
 	 */
     virtual bool noCopySamples(std::function<void(void *pSamples, size_t numSamples)>callback);
 
+	/**
+	 * @brief Set the codec gain, limiter, and high-pass filter. Called by init() after the codec is reset.
+	 * 
+	 * Without any withCodec*() setting the registers are left as CODEC_Init() set them up.
+	 */
+	void setupCodec();
+
+	/**
+	 * @brief Samples or a completed destination are ready, for waitForSamples()
+	 */
+	virtual bool waitReady() const;
+
+	/**
+	 * @brief Block on the semaphore given by the GDMA interrupt, for waitForSamples()
+	 */
+	virtual bool waitSleep(uint32_t timeoutMs);
+
+	/**
+	 * @brief Called from the GDMA interrupt when a block completes
+	 */
+	static void wakeFromInterrupt();
+
 	/**
 	 * @brief Return the number of int16_t samples that copySamples will copy
 	 * 
@@ -111,10 +214,11 @@ protected:
 	 * that is determined by the MCU type at compile time and does not change. 
 	 * 
 	 * On the RTL872x, it's 256 samples (512 bytes). It's smaller because the are 4 buffers instead of the
-	 * 2 buffers used on the nRF52, and the optimal DMA size on the RTL872x is 512 bytes.
+	 * 2 buffers used on the nRF52, and the optimal DMA size on the RTL872x is 512 bytes. If the capture
+	 * sample rate is higher than the sample rate, it's divided by the decimation factor (2 or 4).
 	 */
 	size_t getNumberOfSamples() const {
-		return BUFFER_SIZE_SAMPLES;
+		return BUFFER_SIZE_SAMPLES / decimator.getFactor();
 	}
 
 
@@ -124,6 +228,16 @@ protected:
 	 */
 	bool running = false;
 
+	/**
+	 * @brief The DMA keeps running while stopped, so overruns are counted from start()
+	 */
+	uint32_t overrunsAtStart = 0;
+
+	/**
+	 * @brief Given by the GDMA interrupt, taken by waitForSamples(). Created by init().
+	 */
+	os_semaphore_t wakeSemaphore = NULL;
+
 };
 
 /**
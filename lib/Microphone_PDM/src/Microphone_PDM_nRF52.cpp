@@ -20,6 +20,28 @@ int Microphone_PDM_nRF52::init() {
 	Hal_Pin_Info *pinMap = HAL_Pin_Map();
 #endif
 
+	// The hardware always samples at 16000 Hz. 8000 Hz is produced by filtering and decimating by 2, which
+	// is only done in mono.
+	if (sampleRate != 8000 || stereoMode) {
+		sampleRate = 16000;
+	}
+	if (!decimator.init(16000 / sampleRate, BUFFER_SIZE_SAMPLES)) {
+		return SYSTEM_ERROR_NO_MEMORY;
+	}
+
+	// Allocated once. The extra buffer at the end is where samples go when the consumer is too far behind.
+	if (!samples) {
+		samples = new int16_t[BUFFER_SIZE_SAMPLES * (numBuffers + 1)];
+		sequence = new uint32_t[numBuffers];
+		timestamp = new uint32_t[numBuffers];
+		if (!samples || !sequence || !timestamp) {
+			return SYSTEM_ERROR_NO_MEMORY;
+		}
+	}
+	if (!wakeSemaphore && os_semaphore_create(&wakeSemaphore, 1, 0) != 0) {
+		wakeSemaphore = NULL;
+	}
+
 	pinMode(clkPin, OUTPUT);
 	pinMode(datPin, INPUT);
 
@@ -28,6 +50,19 @@ int Microphone_PDM_nRF52::init() {
 	uint8_t nrfClkPin = (uint8_t)NRF_GPIO_PIN_MAP(pinMap[clkPin].gpio_port, pinMap[clkPin].gpio_pin);
 	uint8_t nrfDatPin = (uint8_t)NRF_GPIO_PIN_MAP(pinMap[datPin].gpio_port, pinMap[datPin].gpio_pin);
 
+	// Hardware gain is 0x00 (-20 dB) to 0x50 (+20 dB) in 0.5 dB steps
+	if (codecGain) {
+		int gain = NRF_PDM_GAIN_DEFAULT + (int)lroundf(codecGainDb * 2);
+		if (gain < NRF_PDM_GAIN_MINIMUM) {
+			gain = NRF_PDM_GAIN_MINIMUM;
+		}
+		if (gain > NRF_PDM_GAIN_MAXIMUM) {
+			gain = NRF_PDM_GAIN_MAXIMUM;
+		}
+		gainL = gainR = (nrf_pdm_gain_t)gain;
+		codecGainDb = 0.5 * (gain - NRF_PDM_GAIN_DEFAULT);
+	}
+
 	// Start with default vales
 	nrfx_pdm_config_t config = NRFX_PDM_DEFAULT_CONFIG(nrfClkPin, nrfDatPin);
 
@@ -45,18 +80,19 @@ int Microphone_PDM_nRF52::init() {
 }
 
 int Microphone_PDM_nRF52::uninit() {
-	currentSampleAvailable = NULL;
-
 	nrfx_pdm_uninit();
 
+	numConsumed = numReleased;
+
 	pinMode(clkPin, INPUT);
 
     return 0;
 }
 
 int Microphone_PDM_nRF52::start() {
-	useBufferA = true;
-	currentSampleAvailable = NULL;
+	numRequested = numReleased = numConsumed = 0;
+	overrunCount = 0;
+	decimator.reset();
 
 	nrfx_err_t err = nrfx_pdm_start();
 
@@ -64,22 +100,25 @@ int Microphone_PDM_nRF52::start() {
 }
 
 int Microphone_PDM_nRF52::stop() {
-	currentSampleAvailable = NULL;
-
 	nrfx_err_t err = nrfx_pdm_stop();
 
+	// Anything not yet read is discarded
+	numConsumed = numReleased;
+
 	return (int)err;
 }
 
 
 bool Microphone_PDM_nRF52::samplesAvailable() const {
-	return (currentSampleAvailable != NULL);
+	return (readyBuffer() != NULL);
 }
 
 bool Microphone_PDM_nRF52::copySamples(void*pSamples) {
-	if (currentSampleAvailable) {
-		copySamplesInternal(currentSampleAvailable, (uint8_t *)pSamples);
-		currentSampleAvailable = NULL;
+	int16_t *src = readyBuffer();
+	if (src) {
+		acquireBuffer();
+		copySamplesInternal(src, (uint8_t *)pSamples);
+		releaseBuffer();
 		return true;
 	}
 	else {
@@ -88,10 +127,12 @@ bool Microphone_PDM_nRF52::copySamples(void*pSamples) {
 }
 
 bool Microphone_PDM_nRF52::noCopySamples(std::function<void(void *pSamples, size_t numSamples)>callback) {
-	if (currentSampleAvailable) {
-		copySamplesInternal(currentSampleAvailable, (uint8_t *)currentSampleAvailable);
-		callback(currentSampleAvailable, getNumberOfSamples());
-		currentSampleAvailable = NULL;
+	int16_t *src = readyBuffer();
+	if (src) {
+		acquireBuffer();
+		copySamplesInternal(src, (uint8_t *)src);
+		callback(src, getNumberOfSamples());
+		releaseBuffer();
 		return true;
 	}
 	else {
@@ -100,16 +141,43 @@ bool Microphone_PDM_nRF52::noCopySamples(std::function<void(void *pSamples, size
 
 }
 
-size_t Microphone_PDM_nRF52::copySrcIncrement() const {
-	if (sampleRate == 8000) {
-		return 2;
+bool Microphone_PDM_nRF52::waitReady() const {
+	return (readyBuffer() != NULL);
+}
+
+bool Microphone_PDM_nRF52::waitSleep(uint32_t timeoutMs) {
+	if (!wakeSemaphore) {
+		// No semaphore, fall back to polling
+		delay(1);
+		return false;
 	}
-	else {
-		return 1;
+	return os_semaphore_take(wakeSemaphore, timeoutMs, false) == 0;
+}
+
+int16_t *Microphone_PDM_nRF52::readyBuffer() const {
+	if (numConsumed == numReleased) {
+		return NULL;
 	}
+	return &samples[(numConsumed % numBuffers) * BUFFER_SIZE_SAMPLES];
+}
+
+void Microphone_PDM_nRF52::acquireBuffer() {
+	bufferAcquired(sequence[numConsumed % numBuffers], timestamp[numConsumed % numBuffers], numReleased - numConsumed);
 }
 
+void Microphone_PDM_nRF52::releaseBuffer() {
+	// The buffer can now be handed back to the peripheral
+	numConsumed++;
+}
 
+bool Microphone_PDM_nRF52::setNumBuffers(size_t numBuffers) {
+	// samples, sequence and timestamp are sized by the first init() and never reallocated
+	if (samples) {
+		return false;
+	}
+	this->numBuffers = (numBuffers < MIN_BUFFERS) ? MIN_BUFFERS : numBuffers;
+	return true;
+}
 
 void Microphone_PDM_nRF52::dataHandler(nrfx_pdm_evt_t const * const pEvent) {
 	/*
@@ -117,19 +185,35 @@ void Microphone_PDM_nRF52::dataHandler(nrfx_pdm_evt_t const * const pEvent) {
     int16_t *        buffer_released;   ///< Pointer to the released buffer. Can be NULL.
     nrfx_pdm_error_t error;             ///< Error type.
 	 */
+	int16_t *discard = &samples[numBuffers * BUFFER_SIZE_SAMPLES];
 
 	if (pEvent->buffer_released) {
-		currentSampleAvailable = (int16_t *)pEvent->buffer_released;;
+		// Buffers are released in the order they were requested
+		if (pEvent->buffer_released == discard) {
+			overrunCount++;
+		}
+		else {
+			sequence[numReleased % numBuffers] = nextSequence;
+			timestamp[numReleased % numBuffers] = micros();
+			numReleased++;
+		}
+		nextSequence++;
+
+		// Binary semaphore, so buffers released while nobody is waiting leave at most one wakeup
+		if (wakeSemaphore) {
+			os_semaphore_give(wakeSemaphore, false);
+		}
 	}
 
 	if (pEvent->buffer_requested) {
-		if (useBufferA) {
-			nrfx_pdm_buffer_set(samples, BUFFER_SIZE_SAMPLES);
+		if ((numRequested - numConsumed) < numBuffers) {
+			nrfx_pdm_buffer_set(&samples[(numRequested % numBuffers) * BUFFER_SIZE_SAMPLES], BUFFER_SIZE_SAMPLES);
+			numRequested++;
 		}
 		else {
-			nrfx_pdm_buffer_set(&samples[BUFFER_SIZE_SAMPLES], BUFFER_SIZE_SAMPLES);
+			// Consumer owns every buffer that isn't already owned by the peripheral
+			nrfx_pdm_buffer_set(discard, BUFFER_SIZE_SAMPLES);
 		}
-		useBufferA = !useBufferA;
 	}
 }
 
@@ -15,7 +15,24 @@ class Microphone_PDM_nRF52  : public Microphone_PDM_Base
 {
 public:
     static const size_t BUFFER_SIZE_SAMPLES = 512; //!< 1024 bytes per buffer
-    static const size_t NUM_BUFFERS = 2;  //!< 2 buffers, so 2048 bytes total
+    static const size_t NUM_BUFFERS = 4;  //!< Default number of buffers, so 4096 bytes total
+    static const size_t MIN_BUFFERS = 3;  //!< The PDM peripheral always owns 2 buffers, so at least one more is required
+
+	/**
+	 * @brief Number of DMA buffers discarded because the consumer had not released a buffer for the DMA to use
+	 * 
+	 * @return uint32_t Count since start()
+	 * 
+	 * The PDM peripheral owns a buffer until it's filled, then the consumer owns it until copySamples() or 
+	 * noCopySamples() returns. If there is no free buffer when the peripheral needs one, the samples are 
+	 * discarded and this is incremented. The sequence numbers (getLastSequence()) still advance so the 
+	 * gap shows where samples were lost.
+	 * 
+	 * This works the same way as on the RTL872x.
+	 */
+	uint32_t getOverrunCount() const {
+		return overrunCount;
+	}
 
 
 protected:
@@ -104,6 +121,16 @@ protected:
 	 */
 	virtual bool noCopySamples(std::function<void(void *pSamples, size_t numSamples)>callback);
 
+	/**
+	 * @brief Samples are ready, for waitForSamples()
+	 */
+	virtual bool waitReady() const;
+
+	/**
+	 * @brief Block on the semaphore given by the PDM interrupt, for waitForSamples()
+	 */
+	virtual bool waitSleep(uint32_t timeoutMs);
+
 	/**
 	 * @brief Return the number of int16_t samples that copySamples will copy
 	 * 
@@ -113,25 +140,35 @@ protected:
 	 * that is determined by the MCU type at compile time and does not change. 
 	 * 
 	 * On the nRF52, it's 512 samples (1024 bytes), except in one case: If you set a sample rate of
-	 * 8000 Hz, it will be 256 samples because the hardware only samples at 16000 Hz but the code
-	 * will automatically discard every other sample so there will only be 256 samples.
+	 * 8000 Hz, it will be 256 samples because the hardware only samples at 16000 Hz and the samples
+	 * are filtered and decimated by 2.
 	 */	
 	size_t getNumberOfSamples() const {
-		return BUFFER_SIZE_SAMPLES / copySrcIncrement();
+		return BUFFER_SIZE_SAMPLES / decimator.getFactor();
 	}
 
-protected:
 	/**
-	 * @brief How much to increment src in copySamplesInternal. Used internally.
-	 * 
-	 * @return size_t number of bytes
-	 * 
-	 * This is almost always 1. The exception is if you are using 8000 Hz sampling on the nRF52. In this case,
-	 * every other sample is skipped and the subclass overrides this to return 2.
-	 * 
-	 * Override of virtual method in base class Microphone_PDM_Base
+	 * @brief Get the oldest filled buffer, or NULL if there isn't one. Used internally.
+	 */
+	int16_t *readyBuffer() const;
+
+	/**
+	 * @brief Record the sequence, timestamp, and lateness of the oldest filled buffer before it's passed
+	 * to the consumer, the same as the RTL872x does. Used internally.
+	 */
+	void acquireBuffer();
+
+	/**
+	 * @brief Return the oldest filled buffer to the free pool. Used internally.
 	 */
-	size_t copySrcIncrement() const;
+	void releaseBuffer();
+
+	/**
+	 * @brief Sets the number of buffers allocated by init(). Used internally by withNumBuffers().
+	 *
+	 * @return false if the buffers have already been allocated, in which case the number is unchanged
+	 */
+	bool setNumBuffers(size_t numBuffers);
 
 private:
 	/**
@@ -152,10 +189,20 @@ private:
 	nrf_pdm_freq_t freq = NRF_PDM_FREQ_1032K;		//!< clock frequency
 	nrf_pdm_edge_t edge = NRF_PDM_EDGE_LEFTFALLING; //!< clock edge configuration
 
-	int16_t *currentSampleAvailable = NULL;
-	bool useBufferA = true;							//!< Which buffer we're reading from of the double buffers
-
-	int16_t samples[BUFFER_SIZE_SAMPLES * NUM_BUFFERS];
+	// Buffers are handed to the peripheral, filled, and read in ring order, buffer index is the counter 
+	// modulo numBuffers. The counters only ever increase. numRequested and numReleased are written by
+	// the interrupt handler, numConsumed by the consumer.
+	size_t numBuffers = NUM_BUFFERS;				//!< Number of buffers in samples
+	volatile uint32_t numRequested = 0;				//!< Buffers handed to the PDM peripheral
+	volatile uint32_t numReleased = 0;				//!< Buffers filled by the PDM peripheral
+	volatile uint32_t numConsumed = 0;				//!< Buffers read by the consumer and free again
+	volatile uint32_t nextSequence = 0;				//!< Sequence number for the next filled buffer
+	volatile uint32_t overrunCount = 0;				//!< Buffers discarded since start()
+
+	int16_t *samples = NULL;						//!< numBuffers buffers, followed by the discard buffer
+	uint32_t *sequence = NULL;						//!< Sequence number of each filled buffer
+	uint32_t *timestamp = NULL;						//!< micros() when each buffer was filled
+	os_semaphore_t wakeSemaphore = NULL;			//!< Given by the interrupt handler, taken by waitForSamples()
 };
 
 /**
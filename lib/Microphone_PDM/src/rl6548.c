@@ -616,7 +616,7 @@ void CODEC_SetAdcGain(u32 ad_gain_left, u32 ad_gain_right)
 
 	reg_value = AUDIO_SI_ReadReg(ADC_R_GAIN);
 	reg_value &= ~(0x7f << ADC_R_AD_GAIN);
-	reg_value |= (ad_gain_left << ADC_R_AD_GAIN);
+	reg_value |= (ad_gain_right << ADC_R_AD_GAIN);
 	AUDIO_SI_WriteReg(ADC_R_GAIN, reg_value);
 }
 
@@ -924,7 +924,8 @@ void CODEC_SetALC(u32 limiter_val)
 	AUDIO_SI_WriteReg(ALC_DRC_CTRL, reg_value);
 
 	reg_value = AUDIO_SI_ReadReg(ALC_RATE_CTRL);
-	reg_value |= (limiter_val << 10);
+	reg_value &= ~(0x3f << 10);
+	reg_value |= ((limiter_val & 0x3f) << 10);
 	AUDIO_SI_WriteReg(ALC_RATE_CTRL, reg_value);
 }
 
@@ -676,7 +676,7 @@ void CODEC_MutePlay(u32 mute_lch, u32 mute_rch);
 void CODEC_DeInit(u32 application);
 void CODEC_DacEqConfig(u32 sample_rate);
 void CODEC_SetALC(u32 limiter_val);
-void CODEDC_ALC_deinit();
+void CODEC_ALC_deinit();
 /**
   * @}
   */
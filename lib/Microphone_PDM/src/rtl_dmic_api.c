@@ -3,12 +3,15 @@
 #include "rl6548.h" // RTL standard peripheral audio driver
 
 #include "rtl_dmic_api.h"
+#include "timer_hal.h" // HAL_Timer_Get_Micro_Seconds(), the same clock as micros()
 
 // These should be in rtl8721d_pinmux_defines.h but aren't getting picked up
 #define _PB_1		(0x21)	//0x484 = DMIC_CLK - A0
 #define _PB_2		(0x22)	//0x488 = DMIC_DATA - A1
 
-#define SP_FULL_BUF_SIZE		128
+// Discard buffer used when the consumer owns every page. A whole page, so each sequence number
+// is always SP_DMA_PAGE_SIZE bytes of audio.
+#define SP_FULL_BUF_SIZE		SP_DMA_PAGE_SIZE
 
 typedef struct {
 	GDMA_InitTypeDef       	SpRxGdmaInitStruct;              //Pointer to GDMA_InitTypeDef	
@@ -19,6 +22,8 @@ typedef struct {
 	u8 rx_gdma_own;
 	u32 rx_addr;
 	u32 rx_length;
+	u32 rx_seq;
+	u32 rx_time;	// micros() when the GDMA completed the block
 	
 }RX_BLOCK, *pRX_BLOCK;
 
@@ -28,14 +33,39 @@ typedef struct {
 	u8 rx_gdma_cnt;
 	u8 rx_usr_cnt;
 	u8 rx_full_flag;
+	volatile u32 rx_seq;		// Sequence number of the next block the GDMA completes
+	volatile u32 rx_overruns;	// Blocks discarded because the consumer had no room for them
 	
 }SP_RX_INFO, *pSP_RX_INFO;
 
+typedef struct {
+	u32 addr;
+	u32 length;
+	u32 seq;
+	u32 time;
+}DEST_BLOCK, *pDEST_BLOCK;
+
+// Caller-supplied DMA destinations. The counters only ever increase; the block index is
+// the counter modulo SP_DEST_QUEUE_NUM. queued and released are written by the consumer,
+// started and completed by the GDMA interrupt.
+typedef struct {
+	DEST_BLOCK block[SP_DEST_QUEUE_NUM];
+	volatile u32 queued;
+	volatile u32 started;
+	volatile u32 completed;
+	volatile u32 released;
+	volatile u8 enabled;
+	u8 in_flight;	// The block currently owned by the GDMA is block[started - 1]
+}SP_DEST_INFO, *pSP_DEST_INFO;
+
 
 
 static SP_InitTypeDef SP_InitStruct;
 static SP_GDMA_STRUCT SPGdmaStruct;
 static SP_RX_INFO sp_rx_info;
+static SP_DEST_INFO sp_dest_info;
+static volatile dmic_wake_fn sp_wake_fn = NULL;
+static u32 sp_sample_rate = SR_16K;
 
 
 //The size of this buffer should be multiples of 32 and its head address should align to 32 
@@ -72,13 +102,18 @@ void sp_read_rx_page(u8 *dst, u32 length)
 	}
 }
 
-void sp_release_rx_page(void)
+void sp_release_rx_page(u32 time)
 {
 	pRX_BLOCK prx_block = &(sp_rx_info.rx_block[sp_rx_info.rx_gdma_cnt]);
 	
 	if (sp_rx_info.rx_full_flag){
+		// Block went to sp_full_buf because every page was still owned by the consumer
+		sp_rx_info.rx_overruns++;
+		sp_rx_info.rx_seq++;
 	}
 	else{
+		prx_block->rx_seq = sp_rx_info.rx_seq++;
+		prx_block->rx_time = time;
 		prx_block->rx_gdma_own = 0;
 		sp_rx_info.rx_gdma_cnt++;
 		if (sp_rx_info.rx_gdma_cnt == SP_DMA_PAGE_NUM){
@@ -120,20 +155,59 @@ void sp_rx_complete(void *Data)
 	PGDMA_InitTypeDef GDMA_InitStruct;
 	u32 rx_addr;
 	u32 rx_length;
+	// Taken first, so the time is as close as possible to when the last sample arrived
+	u32 time = HAL_Timer_Get_Micro_Seconds();
 	
 	GDMA_InitStruct = &(gs->SpRxGdmaInitStruct);
-	DCache_Invalidate(GDMA_InitStruct->GDMA_DstAddr, GDMA_InitStruct->GDMA_BlockSize<<2);
 	/* Clear Pending ISR */
 	GDMA_ClearINT(GDMA_InitStruct->GDMA_Index, GDMA_InitStruct->GDMA_ChNum);
 
-	sp_release_rx_page();
-	rx_addr = (u32)sp_get_free_rx_page();
-	rx_length = sp_get_free_rx_length();
+	if (sp_dest_info.in_flight) {
+		// Caller-supplied destination is full. Drop any lines the CPU may have speculatively
+		// loaded while the GDMA was writing so the consumer sees the new samples.
+		pDEST_BLOCK pdest = &(sp_dest_info.block[sp_dest_info.completed % SP_DEST_QUEUE_NUM]);
+		DCache_Invalidate(pdest->addr, pdest->length);
+		pdest->seq = sp_rx_info.rx_seq++;
+		pdest->time = time;
+		sp_dest_info.completed++;
+	}
+	else {
+		DCache_Invalidate(GDMA_InitStruct->GDMA_DstAddr, GDMA_InitStruct->GDMA_BlockSize<<2);
+		sp_release_rx_page(time);
+	}
+
+	if (sp_dest_info.enabled) {
+		if (sp_dest_info.started != sp_dest_info.queued) {
+			pDEST_BLOCK pdest = &(sp_dest_info.block[sp_dest_info.started % SP_DEST_QUEUE_NUM]);
+			rx_addr = pdest->addr;
+			rx_length = pdest->length;
+			sp_dest_info.started++;
+			sp_dest_info.in_flight = 1;
+		}
+		else {
+			// Consumer did not queue a destination in time; discard this block
+			rx_addr = sp_rx_info.rx_full_block.rx_addr;
+			rx_length = sp_rx_info.rx_full_block.rx_length;
+			sp_rx_info.rx_full_flag = 1;
+			sp_dest_info.in_flight = 0;
+		}
+	}
+	else {
+		rx_addr = (u32)sp_get_free_rx_page();
+		rx_length = sp_get_free_rx_length();
+		sp_dest_info.in_flight = 0;
+	}
 	GDMA_SetDstAddr(GDMA_InitStruct->GDMA_Index, GDMA_InitStruct->GDMA_ChNum, rx_addr);
 	GDMA_SetBlkSize(GDMA_InitStruct->GDMA_Index, GDMA_InitStruct->GDMA_ChNum, rx_length>>2);	
 	
 	GDMA_Cmd(GDMA_InitStruct->GDMA_Index, GDMA_InitStruct->GDMA_ChNum, ENABLE);
 	//AUDIO_SP_RXGDMA_Restart(GDMA_InitStruct->GDMA_Index, GDMA_InitStruct->GDMA_ChNum, rx_addr, rx_length);
+
+	// Last, once the GDMA is running again, so a woken consumer sees the completed block
+	dmic_wake_fn wake = sp_wake_fn;
+	if (wake) {
+		wake();
+	}
 }
 
 static void sp_init_hal(pSP_OBJ psp_obj)
@@ -219,6 +293,8 @@ void dmic_setup(int sampleRate, bool stereoMode) {
 			break;
 	}
 
+	sp_sample_rate = sp_obj.sample_rate;
+
 	sp_obj.word_len = WL_16;
 	sp_obj.mono_stereo = stereoMode ? CH_STEREO : CH_MONO;
 	sp_obj.direction = APP_DMIC_IN;
@@ -251,6 +327,57 @@ void dmic_setup(int sampleRate, bool stereoMode) {
     // Particle.connect();
 }
 
+// Call after dmic_setup(), which resets the codec with CODEC_Init(). Every setting in codec is
+// written, so only call it when the application asked for codec settings.
+void dmic_codec_config(const DMIC_CODEC_OBJ *codec) {
+	u32 reg_value;
+	u32 coef = 0;
+
+	if (codec->gain_enable) {
+		CODEC_SetDmicBst(codec->dmic_boost, codec->dmic_boost);
+		CODEC_SetAdcGain(codec->adc_gain & 0x7f, codec->adc_gain & 0x7f);
+	}
+
+	if (codec->limiter_enable) {
+		CODEC_SetALC(codec->limiter_threshold);
+	}
+	else {
+		CODEC_ALC_deinit();
+	}
+
+	// High-pass cutoff follows the sample rate, as CODEC_Init does for the analog inputs
+	if (sp_sample_rate == SR_32K) {
+		coef = 1;
+	}
+
+	reg_value = AUDIO_SI_ReadReg(ADC_DMIC_L_FILTER_CTRL);
+	reg_value &= (0xffff & (~(1 << BIT_ADC_L_AD_DCHPF_EN)));
+	if (codec->high_pass != DMIC_HPF_OFF) {
+		reg_value |= (1 << BIT_ADC_L_AD_DCHPF_EN);
+	}
+	AUDIO_SI_WriteReg(ADC_DMIC_L_FILTER_CTRL, reg_value);
+
+	reg_value = AUDIO_SI_ReadReg(ADC_DMIC_R_FILTER_CTRL);
+	reg_value &= (0xffff & (~(1 << BIT_ADC_R_AD_DCHPF_EN)));
+	if (codec->high_pass != DMIC_HPF_OFF) {
+		reg_value |= (1 << BIT_ADC_R_AD_DCHPF_EN);
+	}
+	AUDIO_SI_WriteReg(ADC_DMIC_R_FILTER_CTRL, reg_value);
+
+	reg_value = AUDIO_SI_ReadReg(ADC_L_CTRL);
+	reg_value &= (0xffff & (~(1 << BIT_ADC_L_ADJ_HPF_2ND_EN | 7 << BIT_ADC_L_ADJ_HPF_COEF_SEL)));
+	if (codec->high_pass == DMIC_HPF_HIGH_PASS) {
+		reg_value |= (1 << BIT_ADC_L_ADJ_HPF_2ND_EN | coef << BIT_ADC_L_ADJ_HPF_COEF_SEL);
+	}
+	AUDIO_SI_WriteReg(ADC_L_CTRL, reg_value);
+
+	reg_value = AUDIO_SI_ReadReg(ADC_R_ADJ_D);
+	reg_value &= (0xffff & (~(1 << BIT_ADC_R_ADJ_HPF_2ND_EN | 7 << BIT_ADC_R_ADJ_HPF_COEF_SEL)));
+	if (codec->high_pass == DMIC_HPF_HIGH_PASS) {
+		reg_value |= (1 << BIT_ADC_R_ADJ_HPF_2ND_EN | coef << BIT_ADC_R_ADJ_HPF_COEF_SEL);
+	}
+	AUDIO_SI_WriteReg(ADC_R_ADJ_D, reg_value);
+}
 
 void dmic_flush() {
 	while(sp_get_ready_rx_page() != NULL) {
@@ -262,10 +389,97 @@ unsigned char *dmic_ready() {
 	return sp_get_ready_rx_page();
 }
 
+unsigned int dmic_ready_count() {
+	unsigned int count = 0;
+	u8 usr_cnt = sp_rx_info.rx_usr_cnt;
+
+	while(count < SP_DMA_PAGE_NUM && !sp_rx_info.rx_block[(usr_cnt + count) % SP_DMA_PAGE_NUM].rx_gdma_own) {
+		count++;
+	}
+	return count;
+}
+
+unsigned int dmic_ready_sequence() {
+	return sp_rx_info.rx_block[sp_rx_info.rx_usr_cnt].rx_seq;
+}
+
+unsigned int dmic_ready_timestamp() {
+	return sp_rx_info.rx_block[sp_rx_info.rx_usr_cnt].rx_time;
+}
+
+unsigned int dmic_overruns() {
+	return sp_rx_info.rx_overruns;
+}
+
 void dmic_read(unsigned char *buf, size_t len) {
 	sp_read_rx_page(buf, len);
 }
 
+void dmic_dest_enable(bool enable) {
+	if (!enable) {
+		// Anything queued but not yet started is abandoned. A block already owned by the
+		// GDMA still completes normally and can be retrieved with dmic_dest_ready().
+		sp_dest_info.queued = sp_dest_info.started;
+	}
+	sp_dest_info.enabled = enable ? 1 : 0;
+}
+
+int dmic_dest_queue(unsigned char *buf, size_t len) {
+	u32 addr = (u32)buf;
+
+	if ((addr % SP_DEST_ALIGN) != 0 || len == 0 || (len % SP_DEST_ALIGN) != 0 || len > SP_DEST_MAX_SIZE) {
+		return -1;
+	}
+	if ((sp_dest_info.queued - sp_dest_info.released) >= SP_DEST_QUEUE_NUM) {
+		return -1;
+	}
+
+	// Write back and drop any cached copy so an eviction can't overwrite what the GDMA stores
+	DCache_CleanInvalidate(addr, len);
+
+	pDEST_BLOCK pdest = &(sp_dest_info.block[sp_dest_info.queued % SP_DEST_QUEUE_NUM]);
+	pdest->addr = addr;
+	pdest->length = len;
+
+	// The block must be visible before the interrupt can see the new count
+	__DMB();
+	sp_dest_info.queued++;
+
+	return 0;
+}
+
+unsigned char *dmic_dest_ready(size_t *len, unsigned int *seq, unsigned int *timestamp) {
+	if (sp_dest_info.released == sp_dest_info.completed) {
+		return NULL;
+	}
+
+	pDEST_BLOCK pdest = &(sp_dest_info.block[sp_dest_info.released % SP_DEST_QUEUE_NUM]);
+	if (len) {
+		*len = pdest->length;
+	}
+	if (seq) {
+		*seq = pdest->seq;
+	}
+	if (timestamp) {
+		*timestamp = pdest->time;
+	}
+	return (unsigned char *)pdest->addr;
+}
+
+unsigned int dmic_dest_ready_count(void) {
+	return sp_dest_info.completed - sp_dest_info.released;
+}
+
+void dmic_dest_release(void) {
+	if (sp_dest_info.released != sp_dest_info.completed) {
+		sp_dest_info.released++;
+	}
+}
+
+void dmic_set_wake_callback(dmic_wake_fn fn) {
+	sp_wake_fn = fn;
+}
+
 
 
 #endif
@@ -7,6 +7,13 @@ extern "C" {
 #define SP_DMA_PAGE_SIZE	512   // 2 ~ 4096
 #define SP_DMA_PAGE_NUM    	4
 
+#define SP_DEST_QUEUE_NUM	32    // Maximum number of caller-supplied destinations queued at once
+#define SP_DEST_ALIGN		32    // Destination address and length alignment (D-cache line size)
+#define SP_DEST_MAX_SIZE	4096  // Largest single destination in bytes
+
+// Called from the GDMA interrupt every time a block completes
+typedef void (*dmic_wake_fn)(void);
+
 typedef struct {
 	unsigned int sample_rate;
 	unsigned int word_len;
@@ -14,11 +21,37 @@ typedef struct {
 	unsigned int direction;	
 }SP_OBJ, *pSP_OBJ;
 
+#define DMIC_HPF_OFF		0     // No DC blocking or high-pass filter
+#define DMIC_HPF_DC_BLOCK	1     // DC blocking filter only
+#define DMIC_HPF_HIGH_PASS	2     // DC blocking and 2nd order high-pass filter (what CODEC_Init sets up)
+
+typedef struct {
+	unsigned int gain_enable;		// Write dmic_boost and adc_gain, otherwise the CODEC_Init values are kept
+	unsigned int dmic_boost;		// 0 to 3: 0, 12, 24, 36 dB
+	unsigned int adc_gain;			// 0x00 (-17.625 dB) to 0x7f (+30 dB) in 0.375 dB steps, 0x2f is 0 dB
+	unsigned int limiter_enable;	// ALC limiter
+	unsigned int limiter_threshold;	// 0x00 (0 dB) to 0x3f (-23.625 dB) in 0.375 dB steps
+	unsigned int high_pass;			// DMIC_HPF_*
+}DMIC_CODEC_OBJ, *pDMIC_CODEC_OBJ;
+
 void dmic_setup(int sampleRate, bool stereoMode);
+void dmic_codec_config(const DMIC_CODEC_OBJ *codec);
 
 void dmic_flush();
 unsigned char *dmic_ready();
 void dmic_read(unsigned char *buf, size_t len);
+unsigned int dmic_ready_count();
+unsigned int dmic_ready_sequence();
+unsigned int dmic_ready_timestamp();
+unsigned int dmic_overruns();
+
+void dmic_dest_enable(bool enable);
+int dmic_dest_queue(unsigned char *buf, size_t len);
+unsigned char *dmic_dest_ready(size_t *len, unsigned int *seq, unsigned int *timestamp);
+unsigned int dmic_dest_ready_count(void);
+void dmic_dest_release(void);
+
+void dmic_set_wake_callback(dmic_wake_fn fn);
 
 
 #ifdef __cplusplus
@@ -6,6 +6,11 @@ CFLAGS+= -DEIDSP_USE_CMSIS_DSP=1
 CFLAGS+= -D__STATIC_FORCEINLINE="__attribute__((always_inline)) static inline"
 CFLAGS+= -DEI_PORTING_PARTICLE=1
 CFLAGS+= -DEIDSP_LOAD_CMSIS_DSP_SOURCES=1
+# keep the int8 classifier output, it changes ei_impulse_result_t so it has to be set for all sources
+CFLAGS+= -DEI_CLASSIFIER_QUANTIZED_POSTPROCESSING=1
+# ei_printf and the predictions go through the telemetry ring, drained by a low priority thread.
+# This makes ei_printf asynchronous for all sources, see "Serial output" in README.md
+CFLAGS+= -DEI_CLASSIFIER_TELEMETRY=1
 
 # add C and CPP files - if USRSRC is not empty, then add a slash
 CPPSRC += $(call target_files,$(USRSRC_SLASH),*.cpp)
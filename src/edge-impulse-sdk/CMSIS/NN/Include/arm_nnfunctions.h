@@ -274,6 +274,38 @@ extern "C"
      */
     int32_t arm_convolve_s8_get_buffer_size(const cmsis_nn_dims *input_dims, const cmsis_nn_dims *filter_dims);
 
+    /**
+     * @brief s8 convolution function with pre-packed weights
+     * @param[in, out] ctx            Function context, the buffer is the same as for arm_convolve_s8 and
+     *                                arm_convolve_s8_get_buffer_size returns its size
+     * @param[in]      filter_data    Filter data pointer, in the packed layout. Data type: int8
+     *
+     * For the other arguments, refer arm_convolve_s8.
+     *
+     * @return     The function returns <code>ARM_MATH_SUCCESS</code>, or <code>ARM_MATH_ARGUMENT_ERROR</code>
+     *             if the DSP extension is not available (or MVE is)
+     *
+     * @details
+     *    1. Each row of the filter (one output channel, HK * WK * C_IN weights) is stored in groups of four,
+     *       with the middle two weights of each group swapped: [w0, w2, w1, w3]. The last
+     *       (HK * WK * C_IN) % 4 weights of the row are not changed. SXTB16 then gives the q15 pairs
+     *       [w0, w1] and [w2, w3] directly, so the weights don't have to be reordered on every invoke.
+     *    2. The layout is for little endian targets. It's produced offline, with the compiled model.
+     *    3. Dilation is not supported, the same as arm_convolve_s8.
+     *
+     */
+    arm_status arm_convolve_s8_packed(const cmsis_nn_context *ctx,
+                                      const cmsis_nn_conv_params *conv_params,
+                                      const cmsis_nn_per_channel_quant_params *quant_params,
+                                      const cmsis_nn_dims *input_dims,
+                                      const q7_t *input_data,
+                                      const cmsis_nn_dims *filter_dims,
+                                      const q7_t *filter_data,
+                                      const cmsis_nn_dims *bias_dims,
+                                      const int32_t *bias_data,
+                                      const cmsis_nn_dims *output_dims,
+                                      q7_t *output_data);
+
     /**
      * @brief Basic Q7 convolution function
      * @param[in]       Im_in       pointer to input tensor
@@ -1364,6 +1396,25 @@ extern "C"
                                         const int32_t *const output_bias,
                                         q7_t *out_0);
 
+    /**
+     * @brief Matrix-multiplication function for convolution with pre-packed weights.
+     *
+     * @details  For arguments, refer arm_nn_mat_mult_kernel_s8_s16. input_a is in the packed layout
+     *           described for arm_convolve_s8_packed. Returns NULL if the DSP extension is not available.
+     *
+     */
+    q7_t *arm_nn_mat_mult_kernel_s8_s16_packed(const q7_t *input_a,
+                                               const q15_t *input_b,
+                                               const uint16_t output_ch,
+                                               const int32_t *out_shift,
+                                               const int32_t *out_mult,
+                                               const int32_t out_offset,
+                                               const int16_t activation_min,
+                                               const int16_t activation_max,
+                                               const uint16_t num_col_a,
+                                               const int32_t *const output_bias,
+                                               q7_t *out_0);
+
     /**
      * @brief Matrix-multiplication of re-ordered input B with A.
      *
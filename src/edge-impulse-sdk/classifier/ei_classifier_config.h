@@ -79,6 +79,83 @@
     #endif // ESP32 check
 #endif
 
+// SIMD int8 conv / fully connected / max pool for host builds (compile with -msse4.1 or -mavx2). Only
+// used when no other kernel backend above is enabled. The NEON path hasn't been through
+// tools/ei_host_simd_sweep.cpp yet, so on NEON targets it's opt-in (define this to 1).
+#ifndef EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD
+    #if defined(__AVX2__) || defined(__SSE4_1__)
+        #define EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD   1
+    #else
+        #define EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD   0
+    #endif
+#endif // EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD
+
+// Use conv / fully connected weights that the compiled model packed offline for the CMSIS-NN DSP kernels
+// (see packed_weights.h). Only the DSP path (not MVE) has packed kernels.
+#ifndef EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS
+    #if EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN == 1 && defined(__ARM_FEATURE_DSP) && !defined(__ARM_FEATURE_MVE)
+        #define EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS     1
+    #else
+        #define EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS     0
+    #endif
+#endif // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS
+
+// Run conv / fully connected layers that the compiled model stores block-sparse (pruned weights with
+// the zero blocks left out, see packed_weights.h) with the sparse kernels. Only the CMSIS-NN and the
+// reference kernels have them, other backends get the dense weights.
+#ifndef EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS
+    #if EI_CLASSIFIER_TFLITE_ENABLE_ARC == 1 || EI_CLASSIFIER_TFLITE_ENABLE_SILABS_MVP == 1 || EI_CLASSIFIER_TFLITE_ENABLE_ESP_NN == 1
+        #define EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS     0
+    #else
+        #define EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS     1
+    #endif
+#endif // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS
+
+// Size of the static region shared by DSP scratch and the NN tensor arena (see ei_scratch_arena.h),
+// 0 keeps using the heap for both
+#ifndef EI_CLASSIFIER_SCRATCH_ARENA_SIZE
+#define EI_CLASSIFIER_SCRATCH_ARENA_SIZE            0
+#endif
+
+// Keep the TFLite Micro interpreter, arena and op resolver between inferences (non-EON models only),
+// release them with ei_tflite_resident_release() or run_classifier_deinit(). The resident arena is
+// taken from the heap, not from the scratch arena.
+#ifndef EI_CLASSIFIER_TFLITE_RESIDENT
+#define EI_CLASSIFIER_TFLITE_RESIDENT               0
+#endif
+
+// Number of graphs that can be resident at the same time, others are set up on every inference
+#ifndef EI_CLASSIFIER_TFLITE_RESIDENT_MAX_GRAPHS
+#define EI_CLASSIFIER_TFLITE_RESIDENT_MAX_GRAPHS    2
+#endif
+
+// Measure every node of the compiled (EON) graph and aggregate per op type (see ei_node_profiler.h)
+#ifndef EI_CLASSIFIER_NODE_PROFILER
+#define EI_CLASSIFIER_NODE_PROFILER                 0
+#endif
+
+// Number of op types the node profiler keeps statistics for
+#ifndef EI_CLASSIFIER_NODE_PROFILER_MAX_OPS
+#define EI_CLASSIFIER_NODE_PROFILER_MAX_OPS         8
+#endif
+
+// Keep quantized (int8) classifier outputs in the result and only dequantize them when asked for,
+// see ei_quantized_results.h. Changes ei_impulse_result_t, so set it for every translation unit.
+#ifndef EI_CLASSIFIER_QUANTIZED_POSTPROCESSING
+#define EI_CLASSIFIER_QUANTIZED_POSTPROCESSING      0
+#endif
+
+// Send ei_printf() text and debug features through the lock-free telemetry ring instead of
+// writing to the serial port from the inference loop (see ei_telemetry.h)
+#ifndef EI_CLASSIFIER_TELEMETRY
+#define EI_CLASSIFIER_TELEMETRY                     0
+#endif
+
+// Size of the telemetry ring in bytes, a power of two
+#ifndef EI_CLASSIFIER_TELEMETRY_SIZE
+#define EI_CLASSIFIER_TELEMETRY_SIZE                4096
+#endif
+
 // no include checks in the compiler? then just include metadata and then ops_define (optional if on EON model)
 #ifndef __has_include
     #include "model-parameters/model_metadata.h"
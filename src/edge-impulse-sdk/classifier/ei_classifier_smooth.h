@@ -21,6 +21,7 @@
 #if EI_CLASSIFIER_OBJECT_DETECTION != 1
 
 #include <stdint.h>
+#include "edge-impulse-sdk/classifier/ei_quantized_results.h"
 
 typedef struct ei_classifier_smooth {
     int *last_readings;
@@ -72,6 +73,9 @@ const char* ei_classifier_smooth_update(ei_classifier_smooth_t *smooth, ei_impul
 
     int reading = -1; // uncertain
 
+    // compares against the float values
+    ei_quantized_dequantize(result);
+
     // print the predictions
     // printf("[");
     for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
@@ -19,8 +19,10 @@
 #define _EDGE_IMPULSE_RUN_CLASSIFIER_TYPES_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 // needed for standalone C example
 #include "model-parameters/model_metadata.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
 
 #ifndef EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT
 #define EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT 10
@@ -54,12 +56,42 @@ typedef struct {
     int64_t anomaly_us;
 } ei_impulse_result_timing_t;
 
+/**
+ * Time spent in one op type of the compiled (EON) graph, see ei_node_profiler.h.
+ * Times are in counter ticks: core cycles on Cortex-M, TSC ticks on x86, nanoseconds elsewhere.
+ */
+typedef struct {
+    const char *op_name;
+    uint32_t count;         // number of node invocations measured
+    uint32_t min;
+    uint32_t max;
+    uint32_t mean;
+    uint32_t p99;           // upper bound of its histogram bucket, at most 25% above the real value
+    uint64_t total;
+} ei_impulse_result_node_timing_t;
+
+/**
+ * Raw output of a quantized classifier, see ei_quantized_results.h.
+ * value[ix] dequantizes to (value[ix] - zero_point) * scale.
+ */
+typedef struct {
+    int8_t value[EI_CLASSIFIER_MAX_LABELS_COUNT];
+    uint32_t count;
+    float scale;
+    int32_t zero_point;
+    bool valid;             // the output was quantized and value[] is filled in
+    bool dequantized;       // classification[].value is up to date with value[]
+} ei_impulse_result_quantized_t;
+
 typedef struct {
     ei_impulse_result_bounding_box_t *bounding_boxes;
     uint32_t bounding_boxes_count;
     ei_impulse_result_classification_t classification[EI_CLASSIFIER_MAX_LABELS_COUNT];
     float anomaly;
     ei_impulse_result_timing_t timing;
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    ei_impulse_result_quantized_t quantized;
+#endif
 } ei_impulse_result_t;
 
 #endif // _EDGE_IMPULSE_RUN_CLASSIFIER_TYPES_H_
@@ -329,6 +329,24 @@ __attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_i8(const ei_i
                                                                       float zero_point,
                                                                       float scale,
                                                                       bool debug) {
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    // Only keep the raw output, ei_quantized_dequantize() fills in the values when they're needed
+    for (uint32_t ix = 0; ix < impulse->label_count; ix++) {
+        result->quantized.value[ix] = data[ix];
+        result->classification[ix].label = impulse->categories[ix];
+    }
+    result->quantized.count = impulse->label_count;
+    result->quantized.scale = scale;
+    result->quantized.zero_point = static_cast<int32_t>(zero_point);
+    result->quantized.valid = true;
+    // with debug on the values are printed, and filled in, below
+    result->quantized.dequantized = debug;
+
+    if (!debug) {
+        return EI_IMPULSE_OK;
+    }
+#endif
+
     for (uint32_t ix = 0; ix < impulse->label_count; ix++) {
         float value = static_cast<float>(data[ix] - zero_point) * scale;
 
@@ -351,6 +369,10 @@ __attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_f32(const ei_
                                                                        ei_impulse_result_t *result,
                                                                        float *data,
                                                                        bool debug) {
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    result->quantized.valid = false;
+#endif
+
     for (uint32_t ix = 0; ix < impulse->label_count; ix++) {
         float value = data[ix];
 
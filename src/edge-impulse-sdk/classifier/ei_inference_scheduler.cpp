@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "edge-impulse-sdk/classifier/ei_inference_scheduler.h"
+#include "edge-impulse-sdk/classifier/ei_quantized_results.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include <string.h>
+
+// Weight of a new measurement in the average DSP and NN times
+#define EI_SCHEDULER_AVG_WEIGHT     0.125f
+
+static bool enabled = false;
+static ei_scheduler_config_t config;
+
+static uint32_t hop = 1;
+static uint32_t slices_to_next = 0;     // slices to skip before the next inference
+static uint32_t quiet_count = 0;
+static bool last_inferred = false;
+
+static uint32_t slice_count = 0;
+static uint32_t inference_count = 0;
+static uint64_t audio_us = 0;
+static uint64_t busy_us = 0;
+static float avg_dsp_us = 0.f;
+static float avg_nn_us = 0.f;
+static uint32_t last_slice_us = 0;
+
+static void update_average(float *avg, int64_t us, bool first) {
+    if (first) {
+        *avg = (float)us;
+    }
+    else {
+        *avg += ((float)us - *avg) * EI_SCHEDULER_AVG_WEIGHT;
+    }
+}
+
+/**
+ * Smallest hop that keeps the DSP (every slice) and NN (every hop slices) time within the budget
+ */
+static uint32_t budget_hop(void) {
+    if (config.cpu_budget_pct == 0 || inference_count == 0 || last_slice_us == 0) {
+        return 1;
+    }
+
+    float budget_us = (float)last_slice_us * (float)config.cpu_budget_pct / 100.f;
+    float nn_room_us = budget_us - avg_dsp_us;
+    if (nn_room_us <= 0.f) {
+        return config.max_hop_slices;
+    }
+
+    float min_hop = avg_nn_us / nn_room_us;
+    if (min_hop >= (float)config.max_hop_slices) {
+        return config.max_hop_slices;
+    }
+    uint32_t h = (uint32_t)min_hop;
+    return ((float)h < min_hop) ? h + 1 : (h > 0 ? h : 1);
+}
+
+void ei_scheduler_configure(const ei_scheduler_config_t *new_config) {
+    if (!new_config) {
+        enabled = false;
+        ei_scheduler_reset();
+        return;
+    }
+
+    config = *new_config;
+    if (config.min_hop_slices == 0) {
+        config.min_hop_slices = 1;
+    }
+    if (config.max_hop_slices < config.min_hop_slices) {
+        config.max_hop_slices = config.min_hop_slices;
+    }
+    if (config.quiet_inferences == 0) {
+        config.quiet_inferences = 1;
+    }
+    enabled = true;
+    ei_scheduler_reset();
+}
+
+void ei_scheduler_reset(void) {
+    hop = 1;
+    if (enabled) {
+        hop = config.start_hop_slices;
+        if (hop < config.min_hop_slices) {
+            hop = config.min_hop_slices;
+        }
+        if (hop > config.max_hop_slices) {
+            hop = config.max_hop_slices;
+        }
+    }
+    slices_to_next = 0;
+    quiet_count = 0;
+    last_inferred = false;
+
+    slice_count = 0;
+    inference_count = 0;
+    audio_us = 0;
+    busy_us = 0;
+    avg_dsp_us = 0.f;
+    avg_nn_us = 0.f;
+}
+
+bool ei_scheduler_next_slice(uint32_t slice_us, int64_t dsp_us) {
+    update_average(&avg_dsp_us, dsp_us, slice_count == 0);
+    slice_count++;
+    audio_us += slice_us;
+    busy_us += (uint64_t)dsp_us;
+    last_slice_us = slice_us;
+
+    if (!enabled || slices_to_next == 0) {
+        last_inferred = true;
+        return true;
+    }
+
+    slices_to_next--;
+    last_inferred = false;
+    return false;
+}
+
+/**
+ * Score of the target label, or the highest score. Reads the raw output of a quantized
+ * classifier directly, so it doesn't have to be dequantized for this.
+ */
+static float target_score(const ei_impulse_result_t *result, uint32_t label_count) {
+    float score = 0.f;
+    for (uint32_t ix = 0; ix < label_count; ix++) {
+        if (config.target_label >= 0 && (uint32_t)config.target_label != ix) {
+            continue;
+        }
+        float value = ei_quantized_value(result, ix);
+        if (value > score) {
+            score = value;
+        }
+    }
+    return score;
+}
+
+void ei_scheduler_inferred(const ei_impulse_result_t *result, uint32_t label_count, int64_t nn_us) {
+    update_average(&avg_nn_us, nn_us, inference_count == 0);
+    inference_count++;
+    busy_us += (uint64_t)nn_us;
+
+    if (!enabled) {
+        return;
+    }
+
+    float score = target_score(result, label_count);
+
+    if (score >= config.near_miss_threshold) {
+        hop = config.min_hop_slices;
+        quiet_count = 0;
+    }
+    else if (score < config.quiet_threshold) {
+        if (++quiet_count >= config.quiet_inferences) {
+            hop = (hop * 2 > config.max_hop_slices) ? config.max_hop_slices : hop * 2;
+            quiet_count = 0;
+        }
+    }
+    else {
+        hop = (hop / 2 < config.min_hop_slices) ? config.min_hop_slices : hop / 2;
+        quiet_count = 0;
+    }
+
+    uint32_t hop_for_budget = budget_hop();
+    if (hop < hop_for_budget) {
+        hop = hop_for_budget;
+    }
+
+    slices_to_next = hop - 1;
+}
+
+bool ei_scheduler_last_slice_inferred(void) {
+    return last_inferred;
+}
+
+void ei_scheduler_get_stats(ei_scheduler_stats_t *stats) {
+    memset(stats, 0, sizeof(ei_scheduler_stats_t));
+
+    stats->hop_slices = enabled ? hop : 1;
+    stats->slices = slice_count;
+    stats->inferences = inference_count;
+    if (slice_count > 0) {
+        stats->duty_cycle = (float)inference_count / (float)slice_count;
+    }
+    if (audio_us > 0) {
+        stats->cpu_load = (float)busy_us / (float)audio_us;
+    }
+    stats->avg_dsp_us = avg_dsp_us;
+    stats->avg_nn_us = avg_nn_us;
+}
+
+void ei_scheduler_print_stats(void) {
+    ei_scheduler_stats_t stats;
+    ei_scheduler_get_stats(&stats);
+
+    ei_printf("Scheduler: hop %u slices, %u of %u slices inferred (duty cycle %u%%), CPU load %u%%, "
+        "DSP %u us/slice, NN %u us\n",
+        (unsigned int)stats.hop_slices, (unsigned int)stats.inferences, (unsigned int)stats.slices,
+        (unsigned int)(stats.duty_cycle * 100.f + 0.5f), (unsigned int)(stats.cpu_load * 100.f + 0.5f),
+        (unsigned int)stats.avg_dsp_us, (unsigned int)stats.avg_nn_us);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCE_SCHEDULER_H_
+#define _EI_CLASSIFIER_INFERENCE_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+
+/**
+ * Adaptive inference rate for run_classifier_continuous().
+ *
+ * Every slice passed to run_classifier_continuous() still goes through the DSP block, so the
+ * MFCC / MFE / spectrogram frames and the feature window stay in sync with the audio. The
+ * scheduler only decides after how many slices (the hop) the NN runs again:
+ *
+ *  - a score of the target label at or above near_miss_threshold drops the hop to min_hop_slices
+ *  - quiet_inferences scores in a row below quiet_threshold double the hop, up to max_hop_slices
+ *  - anything in between halves the hop, but not below min_hop_slices
+ *  - with cpu_budget_pct set, the hop is raised until the average DSP and NN time fits in that
+ *    share of the audio time
+ *
+ * The shortest hop is one slice, so set EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW for the fastest
+ * rate that's needed. For a slice without inference, run_classifier_continuous() returns the
+ * result of the last inference again, ei_scheduler_last_slice_inferred() tells them apart.
+ * Performance calibration still runs on every slice, with the scores of the last inference on
+ * the skipped ones, so its averaging window and suppression time stay the configured duration.
+ *
+ * Until ei_scheduler_configure() is called the NN runs on every slice, as before.
+ */
+
+typedef struct {
+    int32_t target_label;           // label whose score sets the rate, -1 for the highest score
+    uint32_t min_hop_slices;        // hop after a near miss
+    uint32_t start_hop_slices;      // hop after configuring, and after run_classifier_init()
+    uint32_t max_hop_slices;        // hop when it's quiet
+    float quiet_threshold;          // scores below this are quiet
+    float near_miss_threshold;      // scores at or above this are near misses
+    uint32_t quiet_inferences;      // quiet inferences in a row before the hop doubles
+    uint32_t cpu_budget_pct;        // share of the audio time for DSP and NN, 0 for no limit
+} ei_scheduler_config_t;
+
+typedef struct {
+    uint32_t hop_slices;            // current hop
+    uint32_t slices;                // slices seen
+    uint32_t inferences;            // slices that ran the NN
+    float duty_cycle;               // inferences / slices
+    float cpu_load;                 // DSP and NN time / audio time
+    float avg_dsp_us;               // average DSP time of a slice
+    float avg_nn_us;                // average time of an inference
+} ei_scheduler_stats_t;
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C" {
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+/**
+ * Enable the scheduler, or pass NULL to run the NN on every slice again. Resets the statistics.
+ */
+void ei_scheduler_configure(const ei_scheduler_config_t *config);
+
+/**
+ * Go back to the start hop and clear the statistics, called from run_classifier_init()
+ */
+void ei_scheduler_reset(void);
+
+/**
+ * Count a slice that went through the DSP block
+ * @param slice_us Duration of the audio in the slice
+ * @param dsp_us Time the DSP took for it
+ * @returns true if the NN should run on this slice
+ */
+bool ei_scheduler_next_slice(uint32_t slice_us, int64_t dsp_us);
+
+/**
+ * Report an inference, after ei_scheduler_next_slice() returned true
+ * @param result Result of the inference, before performance calibration
+ * @param label_count Number of labels in the result
+ * @param nn_us Time the inference took
+ */
+void ei_scheduler_inferred(const ei_impulse_result_t *result, uint32_t label_count, int64_t nn_us);
+
+/**
+ * Whether the last slice ran the NN, or returned the previous result again
+ */
+bool ei_scheduler_last_slice_inferred(void);
+
+/**
+ * Fill in the statistics since the last reset
+ */
+void ei_scheduler_get_stats(ei_scheduler_stats_t *stats);
+
+/**
+ * Print the statistics with ei_printf
+ */
+void ei_scheduler_print_stats(void);
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+}
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+#endif // _EI_CLASSIFIER_INFERENCE_SCHEDULER_H_
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "edge-impulse-sdk/classifier/ei_node_profiler.h"
+
+#if EI_CLASSIFIER_NODE_PROFILER == 1
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include <string.h>
+
+// Log-linear histogram: values below 4 have their own bucket, above that every power of two is
+// split into 4 buckets. That covers 32 bit values in 124 buckets with at most 25% error.
+#define HISTOGRAM_SUB_BUCKETS   4
+#define HISTOGRAM_BUCKETS       124
+
+typedef struct {
+    const char *op_name;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint16_t histogram[HISTOGRAM_BUCKETS];
+} node_stats_t;
+
+static node_stats_t stats[EI_CLASSIFIER_NODE_PROFILER_MAX_OPS];
+
+static int highest_bit(uint32_t value) {
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+static size_t bucket_index(uint32_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+    int bit = highest_bit(value);
+    uint32_t sub = (value >> (bit - 2)) & (HISTOGRAM_SUB_BUCKETS - 1);
+    return (size_t)(bit - 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+static uint32_t bucket_upper_bound(size_t index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return (uint32_t)index;
+    }
+    int bit = (int)(index / HISTOGRAM_SUB_BUCKETS) + 1;
+    uint64_t sub = index % HISTOGRAM_SUB_BUCKETS;
+    return (uint32_t)((((uint64_t)HISTOGRAM_SUB_BUCKETS + sub + 1) << (bit - 2)) - 1);
+}
+
+void ei_node_profiler_init(void) {
+#if defined(EI_NODE_PROFILER_DWT)
+    // TRCENA, then CYCCNTENA
+    EI_NODE_PROFILER_DEMCR |= (1u << 24);
+    EI_NODE_PROFILER_DWT_CTRL |= 1u;
+#endif
+}
+
+void ei_node_profiler_record(uint32_t op_index, const char *op_name, uint32_t ticks) {
+    if (op_index >= EI_CLASSIFIER_NODE_PROFILER_MAX_OPS) {
+        return;
+    }
+
+    node_stats_t *s = &stats[op_index];
+    if (s->count == 0 || ticks < s->min) {
+        s->min = ticks;
+    }
+    if (ticks > s->max) {
+        s->max = ticks;
+    }
+    s->op_name = op_name;
+    s->count++;
+    s->total += ticks;
+
+    uint16_t *bucket = &s->histogram[bucket_index(ticks)];
+    if (*bucket == UINT16_MAX) {
+        // Halve every bucket, which keeps the shape of the distribution
+        for (size_t ix = 0; ix < HISTOGRAM_BUCKETS; ix++) {
+            s->histogram[ix] = (s->histogram[ix] + 1) / 2;
+        }
+    }
+    (*bucket)++;
+}
+
+size_t ei_node_profiler_get(ei_impulse_result_node_timing_t *timing, size_t max_count) {
+    size_t count = 0;
+
+    for (size_t op = 0; op < EI_CLASSIFIER_NODE_PROFILER_MAX_OPS && count < max_count; op++) {
+        const node_stats_t *s = &stats[op];
+        if (s->count == 0) {
+            continue;
+        }
+
+        ei_impulse_result_node_timing_t *t = &timing[count++];
+        t->op_name = s->op_name;
+        t->count = s->count;
+        t->min = s->min;
+        t->max = s->max;
+        t->total = s->total;
+        t->mean = (uint32_t)(s->total / s->count);
+
+        uint64_t in_histogram = 0;
+        for (size_t ix = 0; ix < HISTOGRAM_BUCKETS; ix++) {
+            in_histogram += s->histogram[ix];
+        }
+
+        // First bucket where at least 99% of the invocations are at or below
+        uint64_t seen = 0;
+        t->p99 = s->max;
+        for (size_t ix = 0; ix < HISTOGRAM_BUCKETS; ix++) {
+            seen += s->histogram[ix];
+            if (seen * 100 >= in_histogram * 99) {
+                uint32_t bound = bucket_upper_bound(ix);
+                t->p99 = bound < s->max ? bound : s->max;
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+void ei_node_profiler_reset(void) {
+    memset(stats, 0, sizeof(stats));
+}
+
+void ei_node_profiler_print(void) {
+    ei_impulse_result_node_timing_t timing[EI_CLASSIFIER_NODE_PROFILER_MAX_OPS];
+    size_t count = ei_node_profiler_get(timing, EI_CLASSIFIER_NODE_PROFILER_MAX_OPS);
+
+    ei_printf("Node timing per op type (ticks):\n");
+    for (size_t ix = 0; ix < count; ix++) {
+        ei_printf("    %s: n=%u min=%u mean=%u max=%u p99=%u\n",
+            timing[ix].op_name ? timing[ix].op_name : "?",
+            (unsigned int)timing[ix].count, (unsigned int)timing[ix].min, (unsigned int)timing[ix].mean,
+            (unsigned int)timing[ix].max, (unsigned int)timing[ix].p99);
+    }
+}
+
+#endif // EI_CLASSIFIER_NODE_PROFILER == 1
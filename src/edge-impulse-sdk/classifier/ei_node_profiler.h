@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_NODE_PROFILER_H_
+#define _EI_CLASSIFIER_NODE_PROFILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+
+/**
+ * Per-node profiler for the compiled (EON) graph.
+ *
+ * With EI_CLASSIFIER_NODE_PROFILER=1 trained_model_invoke() reads a cycle counter around every
+ * node and adds the difference to the statistics of the node's op type. Recording is a few
+ * additions and a histogram increment, nothing is printed while the graph runs. Read the
+ * statistics afterwards with ei_node_profiler_get() or ei_node_profiler_print().
+ *
+ * The counter is the DWT cycle counter on Cortex-M3/M4/M7/M33, the TSC on x86 and
+ * clock_gettime(CLOCK_MONOTONIC) in nanoseconds on other hosts. It's 32 bits, so a single node
+ * must take less than 2^32 ticks.
+ *
+ * With EI_CLASSIFIER_NODE_PROFILER=0 the calls in the generated code are compiled out.
+ */
+
+#if EI_CLASSIFIER_NODE_PROFILER == 1
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+#define EI_NODE_PROFILER_DWT            1
+#define EI_NODE_PROFILER_DEMCR          (*(volatile uint32_t *)0xE000EDFCu)
+#define EI_NODE_PROFILER_DWT_CTRL       (*(volatile uint32_t *)0xE0001000u)
+#define EI_NODE_PROFILER_DWT_CYCCNT     (*(volatile uint32_t *)0xE0001004u)
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C" {
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+/**
+ * Start the cycle counter if the core needs it, called from the model init
+ */
+void ei_node_profiler_init(void);
+
+/**
+ * Add one node invocation to the statistics of its op type
+ * @param op_index Index of the op type in the graph
+ * @param op_name Name of the op type, must stay valid (a string literal)
+ * @param ticks Counter ticks the node took
+ */
+void ei_node_profiler_record(uint32_t op_index, const char *op_name, uint32_t ticks);
+
+/**
+ * Get the statistics per op type
+ * @param timing Filled in, one entry per op type that ran
+ * @param max_count Number of entries in timing
+ * @returns Number of entries filled in
+ */
+size_t ei_node_profiler_get(ei_impulse_result_node_timing_t *timing, size_t max_count);
+
+/**
+ * Clear the statistics, e.g. to leave out the first (cold cache) inference
+ */
+void ei_node_profiler_reset(void);
+
+/**
+ * Print the statistics with ei_printf
+ */
+void ei_node_profiler_print(void);
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+}
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+/**
+ * Read the counter
+ */
+static inline uint32_t ei_node_profiler_ticks(void) {
+#if defined(EI_NODE_PROFILER_DWT)
+    return EI_NODE_PROFILER_DWT_CYCCNT;
+#elif defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+#endif // EI_CLASSIFIER_NODE_PROFILER == 1
+
+#endif // _EI_CLASSIFIER_NODE_PROFILER_H_
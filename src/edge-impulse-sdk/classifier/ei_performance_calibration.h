@@ -22,6 +22,8 @@
 #include "edge-impulse-sdk/dsp/numpy_types.h"
 #include "edge-impulse-sdk/dsp/returntypes.hpp"
 #include "ei_model_types.h"
+#include "ei_classifier_config.h"
+#include <math.h>
 
 /* Private const types ----------------------------------------------------- */
 #define MEM_ERROR   "ERR: Failed to allocate memory for performance calibration\r\n"
@@ -40,6 +42,13 @@ public:
     {
         this->_score_array = nullptr;
         this->_running_sum = nullptr;
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+        this->_score_array_q = nullptr;
+        this->_running_sum_q = nullptr;
+        this->_threshold_sum_q = nullptr;
+        this->_scale_q = 0.f;
+        this->_zero_point_q = 0;
+#endif
         this->_detection_threshold = config->detection_threshold;
         this->_suppression_flags = config->suppression_flags;
         this->_should_boost = config->is_configured;
@@ -92,6 +101,20 @@ public:
             return;
         }
 
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+        /* Raw int8 scores, their running sums (relative to the zero point) and the sum each
+           number of averaged scores needs to reach the detection threshold */
+        this->_score_array_q = (int8_t *)ei_calloc(
+            this->_average_window_duration_samples * this->_n_labels, sizeof(int8_t));
+        this->_running_sum_q = (int32_t *)ei_calloc(this->_n_labels, sizeof(int32_t));
+        this->_threshold_sum_q = (int32_t *)ei_calloc(this->_average_window_duration_samples, sizeof(int32_t));
+
+        if (this->_score_array_q == NULL || this->_running_sum_q == NULL || this->_threshold_sum_q == NULL) {
+            ei_printf(MEM_ERROR);
+            return;
+        }
+#endif
+
         this->_suppression_count = this->_suppression_samples;
         this->_n_scores_in_array = 0;
     }
@@ -104,6 +127,17 @@ public:
         if (this->_running_sum) {
             ei_free((void *)this->_running_sum);
         }
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+        if (this->_score_array_q) {
+            ei_free((void *)this->_score_array_q);
+        }
+        if (this->_running_sum_q) {
+            ei_free((void *)this->_running_sum_q);
+        }
+        if (this->_threshold_sum_q) {
+            ei_free((void *)this->_threshold_sum_q);
+        }
+#endif
     }
 
     bool should_boost()
@@ -171,6 +205,83 @@ public:
         return recognized_event;
     };
 
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    /**
+     * Same as trigger(), on the raw int8 scores. The averages are written back to scores->value,
+     * rounded to the nearest int8 value, and the threshold is compared against the exact sums.
+     * Don't mix calls to both versions on the same object, they keep separate histories.
+     */
+    int32_t trigger(ei_impulse_result_quantized_t *scores)
+    {
+        int32_t recognized_event = EI_PC_RET_NO_EVENT_DETECTED;
+        int32_t current_top_sum = 0;
+        uint32_t current_top_index = 0;
+
+        /* Check pointers */
+        if (this->_score_array_q == NULL || this->_running_sum_q == NULL || this->_threshold_sum_q == NULL) {
+            return EI_PC_RET_MEMORY_ERROR;
+        }
+
+        /* Convert the threshold once, the output quantization doesn't change */
+        if (scores->scale != this->_scale_q || scores->zero_point != this->_zero_point_q) {
+            this->set_quantization(scores->scale, scores->zero_point);
+        }
+
+        /* Update the score array and running sum */
+        int8_t *slot = &this->_score_array_q[this->_score_idx * this->_n_labels];
+        for (uint32_t i = 0; i < this->_n_labels; i++) {
+            this->_running_sum_q[i] += (int32_t)scores->value[i] - (int32_t)slot[i];
+            slot[i] = scores->value[i];
+        }
+
+        if (++this->_score_idx >= this->_average_window_duration_samples) {
+            this->_score_idx = 0;
+        }
+
+        /* Number of samples to average, increases until the buffer is full */
+        if (this->_n_scores_in_array < this->_average_window_duration_samples) {
+            this->_n_scores_in_array++;
+        }
+
+        /* Average data and place in scores & determine top score. All labels are averaged over
+           the same number of scores, so the sums can be compared directly. */
+        const int32_t n = (int32_t)this->_n_scores_in_array;
+        for (uint32_t i = 0; i < this->_n_labels; i++) {
+            int32_t sum = this->_running_sum_q[i];
+            int32_t avg = this->_zero_point_q + (sum >= 0 ? (sum + n / 2) / n : -((-sum + n / 2) / n));
+            scores->value[i] = (int8_t)(avg < -128 ? -128 : (avg > 127 ? 127 : avg));
+
+            if (sum > current_top_sum) {
+                if(this->_suppression_flags == 0) {
+                    current_top_sum = sum;
+                    current_top_index = i;
+                }
+                else if(this->_suppression_flags & (1 << i)) {
+                    current_top_sum = sum;
+                    current_top_index = i;
+                }
+            }
+        }
+        scores->dequantized = false;
+
+        /* Check threshold, suppression */
+        if (this->_suppression_samples && this->_suppression_count < this->_suppression_samples) {
+            this->_suppression_count++;
+        }
+        else {
+            if (current_top_sum >= this->_threshold_sum_q[n - 1]) {
+                recognized_event = current_top_index;
+
+                if (this->_suppression_flags & (1 << current_top_index)) {
+                    this->_suppression_count = 0;
+                }
+            }
+        }
+
+        return recognized_event;
+    };
+#endif
+
     void *operator new(size_t size)
     {
         void *p = ei_malloc(size);
@@ -194,6 +305,38 @@ private:
     uint32_t _score_idx;
     float *_running_sum;
     uint32_t _n_scores_in_array;
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    int8_t *_score_array_q;
+    int32_t *_running_sum_q;
+    int32_t *_threshold_sum_q;
+    float _scale_q;
+    int32_t _zero_point_q;
+
+    /**
+     * The history starts out as zero scores (raw value zero_point), the running sums are relative
+     * to the zero point, and the threshold becomes
+     * the smallest sum of n scores whose average reaches it, for every n in the window
+     */
+    void set_quantization(float scale, int32_t zero_point)
+    {
+        this->_scale_q = scale;
+        this->_zero_point_q = zero_point;
+
+        int8_t zero = (int8_t)zero_point;
+        for (uint32_t i = 0; i < this->_average_window_duration_samples * this->_n_labels; i++) {
+            this->_score_array_q[i] = zero;
+        }
+        for (uint32_t i = 0; i < this->_n_labels; i++) {
+            this->_running_sum_q[i] = 0;
+        }
+        for (uint32_t n = 1; n <= this->_average_window_duration_samples; n++) {
+            double sum = (double)this->_detection_threshold * (double)n / (double)scale;
+            this->_threshold_sum_q[n - 1] = (int32_t)ceil(sum);
+        }
+        this->_score_idx = 0;
+        this->_n_scores_in_array = 0;
+    }
+#endif
 };
 
 #endif //EI_PERFORMANCE_CALIBRATION
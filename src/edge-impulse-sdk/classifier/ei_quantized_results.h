@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_QUANTIZED_RESULTS_H_
+#define _EI_CLASSIFIER_QUANTIZED_RESULTS_H_
+
+#include <string.h>
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+#include "edge-impulse-sdk/classifier/ei_model_types.h"
+
+/**
+ * Post-processing in the int8 domain of a quantized classifier.
+ *
+ * With EI_CLASSIFIER_QUANTIZED_POSTPROCESSING=1 the classifier keeps its raw int8 outputs in
+ * result.quantized and leaves result.classification[].value alone. Thresholds are converted to
+ * the output domain once with ei_quantized_threshold(), labels are looked up once with
+ * ei_find_label_index(), and the moving average of performance calibration runs on integers
+ * (see RecognizeEvents).
+ *
+ * result.classification[].value is then stale (whatever it held before) until
+ * ei_quantized_dequantize() is called, so call it before reading the float values, or read a
+ * single score with ei_quantized_value(). src/build.mk turns this on for this project.
+ *
+ * Without it (or for models with a float output) the float values are filled in as before and
+ * ei_quantized_dequantize() does nothing.
+ */
+
+/**
+ * Convert a threshold on the dequantized output to the int8 domain
+ * @param threshold Threshold on the float value
+ * @param scale Output scale (EI_CLASSIFIER_TFLITE_OUTPUT_SCALE or result.quantized.scale)
+ * @param zero_point Output zero point
+ * @returns q such that (value > threshold) == (raw > q). -129 if every raw value is above the
+ *          threshold, 127 if none is.
+ */
+__attribute__((unused)) static int16_t ei_quantized_threshold(float threshold, float scale, int32_t zero_point) {
+    // Same expression as the dequantization, so comparisons agree with the float values exactly
+    for (int32_t raw = -128; raw <= 127; raw++) {
+        float value = static_cast<float>(raw - zero_point) * scale;
+        if (value > threshold) {
+            return (int16_t)(raw - 1);
+        }
+    }
+    return 127;
+}
+
+/**
+ * Find the first label that contains name
+ * @returns Label index, or -1 if there is none
+ */
+__attribute__((unused)) static int ei_find_label_index(const ei_impulse_t *impulse, const char *name) {
+    for (uint32_t ix = 0; ix < impulse->label_count; ix++) {
+        if (strstr(impulse->categories[ix], name) != NULL) {
+            return (int)ix;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Float value of one classification, computed from the raw output if it hasn't been dequantized
+ * @param ix Label index
+ */
+__attribute__((unused)) static float ei_quantized_value(const ei_impulse_result_t *result, uint32_t ix) {
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    const ei_impulse_result_quantized_t *q = &result->quantized;
+    if (q->valid && !q->dequantized) {
+        return static_cast<float>(q->value[ix] - q->zero_point) * q->scale;
+    }
+#endif
+    return result->classification[ix].value;
+}
+
+/**
+ * Fill in result->classification[].value from the raw output, if that wasn't done already
+ */
+__attribute__((unused)) static void ei_quantized_dequantize(ei_impulse_result_t *result) {
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    ei_impulse_result_quantized_t *q = &result->quantized;
+    if (!q->valid || q->dequantized) {
+        return;
+    }
+    for (uint32_t ix = 0; ix < q->count; ix++) {
+        result->classification[ix].value = ei_quantized_value(result, ix);
+    }
+    q->dequantized = true;
+#else
+    (void)result;
+#endif
+}
+
+#endif // _EI_CLASSIFIER_QUANTIZED_RESULTS_H_
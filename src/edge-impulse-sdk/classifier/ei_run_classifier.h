@@ -24,6 +24,10 @@
 #include "ei_classifier_types.h"
 #include "ei_signal_with_axes.h"
 #include "ei_performance_calibration.h"
+#include "ei_quantized_results.h"
+#include "ei_scratch_arena.h"
+#include "ei_inference_scheduler.h"
+#include "ei_telemetry.h"
 
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 
@@ -91,6 +95,12 @@ static EI_IMPULSE_ERROR can_run_classifier_image_quantized(const ei_impulse_t *i
 
 static uint64_t classifier_continuous_features_written = 0;
 static RecognizeEvents *avg_scores = NULL;
+// returned again for slices the inference scheduler skips
+static ei_impulse_result_t classifier_continuous_last_result;
+#if EI_CLASSIFIER_CALIBRATION_ENABLED
+// same, before performance calibration, which still counts the skipped slices
+static ei_impulse_result_t classifier_continuous_last_raw_result;
+#endif
 
 /* Private functions ------------------------------------------------------- */
 
@@ -113,6 +123,8 @@ extern "C" EI_IMPULSE_ERROR run_inference(
     ei_impulse_result_t *result,
     bool debug = false)
 {
+    EiScratchPhase scratch_phase(EI_SCRATCH_PHASE_NN);
+
     for (size_t ix = 0; ix < impulse->learning_blocks_size; ix++) {
         ei_learning_block_t block = impulse->learning_blocks[ix];
 
@@ -157,6 +169,9 @@ extern "C" EI_IMPULSE_ERROR process_impulse(const ei_impulse_t *impulse,
 
     ei::matrix_t features_matrix(1, impulse->nn_input_frame_size);
 
+    // DSP scratch comes from the same region as the tensor arena, run_inference() switches to the NN phase
+    EiScratchPhase scratch_phase(EI_SCRATCH_PHASE_DSP);
+
     uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
@@ -198,12 +213,17 @@ extern "C" EI_IMPULSE_ERROR process_impulse(const ei_impulse_t *impulse,
     result->timing.dsp = (int)(result->timing.dsp_us / 1000);
 
     if (debug) {
+#if EI_CLASSIFIER_TELEMETRY == 1
+        // One binary record per 62 features instead of formatting every one of them
+        ei_telemetry_features(features_matrix.buffer, features_matrix.cols);
+#else
         ei_printf("Features (%d ms.): ", result->timing.dsp);
         for (size_t ix = 0; ix < features_matrix.cols; ix++) {
             ei_printf_float(features_matrix.buffer[ix]);
             ei_printf(" ");
         }
         ei_printf("\n");
+#endif
     }
 
     if (debug) {
@@ -214,6 +234,70 @@ extern "C" EI_IMPULSE_ERROR process_impulse(const ei_impulse_t *impulse,
 
 }
 
+#if EI_CLASSIFIER_CALIBRATION_ENABLED
+/**
+ * @brief      Run performance calibration (moving average, threshold and suppression) over
+ *             the result of a slice, in place
+ *
+ * @param      impulse     struct with information about model and DSP
+ * @param      result      Classifier results of the slice, before calibration
+ * @param[in]  enable_maf  Enable the moving average filter
+ */
+static void calibrate_continuous_result(const ei_impulse_t *impulse, ei_impulse_result_t *result, bool enable_maf)
+{
+    if (impulse->sensor == EI_CLASSIFIER_SENSOR_MICROPHONE) {
+        if((void *)avg_scores != NULL && enable_maf == true) {
+            if (enable_maf && !impulse->calibration.is_configured) {
+                // perfcal is not configured, print msg first time
+                static bool has_printed_msg = false;
+
+                if (!has_printed_msg) {
+                    ei_printf("WARN: run_classifier_continuous, enable_maf is true, but performance calibration is not configured.\n");
+                    ei_printf("       Previously we'd run a moving-average filter over your outputs in this case, but this is now disabled.\n");
+                    ei_printf("       Go to 'Performance calibration' in your Edge Impulse project to configure post-processing parameters.\n");
+                    ei_printf("       (You can enable this from 'Dashboard' if it's not visible in your project)\n");
+                    ei_printf("\n");
+
+                    has_printed_msg = true;
+                }
+            }
+            else {
+                // perfcal is configured
+                static bool has_printed_msg = false;
+
+                if (!has_printed_msg) {
+                    ei_printf("\nPerformance calibration is configured for your project. If no event is detected, all values are 0.\r\n\n");
+                    has_printed_msg = true;
+                }
+
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+                int label_detected = result->quantized.valid
+                    ? avg_scores->trigger(&result->quantized)
+                    : avg_scores->trigger(result->classification);
+#else
+                int label_detected = avg_scores->trigger(result->classification);
+#endif
+
+                if (avg_scores->should_boost()) {
+                    for (int i = 0; i < impulse->label_count; i++) {
+                        if (i == label_detected) {
+                            result->classification[i].value = 1.0f;
+                        }
+                        else {
+                            result->classification[i].value = 0.0f;
+                        }
+                    }
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+                    // 1.0 doesn't fit in the int8 output, the float values are the result now
+                    result->quantized.dequantized = true;
+#endif
+                }
+            }
+        }
+    }
+}
+#endif
+
 /**
  * @brief      Process a complete impulse for continuous inference
  *
@@ -240,6 +324,9 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(const ei_impulse_t *impul
 
     EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
 
+    // DSP scratch comes from the same region as the tensor arena, run_inference() switches to the NN phase
+    EiScratchPhase scratch_phase(EI_SCRATCH_PHASE_DSP);
+
     uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
@@ -273,8 +360,11 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(const ei_impulse_t *impul
             extract_fn_slice = &extract_mfe_per_slice_features;
             is_mfe = true;
         }
+        else if (block.extract_fn == extract_spectral_analysis_features) {
+            extract_fn_slice = &extract_spectral_analysis_per_slice_features;
+        }
         else {
-            ei_printf("ERR: Unknown extract function, only MFCC, MFE and spectrogram supported\n");
+            ei_printf("ERR: Unknown extract function, only MFCC, MFE, spectrogram and spectral analysis supported\n");
             return EI_IMPULSE_DSP_ERROR;
         }
 
@@ -309,16 +399,38 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(const ei_impulse_t *impul
     result->timing.dsp = (int)(result->timing.dsp_us / 1000);
 
     if (debug) {
+#if EI_CLASSIFIER_TELEMETRY == 1
+        ei_telemetry_features(static_features_matrix.buffer, static_features_matrix.cols);
+#else
         ei_printf("\r\nFeatures (%d ms.): ", result->timing.dsp);
         for (size_t ix = 0; ix < static_features_matrix.cols; ix++) {
             ei_printf_float(static_features_matrix.buffer[ix]);
             ei_printf(" ");
         }
         ei_printf("\n");
+#endif
     }
 
     if (classifier_continuous_features_written >= impulse->nn_input_frame_size) {
-        dsp_start_us = ei_read_timer_us();
+        uint32_t slice_us = impulse->frequency > 0
+            ? (uint32_t)((float)signal->total_length * 1000000.0f / impulse->frequency) : 0;
+        if (!ei_scheduler_next_slice(slice_us, result->timing.dsp_us)) {
+            // The features are up to date, but the NN doesn't run on this slice
+            ei_impulse_result_timing_t timing = result->timing;
+#if EI_CLASSIFIER_CALIBRATION_ENABLED
+            // The calibration window and suppression are counted in slices, so the slice goes
+            // through it with the scores of the last inference
+            *result = classifier_continuous_last_raw_result;
+            calibrate_continuous_result(impulse, result, enable_maf);
+#else
+            *result = classifier_continuous_last_result;
+#endif
+            result->timing = timing;
+            return EI_IMPULSE_OK;
+        }
+
+        uint64_t nn_start_us = ei_read_timer_us();
+        dsp_start_us = nn_start_us;
         ei::matrix_t classify_matrix(1, impulse->nn_input_frame_size);
 
         /* Create a copy of the matrix for normalization */
@@ -344,48 +456,13 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(const ei_impulse_t *impul
 
         ei_impulse_error = run_inference(impulse, &classify_matrix, result, debug);
 
-#if EI_CLASSIFIER_CALIBRATION_ENABLED
-        if (impulse->sensor == EI_CLASSIFIER_SENSOR_MICROPHONE) {
-            if((void *)avg_scores != NULL && enable_maf == true) {
-                if (enable_maf && !impulse->calibration.is_configured) {
-                    // perfcal is not configured, print msg first time
-                    static bool has_printed_msg = false;
-
-                    if (!has_printed_msg) {
-                        ei_printf("WARN: run_classifier_continuous, enable_maf is true, but performance calibration is not configured.\n");
-                        ei_printf("       Previously we'd run a moving-average filter over your outputs in this case, but this is now disabled.\n");
-                        ei_printf("       Go to 'Performance calibration' in your Edge Impulse project to configure post-processing parameters.\n");
-                        ei_printf("       (You can enable this from 'Dashboard' if it's not visible in your project)\n");
-                        ei_printf("\n");
-
-                        has_printed_msg = true;
-                    }
-                }
-                else {
-                    // perfcal is configured
-                    static bool has_printed_msg = false;
-
-                    if (!has_printed_msg) {
-                        ei_printf("\nPerformance calibration is configured for your project. If no event is detected, all values are 0.\r\n\n");
-                        has_printed_msg = true;
-                    }
+        ei_scheduler_inferred(result, impulse->label_count, ei_read_timer_us() - nn_start_us);
 
-                    int label_detected = avg_scores->trigger(result->classification);
-
-                    if (avg_scores->should_boost()) {
-                        for (int i = 0; i < impulse->label_count; i++) {
-                            if (i == label_detected) {
-                                result->classification[i].value = 1.0f;
-                            }
-                            else {
-                                result->classification[i].value = 0.0f;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+#if EI_CLASSIFIER_CALIBRATION_ENABLED
+        classifier_continuous_last_raw_result = *result;
+        calibrate_continuous_result(impulse, result, enable_maf);
 #endif
+        classifier_continuous_last_result = *result;
     }
     else {
         if (!impulse->object_detection) {
@@ -471,6 +548,7 @@ extern "C" void run_classifier_init()
 
     classifier_continuous_features_written = 0;
     ei_dsp_clear_continuous_audio_state();
+    ei_scheduler_reset();
 
 #if EI_CLASSIFIER_CALIBRATION_ENABLED
 
@@ -478,8 +556,11 @@ extern "C" void run_classifier_init()
     const ei_model_performance_calibration_t *calibration = &impulse.calibration;
 
     if(calibration != NULL) {
+        // trigger() runs once per slice, of the size the application reads
+        // (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW), not the one the model was exported with
         avg_scores = new RecognizeEvents(calibration,
-            impulse.label_count, impulse.slice_size, impulse.interval_ms);
+            impulse.label_count, impulse.raw_sample_count / EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW,
+            impulse.interval_ms);
     }
 #endif
 }
@@ -491,13 +572,16 @@ __attribute__((unused)) void run_classifier_init(const ei_impulse_t *impulse)
 {
     classifier_continuous_features_written = 0;
     ei_dsp_clear_continuous_audio_state();
+    ei_scheduler_reset();
 
 #if EI_CLASSIFIER_CALIBRATION_ENABLED
     const ei_model_performance_calibration_t *calibration = &impulse->calibration;
 
     if(calibration != NULL) {
+        // trigger() runs once per slice, see above
         avg_scores = new RecognizeEvents(calibration,
-            impulse->label_count, impulse->slice_size, impulse->interval_ms);
+            impulse->label_count, impulse->raw_sample_count / EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW,
+            impulse->interval_ms);
     }
 #endif
 }
@@ -507,6 +591,9 @@ extern "C" void run_classifier_deinit(void)
     if((void *)avg_scores != NULL) {
         delete avg_scores;
     }
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+    ei_tflite_resident_release();
+#endif
 }
 
 /**
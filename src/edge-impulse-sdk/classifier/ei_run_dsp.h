@@ -112,6 +112,88 @@ __attribute__((unused)) int extract_spectral_analysis_features(
     return EIDSP_NOT_SUPPORTED;
 }
 
+#if !(defined(__cplusplus) && EI_C_LINKAGE == 1)
+// continuous spectral analysis state, one per DSP block (keyed by config)
+#define EI_DSP_SPECTRAL_CONTINUOUS_MAX_BLOCKS   4
+static void *ei_dsp_spectral_cont_config[EI_DSP_SPECTRAL_CONTINUOUS_MAX_BLOCKS] = { nullptr };
+static spectral::feature_continuous *ei_dsp_spectral_cont_state[EI_DSP_SPECTRAL_CONTINUOUS_MAX_BLOCKS] = { nullptr };
+#endif
+
+__attribute__((unused)) int extract_spectral_analysis_per_slice_features(
+    signal_t *signal,
+    matrix_t *output_matrix,
+    void *config_ptr,
+    const float frequency,
+    matrix_size_t *matrix_size_out)
+{
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+    ei_printf("ERR: Continuous spectral analysis is not supported when EI_C_LINKAGE is defined\n");
+    EIDSP_ERR(EIDSP_NOT_SUPPORTED);
+#else
+    ei_dsp_config_spectral_analysis_t *config = (ei_dsp_config_spectral_analysis_t *)config_ptr;
+
+    if (signal->total_length == 0 || signal->total_length % config->axes != 0) {
+        EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+    }
+
+    const size_t slice_size = signal->total_length / config->axes;
+
+    // find the state for this block, or a free slot for it
+    int slot = -1;
+    for (int ix = 0; ix < EI_DSP_SPECTRAL_CONTINUOUS_MAX_BLOCKS; ix++) {
+        if (ei_dsp_spectral_cont_config[ix] == config_ptr || (slot < 0 && !ei_dsp_spectral_cont_config[ix])) {
+            slot = ix;
+            if (ei_dsp_spectral_cont_config[ix] == config_ptr) {
+                break;
+            }
+        }
+    }
+    if (slot < 0) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
+    spectral::feature_continuous *state = ei_dsp_spectral_cont_state[slot];
+    if (!state) {
+        state = new spectral::feature_continuous();
+        if (!state) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+        ei_dsp_spectral_cont_state[slot] = state;
+        ei_dsp_spectral_cont_config[slot] = config_ptr;
+    }
+    if (!state->is_initialized_for(config, slice_size, EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW)) {
+        EI_TRY(state->init(config, frequency, slice_size, EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW));
+    }
+
+    // input matrix from the raw signal, one row per axis
+    matrix_t input_matrix(slice_size, config->axes);
+    if (!input_matrix.buffer) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
+    signal->get_data(0, signal->total_length, input_matrix.buffer);
+
+    numpy::transpose_in_place(&input_matrix);
+    EI_TRY(numpy::scale(&input_matrix, config->scale_axes));
+
+    EI_TRY(state->add_slice(&input_matrix));
+
+    matrix_size_out->rows = 0;
+    matrix_size_out->cols = 0;
+
+    if (state->is_window_full()) {
+        size_t n_features = state->extract(output_matrix);
+        if (n_features != output_matrix->cols) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+        matrix_size_out->rows = 1;
+        matrix_size_out->cols = n_features;
+    }
+
+    return EIDSP_OK;
+#endif
+}
+
 __attribute__((unused)) int extract_raw_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float frequency) {
     ei_dsp_config_raw_t config = *((ei_dsp_config_raw_t*)config_ptr);
 
@@ -1368,6 +1450,14 @@ __attribute__((unused)) int ei_dsp_clear_continuous_audio_state() {
     ei_dsp_cont_current_frame_size = 0;
     ei_dsp_cont_current_frame_ix = 0;
 
+#if !(defined(__cplusplus) && EI_C_LINKAGE == 1)
+    for (int ix = 0; ix < EI_DSP_SPECTRAL_CONTINUOUS_MAX_BLOCKS; ix++) {
+        delete ei_dsp_spectral_cont_state[ix];
+        ei_dsp_spectral_cont_state[ix] = nullptr;
+        ei_dsp_spectral_cont_config[ix] = nullptr;
+    }
+#endif
+
     return EIDSP_OK;
 }
 
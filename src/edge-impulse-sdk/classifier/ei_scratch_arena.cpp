@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "edge-impulse-sdk/classifier/ei_scratch_arena.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include <string.h>
+
+// Every block starts with a header holding its size and linking it to the block below, so blocks
+// freed out of order can be given back once they reach the top. The header is padded to 16 bytes,
+// which keeps the blocks aligned for the tensor arena.
+typedef struct {
+    uint32_t size;      // including the header
+    uint32_t prev;      // offset of the block below, or EI_SCRATCH_NO_BLOCK
+    uint32_t is_free;
+    uint32_t reserved;
+} ei_scratch_block_t;
+
+#define EI_SCRATCH_ALIGN        16
+#define EI_SCRATCH_HEADER_SIZE  sizeof(ei_scratch_block_t)
+#define EI_SCRATCH_NO_BLOCK     0xffffffff
+
+static ei_scratch_phase_t current_phase = EI_SCRATCH_PHASE_NONE;
+static size_t live_bytes = 0;
+static size_t phase_start_bytes = 0;
+static size_t high_water = 0;
+static size_t phase_peak[EI_SCRATCH_PHASE_COUNT] = { 0 };
+static uint32_t phase_runs[EI_SCRATCH_PHASE_COUNT] = { 0 };
+static uint32_t overflow_count = 0;
+static size_t overflow_bytes = 0;
+
+#if EI_CLASSIFIER_SCRATCH_ARENA_SIZE > 0
+static uint8_t arena[EI_CLASSIFIER_SCRATCH_ARENA_SIZE] __attribute__((aligned(EI_SCRATCH_ALIGN)));
+static size_t arena_top = 0;
+static uint32_t last_block = EI_SCRATCH_NO_BLOCK;
+#endif
+
+void *ei_scratch_alloc(size_t size, bool zero) {
+    if (current_phase == EI_SCRATCH_PHASE_NONE) {
+        return NULL;
+    }
+
+#if EI_CLASSIFIER_SCRATCH_ARENA_SIZE > 0
+    size_t block_size = EI_SCRATCH_HEADER_SIZE + ((size + EI_SCRATCH_ALIGN - 1) & ~(size_t)(EI_SCRATCH_ALIGN - 1));
+    if (size > EI_CLASSIFIER_SCRATCH_ARENA_SIZE || block_size > EI_CLASSIFIER_SCRATCH_ARENA_SIZE - arena_top) {
+        overflow_count++;
+        if (size > overflow_bytes) {
+            overflow_bytes = size;
+        }
+        return NULL;
+    }
+
+    ei_scratch_block_t *block = (ei_scratch_block_t *)(arena + arena_top);
+    block->size = (uint32_t)block_size;
+    block->prev = last_block;
+    block->is_free = 0;
+    last_block = (uint32_t)arena_top;
+    arena_top += block_size;
+    if (arena_top > high_water) {
+        high_water = arena_top;
+    }
+
+    live_bytes += block_size;
+    if (live_bytes - phase_start_bytes > phase_peak[current_phase]) {
+        phase_peak[current_phase] = live_bytes - phase_start_bytes;
+    }
+
+    void *ptr = block + 1;
+    if (zero) {
+        memset(ptr, 0, block_size - EI_SCRATCH_HEADER_SIZE);
+    }
+    return ptr;
+#else
+    (void)size;
+    (void)zero;
+    return NULL;
+#endif
+}
+
+bool ei_scratch_free(void *ptr) {
+#if EI_CLASSIFIER_SCRATCH_ARENA_SIZE > 0
+    uint8_t *p = (uint8_t *)ptr;
+    if (p < arena + EI_SCRATCH_HEADER_SIZE || p >= arena + EI_CLASSIFIER_SCRATCH_ARENA_SIZE) {
+        return false;
+    }
+
+    ei_scratch_block_t *block = (ei_scratch_block_t *)p - 1;
+    block->is_free = 1;
+    live_bytes -= block->size;
+
+    // Give back the top block and any freed blocks right below it
+    while (last_block != EI_SCRATCH_NO_BLOCK) {
+        ei_scratch_block_t *last = (ei_scratch_block_t *)(arena + last_block);
+        if (!last->is_free) {
+            break;
+        }
+        arena_top = last_block;
+        last_block = last->prev;
+    }
+    if (live_bytes < phase_start_bytes) {
+        // Freed something that was allocated before the phase started
+        phase_start_bytes = live_bytes;
+    }
+    return true;
+#else
+    (void)ptr;
+    return false;
+#endif
+}
+
+ei_scratch_phase_t ei_scratch_begin_phase(ei_scratch_phase_t phase) {
+    ei_scratch_phase_t previous = current_phase;
+    current_phase = phase;
+    phase_start_bytes = live_bytes;
+    phase_runs[phase]++;
+    return previous;
+}
+
+void ei_scratch_end_phase(ei_scratch_phase_t previous) {
+    current_phase = previous;
+    phase_start_bytes = live_bytes;
+}
+
+void ei_scratch_get_report(ei_scratch_report_t *report) {
+    memset(report, 0, sizeof(ei_scratch_report_t));
+
+    report->arena_size = EI_CLASSIFIER_SCRATCH_ARENA_SIZE;
+    report->planned_size = high_water;
+    report->retained = (current_phase == EI_SCRATCH_PHASE_NONE) ? live_bytes : 0;
+    report->separate_size = report->retained;
+    for (int ix = 0; ix < EI_SCRATCH_PHASE_COUNT; ix++) {
+        report->phase_peak[ix] = phase_peak[ix];
+        report->phase_runs[ix] = phase_runs[ix];
+        report->separate_size += phase_peak[ix];
+    }
+    report->overflow_count = overflow_count;
+    report->overflow_bytes = overflow_bytes;
+}
+
+void ei_scratch_print_report(void) {
+    ei_scratch_report_t report;
+    ei_scratch_get_report(&report);
+
+    if (report.arena_size == 0) {
+        ei_printf("Scratch arena: disabled, define EI_CLASSIFIER_SCRATCH_ARENA_SIZE to enable\n");
+        return;
+    }
+
+    ei_printf("Scratch arena: %u bytes\n", (unsigned int)report.arena_size);
+    ei_printf("\tDSP peak: %u bytes (%u runs)\n",
+        (unsigned int)report.phase_peak[EI_SCRATCH_PHASE_DSP], (unsigned int)report.phase_runs[EI_SCRATCH_PHASE_DSP]);
+    ei_printf("\tNN peak: %u bytes (%u runs)\n",
+        (unsigned int)report.phase_peak[EI_SCRATCH_PHASE_NN], (unsigned int)report.phase_runs[EI_SCRATCH_PHASE_NN]);
+    ei_printf("\tRetained between phases: %u bytes\n", (unsigned int)report.retained);
+    ei_printf("\tPlanned (shared) size: %u bytes, separate regions would need %u bytes\n",
+        (unsigned int)report.planned_size, (unsigned int)report.separate_size);
+
+    if (report.overflow_count > 0) {
+        ei_printf("\t%u allocations did not fit (largest %u bytes) and used the heap, "
+            "increase EI_CLASSIFIER_SCRATCH_ARENA_SIZE and run again to plan\n",
+            (unsigned int)report.overflow_count, (unsigned int)report.overflow_bytes);
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_SCRATCH_ARENA_H_
+#define _EI_CLASSIFIER_SCRATCH_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+
+/**
+ * Scratch arena shared by the DSP and NN phases of an inference.
+ *
+ * Without it the DSP blocks take their scratch buffers from the heap and free them before
+ * inference, and the NN then allocates its own tensor arena, so the heap has to be able to
+ * satisfy the sum of both at different times and fragments in between. The two phases never
+ * overlap, so with EI_CLASSIFIER_SCRATCH_ARENA_SIZE set, every ei_malloc / ei_calloc made while
+ * a phase is active is carved from one static region instead. The DSP scratch is released at the
+ * end of the DSP phase and the NN tensor arena is placed at the same offset, so the region only
+ * needs max(DSP, NN) bytes.
+ *
+ * Allocations are taken from the top of the region. Freeing the top block gives its space back
+ * straight away, together with any blocks right below it that were already freed out of order.
+ * Blocks that outlive their phase (e.g. the state of continuous MFCC) stay where they are and
+ * later phases are placed above them.
+ *
+ * To size the region, run the impulse once with a generous size and call
+ * ei_scratch_print_report(). The planned size is the highest offset that was used. If an
+ * allocation doesn't fit it's served from the heap as before and counted as an overflow.
+ */
+
+typedef enum {
+    EI_SCRATCH_PHASE_NONE = 0,
+    EI_SCRATCH_PHASE_DSP,
+    EI_SCRATCH_PHASE_NN,
+    EI_SCRATCH_PHASE_COUNT
+} ei_scratch_phase_t;
+
+typedef struct {
+    size_t arena_size;                           // EI_CLASSIFIER_SCRATCH_ARENA_SIZE
+    size_t planned_size;                         // highest offset used, the size the region needs
+    size_t separate_size;                        // what the phases would need in separate regions
+    size_t retained;                             // bytes still allocated outside of any phase
+    size_t phase_peak[EI_SCRATCH_PHASE_COUNT];   // largest working set of each phase
+    uint32_t phase_runs[EI_SCRATCH_PHASE_COUNT]; // number of times each phase ran
+    uint32_t overflow_count;                     // allocations that went to the heap
+    size_t overflow_bytes;                       // largest allocation that went to the heap
+} ei_scratch_report_t;
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C" {
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+/**
+ * Allocate from the arena if a phase is active
+ * @param size Number of bytes
+ * @param zero Clear the block
+ * @returns Pointer, or NULL if no phase is active, the arena is disabled, or the block doesn't fit
+ */
+void *ei_scratch_alloc(size_t size, bool zero);
+
+/**
+ * Free a block if it's in the arena
+ * @returns true if ptr was in the arena, false if it should be freed to the heap
+ */
+bool ei_scratch_free(void *ptr);
+
+/**
+ * Enter a phase. Returns the previous phase, pass it to ei_scratch_end_phase.
+ */
+ei_scratch_phase_t ei_scratch_begin_phase(ei_scratch_phase_t phase);
+
+/**
+ * Leave the current phase and go back to the previous one
+ */
+void ei_scratch_end_phase(ei_scratch_phase_t previous);
+
+/**
+ * Fill in the plan from the allocations seen so far
+ */
+void ei_scratch_get_report(ei_scratch_report_t *report);
+
+/**
+ * Print the plan with ei_printf
+ */
+void ei_scratch_print_report(void);
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+}
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+#ifdef __cplusplus
+/**
+ * Keeps a phase active for the lifetime of the object, so early returns end it too
+ */
+class EiScratchPhase {
+public:
+    EiScratchPhase(ei_scratch_phase_t phase) {
+        previous = ei_scratch_begin_phase(phase);
+    }
+    ~EiScratchPhase() {
+        ei_scratch_end_phase(previous);
+    }
+private:
+    ei_scratch_phase_t previous;
+};
+#endif // __cplusplus
+
+#endif // _EI_CLASSIFIER_SCRATCH_ARENA_H_
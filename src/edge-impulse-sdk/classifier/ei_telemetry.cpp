@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "edge-impulse-sdk/classifier/ei_telemetry.h"
+#include "edge-impulse-sdk/classifier/ei_quantized_results.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EI_TELEMETRY_MAX_COUNTER_NAME   32
+
+/**
+ * Fletcher-16 over the type, length and payload of a frame
+ */
+static uint16_t frame_checksum(const uint8_t *data, size_t len) {
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+    for (size_t ix = 0; ix < len; ix++) {
+        sum1 = (sum1 + data[ix]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (uint16_t)((sum2 << 8) | sum1);
+}
+
+__attribute__((unused)) static size_t write_frame(uint8_t *out, uint8_t type, const uint8_t *payload, size_t len) {
+    out[0] = EI_TELEMETRY_SYNC_0;
+    out[1] = EI_TELEMETRY_SYNC_1;
+    out[2] = type;
+    out[3] = (uint8_t)(len & 0xff);
+    out[4] = (uint8_t)(len >> 8);
+    memcpy(out + 5, payload, len);
+
+    uint16_t checksum = frame_checksum(out + 2, len + 3);
+    out[5 + len] = (uint8_t)(checksum & 0xff);
+    out[6 + len] = (uint8_t)(checksum >> 8);
+    return len + EI_TELEMETRY_FRAME_OVERHEAD;
+}
+
+#if EI_CLASSIFIER_TELEMETRY == 1
+
+#if (EI_CLASSIFIER_TELEMETRY_SIZE & (EI_CLASSIFIER_TELEMETRY_SIZE - 1)) != 0 || EI_CLASSIFIER_TELEMETRY_SIZE < 1024
+#error "EI_CLASSIFIER_TELEMETRY_SIZE must be a power of two of at least 1024"
+#endif
+
+// Every record in the ring starts with a header word, the payload length in the low 16 bits
+// and the type in the next 8. A header of 0 means the space is reserved but the record is
+// still being written. Records don't wrap, the space up to the end of the ring is skipped
+// with a padding record instead.
+#define EI_TELEMETRY_PAD                0xff
+
+static uint32_t ring[EI_CLASSIFIER_TELEMETRY_SIZE / 4];
+static std::atomic<uint32_t> ring_head(0);      // bytes reserved by writers
+static std::atomic<uint32_t> ring_tail(0);      // bytes released by the reader
+static std::atomic<uint32_t> dropped(0);
+static uint32_t dropped_reported = 0;           // reader side
+
+static const char * const *labels = NULL;
+static size_t label_count = 0;
+static uint32_t predictions_since_labels = 0;
+
+static uint32_t record_size(size_t len) {
+    return 4 + (((uint32_t)len + 3) & ~3u);
+}
+
+/**
+ * Reserve size bytes, a multiple of 4. Returns NULL and counts a drop if the ring is full.
+ */
+static uint32_t *reserve(uint32_t size) {
+    uint32_t head = ring_head.load(std::memory_order_relaxed);
+    uint32_t pad;
+    uint32_t next;
+
+    do {
+        uint32_t tail = ring_tail.load(std::memory_order_acquire);
+        uint32_t to_end = EI_CLASSIFIER_TELEMETRY_SIZE - (head % EI_CLASSIFIER_TELEMETRY_SIZE);
+        pad = (size > to_end) ? to_end : 0;
+        next = head + pad + size;
+        if (next - tail > EI_CLASSIFIER_TELEMETRY_SIZE) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+    } while (!ring_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    if (pad > 0) {
+        __atomic_store_n(&ring[(head % EI_CLASSIFIER_TELEMETRY_SIZE) / 4],
+            ((uint32_t)EI_TELEMETRY_PAD << 16) | (pad - 4), __ATOMIC_RELEASE);
+    }
+    return &ring[((head + pad) % EI_CLASSIFIER_TELEMETRY_SIZE) / 4];
+}
+
+/**
+ * Oldest complete record, skipping padding. NULL if the ring is empty or the oldest record
+ * is still being written.
+ */
+static uint32_t *peek(uint32_t *header) {
+    uint32_t tail = ring_tail.load(std::memory_order_relaxed);
+
+    while (tail != ring_head.load(std::memory_order_acquire)) {
+        uint32_t *rec = &ring[(tail % EI_CLASSIFIER_TELEMETRY_SIZE) / 4];
+        uint32_t hdr = __atomic_load_n(rec, __ATOMIC_ACQUIRE);
+        if (hdr == 0) {
+            return NULL;
+        }
+        if (((hdr >> 16) & 0xff) != EI_TELEMETRY_PAD) {
+            *header = hdr;
+            return rec;
+        }
+        uint32_t size = record_size(hdr & 0xffff);
+        memset(rec, 0, size);
+        tail += size;
+        ring_tail.store(tail, std::memory_order_release);
+    }
+    return NULL;
+}
+
+static void release(uint32_t *rec, uint32_t header) {
+    uint32_t size = record_size(header & 0xffff);
+
+    // A later record can start anywhere in this space, its header has to read 0 until it's written
+    memset(rec, 0, size);
+    ring_tail.store(ring_tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+/**
+ * Write a record from up to two pieces, so headers and arrays don't have to be copied
+ * together on the stack first
+ */
+static bool write_record(uint8_t type, const void *a, size_t a_len, const void *b, size_t b_len) {
+    size_t len = a_len + b_len;
+    if (type == 0 || len > EI_TELEMETRY_MAX_PAYLOAD) {
+        return false;
+    }
+
+    uint32_t *rec = reserve(record_size(len));
+    if (!rec) {
+        return false;
+    }
+
+    uint8_t *payload = (uint8_t *)(rec + 1);
+    if (a_len > 0) {
+        memcpy(payload, a, a_len);
+    }
+    if (b_len > 0) {
+        memcpy(payload + a_len, b, b_len);
+    }
+    __atomic_store_n(rec, ((uint32_t)type << 16) | (uint32_t)len, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool ei_telemetry_write(uint8_t type, const void *payload, size_t len) {
+    return write_record(type, payload, len, NULL, 0);
+}
+
+bool ei_telemetry_text(const char *text, size_t len) {
+    bool ok = true;
+    while (len > 0) {
+        size_t chunk = (len > EI_TELEMETRY_MAX_PAYLOAD) ? EI_TELEMETRY_MAX_PAYLOAD : len;
+        ok = write_record(EI_TELEMETRY_TEXT, text, chunk, NULL, 0) && ok;
+        text += chunk;
+        len -= chunk;
+    }
+    return ok;
+}
+
+bool ei_telemetry_labels(const char * const *new_labels, size_t count) {
+    labels = new_labels;
+    label_count = (count > EI_TELEMETRY_MAX_LABELS) ? EI_TELEMETRY_MAX_LABELS : count;
+    predictions_since_labels = 0;
+
+    char buf[EI_TELEMETRY_MAX_PAYLOAD];
+    size_t len = 0;
+    for (size_t ix = 0; ix < label_count; ix++) {
+        size_t name_len = strlen(labels[ix]) + 1;
+        if (len + name_len > sizeof(buf)) {
+            break;
+        }
+        memcpy(buf + len, labels[ix], name_len);
+        len += name_len;
+    }
+    return write_record(EI_TELEMETRY_LABELS, buf, len, NULL, 0);
+}
+
+bool ei_telemetry_prediction(const ei_impulse_result_t *result, uint32_t count) {
+    if (labels && ++predictions_since_labels >= EI_TELEMETRY_LABELS_INTERVAL) {
+        ei_telemetry_labels(labels, label_count);
+    }
+
+    if (count > EI_TELEMETRY_MAX_LABELS) {
+        count = EI_TELEMETRY_MAX_LABELS;
+    }
+
+    ei_telemetry_prediction_t pred;
+    memset(&pred, 0, sizeof(pred));
+    pred.time_ms = (uint32_t)ei_read_timer_ms();
+    pred.dsp_us = (uint32_t)result->timing.dsp_us;
+    pred.classification_us = (uint32_t)result->timing.classification_us;
+    pred.anomaly_us = (uint32_t)result->timing.anomaly_us;
+    pred.anomaly = result->anomaly;
+    pred.label_count = (uint8_t)count;
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+    pred.flags |= EI_TELEMETRY_PREDICTION_ANOMALY;
+#endif
+
+    uint16_t scores[EI_TELEMETRY_MAX_LABELS];
+    for (uint32_t ix = 0; ix < count; ix++) {
+        float value = ei_quantized_value(result, ix);
+        if (value < 0.f) {
+            value = 0.f;
+        }
+        if (value > 1.f) {
+            value = 1.f;
+        }
+        scores[ix] = (uint16_t)(value * 65535.f + 0.5f);
+    }
+
+    return write_record(EI_TELEMETRY_PREDICTION, &pred, sizeof(pred), scores, count * sizeof(uint16_t));
+}
+
+bool ei_telemetry_counter(const char *name, uint32_t value) {
+    size_t name_len = strlen(name);
+    if (name_len > EI_TELEMETRY_MAX_COUNTER_NAME) {
+        name_len = EI_TELEMETRY_MAX_COUNTER_NAME;
+    }
+    return write_record(EI_TELEMETRY_COUNTER, &value, sizeof(value), name, name_len);
+}
+
+bool ei_telemetry_features(const float *features, size_t count) {
+    bool ok = true;
+    for (size_t offset = 0; offset < count; offset += EI_TELEMETRY_FEATURES_PER_RECORD) {
+        size_t n = count - offset;
+        if (n > EI_TELEMETRY_FEATURES_PER_RECORD) {
+            n = EI_TELEMETRY_FEATURES_PER_RECORD;
+        }
+        ei_telemetry_features_t hdr;
+        hdr.offset = (uint16_t)offset;
+        hdr.total = (uint16_t)count;
+        ok = write_record(EI_TELEMETRY_FEATURES, &hdr, sizeof(hdr), features + offset, n * sizeof(float)) && ok;
+    }
+    return ok;
+}
+
+uint32_t ei_telemetry_dropped(void) {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+size_t ei_telemetry_read_frames(uint8_t *buf, size_t size) {
+    size_t n = 0;
+
+    uint32_t total = dropped.load(std::memory_order_relaxed);
+    if (total != dropped_reported && size >= EI_TELEMETRY_FRAME_OVERHEAD + sizeof(uint32_t)) {
+        uint32_t count = total - dropped_reported;
+        n += write_frame(buf, EI_TELEMETRY_DROPPED, (const uint8_t *)&count, sizeof(count));
+        dropped_reported = total;
+    }
+
+    uint32_t header;
+    uint32_t *rec;
+    while ((rec = peek(&header)) != NULL) {
+        size_t len = header & 0xffff;
+        if (n + len + EI_TELEMETRY_FRAME_OVERHEAD > size) {
+            break;
+        }
+        n += write_frame(buf + n, (header >> 16) & 0xff, (const uint8_t *)(rec + 1), len);
+        release(rec, header);
+    }
+    return n;
+}
+
+size_t ei_telemetry_read_text(char *buf, size_t size) {
+    static ei_telemetry_decoder_t decoder;
+    static bool decoder_ready = false;
+    size_t n = 0;
+
+    if (!decoder_ready) {
+        ei_telemetry_decoder_init(&decoder);
+        decoder_ready = true;
+    }
+
+    uint32_t total = dropped.load(std::memory_order_relaxed);
+    if (total != dropped_reported) {
+        uint32_t count = total - dropped_reported;
+        size_t len = ei_telemetry_render(&decoder, EI_TELEMETRY_DROPPED, (const uint8_t *)&count,
+            sizeof(count), buf, size);
+        if (len < size) {
+            n += len;
+            dropped_reported = total;
+        }
+    }
+
+    uint32_t header;
+    uint32_t *rec;
+    while ((rec = peek(&header)) != NULL) {
+        size_t len = ei_telemetry_render(&decoder, (header >> 16) & 0xff, (const uint8_t *)(rec + 1),
+            header & 0xffff, buf + n, size - n);
+        if (n + len >= size) {
+            if (n > 0) {
+                // Render it again next time, into an empty buffer
+                break;
+            }
+            // Doesn't fit at all, keep what was rendered
+            len = (size > 0) ? size - 1 : 0;
+        }
+        n += len;
+        release(rec, header);
+    }
+    return n;
+}
+
+#else
+
+bool ei_telemetry_write(uint8_t type, const void *payload, size_t len) {
+    (void)type;
+    (void)payload;
+    (void)len;
+    return false;
+}
+
+bool ei_telemetry_text(const char *text, size_t len) {
+    (void)text;
+    (void)len;
+    return false;
+}
+
+bool ei_telemetry_labels(const char * const *labels, size_t count) {
+    (void)labels;
+    (void)count;
+    return false;
+}
+
+bool ei_telemetry_prediction(const ei_impulse_result_t *result, uint32_t label_count) {
+    (void)result;
+    (void)label_count;
+    return false;
+}
+
+bool ei_telemetry_counter(const char *name, uint32_t value) {
+    (void)name;
+    (void)value;
+    return false;
+}
+
+bool ei_telemetry_features(const float *features, size_t count) {
+    (void)features;
+    (void)count;
+    return false;
+}
+
+uint32_t ei_telemetry_dropped(void) {
+    return 0;
+}
+
+size_t ei_telemetry_read_frames(uint8_t *buf, size_t size) {
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+size_t ei_telemetry_read_text(char *buf, size_t size) {
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+#endif // EI_CLASSIFIER_TELEMETRY == 1
+
+void ei_telemetry_decoder_init(ei_telemetry_decoder_t *decoder) {
+    memset(decoder, 0, sizeof(ei_telemetry_decoder_t));
+}
+
+void ei_telemetry_decode(ei_telemetry_decoder_t *decoder, const uint8_t *data, size_t len,
+    ei_telemetry_record_fn fn, void *ctx)
+{
+    size_t text_start = 0;
+
+    for (size_t ix = 0; ix < len; ix++) {
+        uint8_t b = data[ix];
+
+        if (decoder->frame_len == 0) {
+            if (b != EI_TELEMETRY_SYNC_0) {
+                continue;
+            }
+            if (ix > text_start) {
+                fn(ctx, 0, data + text_start, ix - text_start);
+            }
+            decoder->frame[decoder->frame_len++] = b;
+            text_start = ix + 1;
+            continue;
+        }
+
+        text_start = ix + 1;
+        decoder->frame[decoder->frame_len++] = b;
+
+        if (decoder->frame_len == 2 && b != EI_TELEMETRY_SYNC_1) {
+            // Not a frame after all, the first byte was text
+            fn(ctx, 0, decoder->frame, 1);
+            decoder->frame_len = 0;
+            if (b == EI_TELEMETRY_SYNC_0) {
+                decoder->frame[decoder->frame_len++] = b;
+            }
+            else {
+                fn(ctx, 0, &data[ix], 1);
+            }
+            continue;
+        }
+        if (decoder->frame_len < 5) {
+            continue;
+        }
+
+        size_t payload_len = decoder->frame[3] | ((size_t)decoder->frame[4] << 8);
+        if (payload_len > EI_TELEMETRY_MAX_PAYLOAD) {
+            decoder->bad_frames++;
+            decoder->frame_len = 0;
+            continue;
+        }
+        if (decoder->frame_len < payload_len + EI_TELEMETRY_FRAME_OVERHEAD) {
+            continue;
+        }
+
+        uint16_t checksum = decoder->frame[5 + payload_len] | (decoder->frame[6 + payload_len] << 8);
+        if (checksum == frame_checksum(decoder->frame + 2, payload_len + 3)) {
+            fn(ctx, decoder->frame[2], decoder->frame + 5, payload_len);
+        }
+        else {
+            decoder->bad_frames++;
+        }
+        decoder->frame_len = 0;
+    }
+
+    if (decoder->frame_len == 0 && len > text_start) {
+        fn(ctx, 0, data + text_start, len - text_start);
+    }
+}
+
+typedef struct {
+    char *out;
+    size_t size;
+    size_t len;
+} render_buf_t;
+
+static void render_printf(render_buf_t *buf, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t room = (buf->len < buf->size) ? buf->size - buf->len : 0;
+    int r = vsnprintf(room > 0 ? buf->out + buf->len : NULL, room, format, args);
+    va_end(args);
+
+    if (r > 0) {
+        buf->len += (size_t)r;
+    }
+}
+
+static void render_labels(ei_telemetry_decoder_t *decoder, const uint8_t *payload, size_t len) {
+    memcpy(decoder->labels, payload, len);
+    decoder->labels[len] = '\0';
+
+    decoder->label_count = 0;
+    size_t start = 0;
+    for (size_t ix = 0; ix < len && decoder->label_count < EI_TELEMETRY_MAX_LABELS; ix++) {
+        if (decoder->labels[ix] == '\0') {
+            decoder->label[decoder->label_count++] = &decoder->labels[start];
+            start = ix + 1;
+        }
+    }
+}
+
+size_t ei_telemetry_render(ei_telemetry_decoder_t *decoder, uint8_t type, const uint8_t *payload,
+    size_t len, char *out, size_t size)
+{
+    render_buf_t buf = { out, size, 0 };
+
+    if (size > 0) {
+        out[0] = '\0';
+    }
+    if (len > EI_TELEMETRY_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    switch (type) {
+        case 0:
+        case EI_TELEMETRY_TEXT: {
+            render_printf(&buf, "%.*s", (int)len, (const char *)payload);
+            break;
+        }
+        case EI_TELEMETRY_LABELS: {
+            render_labels(decoder, payload, len);
+            break;
+        }
+        case EI_TELEMETRY_PREDICTION: {
+            ei_telemetry_prediction_t pred;
+            if (len < sizeof(pred)) {
+                break;
+            }
+            memcpy(&pred, payload, sizeof(pred));
+            if (len < sizeof(pred) + pred.label_count * sizeof(uint16_t)) {
+                break;
+            }
+
+            render_printf(&buf, "Predictions (DSP: %u ms., Classification: %u ms., Anomaly: %u ms.): \n",
+                (unsigned int)(pred.dsp_us / 1000), (unsigned int)(pred.classification_us / 1000),
+                (unsigned int)(pred.anomaly_us / 1000));
+            for (size_t ix = 0; ix < pred.label_count; ix++) {
+                uint16_t score;
+                memcpy(&score, payload + sizeof(pred) + ix * sizeof(uint16_t), sizeof(score));
+                if (ix < decoder->label_count) {
+                    render_printf(&buf, "    %s: %.5f\n", decoder->label[ix], (float)score / 65535.f);
+                }
+                else {
+                    render_printf(&buf, "    label %u: %.5f\n", (unsigned int)ix, (float)score / 65535.f);
+                }
+            }
+            if (pred.flags & EI_TELEMETRY_PREDICTION_ANOMALY) {
+                render_printf(&buf, "    anomaly score: %.3f\n", pred.anomaly);
+            }
+            break;
+        }
+        case EI_TELEMETRY_COUNTER: {
+            uint32_t value;
+            if (len < sizeof(value)) {
+                break;
+            }
+            memcpy(&value, payload, sizeof(value));
+            render_printf(&buf, "%.*s: %lu\n", (int)(len - sizeof(value)),
+                (const char *)payload + sizeof(value), (unsigned long)value);
+            break;
+        }
+        case EI_TELEMETRY_FEATURES: {
+            ei_telemetry_features_t hdr;
+            if (len < sizeof(hdr)) {
+                break;
+            }
+            memcpy(&hdr, payload, sizeof(hdr));
+            size_t count = (len - sizeof(hdr)) / sizeof(float);
+
+            if (hdr.offset == 0) {
+                render_printf(&buf, "Features (%u): ", (unsigned int)hdr.total);
+            }
+            for (size_t ix = 0; ix < count; ix++) {
+                float f;
+                memcpy(&f, payload + sizeof(hdr) + ix * sizeof(float), sizeof(f));
+                render_printf(&buf, "%f ", f);
+            }
+            if (hdr.offset + count >= hdr.total) {
+                render_printf(&buf, "\n");
+            }
+            break;
+        }
+        case EI_TELEMETRY_DROPPED: {
+            uint32_t count;
+            if (len < sizeof(count)) {
+                break;
+            }
+            memcpy(&count, payload, sizeof(count));
+            render_printf(&buf, "WARN: %lu telemetry records dropped\n", (unsigned long)count);
+            break;
+        }
+        default: {
+            render_printf(&buf, "[telemetry record type %u, %u bytes]\n", (unsigned int)type, (unsigned int)len);
+            break;
+        }
+    }
+
+    return buf.len;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_TELEMETRY_H_
+#define _EI_CLASSIFIER_TELEMETRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_types.h"
+
+/**
+ * Non-blocking telemetry channel.
+ *
+ * Producers (the inference loop, ei_printf() when EI_CLASSIFIER_TELEMETRY is enabled) copy
+ * compact binary records into a lock-free ring and return straight away. One consumer, a
+ * low priority thread or a poll from the main loop, drains the ring either as framed binary
+ * records (ei_telemetry_read_frames()) or rendered as text (ei_telemetry_read_text()), and
+ * writes them to the serial port. When the ring is full records are dropped and counted,
+ * producers never wait for the serial port.
+ *
+ * Any number of threads can write records, the ring uses compare-and-swap on the write
+ * position and a record is only visible to the consumer once it's complete. Only one thread
+ * may read.
+ *
+ * A frame on the wire is:
+ *
+ *   0xE1 0x7E | type (1) | payload length (2, LE) | payload | Fletcher-16 of type..payload (2, LE)
+ *
+ * Payloads are little endian, the record layouts are below. Bytes outside of frames (e.g. from
+ * a log handler writing to the same port) are passed through as text by the decoder, so
+ * tools/ei_telemetry_decode.cpp can sit between the serial port and the terminal.
+ */
+
+#define EI_TELEMETRY_SYNC_0             0xE1
+#define EI_TELEMETRY_SYNC_1             0x7E
+#define EI_TELEMETRY_MAX_PAYLOAD        256
+#define EI_TELEMETRY_FRAME_OVERHEAD     7
+#define EI_TELEMETRY_MAX_FRAME          (EI_TELEMETRY_MAX_PAYLOAD + EI_TELEMETRY_FRAME_OVERHEAD)
+#define EI_TELEMETRY_MAX_LABELS         32
+// Features per record, a longer feature buffer is split over several records
+#define EI_TELEMETRY_FEATURES_PER_RECORD 62
+// Predictions between two copies of the label names, so a decoder that starts late learns them
+#define EI_TELEMETRY_LABELS_INTERVAL    16
+
+typedef enum {
+    EI_TELEMETRY_TEXT = 1,          // characters, not NUL terminated
+    EI_TELEMETRY_LABELS = 2,        // label names, each NUL terminated
+    EI_TELEMETRY_PREDICTION = 3,    // ei_telemetry_prediction_t, then uint16_t score (0..65535) per label
+    EI_TELEMETRY_COUNTER = 4,       // uint32_t value, then the name (not NUL terminated)
+    EI_TELEMETRY_FEATURES = 5,      // ei_telemetry_features_t, then float features
+    EI_TELEMETRY_DROPPED = 6,       // uint32_t records dropped because the ring was full
+} ei_telemetry_type_t;
+
+typedef struct {
+    uint32_t time_ms;               // ei_read_timer_ms() when the record was written
+    uint32_t dsp_us;
+    uint32_t classification_us;
+    uint32_t anomaly_us;
+    float anomaly;
+    uint8_t label_count;
+    uint8_t flags;                  // EI_TELEMETRY_PREDICTION_*
+    uint8_t reserved[2];
+} ei_telemetry_prediction_t;
+
+#define EI_TELEMETRY_PREDICTION_ANOMALY 0x01    // the anomaly score is valid
+
+typedef struct {
+    uint16_t offset;                // index of the first feature in this record
+    uint16_t total;                 // features in the whole buffer
+} ei_telemetry_features_t;
+
+/**
+ * Decoder state, for the host and for rendering records as text on the device
+ */
+typedef struct {
+    uint8_t frame[EI_TELEMETRY_MAX_FRAME];
+    size_t frame_len;
+    char labels[EI_TELEMETRY_MAX_PAYLOAD + 1];
+    const char *label[EI_TELEMETRY_MAX_LABELS];
+    size_t label_count;
+    uint32_t bad_frames;            // frames with a wrong checksum
+} ei_telemetry_decoder_t;
+
+/**
+ * Called by the decoder for every record (type > 0), and for text outside of frames (type 0)
+ */
+typedef void (*ei_telemetry_record_fn)(void *ctx, uint8_t type, const uint8_t *payload, size_t len);
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C" {
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+/**
+ * Copy a record into the ring. Never blocks.
+ * @param type One of ei_telemetry_type_t
+ * @param payload Record, at most EI_TELEMETRY_MAX_PAYLOAD bytes
+ * @param len Length of the record
+ * @returns false if the ring is full (the record is counted as dropped), or telemetry is disabled
+ */
+bool ei_telemetry_write(uint8_t type, const void *payload, size_t len);
+
+/**
+ * Text record, longer text is split over several records
+ */
+bool ei_telemetry_text(const char *text, size_t len);
+
+/**
+ * Remember the label names (not copied) and send them, they're sent again every
+ * EI_TELEMETRY_LABELS_INTERVAL predictions
+ */
+bool ei_telemetry_labels(const char * const *labels, size_t count);
+
+/**
+ * Scores and timing of an inference. Reads the int8 output directly when the classifier kept it,
+ * so the result doesn't have to be dequantized first.
+ */
+bool ei_telemetry_prediction(const ei_impulse_result_t *result, uint32_t label_count);
+
+/**
+ * Named counter, the name is truncated to 32 characters
+ */
+bool ei_telemetry_counter(const char *name, uint32_t value);
+
+/**
+ * Feature buffer, split into records of EI_TELEMETRY_FEATURES_PER_RECORD features
+ */
+bool ei_telemetry_features(const float *features, size_t count);
+
+/**
+ * Records dropped since startup because the ring was full
+ */
+uint32_t ei_telemetry_dropped(void);
+
+/**
+ * Move complete frames out of the ring, only one thread may read
+ * @param buf Output, at least EI_TELEMETRY_MAX_FRAME bytes so every frame fits
+ * @param size Size of buf
+ * @returns Bytes written to buf, 0 if the ring is empty
+ */
+size_t ei_telemetry_read_frames(uint8_t *buf, size_t size);
+
+/**
+ * Move records out of the ring rendered as text, the same text ei_printf() used to print.
+ * Only one thread may read, and it shouldn't also call ei_telemetry_read_frames().
+ * @param buf Output, at least EI_TELEMETRY_MAX_PAYLOAD + 1 bytes. It's not NUL terminated. A features
+ *            record takes up to 12 characters per feature, with less it's truncated.
+ * @param size Size of buf
+ * @returns Characters written to buf, 0 if the ring is empty
+ */
+size_t ei_telemetry_read_text(char *buf, size_t size);
+
+/**
+ * Clear a decoder before feeding it the first bytes
+ */
+void ei_telemetry_decoder_init(ei_telemetry_decoder_t *decoder);
+
+/**
+ * Split a byte stream into records, partial frames are kept until the next call
+ * @param fn Called for every record, and for the bytes between frames
+ */
+void ei_telemetry_decode(ei_telemetry_decoder_t *decoder, const uint8_t *data, size_t len,
+    ei_telemetry_record_fn fn, void *ctx);
+
+/**
+ * Render a record as text. Labels records are remembered for the predictions that follow.
+ * @returns Length of the text (like snprintf, it can be more than size when truncated)
+ */
+size_t ei_telemetry_render(ei_telemetry_decoder_t *decoder, uint8_t type, const uint8_t *payload,
+    size_t len, char *out, size_t size);
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+}
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+#endif // _EI_CLASSIFIER_TELEMETRY_H_
@@ -30,6 +30,7 @@
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
 #include "edge-impulse-sdk/classifier/ei_fill_result_struct.h"
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
+#include "edge-impulse-sdk/classifier/ei_scratch_arena.h"
 #include "edge-impulse-sdk/classifier/inferencing_engines/tflite_helper.h"
 
 #if defined(EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER) && EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER == 1
@@ -49,6 +50,91 @@ static tflite::ErrorReporter* error_reporter = &micro_error_reporter;
 #endif
 #endif
 
+typedef struct {
+    uint32_t builds;        // interpreters constructed (AllocateTensors run)
+    uint32_t reuses;        // inferences that used a resident interpreter
+    size_t arena_bytes;     // bytes of arena currently held by resident interpreters
+} ei_tflite_resident_stats_t;
+
+#if EI_CLASSIFIER_TFLITE_RESIDENT == 1
+/**
+ * A graph whose interpreter and arena are kept between inferences
+ */
+typedef struct {
+    const unsigned char *model;
+    tflite::MicroInterpreter *interpreter;
+    uint8_t *tensor_arena;
+    size_t arena_size;
+} ei_tflite_resident_t;
+
+static ei_tflite_resident_t ei_tflite_resident[EI_CLASSIFIER_TFLITE_RESIDENT_MAX_GRAPHS] = { };
+#endif // EI_CLASSIFIER_TFLITE_RESIDENT == 1
+
+static ei_tflite_resident_stats_t ei_tflite_resident_stats = { };
+
+/**
+ * Free the interpreters and arenas kept by EI_CLASSIFIER_TFLITE_RESIDENT, e.g. before doing
+ * something that needs the memory. They're set up again on the next inference.
+ */
+__attribute__((unused)) static void ei_tflite_resident_release(void) {
+#if EI_CLASSIFIER_TFLITE_RESIDENT == 1
+    for (size_t ix = 0; ix < EI_CLASSIFIER_TFLITE_RESIDENT_MAX_GRAPHS; ix++) {
+        ei_tflite_resident_t *slot = &ei_tflite_resident[ix];
+        if (!slot->interpreter) {
+            continue;
+        }
+        delete slot->interpreter;
+#ifndef EI_CLASSIFIER_ALLOCATION_STATIC
+        ei_aligned_free(slot->tensor_arena);
+#endif
+        ei_tflite_resident_stats.arena_bytes -= slot->arena_size;
+        memset(slot, 0, sizeof(ei_tflite_resident_t));
+    }
+#endif // EI_CLASSIFIER_TFLITE_RESIDENT == 1
+}
+
+/**
+ * Number of interpreter builds and reuses, to compare against running without
+ * EI_CLASSIFIER_TFLITE_RESIDENT (where every inference is a build)
+ */
+__attribute__((unused)) static void ei_tflite_resident_get_stats(ei_tflite_resident_stats_t *stats) {
+    *stats = ei_tflite_resident_stats;
+}
+
+/**
+ * Delete an interpreter after inference, unless it's resident
+ */
+static void inference_tflite_release_interpreter(tflite::MicroInterpreter *interpreter) {
+#if EI_CLASSIFIER_TFLITE_RESIDENT == 1
+    for (size_t ix = 0; ix < EI_CLASSIFIER_TFLITE_RESIDENT_MAX_GRAPHS; ix++) {
+        if (ei_tflite_resident[ix].interpreter == interpreter) {
+            return;
+        }
+    }
+#endif // EI_CLASSIFIER_TFLITE_RESIDENT == 1
+    delete interpreter;
+}
+
+/**
+ * Get the input and output tensors used by the learning block
+ */
+static void inference_tflite_get_tensors(
+    ei_learning_block_config_tflite_graph_t *block_config,
+    tflite::MicroInterpreter *interpreter,
+    TfLiteTensor** input,
+    TfLiteTensor** output,
+    TfLiteTensor** output_labels,
+    TfLiteTensor** output_scores) {
+
+    *input = interpreter->input(0);
+    *output = interpreter->output(block_config->output_data_tensor);
+
+    if (block_config->object_detection_last_layer == EI_CLASSIFIER_LAST_LAYER_SSD) {
+        *output_scores = interpreter->output(block_config->output_score_tensor);
+        *output_labels = interpreter->output(block_config->output_labels_tensor);
+    }
+}
+
 /**
  * Setup the TFLite runtime
  *
@@ -74,13 +160,61 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
 
     ei_config_tflite_graph_t *graph_config = (ei_config_tflite_graph_t*)block_config->graph_config;
 
+#if EI_CLASSIFIER_TFLITE_RESIDENT == 1
+    ei_tflite_resident_t *resident_slot = NULL;
+
+    for (size_t ix = 0; ix < EI_CLASSIFIER_TFLITE_RESIDENT_MAX_GRAPHS; ix++) {
+        ei_tflite_resident_t *slot = &ei_tflite_resident[ix];
+        if (slot->interpreter && slot->model == graph_config->model) {
+            // Tensors, op registrations and the arena are already set up. Variable tensors are
+            // cleared so stateful models behave as if the arena was new.
+            *micro_interpreter = slot->interpreter;
+            p_tensor_arena = ei_unique_ptr_t(slot->tensor_arena, [](void*){});
+            slot->interpreter->ResetVariableTensors();
+            inference_tflite_get_tensors(block_config, slot->interpreter, input, output, output_labels, output_scores);
+            ei_tflite_resident_stats.reuses++;
+            return EI_IMPULSE_OK;
+        }
+        if (!slot->interpreter && !resident_slot) {
+            resident_slot = slot;
+        }
+    }
+
+#ifdef EI_CLASSIFIER_ALLOCATION_STATIC
+    // All graphs share the static arena, so only one of them can be resident
+    if (!resident_slot) {
+        ei_tflite_resident_release();
+        resident_slot = &ei_tflite_resident[0];
+    }
+    for (size_t ix = 0; ix < EI_CLASSIFIER_TFLITE_RESIDENT_MAX_GRAPHS; ix++) {
+        if (&ei_tflite_resident[ix] != resident_slot && ei_tflite_resident[ix].interpreter) {
+            ei_tflite_resident_release();
+            break;
+        }
+    }
+#endif // EI_CLASSIFIER_ALLOCATION_STATIC
+#endif // EI_CLASSIFIER_TFLITE_RESIDENT == 1
+
 #ifdef EI_CLASSIFIER_ALLOCATION_STATIC
     // Assign a no-op lambda to the "free" function in case of static arena
     static uint8_t tensor_arena[EI_CLASSIFIER_TFLITE_ARENA_SIZE] ALIGN(16);
     p_tensor_arena = ei_unique_ptr_t(tensor_arena, [](void*){});
 #else
     // Create an area of memory to use for input, output, and intermediate arrays.
+#if EI_CLASSIFIER_TFLITE_RESIDENT == 1
+    uint8_t *tensor_arena;
+    if (resident_slot) {
+        // A resident arena outlives the NN phase. In the scratch arena it would stay at the bottom
+        // and push every later DSP phase above it, so it's taken from the heap instead.
+        EiScratchPhase heap_phase(EI_SCRATCH_PHASE_NONE);
+        tensor_arena = (uint8_t*)ei_aligned_calloc(16, graph_config->arena_size);
+    }
+    else {
+        tensor_arena = (uint8_t*)ei_aligned_calloc(16, graph_config->arena_size);
+    }
+#else
     uint8_t *tensor_arena = (uint8_t*)ei_aligned_calloc(16, graph_config->arena_size);
+#endif // EI_CLASSIFIER_TFLITE_RESIDENT == 1
     if (tensor_arena == NULL) {
         ei_printf("Failed to allocate TFLite arena (%zu bytes)\n", graph_config->arena_size);
         return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
@@ -119,6 +253,9 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
 
 #ifdef EI_TFLITE_RESOLVER
     EI_TFLITE_RESOLVER
+#elif EI_CLASSIFIER_TFLITE_RESIDENT == 1
+    // A resident interpreter keeps a reference to the resolver
+    static tflite::AllOpsResolver resolver;
 #else
     tflite::AllOpsResolver resolver;
 #endif
@@ -136,14 +273,24 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
         return EI_IMPULSE_TFLITE_ERROR;
     }
 
-    // Obtain pointers to the model's input and output tensors.
-    *input = interpreter->input(0);
-    *output = interpreter->output(block_config->output_data_tensor);
+    ei_tflite_resident_stats.builds++;
 
-    if (block_config->object_detection_last_layer == EI_CLASSIFIER_LAST_LAYER_SSD) {
-        *output_scores = interpreter->output(block_config->output_score_tensor);
-        *output_labels = interpreter->output(block_config->output_labels_tensor);
+#if EI_CLASSIFIER_TFLITE_RESIDENT == 1
+    if (resident_slot) {
+        // The slot owns the arena from now on
+        p_tensor_arena.release();
+        p_tensor_arena = ei_unique_ptr_t(tensor_arena, [](void*){});
+
+        resident_slot->model = graph_config->model;
+        resident_slot->interpreter = interpreter;
+        resident_slot->tensor_arena = tensor_arena;
+        resident_slot->arena_size = graph_config->arena_size;
+        ei_tflite_resident_stats.arena_bytes += graph_config->arena_size;
     }
+#endif // EI_CLASSIFIER_TFLITE_RESIDENT == 1
+
+    // Obtain pointers to the model's input and output tensors.
+    inference_tflite_get_tensors(block_config, interpreter, input, output, output_labels, output_scores);
 
     if (tflite_first_run) {
         tflite_first_run = false;
@@ -179,7 +326,7 @@ static EI_IMPULSE_ERROR inference_tflite_run(
     // Run inference, and report any error
     TfLiteStatus invoke_status = interpreter->Invoke();
     if (invoke_status != kTfLiteOk) {
-        delete interpreter;
+        inference_tflite_release_interpreter(interpreter);
         error_reporter->Report("Invoke failed (%d)\n", invoke_status);
         return EI_IMPULSE_TFLITE_ERROR;
     }
@@ -197,7 +344,7 @@ static EI_IMPULSE_ERROR inference_tflite_run(
     EI_IMPULSE_ERROR fill_res = fill_result_struct_from_output_tensor_tflite(
         impulse, output, labels_tensor, scores_tensor, result, debug);
 
-    delete interpreter;
+    inference_tflite_release_interpreter(interpreter);
 
     if (fill_res != EI_IMPULSE_OK) {
         return fill_res;
@@ -262,7 +409,7 @@ EI_IMPULSE_ERROR run_nn_inference_from_dsp(
         return output_res;
     }
 
-    delete interpreter;
+    inference_tflite_release_interpreter(interpreter);
 
     return EI_IMPULSE_OK;
 }
@@ -89,5 +89,17 @@
 #define EIDSP_SIGNAL_C_FN_POINTER    0
 #endif // EIDSP_SIGNAL_C_FN_POINTER
 
+// size of the static region for DSP temporaries (see ei_dsp_arena.h), 0 to only use
+// a region passed to ei::dsp_arena::set_buffer()
+#ifndef EIDSP_ARENA_SIZE
+#define EIDSP_ARENA_SIZE             0
+#endif // EIDSP_ARENA_SIZE
+
+// assert when the DSP arena is full or a dsp_scope closes with blocks still allocated,
+// instead of falling back to the heap, for tests
+#ifndef EIDSP_ARENA_ASSERTS
+#define EIDSP_ARENA_ASSERTS          0
+#endif // EIDSP_ARENA_ASSERTS
+
 // clang-format on
 #endif // _EIDSP_CPP_CONFIG_H_
@@ -24,6 +24,7 @@
 #define __EI_ALLOC__H__
 
 #include "memory.hpp"
+#include "ei_dsp_arena.h"
 
 #if EIDSP_TRACK_ALLOCATIONS
 #include <map>
@@ -42,7 +43,12 @@ struct EiAlloc
     T *allocate(size_t n)
     {
         auto bytes = n * sizeof(T);
-        auto ptr = ei_dsp_malloc(bytes);
+        // std::vector initializes its elements, so the arena doesn't need to clear them
+        auto ptr = dsp_arena::alloc(bytes, false);
+        if (ptr) {
+            return (T *)ptr;
+        }
+        ptr = ei_dsp_malloc(bytes);
 #if EIDSP_TRACK_ALLOCATIONS
         allocs[ptr] = bytes;
 #endif
@@ -51,6 +57,9 @@ struct EiAlloc
 
     void deallocate(T *p, size_t n) noexcept
     {
+        if (dsp_arena::free(p)) {
+            return;
+        }
 #if EIDSP_TRACK_ALLOCATIONS
         auto size_p = allocs.find(p);
         ei_dsp_free(p,size_p->second);
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ei_dsp_arena.h"
+#include <string.h>
+
+#if EIDSP_ARENA_ASSERTS == 1
+#include <assert.h>
+#endif
+
+namespace ei {
+
+// Each block starts with a header linking it to the block below, so blocks freed out of order
+// can be given back once they reach the top
+typedef struct {
+    uint32_t prev;      // offset of the block below, or ARENA_NO_BLOCK
+    uint32_t is_free;
+} arena_block_t;
+
+#define ARENA_ALIGN     8
+#define ARENA_NO_BLOCK  0xffffffff
+
+#if EIDSP_ARENA_SIZE > 0
+static uint64_t static_region[(EIDSP_ARENA_SIZE + 7) / 8];
+static uint8_t *region = (uint8_t *)static_region;
+static size_t region_size = sizeof(static_region);
+#else
+static uint8_t *region = NULL;
+static size_t region_size = 0;
+#endif
+
+static size_t top = 0;
+static uint32_t last_block = ARENA_NO_BLOCK;
+static int scope_depth = 0;
+static size_t peak = 0;
+static uint32_t overflows = 0;
+static uint32_t escapes = 0;
+
+void dsp_arena::set_buffer(void *buffer, size_t size) {
+    if (top != 0) {
+        ei_printf("ERR: dsp_arena::set_buffer called while blocks are allocated\n");
+        return;
+    }
+    region = (uint8_t *)buffer;
+    region_size = buffer ? size : 0;
+    last_block = ARENA_NO_BLOCK;
+}
+
+void *dsp_arena::alloc(size_t size, bool zero) {
+    if (scope_depth == 0 || !region) {
+        return NULL;
+    }
+
+    size_t block_size = sizeof(arena_block_t) + ((size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    if (size > region_size || block_size > region_size - top) {
+        overflows++;
+#if EIDSP_ARENA_ASSERTS == 1
+        ei_printf("ERR: dsp_arena overflow, %u bytes requested, %u of %u in use\n",
+            (unsigned int)size, (unsigned int)top, (unsigned int)region_size);
+        assert(false);
+#endif
+        return NULL;
+    }
+
+    arena_block_t *block = (arena_block_t *)(region + top);
+    block->prev = last_block;
+    block->is_free = 0;
+    last_block = (uint32_t)top;
+
+    top += block_size;
+    if (top > peak) {
+        peak = top;
+    }
+
+    void *ptr = block + 1;
+    if (zero) {
+        memset(ptr, 0, block_size - sizeof(arena_block_t));
+    }
+    return ptr;
+}
+
+bool dsp_arena::free(void *ptr) {
+    uint8_t *p = (uint8_t *)ptr;
+    if (!region || p < region + sizeof(arena_block_t) || p >= region + region_size) {
+        return false;
+    }
+
+    arena_block_t *block = (arena_block_t *)p - 1;
+    block->is_free = 1;
+
+    // Give back the top block and any freed blocks right below it
+    while (last_block != ARENA_NO_BLOCK) {
+        arena_block_t *last = (arena_block_t *)(region + last_block);
+        if (!last->is_free) {
+            break;
+        }
+        top = last_block;
+        last_block = last->prev;
+    }
+    return true;
+}
+
+size_t dsp_arena::size() {
+    return region_size;
+}
+
+size_t dsp_arena::in_use() {
+    return top;
+}
+
+size_t dsp_arena::high_water() {
+    return peak;
+}
+
+uint32_t dsp_arena::overflow_count() {
+    return overflows;
+}
+
+uint32_t dsp_arena::escape_count() {
+    return escapes;
+}
+
+void dsp_arena::reset_stats() {
+    peak = top;
+    overflows = 0;
+    escapes = 0;
+}
+
+void dsp_arena::scope_begin() {
+    scope_depth++;
+}
+
+void dsp_arena::scope_end(size_t marker) {
+    scope_depth--;
+
+    if (top > marker) {
+        // Still allocated, it stays where it is until it's freed
+        escapes++;
+#if EIDSP_ARENA_ASSERTS == 1
+        ei_printf("ERR: dsp_scope closed with %u bytes still allocated\n", (unsigned int)(top - marker));
+        assert(false);
+#endif
+    }
+}
+
+} // namespace ei
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EIDSP_ARENA_H_
+#define _EIDSP_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.hpp"
+#include "../porting/ei_classifier_porting.h"
+
+namespace ei {
+
+/**
+ * LIFO (stack) allocator for DSP temporaries.
+ *
+ * The DSP blocks create and destroy dozens of matrix_t and ei_vector buffers per frame. While a
+ * dsp_scope is open these are taken from the top of a fixed region instead of the heap, which
+ * is a pointer bump, and freeing the block on top is a pointer decrement. A block freed out of
+ * order is marked and its space is given back once everything above it is freed too, so a block
+ * is never reused while it's still allocated.
+ *
+ * Outside of a scope, or if the region is full, allocations go to ei_malloc / ei_calloc as
+ * before. With EIDSP_ARENA_ASSERTS=1 a full region, or a block that is still allocated when its
+ * scope closes, asserts instead, which is meant for tests.
+ *
+ * The region is static (EIDSP_ARENA_SIZE bytes) or can be supplied with set_buffer().
+ */
+class dsp_arena {
+public:
+    /**
+     * Use your own region instead of the static one. Only call this while nothing is allocated from the arena.
+     * @param buffer Region, 8 byte aligned, or NULL to disable the arena
+     * @param size Size in bytes
+     */
+    static void set_buffer(void *buffer, size_t size);
+
+    /**
+     * Allocate from the arena if a scope is open
+     * @param size Number of bytes
+     * @param zero Clear the block. Blocks are not cleared otherwise.
+     * @returns Pointer, or NULL if no scope is open or the block doesn't fit
+     */
+    static void *alloc(size_t size, bool zero);
+
+    /**
+     * Free a block if it's in the arena
+     * @returns true if ptr was in the arena
+     */
+    static bool free(void *ptr);
+
+    /**
+     * Allocate from the arena, or from the heap if that's not possible
+     */
+    static void *allocate(size_t size, bool zero) {
+        void *ptr = alloc(size, zero);
+        if (ptr) {
+            return ptr;
+        }
+        return zero ? ei_calloc(size, 1) : ei_malloc(size);
+    }
+
+    /**
+     * Free a block from allocate()
+     */
+    static void release(void *ptr) {
+        if (!free(ptr)) {
+            ei_free(ptr);
+        }
+    }
+
+    /** Size of the region in bytes */
+    static size_t size();
+
+    /** Bytes in use, including freed blocks that are still below an allocated one */
+    static size_t in_use();
+
+    /** Largest number of bytes that were in use */
+    static size_t high_water();
+
+    /** Number of allocations in a scope that didn't fit and went to the heap */
+    static uint32_t overflow_count();
+
+    /** Number of scopes that closed with blocks they allocated still in use */
+    static uint32_t escape_count();
+
+    /** Reset the high water mark and counters */
+    static void reset_stats();
+
+private:
+    friend class dsp_scope;
+
+    static void scope_begin();
+    static void scope_end(size_t marker);
+};
+
+/**
+ * Marks the top of the arena. Allocations from matrix_t and ei_vector go to the arena while at
+ * least one scope is open. Every block allocated in the scope should be freed when it closes,
+ * which is automatic for locals declared after the scope.
+ */
+class dsp_scope {
+public:
+    dsp_scope() : marker(dsp_arena::in_use()) {
+        dsp_arena::scope_begin();
+    }
+    ~dsp_scope() {
+        dsp_arena::scope_end(marker);
+    }
+
+    dsp_scope(const dsp_scope&) = delete;
+    dsp_scope& operator=(const dsp_scope&) = delete;
+
+private:
+    size_t marker;
+};
+
+} // namespace ei
+
+#endif // _EIDSP_ARENA_H_
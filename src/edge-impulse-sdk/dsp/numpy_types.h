@@ -31,6 +31,9 @@
 #include "config.hpp"
 
 #include "../porting/ei_classifier_porting.h"
+#ifdef __cplusplus
+#include "ei_dsp_arena.h"
+#endif // __cplusplus
 
 #if EIDSP_TRACK_ALLOCATIONS
 #include "memory.hpp"
@@ -91,7 +94,7 @@ typedef struct ei_matrix {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (float*)ei_calloc(n_rows * n_cols * sizeof(float), 1);
+            buffer = (float*)ei::dsp_arena::allocate(n_rows * n_cols * sizeof(float), true);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -116,7 +119,7 @@ typedef struct ei_matrix {
 
     ~ei_matrix() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei::dsp_arena::release(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -188,7 +191,7 @@ typedef struct ei_matrix_i8 {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (int8_t*)ei_calloc(n_rows * n_cols * sizeof(int8_t), 1);
+            buffer = (int8_t*)ei::dsp_arena::allocate(n_rows * n_cols * sizeof(int8_t), true);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -213,7 +216,7 @@ typedef struct ei_matrix_i8 {
 
     ~ei_matrix_i8() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei::dsp_arena::release(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -284,7 +287,7 @@ typedef struct ei_matrix_i32 {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (int32_t*)ei_calloc(n_rows * n_cols * sizeof(int32_t), 1);
+            buffer = (int32_t*)ei::dsp_arena::allocate(n_rows * n_cols * sizeof(int32_t), true);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -309,7 +312,7 @@ typedef struct ei_matrix_i32 {
 
     ~ei_matrix_i32() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei::dsp_arena::release(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -391,7 +394,7 @@ typedef struct ei_quantized_matrix {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (uint8_t*)ei_calloc(n_rows * n_cols * sizeof(uint8_t), 1);
+            buffer = (uint8_t*)ei::dsp_arena::allocate(n_rows * n_cols * sizeof(uint8_t), true);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -416,7 +419,7 @@ typedef struct ei_quantized_matrix {
 
     ~ei_quantized_matrix() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei::dsp_arena::release(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -487,7 +490,7 @@ typedef struct ei_matrix_u8 {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (uint8_t*)ei_calloc(n_rows * n_cols * sizeof(uint8_t), 1);
+            buffer = (uint8_t*)ei::dsp_arena::allocate(n_rows * n_cols * sizeof(uint8_t), true);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -512,7 +515,7 @@ typedef struct ei_matrix_u8 {
 
     ~ei_matrix_u8() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei::dsp_arena::release(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -194,6 +194,8 @@ public:
         ei_dsp_config_spectral_analysis_t *config_ptr,
         const float sampling_freq)
     {
+        dsp_scope scope;
+
         // scale the signal
         int ret = numpy::scale(input_matrix, config_ptr->scale_axes);
         if (ret != EIDSP_OK) {
@@ -476,6 +478,8 @@ public:
         ei_dsp_config_spectral_analysis_t *config,
         const float sampling_freq)
     {
+        dsp_scope scope;
+
         size_t n_features =
             extract_spec_features(input_matrix, output_matrix, config, sampling_freq);
         return n_features == output_matrix->cols ? EIDSP_OK : EIDSP_MATRIX_SIZE_MISMATCH;
@@ -510,17 +514,22 @@ public:
         return {0}; // to make linter happy
     }
 
-    // can do in-place or out-of-place
-    static size_t _decimate(matrix_t *input_matrix, matrix_t *output_matrix, size_t ratio)
+    /**
+     * @brief Get the anti-aliasing filter used by _decimate
+     * @param ratio Decimation ratio, 3 or 10
+     * @param sos Set to the 4 second-order sections (24 coefficients)
+     * @param sos_zi Set to the initial conditions for a step input of 1 (8 values)
+     */
+    static void get_decimate_sos(size_t ratio, const float **sos, const float **sos_zi)
     {
         // generated by build_sav4_header in prepare.py
-        static float sos_deci_3[] = {
+        static const float sos_deci_3[] = {
             3.4799547399084973e-05f, 6.959909479816995e-05f, 3.4799547399084973e-05f, 1.0f, -1.416907422639627f, 0.5204552955670066f, 1.0f, 2.0f, 1.0f, 1.0f, -1.3342748248687593f, 0.594631953081447f, 1.0f, 2.0f, 1.0f, 1.0f, -1.237675162600336f, 0.7259326611233617f, 1.0f, 2.0f, 1.0f, 1.0f, -1.2180861262950025f, 0.8987833581253264};
-        static float sos_zi_deci_3[] = { 0.0013094887094341828f, -0.0006648423946383296f,
+        static const float sos_zi_deci_3[] = { 0.0013094887094341828f, -0.0006648423946383296f,
                                          0.0193087012128479f,    -0.010936639208493802f,
                                          0.1485445305451165f,    -0.10217301649013415f,
                                          0.8250625539381586f,    -0.7244268881025758 };
-        static float sos_deci_10[] = { 3.5863243209995215e-09f,
+        static const float sos_deci_10[] = { 3.5863243209995215e-09f,
                                        7.172648641999043e-09f,
                                        3.5863243209995215e-09f,
                                        1.0f,
@@ -544,15 +553,23 @@ public:
                                        1.0f,
                                        -1.8965395961864169f,
                                        0.9644245584642932 };
-        static float sos_zi_deci_10[] = { 1.38071060429997e-06f,   -1.146570262401316e-06f,
+        static const float sos_zi_deci_10[] = { 1.38071060429997e-06f,   -1.146570262401316e-06f,
                                           0.00020862168862901534f, -0.0001782374705409433f,
                                           0.016663820918116152f,   -0.015002020730727955f,
                                           0.9773862470492868f,     -0.9420150059170858 };
 
         assert(ratio == 3 || ratio == 10);
 
-        float* sos = ratio == 3 ? sos_deci_3 : sos_deci_10;
-        float* sos_zi = ratio == 3 ? sos_zi_deci_3 : sos_zi_deci_10;
+        *sos = ratio == 3 ? sos_deci_3 : sos_deci_10;
+        *sos_zi = ratio == 3 ? sos_zi_deci_3 : sos_zi_deci_10;
+    }
+
+    // can do in-place or out-of-place
+    static size_t _decimate(matrix_t *input_matrix, matrix_t *output_matrix, size_t ratio)
+    {
+        const float *sos;
+        const float *sos_zi;
+        get_decimate_sos(ratio, &sos, &sos_zi);
 
         const size_t out_size = signal::get_decimated_size(input_matrix->cols, ratio);
 
@@ -578,6 +595,8 @@ public:
         ei_dsp_config_spectral_analysis_t *config,
         const float sampling_freq)
     {
+        dsp_scope scope;
+
         if (strcmp(config->analysis_type, "Wavelet") == 0) {
             return wavelet::extract_wavelet_features(input_matrix, output_matrix, config, sampling_freq);
         }
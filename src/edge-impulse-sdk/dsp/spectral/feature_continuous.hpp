@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EIDSP_SPECTRAL_FEATURE_CONTINUOUS_H_
+#define _EIDSP_SPECTRAL_FEATURE_CONTINUOUS_H_
+
+#include <math.h>
+#include "feature.hpp"
+#include "signal.hpp"
+#include "../numpy.hpp"
+
+namespace ei {
+namespace spectral {
+
+/**
+ * @brief Sliced (continuous) version of the spectral analysis FFT features
+ *
+ * The window is built from slices. The work that only depends on each sample is done once per slice
+ * instead of once per window:
+ *  - decimation, with the sosfilt state kept between slices
+ *  - the Butterworth filter, with its w1/w2 state kept between slices
+ *  - per-slice mean and central moments, which are merged into window statistics
+ *  - power spectra of FFT frames that are entirely inside the window
+ *
+ * Only the frames that contain new samples are transformed for each slice. For a window of 4 slices,
+ * that is about a quarter of the FFTs of the batch version.
+ *
+ * The output has the same layout as extract_spectral_analysis_features_v2/v4. The filters run
+ * continuously instead of restarting from zero state at each window, so there is no filter start-up
+ * transient. The features are equal to the batch features for the first window and very close
+ * after that.
+ */
+class feature_continuous {
+public:
+    feature_continuous() { }
+
+    /**
+     * @brief Check the configuration and allocate the state
+     * @param config Spectral analysis DSP block config. Only analysis type FFT, implementation version 2 to 4,
+     * and extra_low_freq false are supported.
+     * @param sampling_freq Sampling frequency of the raw signal
+     * @param slice_size Number of samples (per axis) in each slice
+     * @param slices_per_window Number of slices in the window
+     * @returns 0 when successful
+     */
+    int init(
+        ei_dsp_config_spectral_analysis_t *config,
+        float sampling_freq,
+        size_t slice_size,
+        size_t slices_per_window)
+    {
+        if (strcmp(config->analysis_type, "FFT") != 0 || config->implementation_version < 2 ||
+            config->extra_low_freq) {
+            ei_printf("ERR: Continuous spectral analysis only supports FFT (version 2 and up) without extra low frequency features\n");
+            EIDSP_ERR(EIDSP_NOT_SUPPORTED);
+        }
+        if (config->axes <= 0 || slice_size == 0 || slices_per_window == 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        // only implementation version 4 decimates the input
+        int ratio = (config->implementation_version >= 4 && config->input_decimation_ratio > 1) ?
+            config->input_decimation_ratio : 1;
+        if (slice_size % ratio != 0) {
+            ei_printf("ERR: Slice size (%d) must be a multiple of the decimation ratio (%d)\n", (int)slice_size, ratio);
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        this->config = config;
+        this->axes = config->axes;
+        this->raw_slice_size = slice_size;
+        this->slice_size = slice_size / ratio;
+        this->slices_per_window = slices_per_window;
+        this->window_size = this->slice_size * slices_per_window;
+        this->freq = sampling_freq / ratio;
+        this->fft_length = config->fft_length;
+        this->hop = config->do_fft_overlap ? fft_length / 2 : fft_length;
+
+        // decimation stages, each with 4 second-order sections of state per axis
+        deci_stages.clear();
+        if (ratio > 1) {
+            ei_vector<int> ratio_combo = feature::get_ratio_combo(ratio);
+            for (int r : ratio_combo) {
+                deci_stages.push_back(r);
+            }
+        }
+        deci_zi.assign(deci_stages.size() * axes * 8, 0.0f);
+
+        // Butterworth filter coefficients, same as filters::butterworth_lowpass/highpass
+        filter_type = filter_none;
+        if (strcmp(config->filter_type, "low") == 0) {
+            filter_type = filter_lowpass;
+        }
+        else if (strcmp(config->filter_type, "high") == 0) {
+            filter_type = filter_highpass;
+        }
+        filter_steps = (filter_type != filter_none) ? config->filter_order / 2 : 0;
+        filter_coeff.assign(filter_steps * 3, 0.0f);
+        if (filter_steps > 0) {
+            float a = tan(M_PI * config->filter_cutoff / freq);
+            float a2 = pow(a, 2);
+            for (size_t ix = 0; ix < filter_steps; ix++) {
+                float r = sin(M_PI * ((2.0 * ix) + 1.0) / (2.0 * config->filter_order));
+                float s = a2 + (2.0 * a * r) + 1.0;
+                filter_coeff[ix * 3] = (filter_type == filter_lowpass) ? a2 / s : 1.0f / s;
+                filter_coeff[ix * 3 + 1] = 2.0 * (1 - a2) / s;
+                filter_coeff[ix * 3 + 2] = -(a2 - (2.0 * a * r) + 1.0) / s;
+            }
+        }
+        filter_w.assign(axes * filter_steps * 2, 0.0f);
+
+        window.assign(axes * window_size, 0.0f);
+        moments.assign(axes * slices_per_window * 4, 0.0f);
+
+        // power spectra of whole frames are only reusable if frames stay aligned as the window moves
+        fft_out_size = fft_length / 2 + 1;
+        size_t frames = (window_size >= fft_length && slice_size % hop == 0) ? (window_size - fft_length) / hop + 1 : 0;
+        cache_frames = frames;
+        cache.assign(axes * cache_frames * fft_out_size, 0.0f);
+        cache_sum.assign(axes * cache_frames, 0.0f);
+        cache_id.assign(axes * cache_frames, -1);
+
+        initialized = true;
+        reset();
+        return EIDSP_OK;
+    }
+
+    /**
+     * @brief Returns true if init() was called with this config and slice size
+     */
+    bool is_initialized_for(ei_dsp_config_spectral_analysis_t *config, size_t slice_size, size_t slices_per_window) const
+    {
+        return initialized && this->config == config && this->raw_slice_size == slice_size &&
+            this->slices_per_window == slices_per_window;
+    }
+
+    /**
+     * @brief Clear the filter state and window, for example when the sensor is restarted
+     */
+    void reset()
+    {
+        slices_added = 0;
+        std::fill(deci_zi.begin(), deci_zi.end(), 0.0f);
+        std::fill(filter_w.begin(), filter_w.end(), 0.0f);
+        std::fill(window.begin(), window.end(), 0.0f);
+        std::fill(moments.begin(), moments.end(), 0.0f);
+        std::fill(cache_id.begin(), cache_id.end(), -1);
+    }
+
+    /**
+     * @brief Add a slice to the window
+     * @param slice Matrix with one row per axis, raw_slice_size columns, already scaled. Modified in place.
+     * @returns 0 when successful
+     */
+    int add_slice(matrix_t *slice)
+    {
+        if (!initialized || slice->rows != axes || slice->cols != raw_slice_size) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        const size_t slot = slices_added % slices_per_window;
+
+        for (size_t axis = 0; axis < axes; axis++) {
+            float *x = slice->get_row_ptr(axis);
+            size_t n = raw_slice_size;
+
+            // decimate in place, keeping the state of each stage
+            for (size_t stage = 0; stage < deci_stages.size(); stage++) {
+                const size_t r = deci_stages[stage];
+                const float *sos;
+                const float *sos_zi;
+                feature::get_decimate_sos(r, &sos, &sos_zi);
+
+                float *zi = &deci_zi[(stage * axes + axis) * 8];
+                if (slices_added == 0) {
+                    // same initial conditions as signal::decimate_simple
+                    for (size_t ix = 0; ix < 8; ix++) {
+                        zi[ix] = sos_zi[ix] * x[0];
+                    }
+                }
+                for (size_t sect = 0; sect < 4; sect++) {
+                    signal::iir2(x, x, n, sos + sect * 6, sos + sect * 6 + 3, zi + sect * 2);
+                }
+                for (size_t ix = 0; ix < n / r; ix++) {
+                    x[ix] = x[ix * r];
+                }
+                n /= r;
+            }
+
+            // Butterworth filter, keeping w1 and w2
+            float *w = &filter_w[axis * filter_steps * 2];
+            for (size_t sx = 0; sx < n && filter_steps > 0; sx++) {
+                float v = x[sx];
+                for (size_t i = 0; i < filter_steps; i++) {
+                    const float A = filter_coeff[i * 3];
+                    const float d1 = filter_coeff[i * 3 + 1];
+                    const float d2 = filter_coeff[i * 3 + 2];
+                    float w0 = d1 * w[i * 2] + d2 * w[i * 2 + 1] + v;
+                    if (filter_type == filter_lowpass) {
+                        v = A * (w0 + (2.0 * w[i * 2]) + w[i * 2 + 1]);
+                    }
+                    else {
+                        v = A * (w0 - (2.0 * w[i * 2]) + w[i * 2 + 1]);
+                    }
+                    w[i * 2 + 1] = w[i * 2];
+                    w[i * 2] = w0;
+                }
+                x[sx] = v;
+            }
+
+            // slide the window
+            float *win = &window[axis * window_size];
+            memmove(win, win + slice_size, (window_size - slice_size) * sizeof(float));
+            memcpy(win + window_size - slice_size, x, slice_size * sizeof(float));
+
+            // mean and central moment sums of this slice (two pass, so they're accurate with a large offset)
+            float mean = 0;
+            for (size_t ix = 0; ix < slice_size; ix++) {
+                mean += x[ix];
+            }
+            mean /= slice_size;
+
+            float m2 = 0, m3 = 0, m4 = 0;
+            for (size_t ix = 0; ix < slice_size; ix++) {
+                float d = x[ix] - mean;
+                float d2 = d * d;
+                m2 += d2;
+                m3 += d2 * d;
+                m4 += d2 * d2;
+            }
+            float *m = &moments[(axis * slices_per_window + slot) * 4];
+            m[0] = mean;
+            m[1] = m2;
+            m[2] = m3;
+            m[3] = m4;
+        }
+
+        slices_added++;
+        return EIDSP_OK;
+    }
+
+    /**
+     * @brief Returns true once enough slices have been added to fill the window
+     */
+    bool is_window_full() const
+    {
+        return slices_added >= slices_per_window;
+    }
+
+    /**
+     * @brief Calculate the features of the current window
+     * @param output_matrix Output, same size as for extract_spectral_analysis_features_v2/v4
+     * @returns the number of features calculated
+     */
+    size_t extract(matrix_t *output_matrix)
+    {
+        size_t start_bin, stop_bin;
+        if (filter_type != filter_none) {
+            feature::get_start_stop_bin(freq, fft_length, config->filter_cutoff, &start_bin, &stop_bin,
+                filter_type == filter_highpass);
+        }
+        else {
+            start_bin = 1;
+            stop_bin = fft_length / 2 + 1;
+        }
+        const size_t num_bins = stop_bin - start_bin;
+
+        ei_vector<float> fft_out(fft_out_size);
+        ei_vector<float> frame_out(fft_out_size);
+        ei_vector<float> frame(fft_length);
+
+        // absolute index of the first sample in the window, used to identify cached frames
+        const int64_t window_start = (int64_t)(slices_added - slices_per_window) * slice_size;
+
+        float *feature_out = output_matrix->buffer;
+        const float *feature_out_ori = feature_out;
+
+        for (size_t axis = 0; axis < axes; axis++) {
+            float *win = &window[axis * window_size];
+
+            // merge the slice moments (Chan et al. / Pebay pairwise update)
+            float n = 0, mean = 0, m2 = 0, m3 = 0, m4 = 0;
+            for (size_t s = 0; s < slices_per_window; s++) {
+                const float *mb = &moments[(axis * slices_per_window + s) * 4];
+                const float na = n;
+                const float nb = slice_size;
+                n = na + nb;
+                const float delta = mb[0] - mean;
+                const float delta_n = delta / n;
+                const float term = delta * delta_n * na * nb;
+
+                m4 += mb[3] + term * delta_n * delta_n * (na * na - na * nb + nb * nb) +
+                    6 * delta_n * delta_n * (na * na * mb[1] + nb * nb * m2) +
+                    4 * delta_n * (na * mb[2] - nb * m3);
+                m3 += mb[2] + term * delta_n * (na - nb) + 3 * delta_n * (na * mb[1] - nb * m2);
+                m2 += mb[1] + term;
+                mean += delta * nb / n;
+            }
+
+            // RMS of the mean-subtracted signal, which is also the standard deviation
+            float rms = sqrt(m2 / n);
+            *feature_out++ = rms;
+
+            float stddev = rms == 0.0f ? 1e-10f : rms;
+            float temp = stddev * stddev * stddev;
+            *feature_out++ = (m3 / n) / temp;
+            *feature_out++ = ((m4 / n) / (temp * stddev)) - 3;
+
+            // Welch max hold over the frames of the window
+            std::fill(fft_out.begin(), fft_out.end(), 0.0f);
+            for (size_t start = 0; start < window_size; start += hop) {
+                const float *p;
+                if (start + fft_length <= window_size) {
+                    // Whole frame: the spectrum of the frame without the mean subtracted only differs in the DC bin
+                    float sum;
+                    const int64_t id = (window_start + start) / hop;
+                    const size_t slot = cache_frames ? (size_t)(id % cache_frames) : 0;
+                    if (cache_frames && cache_id[axis * cache_frames + slot] == id) {
+                        p = &cache[(axis * cache_frames + slot) * fft_out_size];
+                        sum = cache_sum[axis * cache_frames + slot];
+                    }
+                    else {
+                        float *out = cache_frames ? &cache[(axis * cache_frames + slot) * fft_out_size] : frame_out.data();
+                        if (numpy::power_spectrum(win + start, fft_length, out, fft_out_size, fft_length) != EIDSP_OK) {
+                            return 0;
+                        }
+                        sum = 0;
+                        for (size_t ix = 0; ix < fft_length; ix++) {
+                            sum += win[start + ix];
+                        }
+                        if (cache_frames) {
+                            cache_sum[axis * cache_frames + slot] = sum;
+                            cache_id[axis * cache_frames + slot] = id;
+                        }
+                        p = out;
+                    }
+                    float dc = sum - mean * fft_length;
+                    fft_out[0] = std::max(fft_out[0], dc * dc / fft_length);
+                    for (size_t ix = 1; ix < fft_out_size; ix++) {
+                        fft_out[ix] = std::max(fft_out[ix], p[ix]);
+                    }
+                }
+                else {
+                    // Partial frame at the end, zero padded after subtracting the mean
+                    size_t count = window_size - start;
+                    for (size_t ix = 0; ix < count; ix++) {
+                        frame[ix] = win[start + ix] - mean;
+                    }
+                    if (numpy::power_spectrum(frame.data(), count, frame_out.data(), fft_out_size, fft_length) != EIDSP_OK) {
+                        return 0;
+                    }
+                    for (size_t ix = 0; ix < fft_out_size; ix++) {
+                        fft_out[ix] = std::max(fft_out[ix], frame_out[ix]);
+                    }
+                }
+            }
+
+            if (config->implementation_version == 4) {
+                matrix_t x(1, fft_out.size(), fft_out.data());
+                matrix_t out(1, 1);
+
+                *feature_out++ = (numpy::skew(&x, &out) == EIDSP_OK) ? (out.get_row_ptr(0)[0]) : 0.0f;
+                *feature_out++ = (numpy::kurtosis(&x, &out) == EIDSP_OK) ? (out.get_row_ptr(0)[0]) : 0.0f;
+            }
+            for (size_t i = start_bin; i < stop_bin; i++) {
+                feature_out[i - start_bin] = fft_out[i];
+            }
+            if (config->do_log) {
+                numpy::zero_handling(feature_out, num_bins);
+                ei_matrix temp(num_bins, 1, feature_out);
+                numpy::log10(&temp);
+            }
+            feature_out += num_bins;
+        }
+
+        return feature_out - feature_out_ori;
+    }
+
+private:
+    bool initialized = false;
+    ei_dsp_config_spectral_analysis_t *config = nullptr;
+    size_t axes = 0;
+    size_t raw_slice_size = 0;      // samples per axis in each slice, before decimation
+    size_t slice_size = 0;          // after decimation
+    size_t slices_per_window = 0;
+    size_t window_size = 0;         // after decimation
+    float freq = 0;                 // after decimation
+    size_t fft_length = 0;
+    size_t fft_out_size = 0;
+    size_t hop = 0;
+    uint32_t slices_added = 0;
+
+    ei_vector<int> deci_stages;     // decimation ratio of each stage
+    ei_vector<float> deci_zi;       // [stage][axis][8] sosfilt state
+
+    filter_t filter_type = filter_none;
+    size_t filter_steps = 0;
+    ei_vector<float> filter_coeff;  // [step][A, d1, d2]
+    ei_vector<float> filter_w;      // [axis][step][w1, w2]
+
+    ei_vector<float> window;        // [axis][window_size] filtered samples
+    ei_vector<float> moments;       // [axis][slice][mean, M2, M3, M4]
+
+    size_t cache_frames = 0;        // whole frames per window, 0 if frames can't be reused
+    ei_vector<float> cache;         // [axis][frame][fft_out_size] power spectra
+    ei_vector<float> cache_sum;     // [axis][frame] sum of the samples in the frame
+    ei_vector<int64_t> cache_id;    // [axis][frame] absolute frame number, -1 if empty
+};
+
+} // namespace spectral
+} // namespace ei
+
+#endif // _EIDSP_SPECTRAL_FEATURE_CONTINUOUS_H_
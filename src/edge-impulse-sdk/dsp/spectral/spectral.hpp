@@ -21,5 +21,6 @@
 #include "../config.hpp"
 #include "processing.hpp"
 #include "feature.hpp"
+#include "feature_continuous.hpp"
 
 #endif // _EIDSP_SPECTRAL_SPECTRAL_H_
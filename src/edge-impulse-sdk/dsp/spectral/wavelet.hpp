@@ -32,252 +32,269 @@ namespace spectral {
 
 using fvec = ei_vector<float>;
 
-inline float dot(const float *x, const float *y, size_t sz)
-{
-    float sum = 0.0f;
-    for (size_t i = 0; i < sz; i++) {
-        sum += x[i] * y[i];
-    }
-    return sum;
-}
-
-inline void histo(const fvec &x, size_t nbins, fvec &h, bool normalize = false)
-{
-    float min = *std::min_element(x.begin(), x.end());
-    float max = *std::max_element(x.begin(), x.end());
-    float step = (max - min) / nbins;
-    h.resize(nbins);
-    for (size_t i = 0; i < x.size(); i++) {
-        size_t bin = (x[i] - min) / step;
-        if (bin >= nbins)
-            bin = nbins - 1;
-        h[bin]++;
-    }
-    if (normalize) {
-        float s = numpy::sum(h.data(), h.size());
-        for (size_t i = 0; i < nbins; i++) {
-            h[i] /= s;
-        }
-    }
-}
-
 class wavelet {
 
     static constexpr size_t NUM_FEATHERS_PER_COMP = 14;
+    static constexpr size_t NUM_HISTO_BINS = 100;
+
+    /**
+     * Decomposition filter pair of a wavelet. The coefficients are used in reverse order
+     * directly from wavelet_coeff.hpp, so nothing is copied.
+     */
+    typedef struct {
+        const char *name;
+        const float *dec_lo;
+        const float *dec_hi;
+        size_t size;
+    } wavelet_filter_t;
 
     template <size_t wave_size>
-    static void get_filter(const std::array<std::array<float, wave_size>, 2> wav, fvec &h, fvec &g)
+    static wavelet_filter_t get_filter(const char *name, const std::array<std::array<float, wave_size>, 2> &wav)
     {
-        size_t n = wav[0].size();
-        h.resize(n);
-        g.resize(n);
-        for (size_t i = 0; i < n; i++) {
-            h[i] = wav[0][n - i - 1];
-            g[i] = wav[1][n - i - 1];
-        }
+        return { name, wav[0].data(), wav[1].data(), wave_size };
     }
 
-    static void find_filter(const char *wav, fvec &h, fvec &g)
+    static const wavelet_filter_t *find_filter(const char *wav)
     {
-        if (strcmp(wav, "bior1.3") == 0) get_filter<6>(bior1p3, h, g);
-        else if (strcmp(wav, "bior1.5") == 0) get_filter<10>(bior1p5, h, g);
-        else if (strcmp(wav, "bior2.2") == 0) get_filter<6>(bior2p2, h, g);
-        else if (strcmp(wav, "bior2.4") == 0) get_filter<10>(bior2p4, h, g);
-        else if (strcmp(wav, "bior2.6") == 0) get_filter<14>(bior2p6, h, g);
-        else if (strcmp(wav, "bior2.8") == 0) get_filter<18>(bior2p8, h, g);
-        else if (strcmp(wav, "bior3.1") == 0) get_filter<4>(bior3p1, h, g);
-        else if (strcmp(wav, "bior3.3") == 0) get_filter<8>(bior3p3, h, g);
-        else if (strcmp(wav, "bior3.5") == 0) get_filter<12>(bior3p5, h, g);
-        else if (strcmp(wav, "bior3.7") == 0) get_filter<16>(bior3p7, h, g);
-        else if (strcmp(wav, "bior3.9") == 0) get_filter<20>(bior3p9, h, g);
-        else if (strcmp(wav, "bior4.4") == 0) get_filter<10>(bior4p4, h, g);
-        else if (strcmp(wav, "bior5.5") == 0) get_filter<12>(bior5p5, h, g);
-        else if (strcmp(wav, "bior6.8") == 0) get_filter<18>(bior6p8, h, g);
-        else if (strcmp(wav, "coif1") == 0) get_filter<6>(coif1, h, g);
-        else if (strcmp(wav, "coif2") == 0) get_filter<12>(coif2, h, g);
-        else if (strcmp(wav, "coif3") == 0) get_filter<18>(coif3, h, g);
-        else if (strcmp(wav, "db2") == 0) get_filter<4>(db2, h, g);
-        else if (strcmp(wav, "db3") == 0) get_filter<6>(db3, h, g);
-        else if (strcmp(wav, "db4") == 0) get_filter<8>(db4, h, g);
-        else if (strcmp(wav, "db5") == 0) get_filter<10>(db5, h, g);
-        else if (strcmp(wav, "db6") == 0) get_filter<12>(db6, h, g);
-        else if (strcmp(wav, "db7") == 0) get_filter<14>(db7, h, g);
-        else if (strcmp(wav, "db8") == 0) get_filter<16>(db8, h, g);
-        else if (strcmp(wav, "db9") == 0) get_filter<18>(db9, h, g);
-        else if (strcmp(wav, "db10") == 0) get_filter<20>(db10, h, g);
-        else if (strcmp(wav, "haar") == 0) get_filter<2>(haar, h, g);
-        else if (strcmp(wav, "rbio1.3") == 0) get_filter<6>(rbio1p3, h, g);
-        else if (strcmp(wav, "rbio1.5") == 0) get_filter<10>(rbio1p5, h, g);
-        else if (strcmp(wav, "rbio2.2") == 0) get_filter<6>(rbio2p2, h, g);
-        else if (strcmp(wav, "rbio2.4") == 0) get_filter<10>(rbio2p4, h, g);
-        else if (strcmp(wav, "rbio2.6") == 0) get_filter<14>(rbio2p6, h, g);
-        else if (strcmp(wav, "rbio2.8") == 0) get_filter<18>(rbio2p8, h, g);
-        else if (strcmp(wav, "rbio3.1") == 0) get_filter<4>(rbio3p1, h, g);
-        else if (strcmp(wav, "rbio3.3") == 0) get_filter<8>(rbio3p3, h, g);
-        else if (strcmp(wav, "rbio3.5") == 0) get_filter<12>(rbio3p5, h, g);
-        else if (strcmp(wav, "rbio3.7") == 0) get_filter<16>(rbio3p7, h, g);
-        else if (strcmp(wav, "rbio3.9") == 0) get_filter<20>(rbio3p9, h, g);
-        else if (strcmp(wav, "rbio4.4") == 0) get_filter<10>(rbio4p4, h, g);
-        else if (strcmp(wav, "rbio5.5") == 0) get_filter<12>(rbio5p5, h, g);
-        else if (strcmp(wav, "rbio6.8") == 0) get_filter<18>(rbio6p8, h, g);
-        else if (strcmp(wav, "sym2") == 0) get_filter<4>(sym2, h, g);
-        else if (strcmp(wav, "sym3") == 0) get_filter<6>(sym3, h, g);
-        else if (strcmp(wav, "sym4") == 0) get_filter<8>(sym4, h, g);
-        else if (strcmp(wav, "sym5") == 0) get_filter<10>(sym5, h, g);
-        else if (strcmp(wav, "sym6") == 0) get_filter<12>(sym6, h, g);
-        else if (strcmp(wav, "sym7") == 0) get_filter<14>(sym7, h, g);
-        else if (strcmp(wav, "sym8") == 0) get_filter<16>(sym8, h, g);
-        else if (strcmp(wav, "sym9") == 0) get_filter<18>(sym9, h, g);
-        else if (strcmp(wav, "sym10") == 0) get_filter<20>(sym10, h, g);
-        else assert(0); // wavelet not in the list
-    }
+        static const wavelet_filter_t filters[] = {
+            get_filter<6>("bior1.3", bior1p3),
+            get_filter<10>("bior1.5", bior1p5),
+            get_filter<6>("bior2.2", bior2p2),
+            get_filter<10>("bior2.4", bior2p4),
+            get_filter<14>("bior2.6", bior2p6),
+            get_filter<18>("bior2.8", bior2p8),
+            get_filter<4>("bior3.1", bior3p1),
+            get_filter<8>("bior3.3", bior3p3),
+            get_filter<12>("bior3.5", bior3p5),
+            get_filter<16>("bior3.7", bior3p7),
+            get_filter<20>("bior3.9", bior3p9),
+            get_filter<10>("bior4.4", bior4p4),
+            get_filter<12>("bior5.5", bior5p5),
+            get_filter<18>("bior6.8", bior6p8),
+            get_filter<6>("coif1", coif1),
+            get_filter<12>("coif2", coif2),
+            get_filter<18>("coif3", coif3),
+            get_filter<4>("db2", db2),
+            get_filter<6>("db3", db3),
+            get_filter<8>("db4", db4),
+            get_filter<10>("db5", db5),
+            get_filter<12>("db6", db6),
+            get_filter<14>("db7", db7),
+            get_filter<16>("db8", db8),
+            get_filter<18>("db9", db9),
+            get_filter<20>("db10", db10),
+            get_filter<2>("haar", haar),
+            get_filter<6>("rbio1.3", rbio1p3),
+            get_filter<10>("rbio1.5", rbio1p5),
+            get_filter<6>("rbio2.2", rbio2p2),
+            get_filter<10>("rbio2.4", rbio2p4),
+            get_filter<14>("rbio2.6", rbio2p6),
+            get_filter<18>("rbio2.8", rbio2p8),
+            get_filter<4>("rbio3.1", rbio3p1),
+            get_filter<8>("rbio3.3", rbio3p3),
+            get_filter<12>("rbio3.5", rbio3p5),
+            get_filter<16>("rbio3.7", rbio3p7),
+            get_filter<20>("rbio3.9", rbio3p9),
+            get_filter<10>("rbio4.4", rbio4p4),
+            get_filter<12>("rbio5.5", rbio5p5),
+            get_filter<18>("rbio6.8", rbio6p8),
+            get_filter<4>("sym2", sym2),
+            get_filter<6>("sym3", sym3),
+            get_filter<8>("sym4", sym4),
+            get_filter<10>("sym5", sym5),
+            get_filter<12>("sym6", sym6),
+            get_filter<14>("sym7", sym7),
+            get_filter<16>("sym8", sym8),
+            get_filter<18>("sym9", sym9),
+            get_filter<20>("sym10", sym10),
+        };
+
+        // the config string doesn't change, so only search when we see a new one
+        static const char *last_wav = nullptr;
+        static const wavelet_filter_t *last_filter = nullptr;
+        if (wav == last_wav) {
+            return last_filter;
+        }
 
-    static void calculate_entropy(const fvec &y, fvec &features)
-    {
-        fvec h;
-        histo(y, 100, h, true);
-        // entropy = -sum(prob * log(prob)
-        float entropy = 0.0f;
-        for (size_t i = 0; i < h.size(); i++) {
-            if (h[i] > 0.0f) {
-                entropy -= h[i] * log(h[i]);
+        for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
+            if (strcmp(wav, filters[i].name) == 0) {
+                last_wav = wav;
+                last_filter = &filters[i];
+                return last_filter;
             }
         }
-        features.push_back(entropy);
+        return nullptr; // wavelet not in the list
     }
 
-    static float get_percentile_from_sorted(const fvec &sorted, float percentile)
+    static size_t get_percentile_index(size_t size, float percentile)
     {
         // adding 0.5 is a trick to get rounding out of C flooring behavior during cast
-        size_t index = (size_t) ((percentile * (sorted.size()-1)) + 0.5);
-        return sorted[index];
-    }
-
-    static void calculate_statistics(const fvec &y, fvec &features, float mean)
-    {
-        fvec sorted = y;
-        std::sort(sorted.begin(), sorted.end());
-        features.push_back(get_percentile_from_sorted(sorted,0.05));
-        features.push_back(get_percentile_from_sorted(sorted,0.25));
-        features.push_back(get_percentile_from_sorted(sorted,0.75));
-        features.push_back(get_percentile_from_sorted(sorted,0.95));
-        features.push_back(get_percentile_from_sorted(sorted,0.5));
-
-        matrix_t x(1, y.size(), const_cast<float *>(y.data()));
-        matrix_t out(1, 1);
-
-        features.push_back(mean);
-        if (numpy::stdev(&x, &out) == EIDSP_OK)
-            features.push_back(out.get_row_ptr(0)[0]);
-        features.push_back(numpy::variance(const_cast<float *>(y.data()), y.size()));
-        if (numpy::rms(&x, &out) == EIDSP_OK)
-            features.push_back(out.get_row_ptr(0)[0]);
-        if (numpy::skew(&x, &out) == EIDSP_OK)
-            features.push_back(out.get_row_ptr(0)[0]);
-        if (numpy::kurtosis(&x, &out) == EIDSP_OK)
-            features.push_back(out.get_row_ptr(0)[0]);
+        return (size_t) ((percentile * (size-1)) + 0.5);
     }
 
-    static void calculate_crossings(const fvec &y, fvec &features, float mean)
+    /**
+     * Write the 14 features of one component. y is scratch and is reordered.
+     */
+    static void extract_features(float *y, size_t n, float *features)
     {
+        // first pass: mean, range, power and zero crossings
+        float sum = 0.0f;
+        float sum_sq = 0.0f;
+        float min = y[0];
+        float max = y[0];
         size_t zc = 0;
-        for (size_t i = 1; i < y.size(); i++) {
-            if (y[i] * y[i - 1] < 0) {
+        for (size_t i = 0; i < n; i++) {
+            float v = y[i];
+            sum += v;
+            sum_sq += v * v;
+            min = std::min(min, v);
+            max = std::max(max, v);
+            if (i > 0 && v * y[i - 1] < 0) {
                 zc++;
             }
         }
-        features.push_back(zc / (float)y.size());
+        const float mean = sum / n;
 
+        // second pass: mean crossings, central moments and histogram
         size_t mc = 0;
-        for (size_t i = 1; i < y.size(); i++) {
-            if ((y[i] - mean) * (y[i - 1] - mean) < 0) {
+        float m2 = 0.0f;
+        float m3 = 0.0f;
+        float m4 = 0.0f;
+        uint32_t h[NUM_HISTO_BINS] = { 0 };
+        const float step = (max - min) / NUM_HISTO_BINS;
+        for (size_t i = 0; i < n; i++) {
+            float diff = y[i] - mean;
+            if (i > 0 && diff * (y[i - 1] - mean) < 0) {
                 mc++;
             }
+            float square_diff = diff * diff;
+            m2 += square_diff;
+            m3 += square_diff * diff;
+            m4 += square_diff * square_diff;
+
+            size_t bin = (y[i] - min) / step;
+            if (bin >= NUM_HISTO_BINS)
+                bin = NUM_HISTO_BINS - 1;
+            h[bin]++;
+        }
+
+        // entropy = -sum(prob * log(prob)
+        float entropy = 0.0f;
+        for (size_t i = 0; i < NUM_HISTO_BINS; i++) {
+            if (h[i] > 0) {
+                float prob = h[i] / (float)n;
+                entropy -= prob * log(prob);
+            }
         }
-        features.push_back(mc / (float)y.size());
+        *features++ = entropy;
+
+        *features++ = zc / (float)n;
+        *features++ = mc / (float)n;
+
+        // percentiles, selecting in increasing order so each search only covers what's left
+        const float percentiles[] = { 0.05, 0.25, 0.5, 0.75, 0.95 };
+        float values[5];
+        size_t first = 0;
+        for (size_t i = 0; i < 5; i++) {
+            size_t index = get_percentile_index(n, percentiles[i]);
+            if (index >= first) {
+                std::nth_element(y + first, y + index, y + n);
+                first = index + 1;
+            }
+            values[i] = y[index];
+        }
+        *features++ = values[0];
+        *features++ = values[1];
+        *features++ = values[3];
+        *features++ = values[4];
+        *features++ = values[2];
+
+        *features++ = mean;
+        *features++ = sqrt(m2 / n); // stdev
+        *features++ = m2 / (n - 1); // variance, same as numpy::variance
+        *features++ = sqrt(sum_sq / n); // rms
+
+        const float var = m2 / n;
+        const float var_15 = sqrt(var * var * var);
+        *features++ = var_15 == 0.0f ? 0.0f : (m3 / n) / var_15; // skew
+        *features++ = var == 0.0f ? -3.0f : ((m4 / n) / (var * var)) - 3.0f; // kurtosis
     }
 
-    static void
-    dwt(const float *x, size_t nx, const float *h, const float *g, size_t nh, fvec &a, fvec &d)
+    /**
+     * One level of the decomposition, with symmetric padding (default in PyWavelet).
+     * Only the outputs near the edges read padded samples, so the padding is done by index.
+     */
+    static size_t dwt(const float *x, size_t nx, const wavelet_filter_t *wav, float *a, float *d)
     {
-        assert(nh <= 20 && nh > 0 && nx > 0);
-        size_t nx_padded = nx + nh * 2 - 2;
-        fvec x_padded(nx_padded);
-
-        // symmetric padding (default in PyWavelet)
-        for (size_t i = 0; i < nh - 2; i++)
-            x_padded[i] = x[nh - 3 - i];
-        for (size_t i = 0; i < nx; i++)
-            x_padded[i + nh - 2] = x[i];
-        for (size_t i = 0; i < nh; i++)
-            x_padded[i + nx + nh - 2] = x[nx - 1 - i];
-
-        size_t ny = (nx + nh - 1) / 2;
-        a.resize(ny);
-        d.resize(ny);
-
-        // decimate and filter
-        const float *xx = x_padded.data();
+        const size_t nh = wav->size;
+        const float *lo = wav->dec_lo + nh - 1;
+        const float *hi = wav->dec_hi + nh - 1;
+        const size_t ny = (nx + nh - 1) / 2;
+
         for (size_t i = 0; i < ny; i++) {
-            a[i] = dot(xx + 2 * i, h, nh);
-            d[i] = dot(xx + 2 * i, g, nh);
+            // index in x of the first tap
+            int start = (int)(2 * i) - (int)(nh - 2);
+            float sum_a = 0.0f;
+            float sum_d = 0.0f;
+            if (start >= 0 && start + nh <= nx) {
+                const float *xx = x + start;
+                for (size_t k = 0; k < nh; k++) {
+                    sum_a += xx[k] * lo[-(int)k];
+                    sum_d += xx[k] * hi[-(int)k];
+                }
+            }
+            else {
+                for (size_t k = 0; k < nh; k++) {
+                    int p = start + (int)k;
+                    if (p < 0) {
+                        p = -p - 1;
+                    }
+                    else if (p >= (int)nx) {
+                        p = 2 * (int)nx - 1 - p;
+                    }
+                    sum_a += x[p] * lo[-(int)k];
+                    sum_d += x[p] * hi[-(int)k];
+                }
+            }
+            a[i] = sum_a;
+            d[i] = sum_d;
         }
+        return ny;
     }
 
-    static void extract_features(fvec& y, fvec &features)
+    /**
+     * Size of the scratch buffer for dwt_features, in floats
+     */
+    static size_t get_scratch_size(size_t len, const wavelet_filter_t *wav)
     {
-        matrix_t x(1, y.size(), const_cast<float *>(y.data()));
-        matrix_t out(1, 1);
-        if (numpy::mean(&x, &out) != EIDSP_OK)
-            assert(0);
-        float mean = out.get_row_ptr(0)[0];
-
-        calculate_entropy(y, features);
-        calculate_crossings(y, features, mean);
-        calculate_statistics(y, features, mean);
+        return 3 * ((len + wav->size - 1) / 2);
     }
 
-    static void
-    wavedec_features(const float *x, int len, const char *wav, int level, fvec &features)
+    /**
+     * Multi-level decomposition in a preallocated buffer. The approximation ping-pongs between two
+     * halves of the scratch buffer and the detail of each level is reduced to features straight away.
+     * Features are written approximation first, then details from the deepest level up, to match
+     * the python implementation.
+     */
+    static int dwt_features(const float *x, size_t len, const wavelet_filter_t *wav, int level, float *scratch, float *features)
     {
         assert(level > 0 && level < 8);
 
-        fvec h;
-        fvec g;
-        find_filter(wav, h, g);
-
-        features.clear();
-        fvec a;
-        fvec d;
-        dwt(x, len, h.data(), g.data(), h.size(), a, d);
-        extract_features(d, features);
-
-        for (int l = 1; l < level; l++) {
-            dwt(a.data(), a.size(), h.data(), g.data(), h.size(), a, d);
-            extract_features(d, features);
+        const size_t half = (len + wav->size - 1) / 2;
+        float *approx[2] = { scratch, scratch + half };
+        float *detail = scratch + 2 * half;
+
+        const float *in = x;
+        size_t n = len;
+        for (int l = 1; l <= level; l++) {
+            float *a = approx[l & 1];
+            n = dwt(in, n, wav, a, detail);
+            extract_features(detail, n, features + (level - l + 1) * NUM_FEATHERS_PER_COMP);
+            in = a;
         }
+        extract_features(const_cast<float *>(in), n, features);
 
-        extract_features(a, features);
-
-        for (int l = 0; l <= level / 2; l++) { // reverse order to match python results.
-            for (int i = 0; i < (int)NUM_FEATHERS_PER_COMP; i++) {
-                std::swap(
-                    features[l * NUM_FEATHERS_PER_COMP + i],
-                    features[(level - l) * NUM_FEATHERS_PER_COMP + i]);
-            }
-        }
-    }
-
-    static int dwt_features(const float *x, int len, const char *wav, int level, fvec &features)
-    {
-        assert(level <= 7);
-
-        assert(features.size() == 0); // make sure features is empty
-        features.reserve((level + 1) * NUM_FEATHERS_PER_COMP);
-
-        wavedec_features(x, len, wav, level, features);
-
-        return features.size();
+        return (level + 1) * NUM_FEATHERS_PER_COMP;
     }
 
     static bool check_min_size(int len, int level)
@@ -293,6 +310,11 @@ public:
         ei_dsp_config_spectral_analysis_t *config,
         const float sampling_freq)
     {
+        const wavelet_filter_t *wav = find_filter(config->wavelet);
+        if (!wav) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
         // transpose the matrix so we have one row per axis
         numpy::transpose_in_place(input_matrix);
 
@@ -322,26 +344,29 @@ public:
 
         EI_TRY(processing::subtract_mean(input_matrix));
 
-        int out_idx = 0;
-        for (size_t row = 0; row < input_matrix->rows; row++) {
-            float *data_window = input_matrix->get_row_ptr(row);
-            size_t data_size = input_matrix->cols;
+        size_t data_size = input_matrix->cols;
+        if (!check_min_size(data_size, config->wavelet_level))
+            EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
 
-            if (!check_min_size(data_size, config->wavelet_level))
-                EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
+        const size_t num_features = (config->wavelet_level + 1) * NUM_FEATHERS_PER_COMP;
+        if (num_features * input_matrix->rows != output_matrix->rows * output_matrix->cols) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        // one scratch buffer shared by all axes and levels
+        matrix_t scratch(1, get_scratch_size(data_size, wav));
+        if (!scratch.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
 
-            fvec features;
-            size_t num_features = dwt_features(
-                data_window,
+        for (size_t row = 0; row < input_matrix->rows; row++) {
+            dwt_features(
+                input_matrix->get_row_ptr(row),
                 data_size,
-                config->wavelet,
+                wav,
                 config->wavelet_level,
-                features);
-
-            assert(num_features == output_matrix->cols / input_matrix->rows);
-            for (size_t i = 0; i < num_features; i++) {
-                output_matrix->buffer[out_idx++] = features[i];
-            }
+                scratch.buffer,
+                output_matrix->buffer + row * num_features);
         }
         return EIDSP_OK;
     }
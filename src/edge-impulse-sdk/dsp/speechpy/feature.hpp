@@ -208,6 +208,8 @@ public:
         uint16_t version
         )
     {
+        dsp_scope scope;
+
         int ret = 0;
 
         if (high_frequency == 0) {
@@ -409,6 +411,8 @@ public:
         uint16_t version
         )
     {
+        dsp_scope scope;
+
         int ret = 0;
 
         if (high_frequency == 0) {
@@ -557,6 +561,8 @@ public:
         uint16_t version
         )
     {
+        dsp_scope scope;
+
         int ret = 0;
 
         stack_frames_info_t stack_frame_info = { 0 };
@@ -704,6 +710,8 @@ public:
         uint32_t low_frequency, uint32_t high_frequency, bool dc_elimination,
         uint16_t version)
     {
+        dsp_scope scope;
+
         if (out_features->cols != num_cepstral) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
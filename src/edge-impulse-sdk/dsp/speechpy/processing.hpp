@@ -395,6 +395,8 @@ namespace processing {
     static int cmvnw(matrix_t *features_matrix, uint16_t win_size = 301, bool variance_normalization = false,
         bool scale = false)
     {
+        dsp_scope scope;
+
         if (win_size == 0) {
             return EIDSP_OK;
         }
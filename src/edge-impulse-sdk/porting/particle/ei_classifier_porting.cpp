@@ -18,8 +18,12 @@
 #include "../ei_classifier_porting.h"
 #if EI_PORTING_PARTICLE == 1
 
+#include "edge-impulse-sdk/classifier/ei_scratch_arena.h"
+#include "edge-impulse-sdk/classifier/ei_telemetry.h"
+
 #include <Particle.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #define EI_WEAK_FN __attribute__((weak))
@@ -60,36 +64,75 @@ EI_WEAK_FN char ei_getchar()
     return ch;
 }
 
+// ei_printf can be called from any thread and the buffer is too big for a thread's stack, so
+// there's one, used with the mutex held
+static char print_buf[1024] = { 0 };
+static Mutex print_mutex;
+
+#if EI_CLASSIFIER_TELEMETRY == 1
 /**
- *  Printf function uses vsnprintf and output using Arduino Serial
+ *  Printf function formats into the telemetry ring and returns, whatever drains the ring
+ *  (see ei_telemetry.h) writes it to the serial port. Text longer than a record is split
+ *  by ei_telemetry_text()
  */
 __attribute__((weak)) void ei_printf(const char *format, ...) {
-    static char print_buf[1024] = { 0 };
-
-    va_list args;
-    va_start(args, format);
-    int r = vsnprintf(print_buf, sizeof(print_buf), format, args);
-    va_end(args);
+    WITH_LOCK(print_mutex) {
+        va_list args;
+        va_start(args, format);
+        int r = vsnprintf(print_buf, sizeof(print_buf), format, args);
+        va_end(args);
+
+        if (r > 0) {
+            ei_telemetry_text(print_buf, ((size_t)r < sizeof(print_buf)) ? (size_t)r : sizeof(print_buf) - 1);
+        }
+    }
+}
 
-    if (r > 0) {
-        Serial.write(print_buf);
+__attribute__((weak)) void ei_printf_float(float f) {
+    ei_printf("%f", f);
+}
+#else
+/**
+ *  Printf function uses vsnprintf and output using Arduino Serial
+ */
+__attribute__((weak)) void ei_printf(const char *format, ...) {
+    WITH_LOCK(print_mutex) {
+        va_list args;
+        va_start(args, format);
+        int r = vsnprintf(print_buf, sizeof(print_buf), format, args);
+        va_end(args);
+
+        if (r > 0) {
+            Serial.write(print_buf);
+        }
     }
 }
 
 __attribute__((weak)) void ei_printf_float(float f) {
     Serial.print(f, 6);
 }
+#endif // EI_CLASSIFIER_TELEMETRY == 1
 
+// While the classifier is in its DSP or NN phase, allocations come from the scratch arena
+// (if enabled) and fall back to the heap when it's full
 __attribute__((weak)) void *ei_malloc(size_t size) {
-    return malloc(size);
+    void *ptr = ei_scratch_alloc(size, false);
+    return ptr ? ptr : malloc(size);
 }
 
 __attribute__((weak)) void *ei_calloc(size_t nitems, size_t size) {
-    return calloc(nitems, size);
+    // nitems * size would wrap around and hand out a block that's too small
+    if (size && nitems > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = ei_scratch_alloc(nitems * size, true);
+    return ptr ? ptr : calloc(nitems, size);
 }
 
 __attribute__((weak)) void ei_free(void *ptr) {
-    free(ptr);
+    if (!ei_scratch_free(ptr)) {
+        free(ptr);
+    }
 }
 
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
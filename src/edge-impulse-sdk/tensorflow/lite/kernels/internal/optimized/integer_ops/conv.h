@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/host_simd.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Per-channel int8 convolution, same arguments and results as
+// reference_integer_ops::ConvPerChannel. Each output channel is a dot product
+// over the part of the filter that is inside the input; without dilation the
+// filter_x * input_depth values of one filter row are contiguous in both the
+// input and the filter.
+inline void ConvPerChannel(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* filter_data, const RuntimeShape& bias_shape,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data) {
+  const int32_t input_offset = params.input_offset;
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int filter_row_size = filter_width * input_depth;
+  const int filter_size = filter_height * filter_row_size;
+
+  int32_t acc[host_simd::kAccBlock];
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+
+        // Filter taps that fall inside the image, the rest is zero padding
+        int filter_x_start = 0;
+        int filter_x_end = filter_width;
+        if (dilation_width_factor == 1) {
+          filter_x_start = std::max(0, -in_x_origin);
+          filter_x_end = std::min(filter_width, input_width - in_x_origin);
+        }
+        const int run_length = (filter_x_end - filter_x_start) * input_depth;
+
+        int8_t* out =
+            &output_data[Offset(output_shape, batch, out_y, out_x, 0)];
+
+        for (int ch_start = 0; ch_start < output_depth;
+             ch_start += host_simd::kAccBlock) {
+          const int ch_count =
+              std::min(host_simd::kAccBlock, output_depth - ch_start);
+
+          for (int ch = 0; ch < ch_count; ++ch) {
+            const int8_t* filter =
+                &filter_data[(ch_start + ch) * filter_size];
+            int32_t sum = 0;
+            for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+              const int in_y = in_y_origin + dilation_height_factor * filter_y;
+              if (in_y < 0 || in_y >= input_height) {
+                continue;
+              }
+              if (dilation_width_factor == 1) {
+                if (run_length <= 0) {
+                  continue;
+                }
+                sum += host_simd::DotProduct(
+                    &input_data[Offset(input_shape, batch, in_y,
+                                       in_x_origin + filter_x_start, 0)],
+                    input_offset,
+                    &filter[filter_y * filter_row_size +
+                            filter_x_start * input_depth],
+                    0, run_length);
+                continue;
+              }
+              for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+                const int in_x = in_x_origin + dilation_width_factor * filter_x;
+                if (in_x < 0 || in_x >= input_width) {
+                  continue;
+                }
+                sum += host_simd::DotProduct(
+                    &input_data[Offset(input_shape, batch, in_y, in_x, 0)],
+                    input_offset,
+                    &filter[filter_y * filter_row_size +
+                            filter_x * input_depth],
+                    0, input_depth);
+              }
+            }
+            if (bias_data) {
+              sum += bias_data[ch_start + ch];
+            }
+            acc[ch] = sum;
+          }
+
+          host_simd::Requantize(acc, ch_count, output_multiplier + ch_start,
+                                output_shift + ch_start, true, output_offset,
+                                output_activation_min, output_activation_max,
+                                out + ch_start);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_CONV_H_
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/host_simd.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// int8 fully connected layer, same arguments and results as
+// reference_integer_ops::FullyConnected
+inline void FullyConnected(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* filter_data, const RuntimeShape& bias_shape,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data) {
+  // The input is read as batches x accum_depth and the bias as output_depth,
+  // both taken from the filter and output shapes
+  (void)input_shape;
+  (void)bias_shape;
+  const int32_t input_offset = params.input_offset;
+  const int32_t filter_offset = params.weights_offset;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_multiplier = params.output_multiplier;
+  const int32_t output_shift = params.output_shift;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+  TFLITE_DCHECK_GE(filter_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 2);
+
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int batches = output_shape.Dims(0);
+  const int output_depth = output_shape.Dims(1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+
+  int32_t acc[host_simd::kAccBlock];
+
+  for (int b = 0; b < batches; ++b) {
+    const int8_t* input = &input_data[b * accum_depth];
+    for (int out_start = 0; out_start < output_depth;
+         out_start += host_simd::kAccBlock) {
+      const int out_count =
+          std::min(host_simd::kAccBlock, output_depth - out_start);
+      for (int i = 0; i < out_count; ++i) {
+        const int out_c = out_start + i;
+        acc[i] = host_simd::DotProduct(
+            input, input_offset, &filter_data[out_c * accum_depth],
+            filter_offset, accum_depth);
+        if (bias_data) {
+          acc[i] += bias_data[out_c];
+        }
+      }
+      host_simd::Requantize(acc, out_count, &output_multiplier, &output_shift,
+                            false, output_offset, output_activation_min,
+                            output_activation_max,
+                            &output_data[out_start + output_depth * b]);
+    }
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_HOST_SIMD_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_HOST_SIMD_H_
+
+// SIMD building blocks for the int8 kernels on host builds (x86 SSE4.1 / AVX2,
+// ARM NEON), selected with EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD. The NEON path is
+// opt-in until it has been checked with tools/ei_host_simd_sweep.cpp.
+//
+// Everything here is bit-exact against the reference kernels:
+// - Products are formed from int8 values widened to int16 after adding the
+//   zero point offsets, so every term is at most 255 * 255 and pairs of terms
+//   are summed in int32, the same as the int32 accumulator of the reference.
+// - Requantization follows gemmlowp's SaturatingRoundingDoublingHighMul and
+//   RoundingDivideByPOT exactly, including the rounding of negative ties
+//   (a plain rounding shift such as vrshl rounds those differently).
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+
+#if defined(__AVX2__)
+#define EI_TFLITE_HOST_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#define EI_TFLITE_HOST_SIMD_SSE4
+#include <smmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define EI_TFLITE_HOST_SIMD_NEON
+#include <arm_neon.h>
+#else
+#error "EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD needs SSE4.1, AVX2 or NEON"
+#endif
+
+namespace tflite {
+namespace optimized_integer_ops {
+namespace host_simd {
+
+// Number of output channels requantized per call, accumulators live on the
+// stack in blocks of this size.
+constexpr int kAccBlock = 64;
+
+// sum((a[i] + a_offset) * (b[i] + b_offset)) for i < n
+inline int32_t DotProduct(const int8_t* a, int32_t a_offset, const int8_t* b,
+                          int32_t b_offset, int n) {
+  int i = 0;
+  int32_t acc = 0;
+
+#if defined(EI_TFLITE_HOST_SIMD_AVX2)
+  const __m256i a_off = _mm256_set1_epi16(static_cast<int16_t>(a_offset));
+  const __m256i b_off = _mm256_set1_epi16(static_cast<int16_t>(b_offset));
+  __m256i sum = _mm256_setzero_si256();
+  for (; i + 16 <= n; i += 16) {
+    __m256i va = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    __m256i vb = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_add_epi16(va, a_off),
+                                                  _mm256_add_epi16(vb, b_off)));
+  }
+  __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                 _mm256_extracti128_si256(sum, 1));
+  sum128 = _mm_hadd_epi32(sum128, sum128);
+  sum128 = _mm_hadd_epi32(sum128, sum128);
+  acc = _mm_cvtsi128_si32(sum128);
+#elif defined(EI_TFLITE_HOST_SIMD_SSE4)
+  const __m128i a_off = _mm_set1_epi16(static_cast<int16_t>(a_offset));
+  const __m128i b_off = _mm_set1_epi16(static_cast<int16_t>(b_offset));
+  __m128i sum = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i va = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i)));
+    __m128i vb = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i)));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_add_epi16(va, a_off),
+                                            _mm_add_epi16(vb, b_off)));
+  }
+  sum = _mm_hadd_epi32(sum, sum);
+  sum = _mm_hadd_epi32(sum, sum);
+  acc = _mm_cvtsi128_si32(sum);
+#elif defined(EI_TFLITE_HOST_SIMD_NEON)
+  const int16x8_t a_off = vdupq_n_s16(static_cast<int16_t>(a_offset));
+  const int16x8_t b_off = vdupq_n_s16(static_cast<int16_t>(b_offset));
+  int32x4_t sum = vdupq_n_s32(0);
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t va = vaddq_s16(vmovl_s8(vld1_s8(a + i)), a_off);
+    int16x8_t vb = vaddq_s16(vmovl_s8(vld1_s8(b + i)), b_off);
+    sum = vmlal_s16(sum, vget_low_s16(va), vget_low_s16(vb));
+    sum = vmlal_s16(sum, vget_high_s16(va), vget_high_s16(vb));
+  }
+  int32x2_t sum2 = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+  acc = vget_lane_s32(vpadd_s32(sum2, sum2), 0);
+#endif
+
+  for (; i < n; i++) {
+    acc += (static_cast<int32_t>(a[i]) + a_offset) *
+           (static_cast<int32_t>(b[i]) + b_offset);
+  }
+  return acc;
+}
+
+#if defined(EI_TFLITE_HOST_SIMD_AVX2) || defined(EI_TFLITE_HOST_SIMD_SSE4)
+// (x * m + nudge) >> 31 for each lane, computed in 64 bits. With m = 2^(31 - e)
+// this is x >> e, with a multiplier and a 2^30 nudge it's
+// SaturatingRoundingDoublingHighMul.
+inline __m128i MulShiftRight31(__m128i x, __m128i m, __m128i nudge64) {
+  __m128i even = _mm_add_epi64(_mm_mul_epi32(x, m), nudge64);
+  __m128i odd = _mm_add_epi64(
+      _mm_mul_epi32(_mm_srli_epi64(x, 32), _mm_srli_epi64(m, 32)), nudge64);
+  // Bits 31..62 of each 64 bit product
+  even = _mm_srli_epi64(_mm_slli_epi64(even, 1), 32);
+  odd = _mm_slli_epi64(odd, 1);
+  return _mm_blend_epi16(even, odd, 0xCC);
+}
+
+// gemmlowp SaturatingRoundingDoublingHighMul per lane: (a * b + 2^30) >> 31,
+// which equals the truncating division by 2^31 with a +-2^30 nudge.
+inline __m128i SaturatingRoundingDoublingHighMul(__m128i a, __m128i b) {
+  const __m128i int_min = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+  __m128i overflow = _mm_and_si128(_mm_cmpeq_epi32(a, int_min),
+                                   _mm_cmpeq_epi32(b, int_min));
+  __m128i result = MulShiftRight31(a, b, _mm_set1_epi64x(1LL << 30));
+  return _mm_blendv_epi8(result, _mm_set1_epi32(0x7fffffff), overflow);
+}
+
+// Arithmetic shift right by a different amount per lane
+inline __m128i ShiftRightPerLane(__m128i x, __m128i exponent) {
+#if defined(EI_TFLITE_HOST_SIMD_AVX2)
+  return _mm_srav_epi32(x, exponent);
+#else
+  // x >> e == (x * 2^(31 - e)) >> 31, 2^31 isn't representable so e = 0 is
+  // passed through
+  alignas(16) int32_t e[4];
+  alignas(16) int32_t m[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(e), exponent);
+  for (int i = 0; i < 4; i++) {
+    m[i] = e[i] == 0 ? 1 : (1 << (31 - e[i]));
+  }
+  __m128i shifted = MulShiftRight31(
+      x, _mm_load_si128(reinterpret_cast<const __m128i*>(m)),
+      _mm_setzero_si128());
+  return _mm_blendv_epi8(shifted, x,
+                         _mm_cmpeq_epi32(exponent, _mm_setzero_si128()));
+#endif
+}
+
+// gemmlowp RoundingDivideByPOT per lane, exponent in [0, 31]
+inline __m128i RoundingDivideByPOT(__m128i x, __m128i exponent) {
+  const __m128i one = _mm_set1_epi32(1);
+#if defined(EI_TFLITE_HOST_SIMD_AVX2)
+  __m128i mask = _mm_sub_epi32(_mm_sllv_epi32(one, exponent), one);
+#else
+  alignas(16) int32_t e[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(e), exponent);
+  __m128i mask = _mm_set_epi32(
+      static_cast<int32_t>((1LL << e[3]) - 1), static_cast<int32_t>((1LL << e[2]) - 1),
+      static_cast<int32_t>((1LL << e[1]) - 1), static_cast<int32_t>((1LL << e[0]) - 1));
+#endif
+  __m128i remainder = _mm_and_si128(x, mask);
+  __m128i threshold = _mm_add_epi32(
+      _mm_srai_epi32(mask, 1),
+      _mm_and_si128(_mm_cmplt_epi32(x, _mm_setzero_si128()), one));
+  return _mm_add_epi32(
+      ShiftRightPerLane(x, exponent),
+      _mm_and_si128(_mm_cmpgt_epi32(remainder, threshold), one));
+}
+
+// MultiplyByQuantizedMultiplier for 4 lanes, shift is the TFLite shift (> 0
+// is a left shift)
+inline __m128i MultiplyByQuantizedMultiplier4(__m128i x, __m128i multiplier,
+                                              __m128i shift) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i left_shift = _mm_max_epi32(shift, zero);
+  __m128i right_shift = _mm_max_epi32(_mm_sub_epi32(zero, shift), zero);
+#if defined(EI_TFLITE_HOST_SIMD_AVX2)
+  __m128i left = _mm_sllv_epi32(_mm_set1_epi32(1), left_shift);
+#else
+  alignas(16) int32_t l[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(l), left_shift);
+  __m128i left = _mm_set_epi32(1 << l[3], 1 << l[2], 1 << l[1], 1 << l[0]);
+#endif
+  return RoundingDivideByPOT(
+      SaturatingRoundingDoublingHighMul(_mm_mullo_epi32(x, left), multiplier),
+      right_shift);
+}
+#elif defined(EI_TFLITE_HOST_SIMD_NEON)
+// vqrdmulh is exactly gemmlowp's SaturatingRoundingDoublingHighMul; the
+// rounding division is done by hand as vrshl rounds negative ties upwards.
+inline int32x4_t RoundingDivideByPOT(int32x4_t x, int32x4_t exponent) {
+  const int32x4_t one = vdupq_n_s32(1);
+  int32x4_t mask = vsubq_s32(vshlq_s32(one, exponent), one);
+  int32x4_t remainder = vandq_s32(x, mask);
+  int32x4_t threshold = vaddq_s32(
+      vshrq_n_s32(mask, 1),
+      vandq_s32(vreinterpretq_s32_u32(vcltq_s32(x, vdupq_n_s32(0))), one));
+  return vaddq_s32(
+      vshlq_s32(x, vnegq_s32(exponent)),
+      vandq_s32(vreinterpretq_s32_u32(vcgtq_s32(remainder, threshold)), one));
+}
+
+inline int32x4_t MultiplyByQuantizedMultiplier4(int32x4_t x,
+                                                int32x4_t multiplier,
+                                                int32x4_t shift) {
+  const int32x4_t zero = vdupq_n_s32(0);
+  int32x4_t left_shift = vmaxq_s32(shift, zero);
+  int32x4_t right_shift = vmaxq_s32(vnegq_s32(shift), zero);
+  int32x4_t left = vshlq_s32(vdupq_n_s32(1), left_shift);
+  return RoundingDivideByPOT(
+      vqrdmulhq_s32(vmulq_s32(x, left), multiplier), right_shift);
+}
+#endif
+
+// Requantize n accumulators to int8: MultiplyByQuantizedMultiplier, add the
+// output offset and clamp. multiplier / shift are per element when
+// per_channel is set, otherwise only the first entry is used.
+inline void Requantize(const int32_t* acc, int n, const int32_t* multiplier,
+                       const int32_t* shift, bool per_channel,
+                       int32_t output_offset, int32_t activation_min,
+                       int32_t activation_max, int8_t* output) {
+  int i = 0;
+
+#if defined(EI_TFLITE_HOST_SIMD_AVX2) || defined(EI_TFLITE_HOST_SIMD_SSE4)
+  const __m128i offset = _mm_set1_epi32(output_offset);
+  const __m128i act_min = _mm_set1_epi32(activation_min);
+  const __m128i act_max = _mm_set1_epi32(activation_max);
+  __m128i mult = _mm_set1_epi32(multiplier[0]);
+  __m128i sh = _mm_set1_epi32(shift[0]);
+  for (; i + 4 <= n; i += 4) {
+    if (per_channel) {
+      mult = _mm_loadu_si128(reinterpret_cast<const __m128i*>(multiplier + i));
+      sh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shift + i));
+    }
+    __m128i v = MultiplyByQuantizedMultiplier4(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i)), mult, sh);
+    v = _mm_min_epi32(_mm_max_epi32(_mm_add_epi32(v, offset), act_min),
+                      act_max);
+    // Values are in int8 range, so the saturating packs don't change them
+    v = _mm_packs_epi32(v, v);
+    v = _mm_packs_epi16(v, v);
+    int32_t packed = _mm_cvtsi128_si32(v);
+    memcpy(output + i, &packed, 4);
+  }
+#elif defined(EI_TFLITE_HOST_SIMD_NEON)
+  const int32x4_t offset = vdupq_n_s32(output_offset);
+  const int32x4_t act_min = vdupq_n_s32(activation_min);
+  const int32x4_t act_max = vdupq_n_s32(activation_max);
+  int32x4_t mult = vdupq_n_s32(multiplier[0]);
+  int32x4_t sh = vdupq_n_s32(shift[0]);
+  for (; i + 8 <= n; i += 8) {
+    int32x4_t v[2];
+    for (int half = 0; half < 2; half++) {
+      if (per_channel) {
+        mult = vld1q_s32(multiplier + i + half * 4);
+        sh = vld1q_s32(shift + i + half * 4);
+      }
+      v[half] = MultiplyByQuantizedMultiplier4(vld1q_s32(acc + i + half * 4),
+                                               mult, sh);
+      v[half] = vminq_s32(vmaxq_s32(vaddq_s32(v[half], offset), act_min),
+                          act_max);
+    }
+    int16x8_t v16 = vcombine_s16(vmovn_s32(v[0]), vmovn_s32(v[1]));
+    vst1_s8(output + i, vmovn_s16(v16));
+  }
+#endif
+
+  for (; i < n; i++) {
+    const int ch = per_channel ? i : 0;
+    int32_t v = MultiplyByQuantizedMultiplier(acc[i], multiplier[ch], shift[ch]);
+    v += output_offset;
+    v = std::max(v, activation_min);
+    v = std::min(v, activation_max);
+    output[i] = static_cast<int8_t>(v);
+  }
+}
+
+// Element-wise max of n int8 values into dst
+inline void MaxInt8(int8_t* dst, const int8_t* src, int n) {
+  int i = 0;
+#if defined(EI_TFLITE_HOST_SIMD_AVX2)
+  for (; i + 32 <= n; i += 32) {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_max_epi8(d, s));
+  }
+#endif
+#if defined(EI_TFLITE_HOST_SIMD_AVX2) || defined(EI_TFLITE_HOST_SIMD_SSE4)
+  for (; i + 16 <= n; i += 16) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epi8(d, s));
+  }
+#elif defined(EI_TFLITE_HOST_SIMD_NEON)
+  for (; i + 16 <= n; i += 16) {
+    vst1q_s8(dst + i, vmaxq_s8(vld1q_s8(dst + i), vld1q_s8(src + i)));
+  }
+#endif
+  for (; i < n; i++) {
+    dst[i] = std::max(dst[i], src[i]);
+  }
+}
+
+}  // namespace host_simd
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_HOST_SIMD_H_
@@ -20,10 +20,15 @@ limitations under the License.
 #include <arm_neon.h>
 #endif
 
+// NEON_2_SSE.h is not shipped with the SDK, only use it if it's on the include path
 #if defined __GNUC__ && defined __SSE4_1__ && !defined TF_LITE_DISABLE_X86_NEON
+#if defined(__has_include)
+#if __has_include("NEON_2_SSE.h")
 #define USE_NEON
 #include "NEON_2_SSE.h"
 #endif
+#endif
+#endif
 
 // NEON_OR_PORTABLE(SomeFunc, args) calls NeonSomeFunc(args) if USE_NEON is
 // defined, PortableSomeFunc(args) otherwise.
@@ -0,0 +1,220 @@
+/* Copyright 2023 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_BLOCK_SPARSE_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_BLOCK_SPARSE_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+
+namespace tflite {
+
+// Number of consecutive weights of a row in one block.
+constexpr int kSparseBlockSize = 4;
+
+// Int8 filter with the all-zero blocks left out. The filter is seen as a
+// matrix of rows (output channels) by cols weights, for conv that's the
+// [height][width][input_depth] filter of an output channel flattened. Every
+// row is split into blocks of kSparseBlockSize consecutive weights, the last
+// block is padded with zeros when cols isn't a multiple of the block size.
+// Only blocks with a non-zero weight are stored, row by row (like CSR, with a
+// block per column).
+struct BlockSparseWeights {
+  int rows;
+  int cols;
+  // rows + 1 entries, the blocks of row r are row_start[r] to
+  // row_start[r + 1] - 1.
+  const uint16_t* row_start;
+  // Per block, the column of its first weight divided by kSparseBlockSize.
+  const uint16_t* block_col;
+  // kSparseBlockSize weights per block.
+  const int8_t* values;
+};
+
+namespace reference_integer_ops {
+
+// Columns rounded up to whole blocks, the length the input of
+// BlockSparseDot() has to have.
+inline int BlockSparsePaddedCols(const BlockSparseWeights& filter) {
+  return (filter.cols + kSparseBlockSize - 1) / kSparseBlockSize *
+         kSparseBlockSize;
+}
+
+// Dot product of one row with input, only over the stored blocks. input has
+// BlockSparsePaddedCols() values, input_offset is added to each of them.
+template <typename InputT>
+inline int32_t BlockSparseDot(const BlockSparseWeights& filter, int row,
+                              const InputT* input, int32_t input_offset) {
+  const int start = filter.row_start[row];
+  const int end = filter.row_start[row + 1];
+  const int8_t* values = filter.values + start * kSparseBlockSize;
+  int32_t acc = 0;
+  for (int block = start; block < end; ++block) {
+    const InputT* in = input + filter.block_col[block] * kSparseBlockSize;
+    acc += values[0] * (in[0] + input_offset);
+    acc += values[1] * (in[1] + input_offset);
+    acc += values[2] * (in[2] + input_offset);
+    acc += values[3] * (in[3] + input_offset);
+    values += kSparseBlockSize;
+  }
+  return acc;
+}
+
+// Same as FullyConnected() with a block-sparse filter. The filter zero point
+// has to be 0. padded_input is scratch for BlockSparsePaddedCols() values,
+// only used when cols isn't a multiple of the block size (it can be nullptr
+// otherwise).
+inline void BlockSparseFullyConnected(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const int8_t* input_data, const BlockSparseWeights& filter,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data, int8_t* padded_input) {
+  const int32_t input_offset = params.input_offset;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_multiplier = params.output_multiplier;
+  const int output_shift = params.output_shift;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+
+  const int batches = output_shape.Dims(0);
+  const int output_depth = output_shape.Dims(1);
+  const int accum_depth = filter.cols;
+  const int padded_depth = BlockSparsePaddedCols(filter);
+  TFLITE_DCHECK_LE(output_depth, filter.rows);
+
+  for (int b = 0; b < batches; ++b) {
+    const int8_t* input = input_data + b * accum_depth;
+    if (padded_depth != accum_depth) {
+      // The padding weights are 0, but the values they're multiplied with
+      // still have to be readable
+      TFLITE_DCHECK(padded_input != nullptr);
+      memcpy(padded_input, input, accum_depth);
+      memset(padded_input + accum_depth, 0, padded_depth - accum_depth);
+      input = padded_input;
+    }
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      int32_t acc = BlockSparseDot(filter, out_c, input, input_offset);
+      if (bias_data) {
+        acc += bias_data[out_c];
+      }
+      acc = MultiplyByQuantizedMultiplier(acc, output_multiplier, output_shift);
+      acc += output_offset;
+      acc = std::max(acc, output_activation_min);
+      acc = std::min(acc, output_activation_max);
+      output_data[out_c + output_depth * b] = static_cast<int8_t>(acc);
+    }
+  }
+}
+
+// Same as ConvPerChannel() with a block-sparse filter. filter_shape is the
+// shape of the dense filter. patch is scratch for BlockSparsePaddedCols()
+// values: the receptive field of one output pixel is gathered there with the
+// input offset added (0 for padding), then every output channel is a sparse
+// dot product with it.
+inline void BlockSparseConvPerChannel(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const BlockSparseWeights& filter, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data, int16_t* patch) {
+  const int32_t input_offset = params.input_offset;
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  TFLITE_DCHECK_EQ(filter.rows, output_depth);
+  TFLITE_DCHECK_EQ(filter.cols, filter_height * filter_width * input_depth);
+
+  // The padding at the end of the patch is never written below
+  const int patch_size = filter.cols;
+  for (int i = patch_size; i < BlockSparsePaddedCols(filter); ++i) {
+    patch[i] = 0;
+  }
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+
+        int16_t* dst = patch;
+        for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+          const int in_y = in_y_origin + dilation_height_factor * filter_y;
+          for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+            const int in_x = in_x_origin + dilation_width_factor * filter_x;
+            if ((in_x >= 0) && (in_x < input_width) && (in_y >= 0) &&
+                (in_y < input_height)) {
+              const int8_t* src =
+                  &input_data[Offset(input_shape, batch, in_y, in_x, 0)];
+              for (int in_channel = 0; in_channel < input_depth;
+                   ++in_channel) {
+                dst[in_channel] =
+                    static_cast<int16_t>(src[in_channel] + input_offset);
+              }
+            } else {
+              // Zero padding, same as omitting the areas outside the image
+              for (int in_channel = 0; in_channel < input_depth;
+                   ++in_channel) {
+                dst[in_channel] = 0;
+              }
+            }
+            dst += input_depth;
+          }
+        }
+
+        for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+          int32_t acc = BlockSparseDot(filter, out_channel, patch, 0);
+          if (bias_data) {
+            acc += bias_data[out_channel];
+          }
+          acc = MultiplyByQuantizedMultiplier(
+              acc, output_multiplier[out_channel], output_shift[out_channel]);
+          acc += output_offset;
+          acc = std::max(acc, output_activation_min);
+          acc = std::min(acc, output_activation_max);
+          output_data[Offset(output_shape, batch, out_y, out_x, out_channel)] =
+              static_cast<int8_t>(acc);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace reference_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_REFERENCE_INTEGER_OPS_BLOCK_SPARSE_H_
@@ -32,6 +32,7 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/padding.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/kernel_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/packed_weights.h"
 
 namespace tflite {
 namespace {
@@ -41,6 +42,13 @@ struct OpData {
 
   // Index to buffer for optimizations if applicable.
   int buffer_idx;
+
+  // Set if the filter was packed offline for arm_convolve_s8_packed.
+  bool packed_filter;
+
+  // Set if the filter is stored block-sparse, buffer_idx is then the patch
+  // used by BlockSparseConvPerChannel.
+  const BlockSparseWeights* sparse_filter;
 };
 
 void* Init(TfLiteContext* context, const char* buffer, size_t length) {
@@ -106,6 +114,8 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
       filter_dims.h, output_dims.w, output_dims.h, input->type,
       &data->reference_op_data));
 
+  data->packed_filter = false;
+  data->sparse_filter = nullptr;
   if (input->type == kTfLiteInt8) {
     // Initialize cmsis_nn convolution parameters
     cmsis_nn_conv_params conv_params;
@@ -120,8 +130,38 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
     conv_params.activation.min = data->reference_op_data.output_activation_min;
     conv_params.activation.max = data->reference_op_data.output_activation_max;
 
-    buf_size = arm_convolve_wrapper_s8_get_buffer_size(
-        &conv_params, &input_dims, &filter_dims, &output_dims);
+    const PackedWeights* packed = GetPackedWeights(filter->data.data);
+    (void)packed;
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+    if (packed != nullptr && packed->layout == kPackedWeightsBlockSparse) {
+      const BlockSparseWeights* sparse = packed->sparse;
+      TF_LITE_ENSURE(context, sparse != nullptr);
+      TF_LITE_ENSURE_EQ(context, sparse->rows, filter_dims.n);
+      TF_LITE_ENSURE_EQ(context, sparse->cols,
+                        filter_dims.h * filter_dims.w * filter_dims.c);
+      data->sparse_filter = sparse;
+      buf_size = reference_integer_ops::BlockSparsePaddedCols(*sparse) *
+                 sizeof(int16_t);
+    } else
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+    if (packed != nullptr) {
+      // The packed filter can only be used by arm_convolve_s8_packed, there's
+      // no other kernel to fall back to
+      TF_LITE_ENSURE_MSG(context, packed->layout == kPackedWeightsConvSmlad,
+                         "Conv filter packed in an unknown layout.");
+      TF_LITE_ENSURE_MSG(context,
+                         conv_params.dilation.h == 1 &&
+                             conv_params.dilation.w == 1,
+                         "Packed conv filters don't support dilation.");
+      data->packed_filter = true;
+      buf_size = arm_convolve_s8_get_buffer_size(&input_dims, &filter_dims);
+    } else
+#endif  // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+    {
+      buf_size = arm_convolve_wrapper_s8_get_buffer_size(
+          &conv_params, &input_dims, &filter_dims, &output_dims);
+    }
   }
 
   if (buf_size > 0) {
@@ -138,6 +178,24 @@ TfLiteStatus EvalQuantizedPerChannel(
     const OpData& data, const TfLiteEvalTensor* input,
     const TfLiteEvalTensor* filter, const TfLiteEvalTensor* bias,
     TfLiteEvalTensor* output, TfLiteEvalTensor* im2col) {
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+  if (data.sparse_filter != nullptr) {
+    reference_integer_ops::BlockSparseConvPerChannel(
+        ConvParamsQuantized(params, data.reference_op_data),
+        data.reference_op_data.per_channel_output_multiplier,
+        data.reference_op_data.per_channel_output_shift,
+        tflite::micro::GetTensorShape(input),
+        tflite::micro::GetTensorData<int8_t>(input),
+        tflite::micro::GetTensorShape(filter), *data.sparse_filter,
+        tflite::micro::GetTensorData<int32_t>(bias),
+        tflite::micro::GetTensorShape(output),
+        tflite::micro::GetTensorData<int8_t>(output),
+        static_cast<int16_t*>(
+            context->GetScratchBuffer(context, data.buffer_idx)));
+    return kTfLiteOk;
+  }
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+
   cmsis_nn_conv_params conv_params;
   conv_params.dilation.h = params.dilation_height_factor;
   conv_params.dilation.w = params.dilation_width_factor;
@@ -220,6 +278,21 @@ TfLiteStatus EvalQuantizedPerChannel(
       // arm_convolve_wrapper_s8_get_buffer_size
     }
 
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+    if (data.packed_filter) {
+      TF_LITE_ENSURE_EQ(
+          context,
+          arm_convolve_s8_packed(
+              &ctx, &conv_params, &quant_params, &input_dims,
+              tflite::micro::GetTensorData<int8_t>(input), &filter_dims,
+              tflite::micro::GetTensorData<int8_t>(filter), &bias_dims,
+              tflite::micro::GetTensorData<int32_t>(bias), &output_dims,
+              tflite::micro::GetTensorData<int8_t>(output)),
+          ARM_MATH_SUCCESS);
+      return kTfLiteOk;
+    }
+#endif  // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+
     // arm_convolve_wrapper_s8 dispatches the optimized kernel accordingly with
     // the parameters passed
     TFLITE_DCHECK_EQ(
@@ -1726,13 +1799,64 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/padding.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/kernel_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/packed_weights.h"
+
+#if EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/conv.h"
+#endif
 
 namespace tflite {
 namespace {
 
+struct OpData {
+  // First, ConvPrepare() uses user_data as an OpDataConv.
+  OpDataConv reference_op_data;
+
+  // Set if the filter is stored block-sparse.
+  const BlockSparseWeights* sparse_filter;
+
+  // Patch used by BlockSparseConvPerChannel.
+  int sparse_buffer_idx;
+};
+
 void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
-  return context->AllocatePersistentBuffer(context, sizeof(OpDataConv));
+  return context->AllocatePersistentBuffer(context, sizeof(OpData));
+}
+
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TF_LITE_ENSURE_STATUS(ConvPrepare(context, node));
+
+  OpData* data = static_cast<OpData*>(node->user_data);
+  data->sparse_filter = nullptr;
+  data->sparse_buffer_idx = -1;
+
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+  const TfLiteTensor* input = GetInput(context, node, kConvInputTensor);
+  TF_LITE_ENSURE(context, input != nullptr);
+  const TfLiteTensor* filter = GetInput(context, node, kConvWeightsTensor);
+  TF_LITE_ENSURE(context, filter != nullptr);
+
+  const PackedWeights* packed = GetPackedWeights(filter->data.data);
+  if (packed != nullptr && packed->layout == kPackedWeightsBlockSparse) {
+    const BlockSparseWeights* sparse = packed->sparse;
+    TF_LITE_ENSURE(context, sparse != nullptr);
+    TF_LITE_ENSURE_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, sparse->rows,
+                      filter->dims->data[kConvQuantizedDimension]);
+    TF_LITE_ENSURE_EQ(context, sparse->cols,
+                      filter->dims->data[1] * filter->dims->data[2] *
+                          filter->dims->data[3]);
+    data->sparse_filter = sparse;
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context,
+        reference_integer_ops::BlockSparsePaddedCols(*sparse) *
+            sizeof(int16_t),
+        &data->sparse_buffer_idx));
+  }
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+
+  return kTfLiteOk;
 }
 
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
@@ -1751,7 +1875,8 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const auto& params =
       *(reinterpret_cast<TfLiteConvParams*>(node->builtin_data));
   TFLITE_DCHECK(node->user_data != nullptr);
-  const auto& data = *(static_cast<const OpDataConv*>(node->user_data));
+  const auto& op_data = *(static_cast<const OpData*>(node->user_data));
+  const OpDataConv& data = op_data.reference_op_data;
 
   TF_LITE_ENSURE_EQ(context, input->type, output->type);
   TF_LITE_ENSURE_MSG(context, input->type == filter->type,
@@ -1784,7 +1909,28 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       return kTfLiteError;
       #endif
 
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+      if (op_data.sparse_filter != nullptr) {
+        reference_integer_ops::BlockSparseConvPerChannel(
+            ConvParamsQuantized(params, data),
+            data.per_channel_output_multiplier, data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            tflite::micro::GetTensorShape(filter), *op_data.sparse_filter,
+            tflite::micro::GetTensorData<int32_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output),
+            static_cast<int16_t*>(
+                context->GetScratchBuffer(context, op_data.sparse_buffer_idx)));
+        break;
+      }
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+
+#if EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD == 1
+      optimized_integer_ops::ConvPerChannel(
+#else
       reference_integer_ops::ConvPerChannel(
+#endif
           ConvParamsQuantized(params, data), data.per_channel_output_multiplier,
           data.per_channel_output_shift, tflite::micro::GetTensorShape(input),
           tflite::micro::GetTensorData<int8_t>(input),
@@ -1809,7 +1955,7 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 TfLiteRegistration Register_CONV_2D() {
   return {/*init=*/Init,
           /*free=*/nullptr,
-          /*prepare=*/ConvPrepare,
+          /*prepare=*/Prepare,
           /*invoke=*/Eval,
           /*profiling_string=*/nullptr,
           /*builtin_code=*/0,
@@ -30,6 +30,7 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/kernel_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/packed_weights.h"
 
 namespace tflite {
 namespace {
@@ -39,6 +40,14 @@ struct OpData {
 
   // Index to buffer for optimizations if applicable.
   int buffer_idx;
+
+  // Bias with the input offset folded in, if the model provides one. The
+  // kernel then runs with an input offset of 0.
+  const int32_t* folded_bias;
+
+  // Set if the filter is stored block-sparse, buffer_idx is then the padded
+  // input used by BlockSparseFullyConnected (if needed).
+  const BlockSparseWeights* sparse_filter;
 };
 
 // TODO(b/169801227): This global struct is needed for the linker to drop unused
@@ -76,6 +85,8 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
 
   // Set buffer index to a reset value
   data->buffer_idx = -1;
+  data->folded_bias = nullptr;
+  data->sparse_filter = nullptr;
   TF_LITE_ENSURE_STATUS(CalculateOpDataFullyConnected(
       context, params->activation, input->type, input, filter, bias, output,
       &(data->reference_op_data)));
@@ -98,8 +109,44 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
     filter_dims.w = 1;
     filter_dims.c = output_shape.Dims(1);
 
-    const int32_t buf_size =
-        arm_fully_connected_s8_get_buffer_size(&filter_dims);
+    int32_t buf_size = 0;
+    const PackedWeights* packed = GetPackedWeights(filter->data.data);
+    (void)packed;
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+    if (packed != nullptr && packed->layout == kPackedWeightsBlockSparse) {
+      const BlockSparseWeights* sparse = packed->sparse;
+      TF_LITE_ENSURE(context, sparse != nullptr);
+      TF_LITE_ENSURE_EQ(context, sparse->rows, filter_dims.c);
+      TF_LITE_ENSURE_EQ(context, sparse->cols, filter_dims.n);
+      TF_LITE_ENSURE_EQ(context, data->reference_op_data.filter_zero_point,
+                        0);
+      data->sparse_filter = sparse;
+      data->folded_bias = GetFoldedBias(
+          packed, data->reference_op_data.input_zero_point);
+      // The padded input is only needed if a row doesn't end on a block
+      const int padded_cols =
+          reference_integer_ops::BlockSparsePaddedCols(*sparse);
+      if (padded_cols != filter_dims.n) {
+        buf_size = padded_cols;
+      }
+    } else
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+    if (packed != nullptr) {
+      TF_LITE_ENSURE_MSG(context,
+                         packed->layout == kPackedWeightsFoldedBias &&
+                             packed->folded_bias != nullptr,
+                         "Fully connected filter packed in an unknown layout.");
+      // If the input zero point changed since the bias was folded, run with
+      // the original bias and input offset
+      data->folded_bias = GetFoldedBias(
+          packed, data->reference_op_data.input_zero_point);
+      buf_size = arm_fully_connected_s8_get_buffer_size(&filter_dims);
+    } else
+#endif  // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+    {
+      buf_size = arm_fully_connected_s8_get_buffer_size(&filter_dims);
+    }
 
     if (buf_size > 0) {
       TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
@@ -132,8 +179,33 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
   const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
   const RuntimeShape input_shape = tflite::micro::GetTensorShape(input);
 
+  const int32_t* bias_data = tflite::micro::GetTensorData<int32_t>(bias);
+
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+  if (data.sparse_filter != nullptr) {
+    FullyConnectedParams op_params =
+        FullyConnectedParamsQuantized(data.reference_op_data);
+    if (data.folded_bias != nullptr) {
+      op_params.input_offset = 0;
+      bias_data = data.folded_bias;
+    }
+    reference_integer_ops::BlockSparseFullyConnected(
+        op_params, input_shape, tflite::micro::GetTensorData<int8_t>(input),
+        *data.sparse_filter, bias_data, output_shape,
+        tflite::micro::GetTensorData<int8_t>(output),
+        data.buffer_idx > -1 ? static_cast<int8_t*>(context->GetScratchBuffer(
+                                   context, data.buffer_idx))
+                             : nullptr);
+    return kTfLiteOk;
+  }
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+
   cmsis_nn_fc_params fc_params;
   fc_params.input_offset = -data.reference_op_data.input_zero_point;
+  if (data.folded_bias != nullptr) {
+    fc_params.input_offset = 0;
+    bias_data = data.folded_bias;
+  }
   fc_params.output_offset = data.reference_op_data.output_zero_point;
   fc_params.filter_offset = -data.reference_op_data.filter_zero_point;
   fc_params.activation.min = data.reference_op_data.output_activation_min;
@@ -180,8 +252,8 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
       arm_fully_connected_s8(
           &ctx, &fc_params, &quant_params, &input_dims,
           tflite::micro::GetTensorData<int8_t>(input), &filter_dims,
-          tflite::micro::GetTensorData<int8_t>(filter), &bias_dims,
-          tflite::micro::GetTensorData<int32_t>(bias), &output_dims,
+          tflite::micro::GetTensorData<int8_t>(filter), &bias_dims, bias_data,
+          &output_dims,
           tflite::micro::GetTensorData<int8_t>(output)),
       ARM_MATH_SUCCESS);
 
@@ -1371,21 +1443,39 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "edge-impulse-sdk/tensorflow/lite/kernels/kernel_util.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/kernel_util.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/packed_weights.h"
+
+#if EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+#endif
 
 namespace tflite {
 namespace {
 
+struct OpData {
+  OpDataFullyConnected reference_op_data;
+
+  // Set if the filter is stored block-sparse.
+  const BlockSparseWeights* sparse_filter;
+
+  // Bias with the input offset folded in, used with the sparse filter if the
+  // model provides one.
+  const int32_t* folded_bias;
+
+  // Padded input used by BlockSparseFullyConnected, if needed.
+  int sparse_buffer_idx;
+};
+
 void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
-  return context->AllocatePersistentBuffer(context,
-                                           sizeof(OpDataFullyConnected));
+  return context->AllocatePersistentBuffer(context, sizeof(OpData));
 }
 
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TFLITE_DCHECK(node->user_data != nullptr);
   TFLITE_DCHECK(node->builtin_data != nullptr);
 
-  auto* data = static_cast<OpDataFullyConnected*>(node->user_data);
+  auto* data = static_cast<OpData*>(node->user_data);
   const auto params =
       static_cast<const TfLiteFullyConnectedParams*>(node->builtin_data);
 
@@ -1404,8 +1494,39 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_MSG(context, input->type == filter->type,
                      "Hybrid models are not supported on TFLite Micro.");
 
-  return CalculateOpDataFullyConnected(context, params->activation, input->type,
-                                       input, filter, bias, output, data);
+  data->sparse_filter = nullptr;
+  data->folded_bias = nullptr;
+  data->sparse_buffer_idx = -1;
+  TF_LITE_ENSURE_STATUS(CalculateOpDataFullyConnected(
+      context, params->activation, input->type, input, filter, bias, output,
+      &(data->reference_op_data)));
+
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+  const PackedWeights* packed = GetPackedWeights(filter->data.data);
+  if (packed != nullptr && packed->layout == kPackedWeightsBlockSparse) {
+    const BlockSparseWeights* sparse = packed->sparse;
+    const RuntimeShape filter_shape = GetTensorShape(filter);
+    const int accum_depth =
+        filter_shape.Dims(filter_shape.DimensionsCount() - 1);
+    TF_LITE_ENSURE(context, sparse != nullptr);
+    TF_LITE_ENSURE_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, sparse->rows, filter_shape.Dims(0));
+    TF_LITE_ENSURE_EQ(context, sparse->cols, accum_depth);
+    TF_LITE_ENSURE_EQ(context, data->reference_op_data.filter_zero_point, 0);
+    data->sparse_filter = sparse;
+    data->folded_bias =
+        GetFoldedBias(packed, data->reference_op_data.input_zero_point);
+    // The padded input is only needed if a row doesn't end on a block
+    const int padded_cols =
+        reference_integer_ops::BlockSparsePaddedCols(*sparse);
+    if (padded_cols != accum_depth) {
+      TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+          context, padded_cols, &data->sparse_buffer_idx));
+    }
+  }
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+
+  return kTfLiteOk;
 }
 
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
@@ -1423,8 +1544,8 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       tflite::micro::GetEvalOutput(context, node, kFullyConnectedOutputTensor);
 
   TFLITE_DCHECK(node->user_data != nullptr);
-  const auto& data =
-      *(static_cast<const OpDataFullyConnected*>(node->user_data));
+  const auto& op_data = *(static_cast<const OpData*>(node->user_data));
+  const OpDataFullyConnected& data = op_data.reference_op_data;
 
   // Checks in Prepare ensure input, output and filter types are all the same.
   switch (input->type) {
@@ -1455,7 +1576,33 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       return kTfLiteError;
       #endif
 
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+      if (op_data.sparse_filter != nullptr) {
+        FullyConnectedParams op_params = FullyConnectedParamsQuantized(data);
+        const int32_t* bias_data = tflite::micro::GetTensorData<int32_t>(bias);
+        if (op_data.folded_bias != nullptr) {
+          op_params.input_offset = 0;
+          bias_data = op_data.folded_bias;
+        }
+        reference_integer_ops::BlockSparseFullyConnected(
+            op_params, tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            *op_data.sparse_filter, bias_data,
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output),
+            op_data.sparse_buffer_idx > -1
+                ? static_cast<int8_t*>(context->GetScratchBuffer(
+                      context, op_data.sparse_buffer_idx))
+                : nullptr);
+        break;
+      }
+#endif  // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+
+#if EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD == 1
+      tflite::optimized_integer_ops::FullyConnected(
+#else
       tflite::reference_integer_ops::FullyConnected(
+#endif
           FullyConnectedParamsQuantized(data),
           tflite::micro::GetTensorShape(input),
           tflite::micro::GetTensorData<int8_t>(input),
@@ -0,0 +1,54 @@
+/* Copyright 2023 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/packed_weights.h"
+
+#include <cstddef>
+
+namespace tflite {
+namespace {
+
+const PackedWeights* packed_table = nullptr;
+int packed_count = 0;
+
+}  // namespace
+
+void RegisterPackedWeights(const PackedWeights* table, int count) {
+  packed_table = table;
+  packed_count = (table != nullptr) ? count : 0;
+}
+
+const PackedWeights* GetPackedWeights(const void* weights) {
+  if (weights == nullptr) {
+    return nullptr;
+  }
+  for (int i = 0; i < packed_count; i++) {
+    if (packed_table[i].weights == weights) {
+      return &packed_table[i];
+    }
+  }
+  return nullptr;
+}
+
+const int32_t* GetFoldedBias(const PackedWeights* packed,
+                             int32_t input_zero_point) {
+  if (packed == nullptr || packed->folded_bias == nullptr ||
+      packed->folded_input_zero_point != input_zero_point) {
+    return nullptr;
+  }
+  return packed->folded_bias;
+}
+
+}  // namespace tflite
@@ -0,0 +1,72 @@
+/* Copyright 2023 EdgeImpulse Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_PACKED_WEIGHTS_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_PACKED_WEIGHTS_H_
+
+#include <cstdint>
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/block_sparse.h"
+
+namespace tflite {
+
+// Layout of constant weights that were prepared offline by the compiled model
+// generator, so the kernels don't have to redo it on every invoke.
+enum PackedWeightsLayout {
+  // Plain TFLite layout, the tensor was not packed.
+  kPackedWeightsNone = 0,
+  // Conv filter in the CMSIS-NN SMLAD order, see arm_convolve_s8_packed.
+  kPackedWeightsConvSmlad = 1,
+  // Fully connected filter in the TFLite layout, with the input offset
+  // folded into folded_bias: bias + input_offset * sum(filter + filter_offset)
+  // per output channel. The kernel runs with an input offset of 0, as long as
+  // the input tensor still has the zero point the bias was folded with.
+  kPackedWeightsFoldedBias = 2,
+  // Conv or fully connected filter stored block-sparse (see
+  // BlockSparseWeights), the filter tensor's data is the sparse values. Can be
+  // combined with a folded bias for fully connected layers.
+  kPackedWeightsBlockSparse = 3,
+};
+
+struct PackedWeights {
+  // Data pointer of the filter tensor this entry describes.
+  const void* weights;
+  PackedWeightsLayout layout;
+  // Replacement bias for kPackedWeightsFoldedBias, one per output channel.
+  // For kPackedWeightsBlockSparse it's optional.
+  const int32_t* folded_bias;
+  // Filter for kPackedWeightsBlockSparse.
+  const BlockSparseWeights* sparse;
+  // Input zero point that folded_bias was computed with.
+  int32_t folded_input_zero_point;
+};
+
+// Registers the table of packed weights of a model. The table has to stay
+// valid while the model is in use, generated code keeps it in flash. Call it
+// before the kernels are prepared, registering again replaces the table.
+void RegisterPackedWeights(const PackedWeights* table, int count);
+
+// Returns the entry for a filter tensor's data, or nullptr if it's stored in
+// the plain layout.
+const PackedWeights* GetPackedWeights(const void* weights);
+
+// Returns the entry's folded bias if it was computed with input_zero_point,
+// otherwise nullptr and the kernel has to apply the input offset itself.
+const int32_t* GetFoldedBias(const PackedWeights* packed,
+                             int32_t input_zero_point);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_PACKED_WEIGHTS_H_
@@ -1670,6 +1670,10 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/kernels/padding.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/kernel_util.h"
 
+#if EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD == 1
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/pooling.h"
+#endif
+
 namespace tflite {
 namespace ops {
 namespace micro {
@@ -1792,7 +1796,11 @@ void MaxEvalQuantized(TfLiteContext* context, TfLiteNode* node,
                            tflite::micro::GetTensorShape(output),
                            tflite::micro::GetTensorData<uint8_t>(output));
   } else {
+#if EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD == 1
+    optimized_integer_ops::MaxPool(
+#else
     reference_integer_ops::MaxPool(
+#endif
         op_params, tflite::micro::GetTensorShape(input),
         tflite::micro::GetTensorData<int8_t>(input),
         tflite::micro::GetTensorShape(output),
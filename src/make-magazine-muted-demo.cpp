@@ -19,41 +19,170 @@
 
 /**
  * Define the number of slices per model window. E.g. a model window of 1000 ms
- * with slices per model window set to 4. Results in a slice size of 250 ms.
+ * with slices per model window set to 8. Results in a slice size of 125 ms.
  * For more info: https://docs.edgeimpulse.com/docs/continuous-audio-sampling
+ *
+ * A slice is the shortest time between two inferences, the inference scheduler
+ * below decides how many slices it actually waits.
+ */
+#define EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW 8
+
+/**
+ * Inference scheduler, in slices: every 500 ms while the muted score stays near zero,
+ * every 125 ms after a near miss, and 250 ms in between
+ */
+#define SCHED_MIN_HOP           1
+#define SCHED_START_HOP         2
+#define SCHED_MAX_HOP           4
+#define SCHED_QUIET_THRESHOLD   0.05f
+#define SCHED_NEAR_MISS         0.3f
+#define SCHED_QUIET_INFERENCES  4
+#define SCHED_CPU_BUDGET_PCT    60
+
+/**
+ * Audio kept before and after a detection, written to AUDIO_SNAPSHOT_PATH as a wav file
+ * for debugging false positives. Set both to 0 to disable.
+ */
+#ifndef AUDIO_PRETRIGGER_MS
+#define AUDIO_PRETRIGGER_MS 2000
+#endif
+#ifndef AUDIO_POSTTRIGGER_MS
+#define AUDIO_POSTTRIGGER_MS 2000
+#endif
+#define AUDIO_SNAPSHOT_PATH "/usr/muted.wav"
+
+/** Label that sends the keystroke, and the score it needs */
+#define MUTED_LABEL         "muted"
+#define MUTED_THRESHOLD     0.8f
+
+/** Longest wait for a DMA buffer before reporting that the microphone stopped */
+#define AUDIO_WAIT_TIMEOUT_MS   1000
+
+/** How often the latency histograms are logged, 0 to disable */
+#ifndef LATENCY_REPORT_MS
+#define LATENCY_REPORT_MS   60000
+#endif
+
+/**
+ * With EI_CLASSIFIER_TELEMETRY (build.mk), predictions and ei_printf text go into a ring that a
+ * low priority thread writes to the serial port, so the inference loop never waits for USB.
+ * Set to 1 to send binary frames for tools/ei_telemetry_decode.cpp instead of text.
  */
-#define EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW 4
+#ifndef TELEMETRY_BINARY
+#define TELEMETRY_BINARY    0
+#endif
 
 /* Includes ---------------------------------------------------------------- */
 #include "Microphone_PDM.h"
+#include "MicWavRecorder.h"
+#include "MicLatency.h"
 #include "Particle.h"
 #include <_You_re_Muted__inferencing.h>
 
+/**
+ * On RTL872x (Photon 2) the PDM DMA writes straight into the inference slice buffers,
+ * so the samples are never copied out of a DMA buffer.
+ */
+#if defined(HAL_PLATFORM_RTL872X) && HAL_PLATFORM_RTL872X
+#define PDM_DIRECT_DESTINATIONS 1
+#else
+#define PDM_DIRECT_DESTINATIONS 0
+#endif
+
 SerialLogHandler logHandler(LOG_LEVEL_INFO);
 SYSTEM_THREAD(ENABLED);
 STARTUP(Keyboard.begin());
 
 
+/** Timestamps of one inference, from the capture of its last sample to the keystroke */
+typedef struct {
+    uint32_t captured;      // last sample of the slice captured (DMA timestamp)
+    uint32_t dequeued;      // slice handed to the classifier
+    uint32_t classify_start;
+    uint32_t dsp_us;
+    uint32_t nn_us;
+    uint32_t post_done;     // result and detection known
+    uint32_t hid_done;      // keystroke sent
+} latency_stamp_t;
+
 /* Forward declerations ---------------------------------------------------- */
+static void snapshot_trigger(void);
+static void snapshot_write_page(void);
 static bool microphone_inference_start(uint32_t n_samples);
 static bool microphone_inference_record(void);
 static void microphone_inference_end(void);
 static int microphone_audio_signal_get_data(size_t offset, size_t length, float *out_ptr);
+static bool muted_detected(const ei_impulse_result_t *result);
+static void latency_record(latency_stamp_t *stamp, const ei_impulse_result_t *result);
+static void latency_record_event(const latency_stamp_t *stamp);
+static void latency_log(void);
+static void telemetry_start(void);
+
+/**
+ * The slice buffers are pages in a history ring. A page is free when its reference count is 0.
+ * Filling, being classified, and being part of a snapshot each hold a reference, so a detection
+ * can keep the audio around it without copying it. Free pages are reused oldest first, so
+ * the most recent slices are still in the ring when a detection happens.
+ */
+#define AUDIO_SLICE_MS          (EI_CLASSIFIER_SLICE_SIZE * 1000 / EI_CLASSIFIER_FREQUENCY)
+#define AUDIO_PRETRIGGER_PAGES  ((AUDIO_PRETRIGGER_MS + AUDIO_SLICE_MS - 1) / AUDIO_SLICE_MS)
+#define AUDIO_POSTTRIGGER_PAGES ((AUDIO_POSTTRIGGER_MS + AUDIO_SLICE_MS - 1) / AUDIO_SLICE_MS)
+#define AUDIO_SNAPSHOT_PAGES    (AUDIO_PRETRIGGER_PAGES + AUDIO_POSTTRIGGER_PAGES)
+// 2 being filled (or queued for the DMA), 1 ready and 1 being classified, in addition to a snapshot
+#define AUDIO_HISTORY_PAGES     (AUDIO_SNAPSHOT_PAGES + 4)
+#define AUDIO_PAGE_NONE         0xff
 
 /** Audio buffers, pointers and selectors */
 typedef struct {
-    signed short *buffers[2];
-    unsigned char buf_select;
+    signed short *pages[AUDIO_HISTORY_PAGES];
+    unsigned char page_refs[AUDIO_HISTORY_PAGES];
+    uint32_t page_seq[AUDIO_HISTORY_PAGES];     // slice number, or UINT32_MAX while not complete
+    uint32_t page_time[AUDIO_HISTORY_PAGES];    // micros() when the last sample of the page was captured
+    unsigned char fill[2];                      // pages being filled, in order
+    unsigned char fill_count;
+    unsigned char alloc_next;                   // where to start looking for a free page
+    unsigned char ready_page;                   // last page filled
+    unsigned char classify_page;                // page being classified
     unsigned char buf_ready;
     unsigned int buf_count;
     unsigned int n_samples;
+    uint32_t seq;
+    bool direct;
+    uint32_t dest_overruns;
 } inference_t;
 
+/** Pages pinned by a detection, written out when complete */
+typedef struct {
+    unsigned char pages[AUDIO_SNAPSHOT_PAGES + 1];
+    unsigned char count;
+    unsigned char written;
+    unsigned char post_remaining;
+    bool active;
+    uint32_t skipped;
+} snapshot_t;
+
 static inference_t inference;
+static snapshot_t snapshot;
+
+// Latency breakdown, every inference except for the HID dispatch and capture to keystroke
+static MicLatencyHistogram latency_queue("capture queueing");
+static MicLatencyHistogram latency_dsp("DSP");
+static MicLatencyHistogram latency_nn("NN");
+static MicLatencyHistogram latency_post("post-processing");
+static MicLatencyHistogram latency_result("capture to result");
+static MicLatencyHistogram latency_hid("HID dispatch");
+static MicLatencyHistogram latency_event("capture to keystroke");
+static unsigned long latency_report_ms = 0;
 static bool record_ready = false;
 static signed short *sampleBuffer;
 static bool debug_nn = false; // Set this to true to see e.g. features generated from the raw signal
 static int print_results = -(EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW);
+static int muted_label_ix = -1;
+static int16_t muted_threshold_q = 127;
+static int detect_holdoff = 0; // slices until the next keystroke can be sent
+#if EI_CLASSIFIER_TELEMETRY == 1
+static Thread *telemetry_thread = NULL;
+#endif
 
 void generateKeystrokes() 
 {
@@ -82,6 +211,29 @@ void setup()
     ei_printf("\tNo. of classes: %d\n", sizeof(ei_classifier_inferencing_categories) /
                                             sizeof(ei_classifier_inferencing_categories[0]));
 
+    // Resolve the label and convert its threshold to the int8 output once, instead of every window
+    muted_label_ix = ei_find_label_index(&ei_default_impulse, MUTED_LABEL);
+    if (muted_label_ix < 0) {
+        ei_printf("ERR: No label contains \"%s\"\n", MUTED_LABEL);
+    }
+#if EI_CLASSIFIER_TFLITE_OUTPUT_QUANTIZED == 1
+    muted_threshold_q = ei_quantized_threshold(MUTED_THRESHOLD,
+        EI_CLASSIFIER_TFLITE_OUTPUT_SCALE, EI_CLASSIFIER_TFLITE_OUTPUT_ZEROPOINT);
+#endif
+
+    ei_scheduler_config_t sched = { 0 };
+    sched.target_label = muted_label_ix;
+    sched.min_hop_slices = SCHED_MIN_HOP;
+    sched.start_hop_slices = SCHED_START_HOP;
+    sched.max_hop_slices = SCHED_MAX_HOP;
+    sched.quiet_threshold = SCHED_QUIET_THRESHOLD;
+    sched.near_miss_threshold = SCHED_NEAR_MISS;
+    sched.quiet_inferences = SCHED_QUIET_INFERENCES;
+    sched.cpu_budget_pct = SCHED_CPU_BUDGET_PCT;
+    ei_scheduler_configure(&sched);
+
+    telemetry_start();
+
     run_classifier_init();
     if (microphone_inference_start(EI_CLASSIFIER_SLICE_SIZE) == false) {
         ei_printf("ERR: Could not allocate audio buffer (size %d), this could be due to the window length of your model\r\n", EI_CLASSIFIER_RAW_SAMPLE_COUNT);
@@ -100,19 +252,57 @@ void loop()
         return;
     }
 
+    latency_stamp_t stamp = { 0 };
+    stamp.dequeued = micros();
+    stamp.captured = inference.page_time[inference.classify_page];
+
     signal_t signal;
     signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
     signal.get_data = &microphone_audio_signal_get_data;
     ei_impulse_result_t result = {0};
 
+    stamp.classify_start = micros();
     EI_IMPULSE_ERROR r = run_classifier_continuous(&signal, &result, debug_nn);
     if (r != EI_IMPULSE_OK) {
         ei_printf("ERR: Failed to run classifier (%d)\n", r);
         return;
     }
 
+    if (detect_holdoff > 0) {
+        detect_holdoff--;
+    }
+    if (!ei_scheduler_last_slice_inferred()) {
+        // Same result as the last inference, only the features were updated
+        print_results++;
+        snapshot_write_page();
+        return;
+    }
+
+    // One keystroke per model window, the scheduler can run several inferences in one
+    bool detected = (detect_holdoff == 0 && muted_detected(&result));
+    latency_record(&stamp, &result);
+
+    if (detected) {
+        generateKeystrokes();
+        stamp.hid_done = micros();
+        latency_record_event(&stamp);
+        snapshot_trigger();
+        detect_holdoff = EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW;
+    }
+
     if (++print_results >= (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW)) {
-        // print the predictions
+#if EI_CLASSIFIER_TELEMETRY == 1
+        // A binary record with the int8 scores converted to 16 bits, rendered by the telemetry thread
+        ei_scheduler_stats_t stats;
+        ei_scheduler_get_stats(&stats);
+        ei_telemetry_prediction(&result, EI_CLASSIFIER_LABEL_COUNT);
+        ei_telemetry_counter("sched hop", stats.hop_slices);
+        ei_telemetry_counter("sched duty cycle %", (uint32_t)(stats.duty_cycle * 100.f + 0.5f));
+        ei_telemetry_counter("sched cpu load %", (uint32_t)(stats.cpu_load * 100.f + 0.5f));
+        ei_telemetry_counter("cpu active %", (uint32_t)(Microphone_PDM::instance().getActiveRatio() * 100.f + 0.5f));
+#else
+        // print the predictions, the only place the float scores are needed
+        ei_quantized_dequantize(&result);
         ei_printf("Predictions ");
         ei_printf("(DSP: %d ms., Classification: %d ms., Anomaly: %d ms.)",
             result.timing.dsp, result.timing.classification, result.timing.anomaly);
@@ -124,25 +314,196 @@ void loop()
 #if EI_CLASSIFIER_HAS_ANOMALY == 1
         ei_printf("    anomaly score: %.3f\n", result.anomaly);
 #endif
-        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-            if (strstr(result.classification[ix].label, "muted") && result.classification[ix].value > 0.8) {
-                generateKeystrokes();
-            } 
-        }        
+        ei_scheduler_print_stats();
+        ei_printf("CPU active: %u%%\n", (unsigned int)(Microphone_PDM::instance().getActiveRatio() * 100.f + 0.5f));
+#endif
 
         print_results = 0;
     }
+
+    if (LATENCY_REPORT_MS > 0 && millis() - latency_report_ms >= LATENCY_REPORT_MS) {
+        latency_report_ms = millis();
+        latency_log();
+    }
+
+    // Use the time until the next slice is ready to save a completed snapshot
+    snapshot_write_page();
+}
+
+/**
+ * @brief      Add the stages of an inference to the latency histograms
+ */
+static void latency_record(latency_stamp_t *stamp, const ei_impulse_result_t *result)
+{
+    stamp->post_done = micros();
+    stamp->dsp_us = (uint32_t)result->timing.dsp_us;
+    stamp->nn_us = (uint32_t)(result->timing.classification_us + result->timing.anomaly_us);
+
+    // Whatever run_classifier_continuous() and the detection spent outside of DSP and NN
+    uint32_t classify_us = stamp->post_done - stamp->classify_start;
+    uint32_t measured_us = stamp->dsp_us + stamp->nn_us;
+
+    latency_queue.addInterval(stamp->captured, stamp->dequeued);
+    latency_dsp.add(stamp->dsp_us);
+    latency_nn.add(stamp->nn_us);
+    latency_post.add(classify_us > measured_us ? classify_us - measured_us : 0);
+    latency_result.addInterval(stamp->captured, stamp->post_done);
+}
+
+/**
+ * @brief      Add a keystroke to the latency histograms and log its breakdown
+ */
+static void latency_record_event(const latency_stamp_t *stamp)
+{
+    latency_hid.addInterval(stamp->post_done, stamp->hid_done);
+    latency_event.addInterval(stamp->captured, stamp->hid_done);
+
+    Log.info("Keystroke %lu us after the end of the slice (queueing %lu, DSP %lu, NN %lu, post-processing %lu, HID %lu)",
+        (unsigned long)(stamp->hid_done - stamp->captured), (unsigned long)(stamp->dequeued - stamp->captured),
+        (unsigned long)stamp->dsp_us, (unsigned long)stamp->nn_us,
+        (unsigned long)(stamp->post_done - stamp->classify_start - stamp->dsp_us - stamp->nn_us),
+        (unsigned long)(stamp->hid_done - stamp->post_done));
+}
+
+static void latency_log(void)
+{
+    latency_queue.log();
+    latency_dsp.log();
+    latency_nn.log();
+    latency_post.log();
+    latency_result.log();
+    latency_hid.log();
+    latency_event.log();
+    Microphone_PDM::instance().logWaitStats();
+}
+
+#if EI_CLASSIFIER_TELEMETRY == 1
+/**
+ * @brief      Write the telemetry ring to the serial port. Runs below the application
+ *             thread, so it only gets the time the inference loop spends waiting for audio.
+ */
+static void telemetry_drain(void)
+{
+    // Room for a whole record rendered as text, debug features are the longest
+    static uint8_t buf[1024];
+
+    while (true) {
+#if TELEMETRY_BINARY
+        size_t n = ei_telemetry_read_frames(buf, sizeof(buf));
+#else
+        size_t n = ei_telemetry_read_text((char *)buf, sizeof(buf));
+#endif
+        if (n > 0) {
+            Serial.write(buf, n);
+        }
+        else {
+            delay(5);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief      Send the label names and start the telemetry thread
+ */
+static void telemetry_start(void)
+{
+#if EI_CLASSIFIER_TELEMETRY == 1
+    ei_telemetry_labels(ei_classifier_inferencing_categories, EI_CLASSIFIER_LABEL_COUNT);
+    if (telemetry_thread == NULL) {
+        telemetry_thread = new Thread("telemetry", telemetry_drain, OS_THREAD_PRIORITY_DEFAULT - 1, 3072);
+    }
+#endif
+}
+
+/**
+ * @brief      Check the muted label against its threshold, on the int8 output when the
+ *             classifier kept it
+ */
+static bool muted_detected(const ei_impulse_result_t *result)
+{
+    if (muted_label_ix < 0) {
+        return false;
+    }
+#if EI_CLASSIFIER_QUANTIZED_POSTPROCESSING == 1
+    if (result->quantized.valid && !result->quantized.dequantized) {
+        return result->quantized.value[muted_label_ix] > muted_threshold_q;
+    }
+#endif
+    return result->classification[muted_label_ix].value > MUTED_THRESHOLD;
 }
 
 static int16_t *sptr;
 static uint32_t sample_length = 0;
 
+/**
+ * @brief      Take the oldest free page in the history ring
+ *
+ * @return     Page index. There is always one because the ring has room for a whole snapshot
+ *             plus the pages in use.
+ */
+static unsigned char microphone_inference_alloc_page(void)
+{
+    for (size_t ix = 0; ix < AUDIO_HISTORY_PAGES; ix++) {
+        unsigned char page = (inference.alloc_next + ix) % AUDIO_HISTORY_PAGES;
+        if (inference.page_refs[page] == 0) {
+            inference.page_refs[page] = 1;
+            inference.page_seq[page] = UINT32_MAX;
+            inference.alloc_next = (page + 1) % AUDIO_HISTORY_PAGES;
+            return page;
+        }
+    }
+    return AUDIO_PAGE_NONE;
+}
+
+static void microphone_inference_release_page(unsigned char page)
+{
+    if (page != AUDIO_PAGE_NONE && inference.page_refs[page] > 0) {
+        inference.page_refs[page]--;
+    }
+}
+
+/**
+ * @brief      The first page being filled is full, make it the ready page
+ *
+ * @param[in]  time  micros() when its last sample was captured
+ */
+static void microphone_inference_page_complete(uint32_t time)
+{
+    if (inference.buf_ready) {
+        // The previous page was never classified (overrun), it's only history now
+        microphone_inference_release_page(inference.ready_page);
+    }
+    inference.ready_page = inference.fill[0];
+    inference.page_seq[inference.ready_page] = inference.seq++;
+    inference.page_time[inference.ready_page] = time;
+    inference.fill[0] = inference.fill[1];
+    inference.fill_count--;
+    inference.buf_count = 0;
+    inference.buf_ready = 1;
+}
+
 /**
  * @brief      PDM buffer full callback
  *             Get data and call audio thread callback
  */
 static void pdm_data_ready_inference_callback(void)
 {
+#if PDM_DIRECT_DESTINATIONS
+    if (inference.direct) {
+        // The DMA has already written the samples into the slice buffer, just account for them
+        Microphone_PDM::instance().destinationComplete([](int16_t *pSamples, size_t numSamples) {
+            inference.buf_count += numSamples;
+
+            if (inference.buf_count >= inference.n_samples) {
+                // The page ends with this DMA block
+                microphone_inference_page_complete(Microphone_PDM::instance().getLastTimestamp());
+            }
+        });
+        return;
+    }
+#endif
+
     bool dma_ready = Microphone_PDM::instance().noCopySamples([](void *pSamples, size_t numSamples) {
 
         sample_length = Microphone_PDM::instance().getBufferSizeInBytes() / 2;
@@ -150,19 +511,47 @@ static void pdm_data_ready_inference_callback(void)
     });
 
     if (record_ready == true && dma_ready) {
+        // Capture time of the last sample in the DMA buffer
+        uint32_t buffer_time = Microphone_PDM::instance().getLastTimestamp();
 
         for (int i = 0; i < sample_length; i++) {
-            inference.buffers[inference.buf_select][inference.buf_count++] = sptr[i];
+            inference.pages[inference.fill[0]][inference.buf_count++] = sptr[i];
 
             if (inference.buf_count >= inference.n_samples) {
-                inference.buf_select ^= 1;
-                inference.buf_count = 0;
-                inference.buf_ready = 1;
+                // The page can end part way through the DMA buffer
+                microphone_inference_page_complete(buffer_time -
+                    (uint32_t)(((uint64_t)(sample_length - 1 - i) * 1000000) / EI_CLASSIFIER_FREQUENCY));
+
+                // Copying, so the next page can be picked now instead of when it's queued
+                inference.fill[inference.fill_count++] = microphone_inference_alloc_page();
             }
         }
     }
 }
 
+#if PDM_DIRECT_DESTINATIONS
+/**
+ * @brief      Queue a slice buffer as PDM DMA destinations, one DMA page at a time
+ *
+ * @return     false if the driver rejected a piece (queue full or misaligned)
+ */
+static bool microphone_inference_queue(signed short *buffer)
+{
+    const size_t page = Microphone_PDM::BUFFER_SIZE_SAMPLES;
+
+    for (size_t offset = 0; offset < inference.n_samples; offset += page) {
+        size_t count = inference.n_samples - offset;
+        if (count > page) {
+            count = page;
+        }
+        if (!Microphone_PDM::instance().queueDestination(&buffer[offset], count)) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
 /**
  * @brief      Init inferencing struct and setup/start PDM
  *
@@ -172,31 +561,32 @@ static void pdm_data_ready_inference_callback(void)
  */
 static bool microphone_inference_start(uint32_t n_samples)
 {
-    inference.buffers[0] = (signed short *)malloc(n_samples * sizeof(signed short));
-
-    if (inference.buffers[0] == NULL) {
-        return false;
-    }
+    memset(&inference, 0, sizeof(inference));
+    memset(&snapshot, 0, sizeof(snapshot));
 
-    inference.buffers[1] = (signed short *)malloc(n_samples * sizeof(signed short));
+    // Aligned to the D-cache line so the pages can be used as DMA destinations
+    for (size_t ix = 0; ix < AUDIO_HISTORY_PAGES; ix++) {
+        inference.pages[ix] = (signed short *)ei_aligned_calloc(32, n_samples * sizeof(signed short));
 
-    if (inference.buffers[1] == NULL) {
-        free(inference.buffers[0]);
-        return false;
+        if (inference.pages[ix] == NULL) {
+            microphone_inference_end();
+            return false;
+        }
+        inference.page_seq[ix] = UINT32_MAX;
     }
 
     sampleBuffer = (signed short *)malloc((n_samples >> 1) * sizeof(signed short));
 
     if (sampleBuffer == NULL) {
-        free(inference.buffers[0]);
-        free(inference.buffers[1]);
+        microphone_inference_end();
         return false;
     }
 
-    inference.buf_select = 0;
-    inference.buf_count = 0;
     inference.n_samples = n_samples;
-    inference.buf_ready = 0;
+    inference.ready_page = AUDIO_PAGE_NONE;
+    inference.classify_page = AUDIO_PAGE_NONE;
+    inference.fill[0] = microphone_inference_alloc_page();
+    inference.fill_count = 1;
 
 	int err = Microphone_PDM::instance()
 		.withOutputSize(Microphone_PDM::OutputSize::SIGNED_16)
@@ -215,6 +605,22 @@ static bool microphone_inference_start(uint32_t n_samples)
         return false;
     }
 
+#if PDM_DIRECT_DESTINATIONS
+    // Queue the first two pages. If the slice size can't be split into aligned pieces,
+    // fall back to copying out of the DMA buffers.
+    inference.fill[1] = microphone_inference_alloc_page();
+    inference.direct = microphone_inference_queue(inference.pages[inference.fill[0]]) &&
+                       microphone_inference_queue(inference.pages[inference.fill[1]]);
+    if (inference.direct) {
+        inference.fill_count = 2;
+    }
+    else {
+        microphone_inference_release_page(inference.fill[1]);
+    }
+    Microphone_PDM::instance().enableDestinations(inference.direct);
+    inference.dest_overruns = Microphone_PDM::instance().getDestinationOverruns();
+#endif
+
     record_ready = true;
 
     return true;
@@ -228,7 +634,6 @@ static bool microphone_inference_start(uint32_t n_samples)
 static bool microphone_inference_record(void)
 {
     bool ret = true;
-
     if (inference.buf_ready == 1) {
         ei_printf(
             "Error sample buffer overrun. Decrease the number of slices per model window "
@@ -236,12 +641,51 @@ static bool microphone_inference_record(void)
         ret = false;
     }
 
+    // The classifier is done with the previous slice. It stays in the ring as history.
+    microphone_inference_release_page(inference.classify_page);
+    inference.classify_page = AUDIO_PAGE_NONE;
+
+#if PDM_DIRECT_DESTINATIONS
+    if (inference.direct) {
+        // Give the DMA the oldest free page
+        if (inference.fill_count < 2) {
+            unsigned char page = microphone_inference_alloc_page();
+            if (page != AUDIO_PAGE_NONE && microphone_inference_queue(inference.pages[page])) {
+                inference.fill[inference.fill_count++] = page;
+            }
+            else {
+                microphone_inference_release_page(page);
+            }
+        }
+
+        uint32_t overruns = Microphone_PDM::instance().getDestinationOverruns();
+        if (overruns != inference.dest_overruns) {
+            ei_printf("Error PDM DMA overrun (%u blocks dropped)\n", (unsigned int)(overruns - inference.dest_overruns));
+            inference.dest_overruns = overruns;
+            ret = false;
+        }
+    }
+#endif
+
     while (inference.buf_ready == 0) {
+        // Sleep until the DMA completes a buffer instead of polling. The telemetry thread runs in
+        // the meantime, and when it's idle too the CPU waits for the interrupt (WFI).
+        if (!Microphone_PDM::instance().waitForSamples(AUDIO_WAIT_TIMEOUT_MS)) {
+            ei_printf("ERR: No audio for %d ms\n", AUDIO_WAIT_TIMEOUT_MS);
+        }
         pdm_data_ready_inference_callback();
     }
 
+    inference.classify_page = inference.ready_page;
     inference.buf_ready = 0;
 
+    // A snapshot waiting for audio after the detection keeps this page too
+    if (snapshot.active && snapshot.post_remaining > 0) {
+        inference.page_refs[inference.classify_page]++;
+        snapshot.pages[snapshot.count++] = inference.classify_page;
+        snapshot.post_remaining--;
+    }
+
     return ret;
 }
 
@@ -250,7 +694,7 @@ static bool microphone_inference_record(void)
  */
 static int microphone_audio_signal_get_data(size_t offset, size_t length, float *out_ptr)
 {
-    numpy::int16_to_float(&inference.buffers[inference.buf_select ^ 1][offset], out_ptr, length);
+    numpy::int16_to_float(&inference.pages[inference.classify_page][offset], out_ptr, length);
 
     return 0;
 }
@@ -261,9 +705,100 @@ static int microphone_audio_signal_get_data(size_t offset, size_t length, float
 static void microphone_inference_end(void)
 {
     Microphone_PDM::instance().stop();
-    free(inference.buffers[0]);
-    free(inference.buffers[1]);
+#if PDM_DIRECT_DESTINATIONS
+    Microphone_PDM::instance().enableDestinations(false);
+#endif
+    for (size_t ix = 0; ix < AUDIO_HISTORY_PAGES; ix++) {
+        ei_aligned_free(inference.pages[ix]);
+        inference.pages[ix] = NULL;
+    }
     free(sampleBuffer);
+    sampleBuffer = NULL;
+}
+
+/**
+ * @brief      Pin the slices before a detection, and the ones after it as they arrive
+ */
+static void snapshot_trigger(void)
+{
+    if (AUDIO_SNAPSHOT_PAGES == 0) {
+        return;
+    }
+    if (snapshot.active) {
+        // Still collecting or writing the previous one
+        snapshot.skipped++;
+        return;
+    }
+
+    uint32_t last = inference.page_seq[inference.classify_page];
+    uint32_t first = (last + 1 >= AUDIO_PRETRIGGER_PAGES) ? last + 1 - AUDIO_PRETRIGGER_PAGES : 0;
+
+    snapshot.count = 0;
+    snapshot.written = 0;
+    for (uint32_t seq = first; seq <= last; seq++) {
+        for (size_t page = 0; page < AUDIO_HISTORY_PAGES; page++) {
+            if (inference.page_seq[page] == seq) {
+                inference.page_refs[page]++;
+                snapshot.pages[snapshot.count++] = page;
+                break;
+            }
+        }
+    }
+    snapshot.post_remaining = AUDIO_POSTTRIGGER_PAGES;
+    snapshot.active = true;
+}
+
+/**
+ * @brief      Write one page of a complete snapshot to the file and release it
+ *
+ * The samples are written straight from the history ring. The file is written a page at a
+ * time between slices so classification doesn't fall behind.
+ */
+static void snapshot_write_page(void)
+{
+    static MicWavFileSink sink(AUDIO_SNAPSHOT_PATH);
+
+    if (!snapshot.active || snapshot.post_remaining > 0) {
+        return;
+    }
+    if (snapshot.count == 0) {
+        snapshot.active = false;
+        return;
+    }
+
+    const size_t page_bytes = inference.n_samples * sizeof(signed short);
+    int res = 0;
+
+    if (snapshot.written == 0) {
+        MicWavHeader<MicWavHeaderBase::STANDARD_SIZE> header;
+        header.writeHeader(1, EI_CLASSIFIER_FREQUENCY, 16, snapshot.count * page_bytes);
+
+        res = sink.open();
+        if (res == 0) {
+            res = sink.write(header.getBuffer(), header.getBufferOffset());
+        }
+    }
+    if (res == 0) {
+        res = sink.write((const uint8_t *)inference.pages[snapshot.pages[snapshot.written]], page_bytes);
+    }
+
+    if (res != 0) {
+        ei_printf("ERR: Failed to write %s (%d)\n", AUDIO_SNAPSHOT_PATH, res);
+    }
+    microphone_inference_release_page(snapshot.pages[snapshot.written]);
+    snapshot.written++;
+
+    if (res != 0 || snapshot.written >= snapshot.count) {
+        // On error, release the rest of the pages
+        while (snapshot.written < snapshot.count) {
+            microphone_inference_release_page(snapshot.pages[snapshot.written++]);
+        }
+        sink.close();
+        snapshot.active = false;
+        if (res == 0) {
+            ei_printf("Saved %d ms of audio to %s\n", (int)(snapshot.count * AUDIO_SLICE_MS), AUDIO_SNAPSHOT_PATH);
+        }
+    }
 }
 
 #if !defined(EI_CLASSIFIER_SENSOR) || EI_CLASSIFIER_SENSOR != EI_CLASSIFIER_SENSOR_MICROPHONE
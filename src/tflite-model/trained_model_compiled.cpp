@@ -26,6 +26,8 @@
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_mutable_op_resolver.h"
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/packed_weights.h"
+#include "edge-impulse-sdk/classifier/ei_node_profiler.h"
 
 #if EI_CLASSIFIER_PRINT_STATE
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
@@ -87,6 +89,11 @@ template <int SZ, class T> struct TfArray {
 enum used_operators_e {
   OP_RESHAPE, OP_CONV_2D, OP_MAX_POOL_2D, OP_FULLY_CONNECTED, OP_SOFTMAX,  OP_LAST
 };
+#if EI_CLASSIFIER_NODE_PROFILER == 1
+static const char *used_operator_names[OP_LAST] = {
+  "RESHAPE", "CONV_2D", "MAX_POOL_2D", "FULLY_CONNECTED", "SOFTMAX",
+};
+#endif // EI_CLASSIFIER_NODE_PROFILER == 1
 struct TensorInfo_t { // subset of TfLiteTensor used for initialization from constant memory
   TfLiteAllocationType allocation_type;
   TfLiteType type;
@@ -134,6 +141,18 @@ const ALIGN(16) int32_t tensor_data4[4] = { 1, 25, 1, 16, };
 const TfArray<1, int> tensor_dimension4 = { 1, { 4 } };
 const ALIGN(8) int32_t tensor_data5[2] = { -1, 208, };
 const TfArray<1, int> tensor_dimension5 = { 1, { 2 } };
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+const ALIGN(16) int8_t tensor_data6[8*1*3*13] = { 
+  /* [0][0][][] */ -61,40,27,75,87,37,-20,39,20,8,-39,-5,-9,-78,127,-44,-44,-22,-15,-24,-43,4,4,18,38,-84,27,18,7,-37,-44,11,-12,21,1,29,-32,-35,0, 
+  /* [1][0][][] */ 75,23,95,85,63,55,-45,-38,16,30,-21,-48,15,100,82,97,30,-16,38,15,-60,-46,42,-24,31,52,-7,127,-24,30,50,-26,-16,21,-12,-36,17,-42,23, 
+  /* [2][0][][] */ 37,-95,21,35,-127,-109,-81,12,-37,5,22,4,14,-6,98,-81,-55,-53,-63,-14,20,-37,9,-11,-44,111,5,-3,-64,-115,-78,-44,32,-1,68,6,-38,-33,3, 
+  /* [3][0][][] */ -127,31,36,37,12,30,15,14,-23,18,0,-5,1,-4,102,5,-16,-36,-37,-15,5,13,39,2,-6,29,-4,-51,-33,28,-9,8,9,-2,-16,-30,-17,7,3, 
+  /* [4][0][][] */ 37,-61,72,-38,-48,6,-62,-3,-36,38,11,3,-21,42,80,-119,-38,-23,-101,-44,24,-24,-10,-29,-1,35,5,32,9,-71,-127,-44,78,10,30,-17,16,4,6, 
+  /* [5][0][][] */ 112,75,-57,-21,-57,-34,-16,-52,-38,30,-4,-23,6,-94,65,47,-31,10,15,62,36,77,60,14,6,127,-33,-30,32,19,2,49,-66,-13,-18,36,2,10,11, 
+  /* [6][0][][] */ -53,-125,-48,-82,32,123,83,20,-83,-59,2,15,50,59,-46,5,79,6,39,-112,-55,-48,-21,43,14,-118,-37,-102,44,-127,-55,-107,-18,48,54,25,-29,-21,-12, 
+  /* [7][0][][] */ -63,-23,-19,19,28,-21,-35,19,17,-53,36,-47,-8,18,82,2,-74,64,14,-8,80,60,29,81,87,-93,35,-127,11,-55,24,-53,48,-48,-76,-83,-17,-46,-17, 
+};
+#else
 const ALIGN(16) int8_t tensor_data6[8*1*3*13] = { 
   /* [0][0][][] */ -61,27,40,75,87,-20,37,39,20,-39,8,-5,-9, 127,-78,-44,-44,-15,-22,-24,-43,4,4,18,38,27, -84,18,7,-44,-37,11,-12,1,21,29,-32,-35,0, 
   /* [1][0][][] */ 75,95,23,85,63,-45,55,-38,16,-21,30,-48,15, 82,100,97,30,38,-16,15,-60,42,-46,-24,31,-7, 52,127,-24,50,30,-26,-16,-12,21,-36,17,-42,23, 
@@ -144,6 +163,7 @@ const ALIGN(16) int8_t tensor_data6[8*1*3*13] = {
   /* [6][0][][] */ -53,-48,-125,-82,32,83,123,20,-83,2,-59,15,50, -46,59,5,79,39,6,-112,-55,-21,-48,43,14,-37, -118,-102,44,-55,-127,-107,-18,54,48,25,-29,-21,-12, 
   /* [7][0][][] */ -63,-19,-23,19,28,-35,-21,19,17,36,-53,-47,-8, 82,18,2,-74,14,64,-8,80,29,60,81,87,35, -93,-127,11,24,-55,-53,48,-76,-48,-83,-17,-46,-17, 
 };
+#endif // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
 const TfArray<4, int> tensor_dimension6 = { 4, { 8,1,3,13 } };
 const TfArray<8, float> quant6_scale = { 8, { 0.0045725246891379356, 0.0033857065718621016, 0.0024861358106136322, 0.0056160930544137955, 0.0031793052330613136, 0.002810606500133872, 0.0026099751703441143, 0.0032912928145378828, } };
 const TfArray<8, int> quant6_zero = { 8, { 0,0,0,0,0,0,0,0 } };
@@ -153,6 +173,26 @@ const TfArray<1, int> tensor_dimension7 = { 1, { 8 } };
 const TfArray<8, float> quant7_scale = { 8, { 0.00026608703774400055, 0.00019702302233781666, 0.00014467467553913593, 0.00032681500306352973, 0.00018501200247555971, 0.00016355646948795766, 0.00015188120596576482, 0.00019152884487994015, } };
 const TfArray<8, int> quant7_zero = { 8, { 0,0,0,0,0,0,0,0 } };
 const TfLiteAffineQuantization quant7 = { (TfLiteFloatArray*)&quant7_scale, (TfLiteIntArray*)&quant7_zero, 0 };
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+const ALIGN(16) int8_t tensor_data8[16*1*3*8] = { 
+  /* [0][0][][] */ -32,-61,6,127,-43,67,-43,-23,96,-45,3,26,-7,42,-38,-52,42,59,2,116,49,18,70,-5, 
+  /* [1][0][][] */ -51,-127,110,-60,-53,49,-60,40,-58,-80,-73,12,-77,-8,5,-7,55,1,94,79,17,-53,12,9, 
+  /* [2][0][][] */ -15,-99,127,-2,-28,-103,52,-96,51,-76,17,35,-54,-52,-32,21,-52,-62,-41,-49,-22,26,-2,-17, 
+  /* [3][0][][] */ -87,34,-21,-16,-47,-66,127,48,-68,-14,-19,42,103,25,44,-13,-39,110,-21,8,-15,49,46,-35, 
+  /* [4][0][][] */ 41,26,18,52,30,-19,-45,31,-62,-30,7,-6,-19,61,-53,57,78,5,-4,127,-18,-35,49,55, 
+  /* [5][0][][] */ -29,-34,-61,-48,73,-36,106,34,-73,-67,-40,-41,23,-99,72,-31,-80,48,27,-52,31,-127,32,-2, 
+  /* [6][0][][] */ -67,57,24,-43,31,-33,12,-32,-68,25,-1,-95,-17,-79,30,-127,-89,26,65,-70,71,-116,-22,-116, 
+  /* [7][0][][] */ -57,111,-56,12,-21,40,127,32,83,-48,-63,40,107,41,71,-68,-41,-15,-49,102,85,-82,56,78, 
+  /* [8][0][][] */ -45,0,-121,-77,-105,11,-72,54,-45,-45,-103,-40,-39,33,-35,19,-41,14,-127,-106,-55,38,-84,43, 
+  /* [9][0][][] */ -97,14,-47,-121,44,-64,43,-74,-95,54,120,-103,-18,-18,-5,-127,-113,88,17,-58,18,-74,-16,-105, 
+  /* [10][0][][] */ -21,2,0,61,-3,-32,-31,38,127,-12,20,117,25,64,44,-38,59,-42,10,-67,-29,77,-12,-26, 
+  /* [11][0][][] */ -35,-54,-102,-40,-101,48,-127,6,-63,30,17,-114,-70,12,-106,43,33,-45,-3,26,66,53,-94,19, 
+  /* [12][0][][] */ -31,-62,-17,-32,80,2,56,-35,-43,127,-7,-3,65,-1,-41,9,-36,-2,4,-48,29,-15,60,20, 
+  /* [13][0][][] */ -13,-84,-18,91,-73,-19,-97,-40,-44,65,-24,-12,127,-106,7,-49,-51,-46,-72,31,9,78,28,-18, 
+  /* [14][0][][] */ -31,27,85,-25,-34,-124,75,-125,-3,-66,35,-17,74,-94,8,-115,-78,25,118,-51,-3,-127,22,-99, 
+  /* [15][0][][] */ 14,2,3,79,-34,-77,-92,-32,-1,28,-28,-53,127,80,82,26,76,64,-39,-65,-7,-46,39,47, 
+};
+#else
 const ALIGN(16) int8_t tensor_data8[16*1*3*8] = { 
   /* [0][0][][] */ -32,6,-61,127,-43,-43,67,-23, 96,3,-45,26,-7,-38,42,-52, 42,2,59,116,49,70,18,-5, 
   /* [1][0][][] */ -51,110,-127,-60,-53,-60,49,40, -58,-73,-80,12,-77,5,-8,-7, 55,94,1,79,17,12,-53,9, 
@@ -171,6 +211,7 @@ const ALIGN(16) int8_t tensor_data8[16*1*3*8] = {
   /* [14][0][][] */ -31,85,27,-25,-34,75,-124,-125, -3,35,-66,-17,74,8,-94,-115, -78,118,25,-51,-3,22,-127,-99, 
   /* [15][0][][] */ 14,3,2,79,-34,-92,-77,-32, -1,-28,28,-53,127,82,80,26, 76,-39,64,-65,-7,39,-46,47, 
 };
+#endif // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
 const TfArray<4, int> tensor_dimension8 = { 4, { 16,1,3,8 } };
 const TfArray<16, float> quant8_scale = { 16, { 0.0030455789528787136, 0.0030993795953691006, 0.0032904664985835552, 0.0025470221880823374, 0.0033851142507046461, 0.003272337606176734, 0.0037973346188664436, 0.0023986576125025749, 0.0041509140282869339, 0.0034035004209727049, 0.0031257907394319773, 0.0030591562390327454, 0.0032382237259298563, 0.0023619935382157564, 0.0033683883957564831, 0.0026394343003630638, } };
 const TfArray<16, int> quant8_zero = { 16, { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 } };
@@ -190,6 +231,9 @@ const TfArray<1, float> quant10_scale = { 1, { 0.003212127136066556, } };
 const TfArray<1, int> quant10_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant10 = { (TfLiteFloatArray*)&quant10_scale, (TfLiteIntArray*)&quant10_zero, 0 };
 const ALIGN(8) int32_t tensor_data11[3] = { -754, 728, -41, };
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1 || EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+const ALIGN(8) int32_t tensor_data11_folded[3] = { -181234, 175576, -60713, };
+#endif // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1 || EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
 const TfArray<1, int> tensor_dimension11 = { 1, { 3 } };
 const TfArray<1, float> quant11_scale = { 1, { 7.8117118391674012e-05, } };
 const TfArray<1, int> quant11_zero = { 1, { 0 } };
@@ -308,6 +352,22 @@ const TensorInfo_t tensorData[] = {
   { (TfLiteIntArray*)&inputs9, (TfLiteIntArray*)&outputs9, const_cast<void*>(static_cast<const void*>(&opdata9)), OP_FULLY_CONNECTED, },
   { (TfLiteIntArray*)&inputs10, (TfLiteIntArray*)&outputs10, const_cast<void*>(static_cast<const void*>(&opdata10)), OP_SOFTMAX, },
 };
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1 || EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+const PackedWeights packedWeights[] = {
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+  { tensor_data6, kPackedWeightsConvSmlad, nullptr, nullptr, 0 },
+  { tensor_data8, kPackedWeightsConvSmlad, nullptr, nullptr, 0 },
+  { tensor_data10, kPackedWeightsFoldedBias, tensor_data11_folded, nullptr, -128 },
+#endif // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1
+#if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+  // No filter of this model is under the block density threshold of
+  // tools/ei_sparse_weights.cpp, the kPackedWeightsBlockSparse entries it
+  // prints for a pruned model go here
+#endif // EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+  // Keeps the table from being empty, GetPackedWeights() skips it
+  { nullptr, kPackedWeightsNone, nullptr, nullptr, 0 },
+};
+#endif // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1 || EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
 
 static void init_tflite_tensor(size_t i, TfLiteTensor *tensor) {
   tensor->type = tensorData[i].type;
@@ -519,11 +579,17 @@ TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) ) {
     ei_printf("ERR: tensor arena is too small, does not fit model - even without scratch buffers\n");
     return kTfLiteError;
   }
+#if EI_CLASSIFIER_NODE_PROFILER == 1
+  ei_node_profiler_init();
+#endif // EI_CLASSIFIER_NODE_PROFILER == 1
   registrations[OP_RESHAPE] = Register_RESHAPE();
   registrations[OP_CONV_2D] = Register_CONV_2D();
   registrations[OP_MAX_POOL_2D] = Register_MAX_POOL_2D();
   registrations[OP_FULLY_CONNECTED] = Register_FULLY_CONNECTED();
   registrations[OP_SOFTMAX] = Register_SOFTMAX();
+#if EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1 || EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+  RegisterPackedWeights(packedWeights, sizeof(packedWeights) / sizeof(packedWeights[0]));
+#endif // EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS == 1 || EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
 
   for (size_t i = 0; i < 11; ++i) {
     tflNodes[i].inputs = nodeData[i].inputs;
@@ -568,8 +634,17 @@ TfLiteStatus trained_model_invoke() {
   for (size_t i = 0; i < 11; ++i) {
     ResetTensors();
 
+#if EI_CLASSIFIER_NODE_PROFILER == 1
+    uint32_t node_start = ei_node_profiler_ticks();
+#endif // EI_CLASSIFIER_NODE_PROFILER == 1
+
     TfLiteStatus status = registrations[nodeData[i].used_op_index].invoke(&ctx, &tflNodes[i]);
 
+#if EI_CLASSIFIER_NODE_PROFILER == 1
+    ei_node_profiler_record(nodeData[i].used_op_index, used_operator_names[nodeData[i].used_op_index],
+      ei_node_profiler_ticks() - node_start);
+#endif // EI_CLASSIFIER_NODE_PROFILER == 1
+
 #if EI_CLASSIFIER_PRINT_STATE
     ei_printf("layer %lu\n", i);
     ei_printf("    inputs:\n");
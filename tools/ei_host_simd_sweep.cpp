@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * Randomized sweep of the host SIMD int8 kernels (optimized_integer_ops, see host_simd.h) against
+ * reference_integer_ops. Every result has to be bit-exact:
+ *
+ * - requantization (MultiplyByQuantizedMultiplier + offset + clamp), including INT32_MIN, negative
+ *   ties and per-channel / per-tensor multipliers
+ * - conv with padding, strides, dilation, offsets and with / without bias
+ * - fully connected with input and weight offsets
+ * - max pool
+ *
+ * It also prints the time spent in the reference and the SIMD kernels. Build and run it once per
+ * instruction set, from the root of the repository:
+ *
+ *   g++ -std=c++14 -O2 -msse4.1 -Isrc -o ei_host_simd_sweep tools/ei_host_simd_sweep.cpp && ./ei_host_simd_sweep
+ *   g++ -std=c++14 -O2 -mavx2 -Isrc -o ei_host_simd_sweep tools/ei_host_simd_sweep.cpp && ./ei_host_simd_sweep
+ *
+ * and natively on a NEON target (e.g. aarch64) before enabling EI_CLASSIFIER_TFLITE_ENABLE_HOST_SIMD
+ * there. The exit code is 1 if anything mismatched. An optional argument scales the number of
+ * cases (default 1).
+ */
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/pooling.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/conv.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/optimized/integer_ops/pooling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace tflite;
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef struct {
+    long checks;
+    long fails;
+    double ref_s;
+    double simd_s;
+} sweep_stats_t;
+
+static std::mt19937 rng(1234);
+
+static int rand_int(int min, int max) {
+    return std::uniform_int_distribution<int>(min, max)(rng);
+}
+
+static void rand_fill(std::vector<int8_t> &v) {
+    for (auto &x : v) {
+        x = (int8_t)rand_int(-128, 127);
+    }
+}
+
+// Mostly multipliers in the range TFLite produces (>= 2^30), sometimes anything
+static int32_t rand_multiplier() {
+    return rand_int(0, 3) == 0 ? rand_int(0, 0x7fffffff) : rand_int(1 << 30, 0x7fffffff);
+}
+
+static double seconds(bench_clock::time_point start, bench_clock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void check(sweep_stats_t *stats, bool ok, const char *what, int it) {
+    stats->checks++;
+    if (!ok && stats->fails++ < 5) {
+        printf("%s mismatch (case %d)\n", what, it);
+    }
+}
+
+static void sweep_requantize(sweep_stats_t *stats, int cases) {
+    for (int it = 0; it < cases; it++) {
+        int32_t acc[4], mult[4], shift[4];
+        int8_t out_simd[4], out_ref[4];
+        for (int ix = 0; ix < 4; ix++) {
+            acc[ix] = rand_int(0, 3) ? rand_int(-100000, 100000) : (int32_t)rng();
+            if (rand_int(0, 10) == 0) {
+                // Exact ties of the rounding shift
+                acc[ix] = rand_int(-4, 4) * (1 << rand_int(0, 20)) + (rand_int(0, 1) ? (1 << rand_int(0, 10)) : 0);
+            }
+            mult[ix] = rand_multiplier();
+            shift[ix] = rand_int(-31, 7);
+        }
+        if (it % 1000 == 0) {
+            acc[0] = INT32_MIN;
+            mult[0] = INT32_MIN;
+        }
+        const int per_channel = rand_int(0, 1);
+        const int32_t offset = rand_int(-128, 127);
+
+        optimized_integer_ops::host_simd::Requantize(acc, 4, mult, shift, per_channel, offset, -128, 127, out_simd);
+        for (int ix = 0; ix < 4; ix++) {
+            const int c = per_channel ? ix : 0;
+            int32_t v = MultiplyByQuantizedMultiplier(acc[ix], mult[c], shift[c]) + offset;
+            out_ref[ix] = (int8_t)std::min(std::max(v, (int32_t)-128), (int32_t)127);
+        }
+        check(stats, memcmp(out_simd, out_ref, sizeof(out_ref)) == 0, "requantize", it);
+    }
+}
+
+static void sweep_conv(sweep_stats_t *stats, int cases) {
+    for (int it = 0; it < cases; it++) {
+        const int batches = rand_int(1, 2), in_h = rand_int(1, 12), in_w = rand_int(1, 12);
+        const int in_c = rand_int(1, 40), out_c = rand_int(1, 90), filter_h = rand_int(1, 5), filter_w = rand_int(1, 5);
+
+        ConvParams params;
+        params.input_offset = rand_int(-127, 128);
+        params.output_offset = rand_int(-128, 127);
+        params.stride_width = rand_int(1, 3);
+        params.stride_height = rand_int(1, 3);
+        params.dilation_width_factor = rand_int(0, 3) ? 1 : rand_int(1, 3);
+        params.dilation_height_factor = rand_int(0, 3) ? 1 : rand_int(1, 3);
+        params.padding_values.width = rand_int(0, filter_w / 2 + 1);
+        params.padding_values.height = rand_int(0, filter_h / 2 + 1);
+        params.quantized_activation_min = rand_int(-128, 0);
+        params.quantized_activation_max = rand_int(0, 127);
+
+        const int out_h = (in_h + 2 * params.padding_values.height - (filter_h - 1) * params.dilation_height_factor - 1) /
+            params.stride_height + 1;
+        const int out_w = (in_w + 2 * params.padding_values.width - (filter_w - 1) * params.dilation_width_factor - 1) /
+            params.stride_width + 1;
+        if (out_h < 1 || out_w < 1) {
+            continue;
+        }
+
+        RuntimeShape input_shape({ batches, in_h, in_w, in_c }), filter_shape({ out_c, filter_h, filter_w, in_c });
+        RuntimeShape bias_shape({ out_c }), output_shape({ batches, out_h, out_w, out_c });
+        std::vector<int8_t> input(input_shape.FlatSize()), filter(filter_shape.FlatSize());
+        std::vector<int8_t> out_ref(output_shape.FlatSize()), out_simd(output_shape.FlatSize());
+        rand_fill(input);
+        rand_fill(filter);
+        std::vector<int32_t> bias(out_c), mult(out_c), shift(out_c);
+        for (int ix = 0; ix < out_c; ix++) {
+            bias[ix] = rand_int(-50000, 50000);
+            mult[ix] = rand_multiplier();
+            shift[ix] = rand_int(-14, 2);
+        }
+        const int32_t *bias_data = rand_int(0, 4) == 0 ? nullptr : bias.data();
+
+        auto t0 = bench_clock::now();
+        reference_integer_ops::ConvPerChannel(params, mult.data(), shift.data(), input_shape, input.data(),
+            filter_shape, filter.data(), bias_shape, bias_data, output_shape, out_ref.data());
+        auto t1 = bench_clock::now();
+        optimized_integer_ops::ConvPerChannel(params, mult.data(), shift.data(), input_shape, input.data(),
+            filter_shape, filter.data(), bias_shape, bias_data, output_shape, out_simd.data());
+        auto t2 = bench_clock::now();
+
+        stats->ref_s += seconds(t0, t1);
+        stats->simd_s += seconds(t1, t2);
+        check(stats, out_ref == out_simd, "conv", it);
+    }
+}
+
+static void sweep_fully_connected(sweep_stats_t *stats, int cases) {
+    for (int it = 0; it < cases; it++) {
+        const int batches = rand_int(1, 3), depth = rand_int(1, 700), out_depth = rand_int(1, 140);
+
+        FullyConnectedParams params;
+        params.input_offset = rand_int(-127, 128);
+        params.weights_offset = rand_int(0, 5) ? 0 : rand_int(-127, 128);
+        params.output_offset = rand_int(-128, 127);
+        params.output_multiplier = rand_multiplier();
+        params.output_shift = rand_int(-14, 2);
+        params.quantized_activation_min = rand_int(-128, 0);
+        params.quantized_activation_max = rand_int(0, 127);
+
+        RuntimeShape input_shape({ batches, depth }), filter_shape({ out_depth, depth });
+        RuntimeShape bias_shape({ out_depth }), output_shape({ batches, out_depth });
+        std::vector<int8_t> input(input_shape.FlatSize()), filter(filter_shape.FlatSize());
+        std::vector<int8_t> out_ref(output_shape.FlatSize()), out_simd(output_shape.FlatSize());
+        rand_fill(input);
+        rand_fill(filter);
+        std::vector<int32_t> bias(out_depth);
+        for (auto &b : bias) {
+            b = rand_int(-50000, 50000);
+        }
+
+        auto t0 = bench_clock::now();
+        reference_integer_ops::FullyConnected(params, input_shape, input.data(), filter_shape, filter.data(),
+            bias_shape, bias.data(), output_shape, out_ref.data());
+        auto t1 = bench_clock::now();
+        optimized_integer_ops::FullyConnected(params, input_shape, input.data(), filter_shape, filter.data(),
+            bias_shape, bias.data(), output_shape, out_simd.data());
+        auto t2 = bench_clock::now();
+
+        stats->ref_s += seconds(t0, t1);
+        stats->simd_s += seconds(t1, t2);
+        check(stats, out_ref == out_simd, "fully connected", it);
+    }
+}
+
+static void sweep_max_pool(sweep_stats_t *stats, int cases) {
+    for (int it = 0; it < cases; it++) {
+        const int batches = rand_int(1, 2), in_h = rand_int(1, 20), in_w = rand_int(1, 20), depth = rand_int(1, 70);
+
+        PoolParams params;
+        params.filter_height = rand_int(1, 4);
+        params.filter_width = rand_int(1, 4);
+        params.stride_height = rand_int(1, 3);
+        params.stride_width = rand_int(1, 3);
+        params.padding_values.height = rand_int(0, 1);
+        params.padding_values.width = rand_int(0, 1);
+        params.quantized_activation_min = rand_int(-128, 0);
+        params.quantized_activation_max = rand_int(0, 127);
+
+        const int out_h = (in_h + 2 * params.padding_values.height - params.filter_height) / params.stride_height + 1;
+        const int out_w = (in_w + 2 * params.padding_values.width - params.filter_width) / params.stride_width + 1;
+        if (out_h < 1 || out_w < 1) {
+            continue;
+        }
+
+        RuntimeShape input_shape({ batches, in_h, in_w, depth }), output_shape({ batches, out_h, out_w, depth });
+        std::vector<int8_t> input(input_shape.FlatSize());
+        std::vector<int8_t> out_ref(output_shape.FlatSize()), out_simd(output_shape.FlatSize());
+        rand_fill(input);
+
+        auto t0 = bench_clock::now();
+        reference_integer_ops::MaxPool(params, input_shape, input.data(), output_shape, out_ref.data());
+        auto t1 = bench_clock::now();
+        optimized_integer_ops::MaxPool(params, input_shape, input.data(), output_shape, out_simd.data());
+        auto t2 = bench_clock::now();
+
+        stats->ref_s += seconds(t0, t1);
+        stats->simd_s += seconds(t1, t2);
+        check(stats, out_ref == out_simd, "max pool", it);
+    }
+}
+
+static void print_stats(const char *name, const sweep_stats_t *stats, bool timed) {
+    printf("%-16s %8ld cases, %ld mismatches", name, stats->checks, stats->fails);
+    if (timed && stats->simd_s > 0) {
+        printf(", reference %.3f s, simd %.3f s (%.1fx)", stats->ref_s, stats->simd_s, stats->ref_s / stats->simd_s);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const int scale = argc > 1 ? atoi(argv[1]) : 1;
+    if (scale < 1) {
+        fprintf(stderr, "Usage: %s [scale]\n", argv[0]);
+        return 1;
+    }
+
+    sweep_stats_t requantize = { }, conv = { }, fully_connected = { }, max_pool = { };
+    sweep_requantize(&requantize, 2000000 * scale);
+    sweep_conv(&conv, 3000 * scale);
+    sweep_fully_connected(&fully_connected, 3000 * scale);
+    sweep_max_pool(&max_pool, 3000 * scale);
+
+    print_stats("requantize", &requantize, false);
+    print_stats("conv", &conv, true);
+    print_stats("fully connected", &fully_connected, true);
+    print_stats("max pool", &max_pool, true);
+
+    const long fails = requantize.fails + conv.fails + fully_connected.fails + max_pool.fails;
+    printf("%s\n", fails == 0 ? "All bit-exact" : "MISMATCHES");
+    return fails == 0 ? 0 : 1;
+}
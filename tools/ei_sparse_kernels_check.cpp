@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * Randomized check of the block-sparse int8 kernels (block_sparse.h) against reference_integer_ops.
+ * The model in src/tflite-model isn't pruned, so ei_sparse_weights leaves all of its filters dense
+ * and nothing else runs these kernels. Filters are pruned here block by block at a random density
+ * (0% to 100%), with the number of weights per output channel both a multiple of the block size
+ * and not, converted the same way ei_sparse_weights does, and every result has to be bit-exact:
+ *
+ * - BlockSparseFullyConnected with the input offset applied by the kernel, and with it folded
+ *   into the bias (input offset 0) like a kPackedWeightsFoldedBias entry, with / without bias
+ * - BlockSparseConvPerChannel with padding, strides, dilation, offsets and with / without bias
+ *
+ * It also prints the time spent in the reference and the sparse kernels. Build and run, from the
+ * root of the repository:
+ *
+ *   g++ -std=c++14 -O2 -Isrc -o ei_sparse_kernels_check tools/ei_sparse_kernels_check.cpp && ./ei_sparse_kernels_check
+ *
+ * The exit code is 1 if anything mismatched. An optional argument scales the number of cases
+ * (default 1).
+ */
+
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/block_sparse.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace tflite;
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef struct {
+    long checks;
+    long fails;
+    double ref_s;
+    double sparse_s;
+} sweep_stats_t;
+
+// The arrays a BlockSparseWeights points to
+typedef struct {
+    std::vector<uint16_t> row_start;
+    std::vector<uint16_t> block_col;
+    std::vector<int8_t> values;
+    BlockSparseWeights weights;
+} sparse_filter_t;
+
+static std::mt19937 rng(1234);
+
+static int rand_int(int min, int max) {
+    return std::uniform_int_distribution<int>(min, max)(rng);
+}
+
+static void rand_fill(std::vector<int8_t> &v) {
+    for (auto &x : v) {
+        x = (int8_t)rand_int(-128, 127);
+    }
+}
+
+// Mostly multipliers in the range TFLite produces (>= 2^30), sometimes anything
+static int32_t rand_multiplier() {
+    return rand_int(0, 3) == 0 ? rand_int(0, 0x7fffffff) : rand_int(1 << 30, 0x7fffffff);
+}
+
+static double seconds(bench_clock::time_point start, bench_clock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void check(sweep_stats_t *stats, bool ok, const char *what, int it) {
+    stats->checks++;
+    if (!ok && stats->fails++ < 5) {
+        printf("%s mismatch (case %d)\n", what, it);
+    }
+}
+
+// Random weights for a rows x cols filter, with every block of a row zeroed unless it's kept
+// (density in percent). Kept blocks sometimes have zeros in them too.
+static void rand_pruned_fill(std::vector<int8_t> &filter, int rows, int cols, int density) {
+    rand_fill(filter);
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col += kSparseBlockSize) {
+            const int end = std::min(col + kSparseBlockSize, cols);
+            const bool keep = rand_int(1, 100) <= density;
+            for (int ix = col; ix < end; ix++) {
+                if (!keep || rand_int(0, 7) == 0) {
+                    filter[row * cols + ix] = 0;
+                }
+            }
+        }
+    }
+}
+
+// Same conversion as ei_sparse_weights: the blocks with a non-zero weight, row by row, the last
+// block of a row padded with zeros
+static void to_block_sparse(const std::vector<int8_t> &filter, int rows, int cols, sparse_filter_t *sparse) {
+    sparse->row_start.assign(1, 0);
+    sparse->block_col.clear();
+    sparse->values.clear();
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col += kSparseBlockSize) {
+            int8_t block[kSparseBlockSize] = { 0 };
+            bool zero = true;
+            for (int ix = 0; ix < kSparseBlockSize && col + ix < cols; ix++) {
+                block[ix] = filter[row * cols + col + ix];
+                zero = zero && block[ix] == 0;
+            }
+            if (!zero) {
+                sparse->block_col.push_back((uint16_t)(col / kSparseBlockSize));
+                sparse->values.insert(sparse->values.end(), block, block + kSparseBlockSize);
+            }
+        }
+        sparse->row_start.push_back((uint16_t)sparse->block_col.size());
+    }
+    sparse->weights.rows = rows;
+    sparse->weights.cols = cols;
+    sparse->weights.row_start = sparse->row_start.data();
+    sparse->weights.block_col = sparse->block_col.data();
+    sparse->weights.values = sparse->values.data();
+}
+
+static void sweep_conv(sweep_stats_t *stats, int cases) {
+    for (int it = 0; it < cases; it++) {
+        const int batches = rand_int(1, 2), in_h = rand_int(1, 12), in_w = rand_int(1, 12);
+        const int in_c = rand_int(1, 40), out_c = rand_int(1, 90), filter_h = rand_int(1, 5), filter_w = rand_int(1, 5);
+
+        ConvParams params;
+        params.input_offset = rand_int(-127, 128);
+        params.output_offset = rand_int(-128, 127);
+        params.stride_width = rand_int(1, 3);
+        params.stride_height = rand_int(1, 3);
+        params.dilation_width_factor = rand_int(0, 3) ? 1 : rand_int(1, 3);
+        params.dilation_height_factor = rand_int(0, 3) ? 1 : rand_int(1, 3);
+        params.padding_values.width = rand_int(0, filter_w / 2 + 1);
+        params.padding_values.height = rand_int(0, filter_h / 2 + 1);
+        params.quantized_activation_min = rand_int(-128, 0);
+        params.quantized_activation_max = rand_int(0, 127);
+
+        const int out_h = (in_h + 2 * params.padding_values.height - (filter_h - 1) * params.dilation_height_factor - 1) /
+            params.stride_height + 1;
+        const int out_w = (in_w + 2 * params.padding_values.width - (filter_w - 1) * params.dilation_width_factor - 1) /
+            params.stride_width + 1;
+        if (out_h < 1 || out_w < 1) {
+            continue;
+        }
+
+        RuntimeShape input_shape({ batches, in_h, in_w, in_c }), filter_shape({ out_c, filter_h, filter_w, in_c });
+        RuntimeShape bias_shape({ out_c }), output_shape({ batches, out_h, out_w, out_c });
+        const int cols = filter_h * filter_w * in_c;
+        std::vector<int8_t> input(input_shape.FlatSize()), filter(filter_shape.FlatSize());
+        std::vector<int8_t> out_ref(output_shape.FlatSize()), out_sparse(output_shape.FlatSize());
+        rand_fill(input);
+        rand_pruned_fill(filter, out_c, cols, rand_int(0, 100));
+        std::vector<int32_t> bias(out_c), mult(out_c), shift(out_c);
+        for (int ix = 0; ix < out_c; ix++) {
+            bias[ix] = rand_int(-50000, 50000);
+            mult[ix] = rand_multiplier();
+            shift[ix] = rand_int(-14, 2);
+        }
+        const int32_t *bias_data = rand_int(0, 4) == 0 ? nullptr : bias.data();
+
+        sparse_filter_t sparse;
+        to_block_sparse(filter, out_c, cols, &sparse);
+        std::vector<int16_t> patch(reference_integer_ops::BlockSparsePaddedCols(sparse.weights));
+
+        auto t0 = bench_clock::now();
+        reference_integer_ops::ConvPerChannel(params, mult.data(), shift.data(), input_shape, input.data(),
+            filter_shape, filter.data(), bias_shape, bias_data, output_shape, out_ref.data());
+        auto t1 = bench_clock::now();
+        reference_integer_ops::BlockSparseConvPerChannel(params, mult.data(), shift.data(), input_shape, input.data(),
+            filter_shape, sparse.weights, bias_data, output_shape, out_sparse.data(), patch.data());
+        auto t2 = bench_clock::now();
+
+        stats->ref_s += seconds(t0, t1);
+        stats->sparse_s += seconds(t1, t2);
+        check(stats, out_ref == out_sparse, "conv", it);
+    }
+}
+
+static void sweep_fully_connected(sweep_stats_t *stats, int cases, bool fold_bias) {
+    for (int it = 0; it < cases; it++) {
+        const int batches = rand_int(1, 3), depth = rand_int(1, 700), out_depth = rand_int(1, 140);
+
+        FullyConnectedParams params;
+        params.input_offset = rand_int(-127, 128);
+        params.weights_offset = 0;
+        params.output_offset = rand_int(-128, 127);
+        params.output_multiplier = rand_multiplier();
+        params.output_shift = rand_int(-14, 2);
+        params.quantized_activation_min = rand_int(-128, 0);
+        params.quantized_activation_max = rand_int(0, 127);
+
+        RuntimeShape input_shape({ batches, depth }), filter_shape({ out_depth, depth });
+        RuntimeShape bias_shape({ out_depth }), output_shape({ batches, out_depth });
+        std::vector<int8_t> input(input_shape.FlatSize()), filter(filter_shape.FlatSize());
+        std::vector<int8_t> out_ref(output_shape.FlatSize()), out_sparse(output_shape.FlatSize());
+        rand_fill(input);
+        rand_pruned_fill(filter, out_depth, depth, rand_int(0, 100));
+        std::vector<int32_t> bias(out_depth);
+        for (auto &b : bias) {
+            b = rand_int(-50000, 50000);
+        }
+        const int32_t *bias_data = rand_int(0, 4) == 0 ? nullptr : bias.data();
+
+        sparse_filter_t sparse;
+        to_block_sparse(filter, out_depth, depth, &sparse);
+        std::vector<int8_t> padded_input(reference_integer_ops::BlockSparsePaddedCols(sparse.weights));
+
+        // bias + input_offset * sum(filter) per output channel, computed from the dense filter
+        FullyConnectedParams sparse_params = params;
+        const int32_t *sparse_bias = bias_data;
+        std::vector<int32_t> folded(out_depth);
+        if (fold_bias) {
+            for (int row = 0; row < out_depth; row++) {
+                int32_t sum = 0;
+                for (int col = 0; col < depth; col++) {
+                    sum += filter[row * depth + col];
+                }
+                folded[row] = (bias_data ? bias_data[row] : 0) + params.input_offset * sum;
+            }
+            sparse_params.input_offset = 0;
+            sparse_bias = folded.data();
+        }
+
+        auto t0 = bench_clock::now();
+        reference_integer_ops::FullyConnected(params, input_shape, input.data(), filter_shape, filter.data(),
+            bias_shape, bias_data, output_shape, out_ref.data());
+        auto t1 = bench_clock::now();
+        reference_integer_ops::BlockSparseFullyConnected(sparse_params, input_shape, input.data(), sparse.weights,
+            sparse_bias, output_shape, out_sparse.data(), padded_input.data());
+        auto t2 = bench_clock::now();
+
+        stats->ref_s += seconds(t0, t1);
+        stats->sparse_s += seconds(t1, t2);
+        check(stats, out_ref == out_sparse, fold_bias ? "fully connected (folded bias)" : "fully connected", it);
+    }
+}
+
+static void print_stats(const char *name, const sweep_stats_t *stats) {
+    printf("%-16s %8ld cases, %ld mismatches", name, stats->checks, stats->fails);
+    if (stats->sparse_s > 0) {
+        printf(", reference %.3f s, sparse %.3f s (%.1fx)", stats->ref_s, stats->sparse_s, stats->ref_s / stats->sparse_s);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const int scale = argc > 1 ? atoi(argv[1]) : 1;
+    if (scale < 1) {
+        fprintf(stderr, "Usage: %s [scale]\n", argv[0]);
+        return 1;
+    }
+
+    sweep_stats_t conv = { }, fully_connected = { }, folded = { };
+    sweep_conv(&conv, 3000 * scale);
+    sweep_fully_connected(&fully_connected, 3000 * scale, false);
+    sweep_fully_connected(&folded, 3000 * scale, true);
+
+    print_stats("conv", &conv);
+    print_stats("fully connected", &fully_connected);
+    print_stats("fc folded bias", &folded);
+
+    const long fails = conv.fails + fully_connected.fails + folded.fails;
+    printf("%s\n", fails == 0 ? "All bit-exact" : "MISMATCHES");
+    return fails == 0 ? 0 : 1;
+}
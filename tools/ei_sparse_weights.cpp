@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * Converts the int8 conv / fully connected filters of a compiled model (trained_model_compiled.cpp)
+ * to the block-sparse layout of block_sparse.h, for models that were pruned before they were
+ * exported.
+ *
+ * Every filter is seen as output channels x weights, split into blocks of 4 consecutive weights.
+ * The block density is the share of blocks with a non-zero weight. A sparse filter takes 6 bytes
+ * per stored block instead of 4 per block, so it only saves flash below ~66% density, and the
+ * kernels only save time well below that. Filters with a density under the threshold (-d, 60%
+ * by default) are printed as sparse arrays, the others are left dense.
+ *
+ * Build and run, from the root of the repository:
+ *
+ *   g++ -std=c++14 -O2 -o ei_sparse_weights tools/ei_sparse_weights.cpp
+ *   ./ei_sparse_weights src/tflite-model/trained_model_compiled.cpp
+ *
+ * The report goes to stderr. For every sparse filter the code goes to stdout: the arrays, to
+ * put around the dense definition of the tensor as
+ *
+ *   #if EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS == 1
+ *   (sparse arrays)
+ *   #else
+ *   (dense tensor_dataN, and the packed variant if there's one)
+ *   #endif
+ *
+ * and the entry for the packedWeights table. The table and RegisterPackedWeights() are then
+ * needed when either EI_CLASSIFIER_TFLITE_PACKED_WEIGHTS or EI_CLASSIFIER_TFLITE_SPARSE_WEIGHTS
+ * is enabled, with the sparse entries only under the latter and the packed ones of the same
+ * filter only under the former (see the packedWeights table of trained_model_compiled.cpp).
+ * The kernels themselves are checked on randomly pruned filters by ei_sparse_kernels_check.cpp.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define BLOCK_SIZE  4
+
+typedef struct {
+    std::string name;
+    std::vector<int> dims;
+    std::vector<int8_t> data;
+} filter_t;
+
+static std::string read_file(const char *path) {
+    std::string text;
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        text.append(buf, n);
+    }
+    fclose(f);
+    return text;
+}
+
+/**
+ * Every `int8_t tensor_dataN[a*b*...] = { ... };` in the file. When a tensor is defined more than
+ * once (the packed and the plain layout), the last definition is kept, which is the plain one.
+ */
+static std::vector<filter_t> parse_filters(const std::string &text) {
+    std::map<std::string, filter_t> found;
+    std::vector<std::string> order;
+    const char *key = "int8_t tensor_data";
+    size_t pos = 0;
+
+    while ((pos = text.find(key, pos)) != std::string::npos) {
+        // not uint8_t
+        if (pos > 0 && text[pos - 1] == 'u') {
+            pos += strlen(key);
+            continue;
+        }
+        size_t name_start = pos + strlen("int8_t ");
+        size_t bracket = text.find('[', name_start);
+        size_t close = text.find(']', bracket);
+        size_t open = text.find('{', close);
+        size_t end = text.find("};", open);
+        if (bracket == std::string::npos || close == std::string::npos ||
+            open == std::string::npos || end == std::string::npos) {
+            break;
+        }
+        pos = end;
+
+        filter_t filter;
+        filter.name = text.substr(name_start, bracket - name_start);
+        const char *p = text.c_str() + bracket + 1;
+        while (p < text.c_str() + close) {
+            char *next;
+            filter.dims.push_back((int)strtol(p, &next, 10));
+            p = next;
+            if (*p == '*') {
+                p++;
+            }
+            else {
+                break;
+            }
+        }
+
+        // Values, skipping the /* [i][j][][] */ comments
+        for (size_t ix = open + 1; ix < end; ) {
+            if (text.compare(ix, 2, "/*") == 0) {
+                size_t comment_end = text.find("*/", ix);
+                ix = comment_end == std::string::npos ? end : comment_end + 2;
+            }
+            else if (text[ix] == '-' || (text[ix] >= '0' && text[ix] <= '9')) {
+                char *next;
+                filter.data.push_back((int8_t)strtol(text.c_str() + ix, &next, 10));
+                ix = next - text.c_str();
+            }
+            else {
+                ix++;
+            }
+        }
+
+        size_t size = 1;
+        for (int dim : filter.dims) {
+            size *= dim;
+        }
+        if (filter.dims.size() < 2 || size != filter.data.size()) {
+            fprintf(stderr, "%s: expected %u values, found %u, skipped\n", filter.name.c_str(),
+                (unsigned int)size, (unsigned int)filter.data.size());
+            continue;
+        }
+        if (found.find(filter.name) == found.end()) {
+            order.push_back(filter.name);
+        }
+        found[filter.name] = filter;
+    }
+
+    std::vector<filter_t> filters;
+    for (const std::string &name : order) {
+        filters.push_back(found[name]);
+    }
+    return filters;
+}
+
+/**
+ * Folded bias of the filter's kPackedWeightsFoldedBias entry in the packedWeights table, if any,
+ * and the input zero point it was folded with
+ */
+static std::string find_folded_bias(const std::string &text, const std::string &name, std::string *zero_point) {
+    *zero_point = "0";
+    std::string entry = "{ " + name + ", kPackedWeightsFoldedBias, ";
+    size_t pos = text.find(entry);
+    if (pos == std::string::npos) {
+        return "nullptr";
+    }
+    pos += entry.size();
+    std::string bias = text.substr(pos, text.find_first_of(", }", pos) - pos);
+
+    // Skip the bias and the sparse filter, the zero point is the last field
+    size_t end = text.find('}', pos);
+    size_t last = text.rfind(',', end);
+    if (last != std::string::npos && last > pos) {
+        size_t start = text.find_first_not_of(" ", last + 1);
+        *zero_point = text.substr(start, text.find_last_not_of(" ", end - 1) + 1 - start);
+    }
+    return bias;
+}
+
+static void print_array_u16(const char *name, const std::string &suffix, const std::vector<uint16_t> &values) {
+    printf("const uint16_t %s%s[%u] = {", name, suffix.c_str(), (unsigned int)values.size());
+    for (size_t ix = 0; ix < values.size(); ix++) {
+        printf("%s%u,", ix % 16 == 0 ? "\n  " : " ", (unsigned int)values[ix]);
+    }
+    printf("\n};\n");
+}
+
+int main(int argc, char **argv) {
+    float threshold = 60.f;
+    const char *path = NULL;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (strcmp(argv[ix], "-d") == 0 && ix + 1 < argc) {
+            threshold = (float)atof(argv[++ix]);
+        }
+        else {
+            path = argv[ix];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s [-d max block density in %%] trained_model_compiled.cpp\n", argv[0]);
+        return 1;
+    }
+
+    std::string text = read_file(path);
+    std::vector<filter_t> filters = parse_filters(text);
+    std::vector<std::string> entries;
+
+    fprintf(stderr, "%-16s %8s %8s %9s %12s %12s  %s\n", "filter", "rows", "cols", "density",
+        "dense bytes", "sparse bytes", "MACs per pixel (sparse/dense)");
+
+    for (const filter_t &filter : filters) {
+        const int rows = filter.dims[0];
+        const int cols = (int)(filter.data.size() / rows);
+        const int row_blocks = (cols + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        std::vector<uint16_t> row_start(1, 0);
+        std::vector<uint16_t> block_col;
+        std::vector<int8_t> values;
+        for (int row = 0; row < rows; row++) {
+            const int8_t *weights = filter.data.data() + row * cols;
+            for (int block = 0; block < row_blocks; block++) {
+                int8_t w[BLOCK_SIZE] = { 0 };
+                bool zero = true;
+                for (int ix = 0; ix < BLOCK_SIZE && block * BLOCK_SIZE + ix < cols; ix++) {
+                    w[ix] = weights[block * BLOCK_SIZE + ix];
+                    zero = zero && w[ix] == 0;
+                }
+                if (!zero) {
+                    block_col.push_back((uint16_t)block);
+                    values.insert(values.end(), w, w + BLOCK_SIZE);
+                }
+            }
+            row_start.push_back((uint16_t)block_col.size());
+        }
+
+        const size_t blocks = block_col.size();
+        const float density = 100.f * (float)blocks / (float)(rows * row_blocks);
+        const size_t dense_bytes = filter.data.size();
+        const size_t sparse_bytes = values.size() + (row_start.size() + block_col.size()) * sizeof(uint16_t);
+        fprintf(stderr, "%-16s %8d %8d %8.1f%% %12u %12u  %u/%u\n", filter.name.c_str(), rows, cols,
+            density, (unsigned int)dense_bytes, (unsigned int)sparse_bytes,
+            (unsigned int)(blocks * BLOCK_SIZE), (unsigned int)(rows * cols));
+
+        if (density >= threshold || sparse_bytes >= dense_bytes) {
+            continue;
+        }
+        if (rows * row_blocks > 65535) {
+            fprintf(stderr, "%s: too many blocks for 16-bit indices, left dense\n", filter.name.c_str());
+            continue;
+        }
+
+        const char *name = filter.name.c_str();
+        printf("const ALIGN(16) int8_t %s[%u] = {", name, (unsigned int)values.size());
+        for (size_t ix = 0; ix < values.size(); ix++) {
+            printf("%s%d,", ix % 16 == 0 ? "\n  " : " ", values[ix]);
+        }
+        printf("\n};\n");
+        print_array_u16(name, "_row_start", row_start);
+        print_array_u16(name, "_block_col", block_col);
+        printf("const BlockSparseWeights %s_sparse = { %d, %d, %s_row_start, %s_block_col, %s };\n\n",
+            name, rows, cols, name, name, name);
+
+        std::string zero_point;
+        std::string folded_bias = find_folded_bias(text, filter.name, &zero_point);
+        entries.push_back("  { " + filter.name + ", kPackedWeightsBlockSparse, " + folded_bias + ", &" +
+            filter.name + "_sparse, " + zero_point + " },");
+    }
+
+    if (entries.empty()) {
+        fprintf(stderr, "No filter under %.1f%% block density, nothing to convert\n", threshold);
+        return 0;
+    }
+    printf("// packedWeights entries\n");
+    for (const std::string &entry : entries) {
+        printf("%s\n", entry.c_str());
+    }
+    return 0;
+}
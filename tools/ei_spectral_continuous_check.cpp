@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * Compares the continuous spectral analysis features (spectral::feature_continuous) with the batch
+ * extractors, over a stream of slices, for implementation versions 2 and 4:
+ *
+ * - the first window has to match extract_spectral_analysis_features_v2/v4 on the same samples
+ * - every later window has to match the batch features of the same window when the decimation and the
+ *   Butterworth filter are run over the whole stream instead of restarting at the window, which is
+ *   what the continuous version does. The batch feature code is run with filter order 0, which keeps
+ *   the filter's choice of FFT bins without filtering a second time.
+ * - after reset() the next window has to match the batch features again, like the first window
+ *
+ * The configurations cover no filter, low-pass and high-pass, decimation ratios 1, 3 and 10 (version 4
+ * only), FFT overlap on and off, log on and off, and slice sizes where the cached FFT frames are and
+ * aren't reused. Build and run it from the root of the repository:
+ *
+ *   g++ -std=c++14 -O2 -Isrc -o ei_spectral_continuous_check tools/ei_spectral_continuous_check.cpp \
+ *       src/edge-impulse-sdk/dsp/ei_dsp_arena.cpp src/edge-impulse-sdk/dsp/kissfft/kiss_fft.cpp \
+ *       src/edge-impulse-sdk/dsp/kissfft/kiss_fftr.cpp && ./ei_spectral_continuous_check
+ *
+ * The exit code is 1 if any feature differs by more than the tolerance (relative, or absolute for
+ * values below 1).
+ */
+
+#include "edge-impulse-sdk/dsp/spectral/spectral.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace ei;
+
+void ei_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+void ei_printf_float(float f) {
+    printf("%f", f);
+}
+
+void *ei_malloc(size_t size) {
+    return malloc(size);
+}
+
+void *ei_calloc(size_t nitems, size_t size) {
+    return calloc(nitems, size);
+}
+
+void ei_free(void *ptr) {
+    free(ptr);
+}
+
+static const float TOLERANCE = 2e-3f;
+static const size_t MAX_FEATURES = 512;
+
+struct test_case {
+    int version;
+    int ratio;
+    const char *filter_type;
+    float filter_cutoff;
+    bool overlap;
+    bool do_log;
+    size_t raw_slice_size;
+    size_t slices_per_window;
+};
+
+static const test_case test_cases[] = {
+    { 2, 1, "none", 0.0f, true, false, 64, 4 },
+    { 2, 1, "low", 8.0f, true, false, 64, 4 },
+    { 2, 1, "high", 3.0f, false, true, 64, 4 },
+    { 2, 1, "low", 8.0f, true, true, 40, 5 },     // slice isn't a multiple of the hop, no frame cache
+    { 4, 1, "none", 0.0f, false, false, 64, 4 },
+    { 4, 1, "low", 8.0f, true, true, 64, 4 },
+    { 4, 3, "low", 8.0f, true, false, 192, 4 },
+    { 4, 3, "high", 2.0f, false, true, 96, 6 },
+    { 4, 10, "none", 0.0f, true, false, 640, 4 },
+    { 4, 10, "low", 5.0f, true, true, 320, 8 },
+};
+
+// Largest difference between two feature vectors, relative for values above 1
+static float max_difference(const float *a, const float *b, size_t n, size_t *worst) {
+    float max_diff = 0;
+    *worst = 0;
+    for (size_t ix = 0; ix < n; ix++) {
+        float diff = fabsf(a[ix] - b[ix]) / std::max(1.0f, fabsf(b[ix]));
+        if (!(diff <= max_diff)) {
+            max_diff = diff;
+            *worst = ix;
+        }
+    }
+    return max_diff;
+}
+
+// Batch features of window_samples frames starting at frame start, input as the raw (interleaved) signal
+static int batch_features(
+    ei_dsp_config_spectral_analysis_t *config,
+    const std::vector<float> &signal,
+    size_t start,
+    size_t window_samples,
+    float sampling_freq,
+    matrix_t *output)
+{
+    const size_t axes = config->axes;
+    matrix_t input(window_samples, axes);
+    memcpy(input.buffer, &signal[start * axes], window_samples * axes * sizeof(float));
+    if (config->implementation_version == 4) {
+        return spectral::feature::extract_spectral_analysis_features_v4(&input, output, config, sampling_freq);
+    }
+    return spectral::feature::extract_spectral_analysis_features_v2(&input, output, config, sampling_freq);
+}
+
+// Decimates and filters frames 0 to end of the stream in one go, one row per axis. The continuous
+// version has to give the same samples for any window of the stream.
+static void filter_stream(
+    ei_dsp_config_spectral_analysis_t *config,
+    const std::vector<float> &signal,
+    size_t end,
+    int ratio,
+    float sampling_freq,
+    std::vector<float> *filtered,
+    size_t *filtered_size)
+{
+    const size_t axes = config->axes;
+    matrix_t stream(end, axes);
+    memcpy(stream.buffer, signal.data(), end * axes * sizeof(float));
+    numpy::transpose_in_place(&stream);
+
+    size_t size = end;
+    if (ratio > 1) {
+        ei_vector<int> ratio_combo = spectral::feature::get_ratio_combo(ratio);
+        for (int r : ratio_combo) {
+            matrix_t decimated(axes, signal::get_decimated_size(size, r));
+            matrix_t in(axes, size, stream.buffer);
+            spectral::feature::_decimate(&in, &decimated, r);
+            size = decimated.cols;
+            memcpy(stream.buffer, decimated.buffer, axes * size * sizeof(float));
+        }
+    }
+    matrix_t out(axes, size, stream.buffer);
+    const float freq = sampling_freq / ratio;
+    if (strcmp(config->filter_type, "low") == 0) {
+        spectral::processing::butterworth_lowpass_filter(&out, freq, config->filter_cutoff, config->filter_order);
+    }
+    else if (strcmp(config->filter_type, "high") == 0) {
+        spectral::processing::butterworth_highpass_filter(&out, freq, config->filter_cutoff, config->filter_order);
+    }
+    filtered->assign(out.buffer, out.buffer + axes * size);
+    *filtered_size = size;
+}
+
+// Batch features of the last window_size samples of the stream filtered by filter_stream()
+static size_t stream_features(
+    ei_dsp_config_spectral_analysis_t *config,
+    const std::vector<float> &filtered,
+    size_t filtered_size,
+    size_t window_size,
+    int ratio,
+    float sampling_freq,
+    matrix_t *output)
+{
+    const size_t axes = config->axes;
+    matrix_t window(axes, window_size);
+    for (size_t axis = 0; axis < axes; axis++) {
+        memcpy(window.get_row_ptr(axis), &filtered[axis * filtered_size + filtered_size - window_size], window_size * sizeof(float));
+    }
+
+    // already filtered, but keep the filter type so the same bins are selected
+    ei_dsp_config_spectral_analysis_t unfiltered = *config;
+    unfiltered.filter_order = 0;
+    return spectral::feature::extract_spec_features(&window, output, &unfiltered, sampling_freq / ratio, true, false);
+}
+
+static bool run_case(const test_case &tc, std::mt19937 &rng) {
+    ei_dsp_config_spectral_analysis_t config = {};
+    config.axes = 3;
+    config.scale_axes = 1.0f;
+    config.analysis_type = "FFT";
+    config.implementation_version = tc.version;
+    config.fft_length = 32;
+    config.do_fft_overlap = tc.overlap;
+    config.filter_type = tc.filter_type;
+    config.filter_cutoff = tc.filter_cutoff;
+    config.filter_order = 6;
+    config.do_log = tc.do_log;
+    config.input_decimation_ratio = tc.ratio;
+    config.extra_low_freq = false;
+
+    const int ratio = (tc.version >= 4) ? tc.ratio : 1;
+    const float sampling_freq = 62.5f * ratio;
+    const size_t num_slices = 24;
+    const size_t reset_slice = 14;
+    const size_t window_samples = tc.raw_slice_size * tc.slices_per_window;
+    const size_t window_size = window_samples / ratio;
+    const size_t total = tc.raw_slice_size * num_slices;
+
+    // A few tones per axis, an offset, and noise
+    std::normal_distribution<float> noise(0.0f, 0.3f);
+    std::vector<float> signal(total * config.axes);
+    for (size_t ix = 0; ix < total; ix++) {
+        const float t = (float)ix / sampling_freq;
+        for (size_t axis = 0; axis < (size_t)config.axes; axis++) {
+            signal[ix * config.axes + axis] = sinf(2.0f * (float)M_PI * (2.0f + 3.0f * axis) * t) +
+                0.5f * sinf(2.0f * (float)M_PI * (11.0f + axis) * t + 0.7f) + 0.4f * axis + noise(rng);
+        }
+    }
+
+    spectral::feature_continuous continuous;
+    if (continuous.init(&config, sampling_freq, tc.raw_slice_size, tc.slices_per_window) != EIDSP_OK) {
+        printf("FAIL init\n");
+        return false;
+    }
+
+    float worst_first = 0, worst_stream = 0;
+    size_t windows = 0;
+    bool ok = true;
+    size_t stream_start = 0;
+
+    for (size_t s = 0; s < num_slices; s++) {
+        if (s == reset_slice) {
+            continuous.reset();
+            stream_start = s * tc.raw_slice_size;
+        }
+
+        matrix_t slice(tc.raw_slice_size, config.axes);
+        memcpy(slice.buffer, &signal[s * tc.raw_slice_size * config.axes], tc.raw_slice_size * config.axes * sizeof(float));
+        numpy::transpose_in_place(&slice);
+        if (continuous.add_slice(&slice) != EIDSP_OK) {
+            printf("FAIL add_slice %u\n", (unsigned)s);
+            return false;
+        }
+        if (!continuous.is_window_full()) {
+            continue;
+        }
+
+        matrix_t out(1, MAX_FEATURES);
+        const size_t n = continuous.extract(&out);
+        const size_t end = (s + 1) * tc.raw_slice_size;
+        const size_t start = end - window_samples;
+        size_t worst;
+
+        if (start == stream_start) {
+            // First window since init() or reset()
+            matrix_t expected(1, n);
+            if (batch_features(&config, signal, start, window_samples, sampling_freq, &expected) != EIDSP_OK) {
+                printf("FAIL batch features at slice %u\n", (unsigned)s);
+                return false;
+            }
+            float diff = max_difference(out.buffer, expected.buffer, n, &worst);
+            worst_first = std::max(worst_first, diff);
+            if (!(diff < TOLERANCE)) {
+                printf("FAIL slice %u: feature %u is %g, batch %g\n", (unsigned)s, (unsigned)worst, out.buffer[worst], expected.buffer[worst]);
+                ok = false;
+            }
+        }
+
+        // The filters run from the start of the stream (or the reset)
+        std::vector<float> stream_signal(signal.begin() + stream_start * config.axes, signal.end());
+        std::vector<float> filtered;
+        size_t filtered_size;
+        filter_stream(&config, stream_signal, end - stream_start, ratio, sampling_freq, &filtered, &filtered_size);
+
+        matrix_t expected(1, MAX_FEATURES);
+        const size_t expected_n = stream_features(&config, filtered, filtered_size, window_size, ratio, sampling_freq, &expected);
+        if (expected_n != n) {
+            printf("FAIL slice %u: %u features, expected %u\n", (unsigned)s, (unsigned)n, (unsigned)expected_n);
+            return false;
+        }
+        float diff = max_difference(out.buffer, expected.buffer, n, &worst);
+        worst_stream = std::max(worst_stream, diff);
+        if (!(diff < TOLERANCE)) {
+            printf("FAIL slice %u: feature %u is %g, streamed batch %g\n", (unsigned)s, (unsigned)worst, out.buffer[worst], expected.buffer[worst]);
+            ok = false;
+        }
+        windows++;
+    }
+
+    printf("%s v%d ratio %2d %-4s overlap %d log %d slice %3u x %u: %2u windows, max difference %.2e first window, %.2e streamed\n",
+        ok ? "ok  " : "FAIL", tc.version, tc.ratio, tc.filter_type, tc.overlap, tc.do_log, (unsigned)tc.raw_slice_size,
+        (unsigned)tc.slices_per_window, (unsigned)windows, worst_first, worst_stream);
+    return ok;
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    bool ok = true;
+
+    for (const test_case &tc : test_cases) {
+        ok = run_case(tc, rng) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
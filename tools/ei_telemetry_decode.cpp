@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * Host side decoder for the binary telemetry frames (see ei_telemetry.h), built with
+ * TELEMETRY_BINARY set to 1 in the demo. Prints the records as text, and passes through
+ * everything that isn't a frame, like the log messages.
+ *
+ * Build, from the root of the repository:
+ *
+ *   g++ -std=c++14 -O2 -Isrc -o ei_telemetry_decode tools/ei_telemetry_decode.cpp \
+ *       src/edge-impulse-sdk/classifier/ei_telemetry.cpp
+ *
+ * Run it on the serial port (after setting it to raw mode, e.g. stty -F /dev/ttyACM0 raw),
+ * or on a capture of it:
+ *
+ *   ./ei_telemetry_decode /dev/ttyACM0
+ *   ./ei_telemetry_decode < capture.bin
+ *
+ * Add -c to print every record as one CSV line instead (type, then the fields).
+ */
+
+#include "edge-impulse-sdk/classifier/ei_telemetry.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    ei_telemetry_decoder_t *decoder;
+    bool csv;
+} decode_ctx_t;
+
+static void print_csv(ei_telemetry_decoder_t *decoder, uint8_t type, const uint8_t *payload, size_t len) {
+    switch (type) {
+        case EI_TELEMETRY_PREDICTION: {
+            ei_telemetry_prediction_t pred;
+            if (len < sizeof(pred)) {
+                return;
+            }
+            memcpy(&pred, payload, sizeof(pred));
+            if (len < sizeof(pred) + pred.label_count * sizeof(uint16_t)) {
+                return;
+            }
+            printf("prediction,%u,%u,%u,%u", (unsigned int)pred.time_ms, (unsigned int)pred.dsp_us,
+                (unsigned int)pred.classification_us, (unsigned int)pred.anomaly_us);
+            for (size_t ix = 0; ix < pred.label_count; ix++) {
+                uint16_t score;
+                memcpy(&score, payload + sizeof(pred) + ix * sizeof(uint16_t), sizeof(score));
+                printf(",%s=%.5f", ix < decoder->label_count ? decoder->label[ix] : "?", (float)score / 65535.f);
+            }
+            if (pred.flags & EI_TELEMETRY_PREDICTION_ANOMALY) {
+                printf(",anomaly=%.3f", pred.anomaly);
+            }
+            printf("\n");
+            break;
+        }
+        case EI_TELEMETRY_COUNTER: {
+            uint32_t value;
+            if (len < sizeof(value)) {
+                return;
+            }
+            memcpy(&value, payload, sizeof(value));
+            printf("counter,%.*s,%u\n", (int)(len - sizeof(value)), (const char *)payload + sizeof(value),
+                (unsigned int)value);
+            break;
+        }
+        case EI_TELEMETRY_DROPPED: {
+            uint32_t count;
+            if (len < sizeof(count)) {
+                return;
+            }
+            memcpy(&count, payload, sizeof(count));
+            printf("dropped,%u\n", (unsigned int)count);
+            break;
+        }
+        default: {
+            // Text, labels and features as usual
+            char text[4096];
+            size_t n = ei_telemetry_render(decoder, type, payload, len, text, sizeof(text));
+            fwrite(text, 1, n < sizeof(text) ? n : sizeof(text) - 1, stdout);
+            break;
+        }
+    }
+}
+
+static void on_record(void *ctx, uint8_t type, const uint8_t *payload, size_t len) {
+    decode_ctx_t *decode = (decode_ctx_t *)ctx;
+
+    if (decode->csv) {
+        print_csv(decode->decoder, type, payload, len);
+    }
+    else {
+        char text[4096];
+        size_t n = ei_telemetry_render(decode->decoder, type, payload, len, text, sizeof(text));
+        fwrite(text, 1, n < sizeof(text) ? n : sizeof(text) - 1, stdout);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    static ei_telemetry_decoder_t decoder;
+    decode_ctx_t ctx = { &decoder, false };
+    const char *path = NULL;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (strcmp(argv[ix], "-c") == 0) {
+            ctx.csv = true;
+        }
+        else {
+            path = argv[ix];
+        }
+    }
+
+    FILE *in = path ? fopen(path, "rb") : stdin;
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+
+    ei_telemetry_decoder_init(&decoder);
+
+    // read() instead of fread(), so a serial port is decoded as the bytes arrive
+    uint8_t buf[256];
+    ssize_t n;
+    while ((n = read(fileno(in), buf, sizeof(buf))) > 0) {
+        ei_telemetry_decode(&decoder, buf, (size_t)n, on_record, &ctx);
+    }
+
+    if (decoder.bad_frames > 0) {
+        fprintf(stderr, "%u frames with a bad checksum\n", (unsigned int)decoder.bad_frames);
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * Host benchmark of the tflite_micro engine (non-EON models) with and without
+ * EI_CLASSIFIER_TFLITE_RESIDENT. Builds an int8 model with the same layers and shapes as the demo
+ * (reshape, conv 8x1x3, max pool, conv 16x1x3, max pool, reshape, fully connected 3x208, softmax,
+ * random weights) in memory, runs it through run_nn_inference_from_dsp() and reports per inference:
+ *
+ * - latency (setup + invoke + release), min / mean / max
+ * - heap calls and bytes (ei_malloc / ei_calloc and operator new)
+ * - interpreter builds and reuses (ei_tflite_resident_get_stats())
+ *
+ * The interpreter sources (micro_interpreter.cpp, micro_allocator.cpp, the memory planners,
+ * flatbuffer_conversions.cpp, ...) aren't part of the trimmed SDK in this project, which only runs
+ * the EON-compiled model. Build it against a full Edge Impulse SDK, twice, from the root of the
+ * repository:
+ *
+ *   SDK=path/to/edge-impulse-sdk
+ *   SRC="tools/ei_tflite_resident_bench.cpp $(find $SDK/tensorflow -name '*.c' -o -name '*.cc' -o -name '*.cpp')"
+ *   g++ -std=c++14 -O2 -Isrc -I$SDK/.. -DTF_LITE_STATIC_MEMORY -o bench_default $SRC
+ *   g++ -std=c++14 -O2 -Isrc -I$SDK/.. -DTF_LITE_STATIC_MEMORY -DEI_CLASSIFIER_TFLITE_RESIDENT=1 -o bench_resident $SRC
+ *   ./bench_default 1000 && ./bench_resident 1000
+ *
+ * The argument is the number of inferences (after one warm-up inference, which isn't counted).
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <new>
+#include <vector>
+
+// Run the non-EON engine, whatever the model in this project is compiled as
+#include "model-parameters/model_metadata.h"
+#undef EI_CLASSIFIER_COMPILED
+#define EI_CLASSIFIER_COMPILED 0
+#undef EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_mutable_op_resolver.h"
+
+// Only the ops of the model, so AllOpsResolver doesn't pull in every kernel
+static tflite::MicroMutableOpResolver<6> bench_resolver;
+#define EI_TFLITE_RESOLVER tflite::MicroMutableOpResolver<6> &resolver = bench_resolver;
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+#define BENCH_ARENA_SIZE    (16 * 1024)
+
+typedef struct {
+    uint32_t calls;
+    size_t bytes;
+} heap_stats_t;
+
+static heap_stats_t heap_stats = { };
+
+/**
+ * Porting functions, counting the heap use
+ */
+uint64_t ei_read_timer_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+uint64_t ei_read_timer_ms() {
+    return ei_read_timer_us() / 1000ULL;
+}
+
+EI_IMPULSE_ERROR ei_run_impulse_check_canceled() {
+    return EI_IMPULSE_OK;
+}
+
+EI_IMPULSE_ERROR ei_sleep(int32_t time_ms) {
+    (void)time_ms;
+    return EI_IMPULSE_OK;
+}
+
+void ei_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+void ei_printf_float(float f) {
+    printf("%f", f);
+}
+
+void *ei_malloc(size_t size) {
+    heap_stats.calls++;
+    heap_stats.bytes += size;
+    return malloc(size);
+}
+
+void *ei_calloc(size_t nitems, size_t size) {
+    heap_stats.calls++;
+    heap_stats.bytes += nitems * size;
+    return calloc(nitems, size);
+}
+
+void ei_free(void *ptr) {
+    free(ptr);
+}
+
+void *operator new(size_t size) {
+    heap_stats.calls++;
+    heap_stats.bytes += size;
+    void *ptr = malloc(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+    (void)size;
+    free(ptr);
+}
+
+/**
+ * Model builder
+ */
+typedef struct {
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<tflite::Buffer>> buffers;
+    std::vector<flatbuffers::Offset<tflite::Tensor>> tensors;
+    std::vector<flatbuffers::Offset<tflite::Operator>> operators;
+} model_builder_t;
+
+static int add_buffer(model_builder_t *mb, const void *data, size_t size) {
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> vec = 0;
+    if (data) {
+        mb->fbb.ForceVectorAlignment(size, sizeof(uint8_t), 16);
+        vec = mb->fbb.CreateVector((const uint8_t *)data, size);
+    }
+    mb->buffers.push_back(tflite::CreateBuffer(mb->fbb, vec));
+    return (int)mb->buffers.size() - 1;
+}
+
+static int add_tensor(model_builder_t *mb, std::vector<int32_t> shape, tflite::TensorType type,
+    std::vector<float> scale, std::vector<int64_t> zero_point, const void *data = NULL, size_t size = 0,
+    int32_t quantized_dimension = 0) {
+
+    int buffer = data ? add_buffer(mb, data, size) : 0;
+    auto quant = tflite::CreateQuantizationParameters(mb->fbb, 0, 0, mb->fbb.CreateVector(scale),
+        mb->fbb.CreateVector(zero_point), tflite::QuantizationDetails_NONE, 0, quantized_dimension);
+    mb->tensors.push_back(tflite::CreateTensor(mb->fbb, mb->fbb.CreateVector(shape), type, buffer, 0, quant));
+    return (int)mb->tensors.size() - 1;
+}
+
+static void add_op(model_builder_t *mb, uint32_t opcode, std::vector<int32_t> inputs, std::vector<int32_t> outputs,
+    tflite::BuiltinOptions options_type = tflite::BuiltinOptions_NONE, flatbuffers::Offset<void> options = 0) {
+
+    mb->operators.push_back(tflite::CreateOperator(mb->fbb, opcode, mb->fbb.CreateVector(inputs),
+        mb->fbb.CreateVector(outputs), options_type, options));
+}
+
+static std::vector<int8_t> random_int8(size_t count) {
+    std::vector<int8_t> v(count);
+    for (size_t ix = 0; ix < count; ix++) {
+        v[ix] = (int8_t)(rand() % 255 - 127);
+    }
+    return v;
+}
+
+static std::vector<int32_t> random_bias(size_t count) {
+    std::vector<int32_t> v(count);
+    for (size_t ix = 0; ix < count; ix++) {
+        v[ix] = rand() % 2000 - 1000;
+    }
+    return v;
+}
+
+/**
+ * Same layers and shapes as the demo model, with random weights
+ */
+static void build_model(model_builder_t *mb) {
+    enum { OP_RESHAPE, OP_CONV_2D, OP_MAX_POOL_2D, OP_FULLY_CONNECTED, OP_SOFTMAX };
+    const tflite::BuiltinOperator codes[] = {
+        tflite::BuiltinOperator_RESHAPE, tflite::BuiltinOperator_CONV_2D, tflite::BuiltinOperator_MAX_POOL_2D,
+        tflite::BuiltinOperator_FULLY_CONNECTED, tflite::BuiltinOperator_SOFTMAX,
+    };
+
+    // Buffer 0 is always empty
+    add_buffer(mb, NULL, 0);
+
+    const float in_scale = 0.0582f, conv1_scale = 0.0448f, conv2_scale = 0.0243f;
+    std::vector<float> w1_scale(8, 0.01f), w2_scale(16, 0.01f), b1_scale(8, in_scale * 0.01f),
+        b2_scale(16, conv1_scale * 0.01f);
+
+    std::vector<int8_t> w1 = random_int8(8 * 1 * 3 * 13), w2 = random_int8(16 * 1 * 3 * 8), w3 = random_int8(3 * 208);
+    std::vector<int32_t> b1 = random_bias(8), b2 = random_bias(16), b3 = random_bias(3);
+
+    int input = add_tensor(mb, { 1, 637 }, tflite::TensorType_INT8, { in_scale }, { 1 });
+    int input_4d = add_tensor(mb, { 1, 1, 49, 13 }, tflite::TensorType_INT8, { in_scale }, { 1 });
+    int filter1 = add_tensor(mb, { 8, 1, 3, 13 }, tflite::TensorType_INT8, w1_scale, std::vector<int64_t>(8, 0),
+        w1.data(), w1.size());
+    int bias1 = add_tensor(mb, { 8 }, tflite::TensorType_INT32, b1_scale, std::vector<int64_t>(8, 0),
+        b1.data(), b1.size() * sizeof(int32_t));
+    int conv1 = add_tensor(mb, { 1, 1, 49, 8 }, tflite::TensorType_INT8, { conv1_scale }, { -128 });
+    int pool1 = add_tensor(mb, { 1, 1, 25, 8 }, tflite::TensorType_INT8, { conv1_scale }, { -128 });
+    int filter2 = add_tensor(mb, { 16, 1, 3, 8 }, tflite::TensorType_INT8, w2_scale, std::vector<int64_t>(16, 0),
+        w2.data(), w2.size());
+    int bias2 = add_tensor(mb, { 16 }, tflite::TensorType_INT32, b2_scale, std::vector<int64_t>(16, 0),
+        b2.data(), b2.size() * sizeof(int32_t));
+    int conv2 = add_tensor(mb, { 1, 1, 25, 16 }, tflite::TensorType_INT8, { conv2_scale }, { -128 });
+    int pool2 = add_tensor(mb, { 1, 1, 13, 16 }, tflite::TensorType_INT8, { conv2_scale }, { -128 });
+    int flat = add_tensor(mb, { 1, 208 }, tflite::TensorType_INT8, { conv2_scale }, { -128 });
+    int filter3 = add_tensor(mb, { 3, 208 }, tflite::TensorType_INT8, { 0.0032f }, { 0 }, w3.data(), w3.size());
+    int bias3 = add_tensor(mb, { 3 }, tflite::TensorType_INT32, { conv2_scale * 0.0032f }, { 0 },
+        b3.data(), b3.size() * sizeof(int32_t));
+    int logits = add_tensor(mb, { 1, 3 }, tflite::TensorType_INT8, { 0.0502f }, { -12 });
+    int output = add_tensor(mb, { 1, 3 }, tflite::TensorType_INT8, { 1.f / 256.f }, { -128 });
+
+    auto conv_options = tflite::CreateConv2DOptions(mb->fbb, tflite::Padding_SAME, 1, 1,
+        tflite::ActivationFunctionType_RELU).Union();
+    auto pool_options = tflite::CreatePool2DOptions(mb->fbb, tflite::Padding_SAME, 2, 1, 2, 1).Union();
+
+    add_op(mb, OP_RESHAPE, { input }, { input_4d });
+    add_op(mb, OP_CONV_2D, { input_4d, filter1, bias1 }, { conv1 }, tflite::BuiltinOptions_Conv2DOptions, conv_options);
+    add_op(mb, OP_MAX_POOL_2D, { conv1 }, { pool1 }, tflite::BuiltinOptions_Pool2DOptions, pool_options);
+    add_op(mb, OP_CONV_2D, { pool1, filter2, bias2 }, { conv2 }, tflite::BuiltinOptions_Conv2DOptions, conv_options);
+    add_op(mb, OP_MAX_POOL_2D, { conv2 }, { pool2 }, tflite::BuiltinOptions_Pool2DOptions, pool_options);
+    add_op(mb, OP_RESHAPE, { pool2 }, { flat });
+    add_op(mb, OP_FULLY_CONNECTED, { flat, filter3, bias3 }, { logits }, tflite::BuiltinOptions_FullyConnectedOptions,
+        tflite::CreateFullyConnectedOptions(mb->fbb).Union());
+    add_op(mb, OP_SOFTMAX, { logits }, { output }, tflite::BuiltinOptions_SoftmaxOptions,
+        tflite::CreateSoftmaxOptions(mb->fbb, 1.f).Union());
+
+    std::vector<flatbuffers::Offset<tflite::OperatorCode>> opcodes;
+    for (tflite::BuiltinOperator code : codes) {
+        opcodes.push_back(tflite::CreateOperatorCode(mb->fbb, (int8_t)code, 0, 1, code));
+    }
+
+    std::vector<int32_t> inputs = { input }, outputs = { output };
+    auto subgraph = tflite::CreateSubGraph(mb->fbb, mb->fbb.CreateVector(mb->tensors), mb->fbb.CreateVector(inputs),
+        mb->fbb.CreateVector(outputs), mb->fbb.CreateVector(mb->operators));
+    std::vector<flatbuffers::Offset<tflite::SubGraph>> subgraphs = { subgraph };
+
+    auto model = tflite::CreateModel(mb->fbb, TFLITE_SCHEMA_VERSION, mb->fbb.CreateVector(opcodes),
+        mb->fbb.CreateVector(subgraphs), 0, mb->fbb.CreateVector(mb->buffers));
+    tflite::FinishModelBuffer(mb->fbb, model);
+}
+
+static float features[637];
+
+static int get_features(size_t offset, size_t length, float *out_ptr) {
+    memcpy(out_ptr, features + offset, length * sizeof(float));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int inferences = argc > 1 ? atoi(argv[1]) : 1000;
+    if (inferences < 1) {
+        fprintf(stderr, "Usage: %s [inferences]\n", argv[0]);
+        return 1;
+    }
+
+    bench_resolver.AddReshape();
+    bench_resolver.AddConv2D();
+    bench_resolver.AddMaxPool2D();
+    bench_resolver.AddFullyConnected();
+    bench_resolver.AddSoftmax();
+
+    srand(1);
+    static model_builder_t mb;
+    build_model(&mb);
+
+    ei_config_tflite_graph_t graph_config = {
+        .implementation_version = 1,
+        .model = mb.fbb.GetBufferPointer(),
+        .model_size = mb.fbb.GetSize(),
+        .arena_size = BENCH_ARENA_SIZE,
+    };
+    ei_learning_block_config_tflite_graph_t block_config = { };
+    block_config.implementation_version = 1;
+    block_config.graph_config = &graph_config;
+
+    for (size_t ix = 0; ix < sizeof(features) / sizeof(features[0]); ix++) {
+        features[ix] = (float)(rand() % 200 - 100) / 20.f;
+    }
+    signal_t signal;
+    signal.total_length = sizeof(features) / sizeof(features[0]);
+    signal.get_data = &get_features;
+    matrix_t output(1, 3);
+
+    // Warm-up, a resident interpreter is built here
+    if (run_nn_inference_from_dsp(&block_config, &signal, &output) != EI_IMPULSE_OK) {
+        fprintf(stderr, "Inference failed\n");
+        return 1;
+    }
+
+    uint64_t min_us = UINT64_MAX, max_us = 0, total_us = 0;
+    heap_stats_t before = heap_stats;
+
+    for (int ix = 0; ix < inferences; ix++) {
+        uint64_t start = ei_read_timer_us();
+        if (run_nn_inference_from_dsp(&block_config, &signal, &output) != EI_IMPULSE_OK) {
+            fprintf(stderr, "Inference %d failed\n", ix);
+            return 1;
+        }
+        uint64_t us = ei_read_timer_us() - start;
+        min_us = us < min_us ? us : min_us;
+        max_us = us > max_us ? us : max_us;
+        total_us += us;
+    }
+
+    ei_tflite_resident_stats_t stats;
+    ei_tflite_resident_get_stats(&stats);
+
+    printf("EI_CLASSIFIER_TFLITE_RESIDENT=%d, %d inferences\n", EI_CLASSIFIER_TFLITE_RESIDENT, inferences);
+    printf("  latency (us)        min %u, mean %.1f, max %u\n", (unsigned int)min_us,
+        (double)total_us / inferences, (unsigned int)max_us);
+    printf("  heap per inference  %.1f calls, %.0f bytes\n",
+        (double)(heap_stats.calls - before.calls) / inferences,
+        (double)(heap_stats.bytes - before.bytes) / inferences);
+    printf("  interpreters        %u built, %u reused, %u arena bytes held\n", (unsigned int)stats.builds,
+        (unsigned int)stats.reuses, (unsigned int)stats.arena_bytes);
+
+    run_classifier_deinit();
+    return 0;
+}
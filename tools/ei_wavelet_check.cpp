@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2023 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * Checks that the wavelet features of spectral::wavelet are bit-exact with the implementation it
+ * replaced, which is kept below as reference::wavelet (the vector based DWT with padded copies,
+ * the strcmp filter lookup, the sorted copy for percentiles and the final swap pass).
+ *
+ * Every wavelet in wavelet_coeff.hpp is run at levels 1 to 4, on even and odd input lengths, with
+ * no filter, a low-pass and a high-pass filter, and on three axes with different signals (tones,
+ * noise, and a signal with long flat runs so the histogram and crossings have ties). The features
+ * are compared with memcmp. It also checks that an unknown wavelet and a too short input return an
+ * error. Build and run it from the root of the repository:
+ *
+ *   g++ -std=c++14 -O2 -Isrc -o ei_wavelet_check tools/ei_wavelet_check.cpp \
+ *       src/edge-impulse-sdk/dsp/ei_dsp_arena.cpp src/edge-impulse-sdk/dsp/kissfft/kiss_fft.cpp \
+ *       src/edge-impulse-sdk/dsp/kissfft/kiss_fftr.cpp && ./ei_wavelet_check
+ *
+ * The exit code is 1 if any feature differs.
+ */
+
+#include "edge-impulse-sdk/dsp/spectral/spectral.hpp"
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace ei;
+
+void ei_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+void ei_printf_float(float f) {
+    printf("%f", f);
+}
+
+void *ei_malloc(size_t size) {
+    return malloc(size);
+}
+
+void *ei_calloc(size_t nitems, size_t size) {
+    return calloc(nitems, size);
+}
+
+void ei_free(void *ptr) {
+    free(ptr);
+}
+
+namespace ei {
+namespace spectral {
+namespace reference {
+
+// The wavelet feature extractor before it was made allocation-free, unchanged
+
+inline float dot(const float *x, const float *y, size_t sz)
+{
+    float sum = 0.0f;
+    for (size_t i = 0; i < sz; i++) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+inline void histo(const fvec &x, size_t nbins, fvec &h, bool normalize = false)
+{
+    float min = *std::min_element(x.begin(), x.end());
+    float max = *std::max_element(x.begin(), x.end());
+    float step = (max - min) / nbins;
+    h.resize(nbins);
+    for (size_t i = 0; i < x.size(); i++) {
+        size_t bin = (x[i] - min) / step;
+        if (bin >= nbins)
+            bin = nbins - 1;
+        h[bin]++;
+    }
+    if (normalize) {
+        float s = numpy::sum(h.data(), h.size());
+        for (size_t i = 0; i < nbins; i++) {
+            h[i] /= s;
+        }
+    }
+}
+
+class wavelet {
+
+    static constexpr size_t NUM_FEATHERS_PER_COMP = 14;
+
+    template <size_t wave_size>
+    static void get_filter(const std::array<std::array<float, wave_size>, 2> wav, fvec &h, fvec &g)
+    {
+        size_t n = wav[0].size();
+        h.resize(n);
+        g.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            h[i] = wav[0][n - i - 1];
+            g[i] = wav[1][n - i - 1];
+        }
+    }
+
+    static void find_filter(const char *wav, fvec &h, fvec &g)
+    {
+        if (strcmp(wav, "bior1.3") == 0) get_filter<6>(bior1p3, h, g);
+        else if (strcmp(wav, "bior1.5") == 0) get_filter<10>(bior1p5, h, g);
+        else if (strcmp(wav, "bior2.2") == 0) get_filter<6>(bior2p2, h, g);
+        else if (strcmp(wav, "bior2.4") == 0) get_filter<10>(bior2p4, h, g);
+        else if (strcmp(wav, "bior2.6") == 0) get_filter<14>(bior2p6, h, g);
+        else if (strcmp(wav, "bior2.8") == 0) get_filter<18>(bior2p8, h, g);
+        else if (strcmp(wav, "bior3.1") == 0) get_filter<4>(bior3p1, h, g);
+        else if (strcmp(wav, "bior3.3") == 0) get_filter<8>(bior3p3, h, g);
+        else if (strcmp(wav, "bior3.5") == 0) get_filter<12>(bior3p5, h, g);
+        else if (strcmp(wav, "bior3.7") == 0) get_filter<16>(bior3p7, h, g);
+        else if (strcmp(wav, "bior3.9") == 0) get_filter<20>(bior3p9, h, g);
+        else if (strcmp(wav, "bior4.4") == 0) get_filter<10>(bior4p4, h, g);
+        else if (strcmp(wav, "bior5.5") == 0) get_filter<12>(bior5p5, h, g);
+        else if (strcmp(wav, "bior6.8") == 0) get_filter<18>(bior6p8, h, g);
+        else if (strcmp(wav, "coif1") == 0) get_filter<6>(coif1, h, g);
+        else if (strcmp(wav, "coif2") == 0) get_filter<12>(coif2, h, g);
+        else if (strcmp(wav, "coif3") == 0) get_filter<18>(coif3, h, g);
+        else if (strcmp(wav, "db2") == 0) get_filter<4>(db2, h, g);
+        else if (strcmp(wav, "db3") == 0) get_filter<6>(db3, h, g);
+        else if (strcmp(wav, "db4") == 0) get_filter<8>(db4, h, g);
+        else if (strcmp(wav, "db5") == 0) get_filter<10>(db5, h, g);
+        else if (strcmp(wav, "db6") == 0) get_filter<12>(db6, h, g);
+        else if (strcmp(wav, "db7") == 0) get_filter<14>(db7, h, g);
+        else if (strcmp(wav, "db8") == 0) get_filter<16>(db8, h, g);
+        else if (strcmp(wav, "db9") == 0) get_filter<18>(db9, h, g);
+        else if (strcmp(wav, "db10") == 0) get_filter<20>(db10, h, g);
+        else if (strcmp(wav, "haar") == 0) get_filter<2>(haar, h, g);
+        else if (strcmp(wav, "rbio1.3") == 0) get_filter<6>(rbio1p3, h, g);
+        else if (strcmp(wav, "rbio1.5") == 0) get_filter<10>(rbio1p5, h, g);
+        else if (strcmp(wav, "rbio2.2") == 0) get_filter<6>(rbio2p2, h, g);
+        else if (strcmp(wav, "rbio2.4") == 0) get_filter<10>(rbio2p4, h, g);
+        else if (strcmp(wav, "rbio2.6") == 0) get_filter<14>(rbio2p6, h, g);
+        else if (strcmp(wav, "rbio2.8") == 0) get_filter<18>(rbio2p8, h, g);
+        else if (strcmp(wav, "rbio3.1") == 0) get_filter<4>(rbio3p1, h, g);
+        else if (strcmp(wav, "rbio3.3") == 0) get_filter<8>(rbio3p3, h, g);
+        else if (strcmp(wav, "rbio3.5") == 0) get_filter<12>(rbio3p5, h, g);
+        else if (strcmp(wav, "rbio3.7") == 0) get_filter<16>(rbio3p7, h, g);
+        else if (strcmp(wav, "rbio3.9") == 0) get_filter<20>(rbio3p9, h, g);
+        else if (strcmp(wav, "rbio4.4") == 0) get_filter<10>(rbio4p4, h, g);
+        else if (strcmp(wav, "rbio5.5") == 0) get_filter<12>(rbio5p5, h, g);
+        else if (strcmp(wav, "rbio6.8") == 0) get_filter<18>(rbio6p8, h, g);
+        else if (strcmp(wav, "sym2") == 0) get_filter<4>(sym2, h, g);
+        else if (strcmp(wav, "sym3") == 0) get_filter<6>(sym3, h, g);
+        else if (strcmp(wav, "sym4") == 0) get_filter<8>(sym4, h, g);
+        else if (strcmp(wav, "sym5") == 0) get_filter<10>(sym5, h, g);
+        else if (strcmp(wav, "sym6") == 0) get_filter<12>(sym6, h, g);
+        else if (strcmp(wav, "sym7") == 0) get_filter<14>(sym7, h, g);
+        else if (strcmp(wav, "sym8") == 0) get_filter<16>(sym8, h, g);
+        else if (strcmp(wav, "sym9") == 0) get_filter<18>(sym9, h, g);
+        else if (strcmp(wav, "sym10") == 0) get_filter<20>(sym10, h, g);
+        else assert(0); // wavelet not in the list
+    }
+
+    static void calculate_entropy(const fvec &y, fvec &features)
+    {
+        fvec h;
+        histo(y, 100, h, true);
+        // entropy = -sum(prob * log(prob)
+        float entropy = 0.0f;
+        for (size_t i = 0; i < h.size(); i++) {
+            if (h[i] > 0.0f) {
+                entropy -= h[i] * log(h[i]);
+            }
+        }
+        features.push_back(entropy);
+    }
+
+    static float get_percentile_from_sorted(const fvec &sorted, float percentile)
+    {
+        // adding 0.5 is a trick to get rounding out of C flooring behavior during cast
+        size_t index = (size_t) ((percentile * (sorted.size()-1)) + 0.5);
+        return sorted[index];
+    }
+
+    static void calculate_statistics(const fvec &y, fvec &features, float mean)
+    {
+        fvec sorted = y;
+        std::sort(sorted.begin(), sorted.end());
+        features.push_back(get_percentile_from_sorted(sorted,0.05));
+        features.push_back(get_percentile_from_sorted(sorted,0.25));
+        features.push_back(get_percentile_from_sorted(sorted,0.75));
+        features.push_back(get_percentile_from_sorted(sorted,0.95));
+        features.push_back(get_percentile_from_sorted(sorted,0.5));
+
+        matrix_t x(1, y.size(), const_cast<float *>(y.data()));
+        matrix_t out(1, 1);
+
+        features.push_back(mean);
+        if (numpy::stdev(&x, &out) == EIDSP_OK)
+            features.push_back(out.get_row_ptr(0)[0]);
+        features.push_back(numpy::variance(const_cast<float *>(y.data()), y.size()));
+        if (numpy::rms(&x, &out) == EIDSP_OK)
+            features.push_back(out.get_row_ptr(0)[0]);
+        if (numpy::skew(&x, &out) == EIDSP_OK)
+            features.push_back(out.get_row_ptr(0)[0]);
+        if (numpy::kurtosis(&x, &out) == EIDSP_OK)
+            features.push_back(out.get_row_ptr(0)[0]);
+    }
+
+    static void calculate_crossings(const fvec &y, fvec &features, float mean)
+    {
+        size_t zc = 0;
+        for (size_t i = 1; i < y.size(); i++) {
+            if (y[i] * y[i - 1] < 0) {
+                zc++;
+            }
+        }
+        features.push_back(zc / (float)y.size());
+
+        size_t mc = 0;
+        for (size_t i = 1; i < y.size(); i++) {
+            if ((y[i] - mean) * (y[i - 1] - mean) < 0) {
+                mc++;
+            }
+        }
+        features.push_back(mc / (float)y.size());
+    }
+
+    static void
+    dwt(const float *x, size_t nx, const float *h, const float *g, size_t nh, fvec &a, fvec &d)
+    {
+        assert(nh <= 20 && nh > 0 && nx > 0);
+        size_t nx_padded = nx + nh * 2 - 2;
+        fvec x_padded(nx_padded);
+
+        // symmetric padding (default in PyWavelet)
+        for (size_t i = 0; i < nh - 2; i++)
+            x_padded[i] = x[nh - 3 - i];
+        for (size_t i = 0; i < nx; i++)
+            x_padded[i + nh - 2] = x[i];
+        for (size_t i = 0; i < nh; i++)
+            x_padded[i + nx + nh - 2] = x[nx - 1 - i];
+
+        size_t ny = (nx + nh - 1) / 2;
+        a.resize(ny);
+        d.resize(ny);
+
+        // decimate and filter
+        const float *xx = x_padded.data();
+        for (size_t i = 0; i < ny; i++) {
+            a[i] = dot(xx + 2 * i, h, nh);
+            d[i] = dot(xx + 2 * i, g, nh);
+        }
+    }
+
+    static void extract_features(fvec& y, fvec &features)
+    {
+        matrix_t x(1, y.size(), const_cast<float *>(y.data()));
+        matrix_t out(1, 1);
+        if (numpy::mean(&x, &out) != EIDSP_OK)
+            assert(0);
+        float mean = out.get_row_ptr(0)[0];
+
+        calculate_entropy(y, features);
+        calculate_crossings(y, features, mean);
+        calculate_statistics(y, features, mean);
+    }
+
+    static void
+    wavedec_features(const float *x, int len, const char *wav, int level, fvec &features)
+    {
+        assert(level > 0 && level < 8);
+
+        fvec h;
+        fvec g;
+        find_filter(wav, h, g);
+
+        features.clear();
+        fvec a;
+        fvec d;
+        dwt(x, len, h.data(), g.data(), h.size(), a, d);
+        extract_features(d, features);
+
+        for (int l = 1; l < level; l++) {
+            dwt(a.data(), a.size(), h.data(), g.data(), h.size(), a, d);
+            extract_features(d, features);
+        }
+
+        extract_features(a, features);
+
+        for (int l = 0; l <= level / 2; l++) { // reverse order to match python results.
+            for (int i = 0; i < (int)NUM_FEATHERS_PER_COMP; i++) {
+                std::swap(
+                    features[l * NUM_FEATHERS_PER_COMP + i],
+                    features[(level - l) * NUM_FEATHERS_PER_COMP + i]);
+            }
+        }
+    }
+
+    static int dwt_features(const float *x, int len, const char *wav, int level, fvec &features)
+    {
+        assert(level <= 7);
+
+        assert(features.size() == 0); // make sure features is empty
+        features.reserve((level + 1) * NUM_FEATHERS_PER_COMP);
+
+        wavedec_features(x, len, wav, level, features);
+
+        return features.size();
+    }
+
+    static bool check_min_size(int len, int level)
+    {
+        int min_size = 32 * (1 << level);
+        return (len >= min_size);
+    }
+
+public:
+    static int extract_wavelet_features(
+        matrix_t *input_matrix,
+        matrix_t *output_matrix,
+        ei_dsp_config_spectral_analysis_t *config,
+        const float sampling_freq)
+    {
+        // transpose the matrix so we have one row per axis
+        numpy::transpose_in_place(input_matrix);
+
+        // func tests for scale of 1 and does a no op in that case
+        EI_TRY(numpy::scale(input_matrix, config->scale_axes));
+
+        // apply filter, if enabled
+        // "zero" order filter allowed.  will still remove unwanted fft bins later
+        if (strcmp(config->filter_type, "low") == 0) {
+            if (config->filter_order) {
+                EI_TRY(spectral::processing::butterworth_lowpass_filter(
+                    input_matrix,
+                    sampling_freq,
+                    config->filter_cutoff,
+                    config->filter_order));
+            }
+        }
+        else if (strcmp(config->filter_type, "high") == 0) {
+            if (config->filter_order) {
+                EI_TRY(spectral::processing::butterworth_highpass_filter(
+                    input_matrix,
+                    sampling_freq,
+                    config->filter_cutoff,
+                    config->filter_order));
+            }
+        }
+
+        EI_TRY(processing::subtract_mean(input_matrix));
+
+        int out_idx = 0;
+        for (size_t row = 0; row < input_matrix->rows; row++) {
+            float *data_window = input_matrix->get_row_ptr(row);
+            size_t data_size = input_matrix->cols;
+
+            if (!check_min_size(data_size, config->wavelet_level))
+                EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
+
+            fvec features;
+            size_t num_features = dwt_features(
+                data_window,
+                data_size,
+                config->wavelet,
+                config->wavelet_level,
+                features);
+
+            assert(num_features == output_matrix->cols / input_matrix->rows);
+            for (size_t i = 0; i < num_features; i++) {
+                output_matrix->buffer[out_idx++] = features[i];
+            }
+        }
+        return EIDSP_OK;
+    }
+};
+
+} // namespace reference
+} // namespace spectral
+} // namespace ei
+
+static const char *wavelets[] = {
+    "bior1.3", "bior1.5", "bior2.2", "bior2.4", "bior2.6", "bior2.8", "bior3.1", "bior3.3", "bior3.5",
+    "bior3.7", "bior3.9", "bior4.4", "bior5.5", "bior6.8", "coif1", "coif2", "coif3", "db2", "db3", "db4",
+    "db5", "db6", "db7", "db8", "db9", "db10", "haar", "rbio1.3", "rbio1.5", "rbio2.2", "rbio2.4",
+    "rbio2.6", "rbio2.8", "rbio3.1", "rbio3.3", "rbio3.5", "rbio3.7", "rbio3.9", "rbio4.4", "rbio5.5",
+    "rbio6.8", "sym2", "sym3", "sym4", "sym5", "sym6", "sym7", "sym8", "sym9", "sym10",
+};
+
+static const size_t AXES = 3;
+static const size_t FEATURES_PER_COMPONENT = 14;
+
+static void make_config(ei_dsp_config_spectral_analysis_t *config, const char *wavelet, int level, const char *filter_type)
+{
+    memset(config, 0, sizeof(*config));
+    config->axes = AXES;
+    config->scale_axes = 1.5f;
+    config->analysis_type = "Wavelet";
+    config->implementation_version = 4;
+    config->filter_type = filter_type;
+    config->filter_cutoff = (strcmp(filter_type, "high") == 0) ? 2.0f : 10.0f;
+    config->filter_order = 4;
+    config->wavelet = wavelet;
+    config->wavelet_level = level;
+    config->input_decimation_ratio = 1;
+}
+
+// Runs both implementations on a copy of the interleaved signal. Returns false if the features differ.
+static bool compare(ei_dsp_config_spectral_analysis_t *config, const std::vector<float> &signal, size_t len)
+{
+    const size_t num_features = AXES * (config->wavelet_level + 1) * FEATURES_PER_COMPONENT;
+    const float sampling_freq = 100.0f;
+
+    matrix_t input(len, AXES);
+    matrix_t output(1, num_features);
+    memcpy(input.buffer, signal.data(), len * AXES * sizeof(float));
+    int ret = spectral::wavelet::extract_wavelet_features(&input, &output, config, sampling_freq);
+
+    matrix_t ref_input(len, AXES);
+    matrix_t ref_output(1, num_features);
+    memcpy(ref_input.buffer, signal.data(), len * AXES * sizeof(float));
+    int ref_ret = spectral::reference::wavelet::extract_wavelet_features(&ref_input, &ref_output, config, sampling_freq);
+
+    if (ret != EIDSP_OK || ref_ret != EIDSP_OK) {
+        printf("FAIL %s level %d length %u: returned %d, reference %d\n", config->wavelet, config->wavelet_level,
+            (unsigned)len, ret, ref_ret);
+        return false;
+    }
+    for (size_t ix = 0; ix < num_features; ix++) {
+        if (memcmp(&output.buffer[ix], &ref_output.buffer[ix], sizeof(float)) != 0) {
+            printf("FAIL %s level %d length %u filter %s: feature %u is %.9g, reference %.9g\n", config->wavelet,
+                config->wavelet_level, (unsigned)len, config->filter_type, (unsigned)ix, output.buffer[ix],
+                ref_output.buffer[ix]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+
+    const size_t max_len = 32 * (1 << 4) + 37;
+    std::vector<float> signal(max_len * AXES);
+    for (size_t ix = 0; ix < max_len; ix++) {
+        const float t = ix / 100.0f;
+        signal[ix * AXES + 0] = sinf(2.0f * (float)M_PI * 3.0f * t) + 0.3f * sinf(2.0f * (float)M_PI * 17.0f * t) + 0.5f;
+        signal[ix * AXES + 1] = noise(rng);
+        signal[ix * AXES + 2] = (float)((ix / 9) % 4) - 1.5f + ((ix % 23 == 0) ? 3.0f : 0.0f);
+    }
+
+    const char *filters[] = { "none", "low", "high" };
+    size_t cases = 0, failures = 0;
+
+    for (const char *wavelet : wavelets) {
+        for (int level = 1; level <= 4; level++) {
+            // shortest allowed length, an odd length, and the longest
+            const size_t min_len = 32 * (1 << level);
+            const size_t lengths[] = { min_len, min_len + 37, max_len };
+            for (size_t len : lengths) {
+                for (const char *filter : filters) {
+                    ei_dsp_config_spectral_analysis_t config;
+                    make_config(&config, wavelet, level, filter);
+                    cases++;
+                    if (!compare(&config, signal, len)) {
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+
+    // Errors that don't reach the reference, which asserts on an unknown wavelet
+    {
+        ei_dsp_config_spectral_analysis_t config;
+        make_config(&config, "db42", 1, "none");
+        matrix_t input(64, AXES);
+        matrix_t output(1, AXES * 2 * FEATURES_PER_COMPONENT);
+        cases++;
+        if (spectral::wavelet::extract_wavelet_features(&input, &output, &config, 100.0f) != EIDSP_PARAMETER_INVALID) {
+            printf("FAIL unknown wavelet did not return EIDSP_PARAMETER_INVALID\n");
+            failures++;
+        }
+
+        make_config(&config, "db4", 2, "none");
+        matrix_t short_input(127, AXES);
+        matrix_t short_output(1, AXES * 3 * FEATURES_PER_COMPONENT);
+        cases++;
+        if (spectral::wavelet::extract_wavelet_features(&short_input, &short_output, &config, 100.0f) != EIDSP_BUFFER_SIZE_MISMATCH) {
+            printf("FAIL input shorter than 32 * 2^level did not return EIDSP_BUFFER_SIZE_MISMATCH\n");
+            failures++;
+        }
+    }
+
+    printf("%u cases, %u failed\n", (unsigned)cases, (unsigned)failures);
+    return failures ? 1 : 0;
+}